@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include "esp_err.h"
+#include "actuator_fsm.h"
+
+
+/*!
+ * Public init function. The actuator is assumed to be off.
+ */
+esp_err_t actuator_fsm_init(Actuator_fsm *fsm, const char *name, const actuator_fsm_config_struct *config,
+  void (*on)(void), void (*off)(void))
+{
+  if ((on == NULL) != (off == NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  fsm->name = name;
+  fsm->config = *config;
+  fsm->state = ACTUATOR_OFF;
+  fsm->last_change = 0;
+  fsm->has_changed = false;
+  fsm->transitions = 0;
+  fsm->held_requests = 0;
+  fsm->on = on;
+  fsm->off = off;
+
+  return ESP_OK;
+}
+
+/*!
+ * Ask for the actuator to be on or off. Returns the state it is actually in afterwards.
+ */
+actuator_fsm_state_t actuator_fsm_request(Actuator_fsm *fsm, bool on, time_t now)
+{
+  actuator_fsm_state_t requested = on ? ACTUATOR_ON : ACTUATOR_OFF;
+  uint32_t dwell_s = (fsm->state == ACTUATOR_ON) ? fsm->config.min_on_s : fsm->config.min_off_s;
+
+  if (requested == fsm->state) {
+    return fsm->state;
+  }
+
+  // Still inside the dwell time of the last transition
+  if (fsm->has_changed && ((now - fsm->last_change) < (time_t) dwell_s)) {
+    fsm->held_requests++;
+    return fsm->state;
+  }
+
+  fsm->state = requested;
+  fsm->last_change = now;
+  fsm->has_changed = true;
+  fsm->transitions++;
+
+  if (fsm->on != NULL) {
+    if (requested == ACTUATOR_ON) {
+      fsm->on();
+    } else {
+      fsm->off();
+    }
+  }
+
+  return fsm->state;
+}
@@ -0,0 +1,41 @@
+#ifndef ACTUATOR_FSM_H
+#define ACTUATOR_FSM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+typedef enum actuator_fsm_state {
+  ACTUATOR_OFF = 0,
+  ACTUATOR_ON = 1
+} actuator_fsm_state_t;
+
+typedef struct actuator_fsm_config {
+  uint32_t  min_on_s;     // Shortest time the actuator stays on once switched on
+  uint32_t  min_off_s;    // Shortest time it stays off once switched off
+} actuator_fsm_config_struct;
+
+/* On/off state machine in front of an actuator. Requests that would switch it
+ * before its dwell time is up are held back (and counted); the actuator is only
+ * driven on a real transition. */
+typedef struct Actuator_fsm {
+  const char                  *name;
+  actuator_fsm_config_struct  config;
+  actuator_fsm_state_t        state;
+  time_t                      last_change;
+  bool                        has_changed;    // No dwell applies before the first transition
+
+  uint32_t                    transitions;
+  uint32_t                    held_requests;
+
+  // Called on each transition, may be NULL if the caller drives the actuator itself
+  void                        (*on)(void);
+  void                        (*off)(void);
+} Actuator_fsm;
+
+esp_err_t             actuator_fsm_init(Actuator_fsm *fsm, const char *name, const actuator_fsm_config_struct *config,
+                        void (*on)(void), void (*off)(void));
+actuator_fsm_state_t  actuator_fsm_request(Actuator_fsm *fsm, bool on, time_t now);
+
+#endif /* ACTUATOR_FSM_H */
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cycle_profiler.h"
+
+// Histograms live in RAM for the life of the firmware; each stage has a single writer
+static stage_histogram_struct histograms[STAGE_COUNT];
+static TaskHandle_t dump_task = NULL;
+
+static const char *stage_names[STAGE_COUNT] = {
+  [STAGE_BME280_READ]       = "BME280",
+  [STAGE_UV_READ]           = "UV",
+  [STAGE_SOIL_READ]         = "Soil",
+  [STAGE_QUEUE_WAIT]        = "Queue",
+  [STAGE_CONTROL]           = "Control",
+  [STAGE_UPLINK_QUEUE_WAIT] = "Uplink queue",
+  [STAGE_SERIALIZE]         = "Serialize",
+  [STAGE_HTTP]              = "HTTP",
+  [STAGE_TIMER_CALLBACK]    = "Timer cb",
+  [STAGE_TIMER_EVENT]       = "Timer event",
+  [STAGE_COMMAND_APPLY]     = "Cmd apply",
+  [STAGE_COMMAND_LATENCY]   = "Cmd latency"
+};
+
+// Logger tag
+static const char *PROFILER_TAG = "Cycle profiler";
+
+// Private functions
+static int bucket_index(uint32_t duration_us);
+static uint32_t bucket_upper_bound(int index);
+static uint32_t percentile(const stage_histogram_struct *histogram, uint32_t per_mille);
+
+
+/*!
+ * Public init function, before any stage is recorded. dump_task_handle is notified by
+ * cycle_profiler_request_dump() and is expected to call cycle_profiler_dump(); pass NULL to dump
+ * from the caller instead.
+ */
+esp_err_t cycle_profiler_init(TaskHandle_t dump_task_handle)
+{
+  dump_task = dump_task_handle;
+  cycle_profiler_reset();
+
+  return ESP_OK;
+}
+
+/*!
+ * Hand dumps to a task started after init. The histograms are kept.
+ */
+void cycle_profiler_set_dump_task(TaskHandle_t dump_task_handle)
+{
+  dump_task = dump_task_handle;
+}
+
+void cycle_profiler_record(profile_stage_t stage, int64_t duration_us)
+{
+  stage_histogram_struct *histogram = NULL;
+  uint32_t duration = 0;
+
+  if ((unsigned)stage >= STAGE_COUNT) {
+    return;
+  }
+
+  histogram = &(histograms[stage]);
+  duration = (duration_us < 0) ? 0 :
+             (duration_us > UINT32_MAX) ? UINT32_MAX :
+             (uint32_t) duration_us;
+
+  histogram->buckets[bucket_index(duration)]++;
+  histogram->total_us += duration;
+  if (duration < histogram->min_us) {
+    histogram->min_us = duration;
+  }
+  if (duration > histogram->max_us) {
+    histogram->max_us = duration;
+  }
+  histogram->count++;
+}
+
+void cycle_profiler_get_summary(profile_stage_t stage, stage_summary_struct *summary)
+{
+  stage_histogram_struct histogram;
+
+  memset(summary, 0, sizeof(stage_summary_struct));
+  if ((unsigned)stage >= STAGE_COUNT) {
+    return;
+  }
+
+  // Work from a copy so a concurrent writer can't move the numbers mid-calculation
+  memcpy(&histogram, &(histograms[stage]), sizeof(stage_histogram_struct));
+
+  summary->name = stage_names[stage];
+  summary->count = histogram.count;
+  if (histogram.count == 0) {
+    return;
+  }
+
+  summary->mean_us = (uint32_t)(histogram.total_us / histogram.count);
+  summary->min_us = histogram.min_us;
+  summary->max_us = histogram.max_us;
+  summary->p50_us = percentile(&histogram, 500);
+  summary->p90_us = percentile(&histogram, 900);
+  summary->p99_us = percentile(&histogram, 990);
+}
+
+/*!
+ * Log a summary line and the raw buckets for every stage
+ */
+void cycle_profiler_dump(void)
+{
+  stage_summary_struct summary;
+  char bucket_line[PROFILE_BUCKETS * 11 + 1];
+
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    size_t length = 0;
+
+    cycle_profiler_get_summary(stage, &summary);
+    ESP_LOGI(PROFILER_TAG, "%-12s n=%" PRIu32 " mean=%" PRIu32 " min=%" PRIu32 " p50<=%" PRIu32 " p90<=%" PRIu32
+      " p99<=%" PRIu32 " max=%" PRIu32 " us",
+      summary.name, summary.count, summary.mean_us, summary.min_us, summary.p50_us, summary.p90_us,
+      summary.p99_us, summary.max_us);
+
+    if (summary.count == 0) {
+      continue;
+    }
+
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+      length += snprintf(&bucket_line[length], sizeof(bucket_line) - length, " %" PRIu32,
+                  histograms[stage].buckets[i]);
+    }
+    ESP_LOGI(PROFILER_TAG, "%-12s buckets:%s", summary.name, bucket_line);
+  }
+}
+
+/*!
+ * Ask the dump task to dump the histograms, so the caller doesn't block on the UART
+ */
+void cycle_profiler_request_dump(void)
+{
+  if (dump_task != NULL) {
+    xTaskNotifyGive(dump_task);
+  } else {
+    cycle_profiler_dump();
+  }
+}
+
+void cycle_profiler_reset(void)
+{
+  memset(histograms, 0, sizeof(histograms));
+  for (int stage = 0; stage < STAGE_COUNT; stage++) {
+    histograms[stage].min_us = UINT32_MAX;
+  }
+}
+
+static int bucket_index(uint32_t duration_us)
+{
+  int index = 0;
+
+  if (duration_us < (1UL << PROFILE_FIRST_BUCKET_SHIFT)) {
+    return 0;
+  }
+
+  // floor(log2(duration)) - (shift - 1)
+  index = (31 - __builtin_clz(duration_us)) - (PROFILE_FIRST_BUCKET_SHIFT - 1);
+
+  return (index >= PROFILE_BUCKETS) ? (PROFILE_BUCKETS - 1) : index;
+}
+
+static uint32_t bucket_upper_bound(int index)
+{
+  if (index >= (PROFILE_BUCKETS - 1)) {
+    return UINT32_MAX;
+  }
+
+  return (1UL << (index + PROFILE_FIRST_BUCKET_SHIFT));
+}
+
+static uint32_t percentile(const stage_histogram_struct *histogram, uint32_t per_mille)
+{
+  uint64_t target = (((uint64_t)histogram->count * per_mille) + 999) / 1000;
+  uint64_t cumulative = 0;
+
+  for (int i = 0; i < PROFILE_BUCKETS; i++) {
+    cumulative += histogram->buckets[i];
+    if (cumulative >= target) {
+      uint32_t bound = bucket_upper_bound(i);
+      // The true value can't exceed the observed maximum
+      return (bound > histogram->max_us) ? histogram->max_us : bound;
+    }
+  }
+
+  return histogram->max_us;
+}
@@ -0,0 +1,69 @@
+#ifndef CYCLE_PROFILER_H
+#define CYCLE_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+/* Log2 histogram: bucket 0 holds everything under 2^PROFILE_FIRST_BUCKET_SHIFT uSec,
+ * bucket k holds [2^(k+shift-1), 2^(k+shift)) uSec, and the last bucket is open ended. */
+#define PROFILE_BUCKETS             20
+#define PROFILE_FIRST_BUCKET_SHIFT  4
+
+// Stages of one sample's trip from the sensors to the cloud, of the controller's timer and of commands
+typedef enum profile_stage {
+  STAGE_BME280_READ = 0,
+  STAGE_UV_READ,
+  STAGE_SOIL_READ,
+  STAGE_QUEUE_WAIT,         // Sensors task -> environmental control task
+  STAGE_CONTROL,            // process_env_data + statuses
+  STAGE_UPLINK_QUEUE_WAIT,  // Environmental control task -> Firebase task
+  STAGE_SERIALIZE,
+  STAGE_HTTP,
+  STAGE_TIMER_CALLBACK,     // Fan run timer expiry, in the FreeRTOS timer task
+  STAGE_TIMER_EVENT,        // Fan run timer expiry -> handled by the environmental control task
+  STAGE_COMMAND_APPLY,      // Downlink command's first byte in -> applied to the controller
+  STAGE_COMMAND_LATENCY,    // Command written at the server -> applied, on the wall clock
+  STAGE_COUNT
+} profile_stage_t;
+
+typedef struct stage_histogram {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t buckets[PROFILE_BUCKETS];
+} stage_histogram_struct;
+
+typedef struct stage_summary {
+  const char  *name;
+  uint32_t    count;
+  uint32_t    mean_us;
+  uint32_t    min_us;
+  uint32_t    max_us;
+  // Percentiles are bucket upper bounds, so they over-estimate by at most 2x
+  uint32_t    p50_us;
+  uint32_t    p90_us;
+  uint32_t    p99_us;
+} stage_summary_struct;
+
+esp_err_t   cycle_profiler_init(TaskHandle_t dump_task_handle);
+void        cycle_profiler_set_dump_task(TaskHandle_t dump_task_handle);
+void        cycle_profiler_record(profile_stage_t stage, int64_t duration_us);
+void        cycle_profiler_get_summary(profile_stage_t stage, stage_summary_struct *summary);
+void        cycle_profiler_dump(void);
+void        cycle_profiler_request_dump(void);
+void        cycle_profiler_reset(void);
+
+/*!
+ * Record the time since start_us (from esp_timer_get_time()) against a stage
+ */
+static inline void cycle_profiler_record_since(profile_stage_t stage, int64_t start_us)
+{
+  cycle_profiler_record(stage, esp_timer_get_time() - start_us);
+}
+
+#endif /* CYCLE_PROFILER_H */
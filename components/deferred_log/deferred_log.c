@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "deferred_log.h"
+
+#define DLOG_RING_SIZE      CONFIG_DLOG_RING_SIZE
+#define DLOG_RING_MASK      (DLOG_RING_SIZE - 1)
+#define DLOG_LINE_LENGTH    160
+#define DLOG_SPEC_LENGTH    16
+
+#if (DLOG_RING_SIZE & DLOG_RING_MASK) != 0
+#error "CONFIG_DLOG_RING_SIZE must be a power of two"
+#endif
+
+typedef struct dlog_entry {
+  esp_log_level_t level;
+  const char      *tag;
+  const char      *format;
+  const char      *types;
+} dlog_entry_struct;
+
+typedef struct dlog_record {
+  // Slot turn counter: a producer may fill the slot when it equals the claimed position,
+  // the consumer may read it when it equals position + 1
+  atomic_uint     sequence;
+  uint16_t        id;
+  uint16_t        arg_count;
+  int64_t         timestamp_us;
+  uint32_t        args[DLOG_MAX_ARGS];
+} dlog_record_struct;
+
+// Catalogue lookup table, indexed by dlog_id_t
+#define DLOG_TABLE_ENTRY(id, level, tag, format, types) { level, tag, format, types },
+static const dlog_entry_struct catalog[DLOG_COUNT] = {
+  DLOG_CATALOG(DLOG_TABLE_ENTRY)
+};
+#undef DLOG_TABLE_ENTRY
+
+// Ring storage
+static dlog_record_struct ring[DLOG_RING_SIZE];
+static atomic_uint        write_position;
+static unsigned int       read_position;
+static bool               is_initialized = false;
+
+// Statistics
+static atomic_uint        written_count;
+static atomic_uint        dropped_count;
+static uint32_t           emitted_count;
+static uint32_t           max_depth;
+
+// Logger tag
+static const char *DLOG_TAG = "Deferred log";
+
+// Private functions
+static void emit_record(const dlog_record_struct *record);
+static int format_record(char *buffer, size_t buffer_length, const dlog_entry_struct *entry,
+  const dlog_record_struct *record);
+
+
+/*!
+ * Public init function -- must run before the first DLOG()
+ */
+esp_err_t deferred_log_init(void)
+{
+  for (unsigned int i = 0; i < DLOG_RING_SIZE; i++) {
+    atomic_init(&(ring[i].sequence), i);
+  }
+  atomic_init(&write_position, 0);
+  atomic_init(&written_count, 0);
+  atomic_init(&dropped_count, 0);
+  read_position = 0;
+  emitted_count = 0;
+  max_depth = 0;
+
+  // Catch catalogue entries that would overflow a record
+  for (int i = 0; i < DLOG_COUNT; i++) {
+    if (strlen(catalog[i].types) > DLOG_MAX_ARGS) {
+      ESP_LOGE(DLOG_TAG, "Catalogue entry %d has too many arguments.", i);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  is_initialized = true;
+
+  return ESP_OK;
+}
+
+/*!
+ * Hot path: claim a slot, copy the raw arguments, publish. No formatting, no locks.
+ */
+void deferred_log_write(dlog_id_t id, ...)
+{
+  dlog_record_struct *record = NULL;
+  unsigned int position = 0;
+  unsigned int sequence = 0;
+  const char *types = NULL;
+  int difference = 0;
+  va_list args;
+
+  if (!is_initialized || ((unsigned)id >= DLOG_COUNT)) {
+    return;
+  }
+
+  position = atomic_load_explicit(&write_position, memory_order_relaxed);
+  while (1) {
+    record = &(ring[position & DLOG_RING_MASK]);
+    sequence = atomic_load_explicit(&(record->sequence), memory_order_acquire);
+    difference = (int)(sequence - position);
+
+    if (difference == 0) {
+      // Slot is free for this position, try to claim it
+      if (atomic_compare_exchange_weak_explicit(&write_position, &position, position + 1,
+            memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Consumer has not freed this slot yet, the ring is full
+      atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+      return;
+    } else {
+      // Another producer claimed it first
+      position = atomic_load_explicit(&write_position, memory_order_relaxed);
+    }
+  }
+
+  record->id = (uint16_t) id;
+  record->timestamp_us = esp_timer_get_time();
+
+  types = catalog[id].types;
+  record->arg_count = 0;
+  va_start(args, id);
+  while ((*types != '\0') && (record->arg_count < DLOG_MAX_ARGS)) {
+    float float_value = 0;
+
+    switch (*types) {
+      case 'f':
+        float_value = (float) va_arg(args, double);
+        memcpy(&(record->args[record->arg_count]), &float_value, sizeof(float));
+        break;
+      case 'i':
+        record->args[record->arg_count] = (uint32_t) va_arg(args, int32_t);
+        break;
+      default:
+        record->args[record->arg_count] = va_arg(args, uint32_t);
+        break;
+    }
+
+    record->arg_count++;
+    types++;
+  }
+  va_end(args);
+
+  // Publish to the consumer
+  atomic_store_explicit(&(record->sequence), position + 1, memory_order_release);
+  atomic_fetch_add_explicit(&written_count, 1, memory_order_relaxed);
+}
+
+/*!
+ * Drain the ring, formatting and emitting every published record. Single consumer only.
+ */
+void deferred_log_flush(void)
+{
+  unsigned int depth = atomic_load_explicit(&write_position, memory_order_relaxed) - read_position;
+
+  if (depth > max_depth) {
+    max_depth = depth;
+  }
+
+  while (1) {
+    dlog_record_struct *record = &(ring[read_position & DLOG_RING_MASK]);
+    unsigned int sequence = atomic_load_explicit(&(record->sequence), memory_order_acquire);
+
+    if ((int)(sequence - (read_position + 1)) < 0) {
+      // Not published yet
+      break;
+    }
+
+    emit_record(record);
+
+    // Hand the slot back to producers for the next lap
+    atomic_store_explicit(&(record->sequence), read_position + DLOG_RING_SIZE, memory_order_release);
+    read_position++;
+    emitted_count++;
+  }
+}
+
+dlog_stats_struct deferred_log_get_stats(void)
+{
+  dlog_stats_struct stats = {
+    .written = atomic_load(&written_count),
+    .dropped = atomic_load(&dropped_count),
+    .emitted = emitted_count,
+    .max_depth = max_depth
+  };
+
+  return stats;
+}
+
+/*!
+ * Low priority task that formats and emits the queued records
+ */
+void deferred_log_task(void *arg)
+{
+  while (1) {
+    deferred_log_flush();
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_DLOG_FLUSH_PERIOD_MS));
+  }
+}
+
+static void emit_record(const dlog_record_struct *record)
+{
+  char line[DLOG_LINE_LENGTH];
+  const dlog_entry_struct *entry = &(catalog[record->id]);
+
+  format_record(line, sizeof(line), entry, record);
+
+  // The record timestamp is when the event happened, not when it was printed
+  ESP_LOG_LEVEL(entry->level, entry->tag, "[%" PRId64 ".%06" PRId64 "] %s", record->timestamp_us / 1000000,
+    record->timestamp_us % 1000000, line);
+}
+
+/*!
+ * Expand the catalogue format one conversion at a time using the stored raw arguments
+ */
+static int format_record(char *buffer, size_t buffer_length, const dlog_entry_struct *entry,
+  const dlog_record_struct *record)
+{
+  const char *format = entry->format;
+  size_t length = 0;
+  int arg_index = 0;
+
+  buffer[0] = '\0';
+
+  while ((*format != '\0') && (length < (buffer_length - 1))) {
+    char spec[DLOG_SPEC_LENGTH];
+    size_t spec_length = 0;
+    float float_value = 0;
+    int written = 0;
+
+    if (*format != '%') {
+      buffer[length++] = *format++;
+      continue;
+    }
+
+    if (format[1] == '%') {
+      buffer[length++] = '%';
+      format += 2;
+      continue;
+    }
+
+    // Copy the conversion spec up to and including the conversion character
+    do {
+      spec[spec_length++] = *format++;
+    } while ((*format != '\0') && (strchr("diuxXfFeEgGc", format[-1]) == NULL) &&
+             (spec_length < (DLOG_SPEC_LENGTH - 1)));
+    spec[spec_length] = '\0';
+
+    if (arg_index >= record->arg_count) {
+      break;
+    }
+
+    switch (entry->types[arg_index]) {
+      case 'f':
+        memcpy(&float_value, &(record->args[arg_index]), sizeof(float));
+        written = snprintf(&buffer[length], buffer_length - length, spec, (double) float_value);
+        break;
+      case 'i':
+        written = snprintf(&buffer[length], buffer_length - length, spec, (int) record->args[arg_index]);
+        break;
+      default:
+        written = snprintf(&buffer[length], buffer_length - length, spec, (unsigned int) record->args[arg_index]);
+        break;
+    }
+    arg_index++;
+
+    if (written < 0) {
+      break;
+    }
+    length += (size_t) written;
+    if (length >= buffer_length) {
+      length = buffer_length - 1;
+    }
+  }
+
+  buffer[length] = '\0';
+
+  return (int) length;
+}
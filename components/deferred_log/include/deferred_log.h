@@ -0,0 +1,40 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "deferred_log_catalog.h"
+
+#define DLOG_MAX_ARGS 4
+
+// Message IDs, one per catalogue entry
+#define DLOG_ENUM_ENTRY(id, level, tag, format, types) id,
+typedef enum dlog_id {
+  DLOG_CATALOG(DLOG_ENUM_ENTRY)
+  DLOG_COUNT
+} dlog_id_t;
+#undef DLOG_ENUM_ENTRY
+
+typedef struct dlog_stats {
+  uint32_t written;
+  uint32_t dropped;     // Ring was full
+  uint32_t emitted;
+  uint32_t max_depth;   // Deepest the ring has been when drained
+} dlog_stats_struct;
+
+/*!
+ * Log a catalogued message. Only the message ID and raw arguments are copied into a
+ * lock-free RAM ring; formatting happens later in deferred_log_task(). Safe to call
+ * from any task on either core.
+ */
+#define DLOG(id, ...) deferred_log_write((id), ##__VA_ARGS__)
+
+esp_err_t         deferred_log_init(void);
+void              deferred_log_write(dlog_id_t id, ...);
+void              deferred_log_flush(void);
+dlog_stats_struct deferred_log_get_stats(void);
+void              deferred_log_task(void *arg);
+
+#endif /* DEFERRED_LOG_H */
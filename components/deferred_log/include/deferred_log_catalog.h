@@ -0,0 +1,32 @@
+#ifndef DEFERRED_LOG_CATALOG_H
+#define DEFERRED_LOG_CATALOG_H
+
+/* Catalogue of every message that can go through the deferred logger.
+ *
+ * X(id, level, tag, format, argument types)
+ *
+ * Argument types, one character per conversion in the format:
+ *   'i' -- int32_t, printed with %d/%i/%x
+ *   'u' -- uint32_t, printed with %u/%x
+ *   'f' -- float (doubles are narrowed), printed with %f/%e/%g
+ * At most DLOG_MAX_ARGS arguments. Length modifiers (l, ll, h) are not allowed in the format.
+ */
+#define DLOG_CATALOG(X) \
+  X(DLOG_SENSOR_BME280,   ESP_LOG_INFO,  "Sensor task", \
+    "Environmental sensor readings: Temp = %.3f degC, Pres = %.3f hPa, Rh = %.3f %%", "fff") \
+  X(DLOG_SENSOR_UV,       ESP_LOG_INFO,  "Sensor task", \
+    "UV sensor readings: UV A = %.3f uW/cm^2, UV B = %.3f uW/cm^2, UV C = %.3f uW/cm^2", "fff") \
+  X(DLOG_SENSOR_SOIL,     ESP_LOG_INFO,  "Sensor task", "Soil sensor reading: %u", "u") \
+  X(DLOG_SENSOR_NO_WIFI,  ESP_LOG_ERROR, "WIFI", "WiFi not connected, unable to run sensor tasks.", "") \
+  X(DLOG_FAN_ON,          ESP_LOG_INFO,  "FAN", "Fan on.", "") \
+  X(DLOG_FAN_OFF,         ESP_LOG_INFO,  "FAN", "Fan off.", "") \
+  X(DLOG_FAN_DUTY,        ESP_LOG_INFO,  "FAN", "Fan duty %u permille.", "u") \
+  X(DLOG_LIGHTS_ON,       ESP_LOG_INFO,  "LIGHTS", "Lights on.", "") \
+  X(DLOG_LIGHTS_OFF,      ESP_LOG_INFO,  "LIGHTS", "Lights off.", "") \
+  X(DLOG_PDLC_ON,         ESP_LOG_INFO,  "PDLC", "PDLC on.", "") \
+  X(DLOG_PDLC_OFF,        ESP_LOG_INFO,  "PDLC", "PDLC off.", "") \
+  X(DLOG_ENV_TIMER,       ESP_LOG_INFO,  "Environmental control", "Fan run timer expired.", "") \
+  X(DLOG_ENV_TIMER_ID,    ESP_LOG_ERROR, "Environmental control", "Timer ID did not match.", "") \
+  X(DLOG_HTTP_ON_DATA,    ESP_LOG_INFO,  "HTTP", "HTTP_EVENT_ON_DATA: %d bytes", "i")
+
+#endif /* DEFERRED_LOG_CATALOG_H */
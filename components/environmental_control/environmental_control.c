@@ -1,10 +1,17 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "fan.h"
 #include "lights.h"
 #include "pdlc.h"
 #include "sdkconfig.h"
+#include "deferred_log.h"
+#include "cycle_profiler.h"
+#include "json_schema.h"
+#include "platform_storage.h"
 #include "environmental_control.h"
 
 extern struct tm global_start_time_info;
@@ -18,15 +25,141 @@ const char* ENVIRONMENTAL_TAG = "Environmental control";
 
 // Private functions
 void check_for_env_changes_callback(TimerHandle_t xTimer);
+static void env_timer_expired(void);
+static void rtos_start_timer(uint32_t period_s, env_timer_callback_t callback);
+static esp_err_t init_actuators(void);
+static esp_err_t init_photoperiod(void);
+static esp_err_t init_models(void);
+static void update_models(void);
+static void evaluate_rules(void);
 static void manage_lights(void);
 static void manage_fans(void);
+static void manage_fans_pid(void);
+static esp_err_t init_fan_loops(void);
+static void take_fan_gains(void);
+static float sample_interval_s(const sensor_data_struct *previous, const sensor_data_struct *current);
+static int64_t sample_time_us(const sensor_data_struct *sample);
 static void manage_pdlc(void);
 bool check_slopes(void);
+static bool fan_is_helping(void);
+static void blank_rule_table(rule_table_struct *table);
+static esp_err_t load_rule_table(esp_err_t decoded, const rule_table_struct *table, bool persist);
 // Public functions privided via struct fn pointers
 static status_data_struct _environmental_control_get_statuses(void);
 static void _environmental_control_process_env_data(sensor_data_struct sensor_readings);
-
-esp_err_t environmental_control_init(Environmental_control *struct_ptr, Fan *fan, Lights *lights, PDLC *pdlc)
+static void _environmental_control_handle_events(uint32_t events);
+static esp_err_t _environmental_control_get_trend(float *temperature_per_minute, float *humidity_per_minute);
+static esp_err_t _environmental_control_set_fan_gains(fan_loop_t loop, pid_gains_struct gains, bool persist);
+static esp_err_t _environmental_control_set_rules(const rule_table_struct *table, bool persist);
+static esp_err_t _environmental_control_set_rules_json(const char *json, size_t length, bool persist);
+static esp_err_t _environmental_control_set_rules_tokens(const jparse_ctx_t *jctx, bool persist);
+static esp_err_t _environmental_control_get_uv_dose(uv_dose_band_t band, uint32_t window_s, float *dose_uj);
+
+// On during the photoperiod (see init_photoperiod())
+#define DAYLIGHT_RULE(output) { (output), RULE_ACTION_ON, 1, { \
+  { RULE_INPUT_PHOTOPERIOD, RULE_OP_AT_LEAST, 1, 0 } } }
+
+#define UV_DOSE_RULE(input, threshold) { RULE_OUTPUT_PDLC, RULE_ACTION_OFF, 1, { \
+  { (input), RULE_OP_AT_LEAST, (threshold), (threshold) * CONFIG_UV_DOSE_HYSTERESIS_PCT / 100.0f } } }
+
+#define OVER_THRESHOLD_RULE(output, input, threshold, hysteresis) { (output), RULE_ACTION_ON, 1, { \
+  { (input), RULE_OP_AT_LEAST, (threshold), (hysteresis) } } }
+
+#define OPAQUE_RULE(input, threshold, hysteresis) { RULE_OUTPUT_PDLC, RULE_ACTION_OFF, 1, { \
+  { (input), RULE_OP_AT_LEAST, (threshold), (hysteresis) } } }
+
+#if CONFIG_FAN_HUMIDITY_TARGET_VPD
+// Run the fan while the air is too close to saturation, i.e. the deficit is under the target
+#define HUMIDITY_RULE { RULE_OUTPUT_FAN_HUMIDITY, RULE_ACTION_ON, 1, { \
+  { RULE_INPUT_VPD, RULE_OP_BELOW, CONFIG_VPD_TARGET_CENTI_KPA / 100.0f, CONFIG_VPD_HYSTERESIS_CENTI_KPA / 100.0f } } }
+#else
+#define HUMIDITY_RULE OVER_THRESHOLD_RULE(RULE_OUTPUT_FAN_HUMIDITY, RULE_INPUT_HUMIDITY, HUMIDITY_THRESHOLD, \
+  CONFIG_HUMIDITY_HYSTERESIS_DECI_PCT / 10.0f)
+#endif
+
+// The humidity forecast is relative humidity, so it has no rule with a VPD target
+#if CONFIG_ENV_PREDICTIVE_CONTROL && CONFIG_FAN_HUMIDITY_TARGET_VPD
+#define PREDICTIVE_RULE_COUNT 2
+#elif CONFIG_ENV_PREDICTIVE_CONTROL
+#define PREDICTIVE_RULE_COUNT 3
+#else
+#define PREDICTIVE_RULE_COUNT 0
+#endif
+
+// Rules used until a table is stored
+static const rule_table_struct default_rules = {
+  .version = RULE_TABLE_VERSION,
+  .rule_count = 8 + PREDICTIVE_RULE_COUNT,
+  .fan_run_s = ONE_MINUTE,
+  .max_fan_runs = MAX_TIMER_FIRES,
+  .rules = {
+    DAYLIGHT_RULE(RULE_OUTPUT_DAYLIGHT),
+    DAYLIGHT_RULE(RULE_OUTPUT_LIGHTS),
+    // The PDLC goes opaque once any of the UV doses is reached, and at night
+    UV_DOSE_RULE(RULE_INPUT_UV_A_DOSE, UV_A_THRESHOLD),
+    UV_DOSE_RULE(RULE_INPUT_UV_B_DOSE, UV_B_THRESHOLD),
+    UV_DOSE_RULE(RULE_INPUT_UV_C_DOSE, UV_C_THRESHOLD),
+#if CONFIG_ENV_PREDICTIVE_CONTROL
+    // ... and when the fan couldn't hold the temperature with the sun coming in
+    OPAQUE_RULE(RULE_INPUT_TEMPERATURE_FORECAST_CLEAR,
+      TEMPERATURE_THRESHOLD + (CONFIG_ENV_PREDICTIVE_PDLC_MARGIN_DECI_C / 10.0f),
+      CONFIG_TEMPERATURE_HYSTERESIS_DECI_C / 10.0f),
+#endif
+    DAYLIGHT_RULE(RULE_OUTPUT_PDLC),
+    // On/off fan runs; the variable speed fan works from its own setpoints
+    OVER_THRESHOLD_RULE(RULE_OUTPUT_FAN_TEMPERATURE, RULE_INPUT_TEMPERATURE, TEMPERATURE_THRESHOLD,
+      CONFIG_TEMPERATURE_HYSTERESIS_DECI_C / 10.0f),
+    HUMIDITY_RULE,
+#if CONFIG_ENV_PREDICTIVE_CONTROL
+    // Start fan runs before the excursion, while the forecast without the fan is over
+    OVER_THRESHOLD_RULE(RULE_OUTPUT_FAN_TEMPERATURE, RULE_INPUT_TEMPERATURE_FORECAST, TEMPERATURE_THRESHOLD,
+      CONFIG_TEMPERATURE_HYSTERESIS_DECI_C / 10.0f),
+#if !CONFIG_FAN_HUMIDITY_TARGET_VPD
+    OVER_THRESHOLD_RULE(RULE_OUTPUT_FAN_HUMIDITY, RULE_INPUT_HUMIDITY_FORECAST, HUMIDITY_THRESHOLD,
+      CONFIG_HUMIDITY_HYSTERESIS_DECI_PCT / 10.0f),
+#endif
+#endif
+  }
+};
+
+/* A rule table as JSON, the way the backend sends it:
+ *   {"version": 2, "fan_run_s": 60, "max_fan_runs": 3, "rules": [
+ *     {"output": 3, "action": 1, "conditions": [{"input": 0, "op": 0, "threshold": 27.5, "hysteresis": 0.5}]}]}
+ * Missing fan_run_s and max_fan_runs keep their defaults. The rule engine checks the rest when it compiles it. */
+static const json_field_struct condition_fields[] = {
+  JSON_FIELD_NUMBER("input", JSON_FIELD_UINT, rule_condition_struct, input, true, 0, RULE_INPUT_COUNT - 1),
+  JSON_FIELD_NUMBER("op", JSON_FIELD_UINT, rule_condition_struct, op, true, 0, RULE_OP_COUNT - 1),
+  JSON_FIELD_NUMBER("threshold", JSON_FIELD_FLOAT, rule_condition_struct, threshold, true, -1e6, 1e6),
+  JSON_FIELD_NUMBER("hysteresis", JSON_FIELD_FLOAT, rule_condition_struct, hysteresis, false, 0, 1e6)
+};
+static const json_schema_struct condition_schema = JSON_SCHEMA(condition_fields);
+static const json_field_struct condition_element = JSON_ELEMENT_STRUCT(rule_condition_struct, &condition_schema);
+
+static const json_field_struct rule_fields[] = {
+  JSON_FIELD_NUMBER("output", JSON_FIELD_UINT, rule_struct, output, true, 0, RULE_OUTPUT_COUNT - 1),
+  JSON_FIELD_NUMBER("action", JSON_FIELD_UINT, rule_struct, action, true, RULE_ACTION_OFF, RULE_ACTION_ON),
+  JSON_FIELD_LIST("conditions", rule_struct, conditions, false, &condition_element, condition_count)
+};
+static const json_schema_struct rule_schema = JSON_SCHEMA(rule_fields);
+static const json_field_struct rule_element = JSON_ELEMENT_STRUCT(rule_struct, &rule_schema);
+
+static const json_field_struct rule_table_fields[] = {
+  JSON_FIELD_NUMBER("version", JSON_FIELD_UINT, rule_table_struct, version, true, RULE_TABLE_VERSION,
+    RULE_TABLE_VERSION),
+  JSON_FIELD_NUMBER("fan_run_s", JSON_FIELD_UINT, rule_table_struct, fan_run_s, false, 1, 3600),
+  JSON_FIELD_NUMBER("max_fan_runs", JSON_FIELD_UINT, rule_table_struct, max_fan_runs, false, 1, 60),
+  JSON_FIELD_LIST("rules", rule_table_struct, rules, true, &rule_element, rule_count)
+};
+static const json_schema_struct rule_table_schema = JSON_SCHEMA(rule_table_fields);
+
+// Default timebase: wall clock and a FreeRTOS timer
+static const env_timebase_struct rtos_timebase = {
+  .get_time = time,
+  .start_timer = rtos_start_timer
+};
+
+esp_err_t environmental_control_init(Environmental_control *struct_ptr, Fan *fan, Lights *lights, PDLC *pdlc,
+  const env_timebase_struct *timebase)
 {
   esp_err_t return_code = ESP_OK;
 
@@ -34,42 +167,114 @@ esp_err_t environmental_control_init(Environmental_control *struct_ptr, Fan *fan
   self->fan = fan;
   self->lights = lights;
   self->pdlc = pdlc;
-  self->time_series_ptr = NULL;
-  self->time_series_index = 0;
+  self->timebase = (timebase != NULL) ? timebase : &rtos_timebase;
   self->timer_id = ENV_TIMER_ID;
+  portMUX_INITIALIZE(&(self->lock));
   self->timer_period = ONE_MINUTE;
   self->timer_fires_counter = 0;
+  self->max_timer_fires = MAX_TIMER_FIRES;
   self->is_daylight = false;
   self->timer_running = false;
   self->over_temp = false;
   self->over_humidity = false;
+  self->fan_give_ups = 0;
+  self->give_up_time = 0;
+  self->fan_wanted = false;
+  self->event_task = NULL;
+  self->timer_fired_us = 0;
   self->get_statuses = _environmental_control_get_statuses;
   self->process_env_data = _environmental_control_process_env_data;
+  self->handle_events = _environmental_control_handle_events;
+  self->get_trend = _environmental_control_get_trend;
+  self->set_fan_gains = _environmental_control_set_fan_gains;
+  self->set_rules = _environmental_control_set_rules;
+  self->set_rules_json = _environmental_control_set_rules_json;
+  self->set_rules_tokens = _environmental_control_set_rules_tokens;
+  self->get_uv_dose = _environmental_control_get_uv_dose;
+  self->rule_outputs = 0;
+  self->sample_interval_s = 0;
   self->give_up_time_info = global_start_time_info;
 
+  // The temperature/humidity trend covers one fan run, whatever the sample rate
+  return_code = time_series_init(&(self->trend), self->timer_period * 1000);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = uv_dose_init(&(self->uv_dose), UV_DOSE_MAX_GAP_MS);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = rule_engine_init(&(self->rules), &default_rules);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = init_photoperiod();
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = init_models();
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
   // Initialize the fan, lights, pdlc
+#if CONFIG_FAN_CONTROL_PID
+  return_code = fan_init_pwm(self->fan, CONFIG_FAN_1_GPIO, CONFIG_FAN_2_GPIO, CONFIG_FAN_PWM_FREQUENCY_HZ);
+#else
   return_code = fan_init(self->fan, CONFIG_FAN_1_GPIO, CONFIG_FAN_2_GPIO);
+#endif
   if (return_code != ESP_OK) {
     return return_code;
   }
 
-  lights_init(self->lights, CONFIG_LIGHTS_GPIO);
+  return_code = init_fan_loops();
   if (return_code != ESP_OK) {
     return return_code;
   }
 
-  pdlc_init(self->pdlc, CONFIG_PDLC_GPIO);
+  return_code = lights_init(self->lights, CONFIG_LIGHTS_GPIO);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = pdlc_init(self->pdlc, CONFIG_PDLC_GPIO);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  // After the actuators are initialized, the state machines take their on/off functions
+  return_code = init_actuators();
   if (return_code != ESP_OK) {
     return return_code;
   }
 
   // Initialize our timer. Note this won't start until we tell it to
+  if (self->timebase != &rtos_timebase) {
+    self->timer_handle = NULL;
+    return return_code;
+  }
+  // Expiries are handed from the timer task to this one
+  self->event_task = xTaskGetCurrentTaskHandle();
   self->timer_handle = xTimerCreate("ENV timer", self->timer_period * CONFIG_FREERTOS_HZ, pdFALSE, 
                                       &(self->timer_id), check_for_env_changes_callback);
 
   return return_code;
 }
 
+/*!
+ * The derived metrics stage: air moisture from the sample's temperature and humidity, worked
+ * out once after acquisition so the controller and the uplink share the same numbers
+ */
+void environmental_control_derive(sensor_data_struct *sample)
+{
+  psychrometrics_derive((float) sample->bme280_data.temperature, (float) sample->bme280_data.humidity,
+    &(sample->derived));
+}
+
 static status_data_struct _environmental_control_get_statuses(void)
 {
   status_data_struct statuses = {self->fan->get_state(),
@@ -79,81 +284,244 @@ static status_data_struct _environmental_control_get_statuses(void)
   return statuses;
 }
 
+/*!
+ * Least-squares temperature (degC/min) and humidity (%Rh/min) trend over the last fan run
+ */
+static esp_err_t _environmental_control_get_trend(float *temperature_per_minute, float *humidity_per_minute)
+{
+  esp_err_t return_code = ESP_OK;
+
+  return_code = time_series_get_slope(&(self->trend), TS_TEMPERATURE, temperature_per_minute);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return time_series_get_slope(&(self->trend), TS_HUMIDITY, humidity_per_minute);
+}
+
+/*!
+ * Retune a variable speed fan loop on the fly, from any task. The loop takes the gains on the next sample and
+ * carries on from its current output. With persist, they are also the gains after a reboot.
+ */
+static esp_err_t _environmental_control_set_fan_gains(fan_loop_t loop, pid_gains_struct gains, bool persist)
+{
+#if CONFIG_FAN_CONTROL_PID
+  pid_gains_struct stored[FAN_LOOP_COUNT];
+
+  if (((unsigned)loop >= FAN_LOOP_COUNT) || (pid_check_gains(&gains) != ESP_OK)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  portENTER_CRITICAL(&(self->lock));
+  self->fan_gains[loop] = gains;
+  self->fan_gains_pending |= (1UL << loop);
+  memcpy(stored, self->fan_gains, sizeof(stored));
+  portEXIT_CRITICAL(&(self->lock));
+
+  if (persist) {
+    return platform_storage_write(FAN_GAINS_STORAGE_KEY, stored, sizeof(stored));
+  }
+
+  return ESP_OK;
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/*!
+ * Swap in a new rule table; it applies from the next sample. With persist, it's also the table after a reboot.
+ */
+static esp_err_t _environmental_control_set_rules(const rule_table_struct *table, bool persist)
+{
+  if (table == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (persist) {
+    return rule_engine_store(&(self->rules), table);
+  }
+
+  return rule_engine_load(&(self->rules), table);
+}
+
+/*!
+ * set_rules() for a table in JSON (see rule_table_schema), decoded in one pass over its tokens
+ */
+static esp_err_t _environmental_control_set_rules_json(const char *json, size_t length, bool persist)
+{
+  rule_table_struct table;
+
+  if (json == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  blank_rule_table(&table);
+
+  return load_rule_table(json_schema_decode(&rule_table_schema, json, length, NULL, &table), &table, persist);
+}
+
+/*!
+ * The same for the object at jctx->cur, in a document already parsed
+ */
+static esp_err_t _environmental_control_set_rules_tokens(const jparse_ctx_t *jctx, bool persist)
+{
+  rule_table_struct table;
+
+  if (jctx == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  blank_rule_table(&table);
+
+  return load_rule_table(json_schema_decode_tokens(&rule_table_schema, jctx, &table), &table, persist);
+}
+
+/*!
+ * Only the fan limits default, a rule or condition is all there in the JSON or zero
+ */
+static void blank_rule_table(rule_table_struct *table)
+{
+  memset(table, 0, sizeof(rule_table_struct));
+  table->fan_run_s = default_rules.fan_run_s;
+  table->max_fan_runs = default_rules.max_fan_runs;
+}
+
+static esp_err_t load_rule_table(esp_err_t decoded, const rule_table_struct *table, bool persist)
+{
+  if (decoded != ESP_OK) {
+    ESP_LOGW(ENVIRONMENTAL_TAG, "Rule table rejected: %s", esp_err_to_name(decoded));
+    return decoded;
+  }
+
+  return _environmental_control_set_rules(table, persist);
+}
+
+/*!
+ * UV dose in uJ/cm^2: since the start of daylight for a window of 0, otherwise over the last
+ * window_s seconds (at most UV_DOSE_BUCKETS minutes, whether or not it was daylight)
+ */
+static esp_err_t _environmental_control_get_uv_dose(uv_dose_band_t band, uint32_t window_s, float *dose_uj)
+{
+  if ((unsigned)band >= UV_DOSE_BAND_COUNT) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (window_s == 0) {
+    *dose_uj = uv_dose_get_total(&(self->uv_dose), band);
+    return ESP_OK;
+  }
+
+  return uv_dose_get_window(&(self->uv_dose), band, window_s, dose_uj);
+}
+
 
 
 static void _environmental_control_process_env_data(sensor_data_struct sensor_readings)
 {
-  bool daylight_time = false;
   // Grab the readings and the current time
+  self->sample_interval_s = sample_interval_s(&(self->current_sensor_data), &sensor_readings);
   self->current_sensor_data = sensor_readings;
 
-  time(&self->time_now);
-  localtime_r(&self->time_now, &self->time_now_info);
-
-  if (CLASS_DEMO) {
-    // The lights will be on for 5 mins
-    daylight_time = (self->time_now_info.tm_min >= global_start_time_info.tm_min) &&
-                    (self->time_now_info.tm_min <= (global_start_time_info.tm_min + 5));
-    
-    self->is_daylight = daylight_time;
+  self->timebase->get_time(&self->time_now);
 
-  } else {
-    // The lights will be on during the daylight hours
-    daylight_time = (self->time_now_info.tm_hour >= DAYLIGHT_START) &&
-                    (self->time_now_info.tm_hour < DAYLIGHT_END);
-    
-    self->is_daylight = daylight_time;
-  }
-/* if needed:
+  // Keep the trend rolling all the time so it covers the whole fan run when the timer fires
+  time_series_add(&(self->trend), sample_time_us(&sensor_readings), sensor_readings.bme280_data.temperature,
+    sensor_readings.bme280_data.humidity);
 
-   uW/cm^2
-  --------- * Time = j/cm^2 -- > time will be time between measurements (1 sec)
-    1,000
+  // Learn from what the actuators did up to this sample, and look ahead
+  update_models();
 
+/*
+   uW/cm^2 * s = uJ/cm^2, integrated over the real time between samples so the dose
+   doesn't depend on the sample rate
 */
+  uv_dose_add(&(self->uv_dose), sample_time_us(&sensor_readings), sensor_readings.uv_data.UV_A,
+    sensor_readings.uv_data.UV_B, sensor_readings.uv_data.UV_C);
 
-  if (self->is_daylight) {
-    // Since we are running the sensors at 1Hz, we can just add the current
-    // UV sensor readings to the integral
-    self->uv_a_integral += sensor_readings.uv_data.UV_A;
-    self->uv_b_integral += sensor_readings.uv_data.UV_B;
-    self->uv_c_integral += sensor_readings.uv_data.UV_C;
-  } else {
+  // Decide what should be on, and whether it's daylight
+  evaluate_rules();
+
+  if (!self->is_daylight) {
     // Make sure we start fresh for the next daylight period
-    self->uv_a_integral = 0;
-    self->uv_b_integral = 0;
-    self->uv_c_integral = 0;
+    uv_dose_reset(&(self->uv_dose));
   }
 
   // Do the stuff
   manage_lights();
+#if CONFIG_FAN_CONTROL_PID
+  manage_fans_pid();
+#else
   manage_fans();
+#endif
   manage_pdlc();
 }
 
+/*!
+ * Controller events notified to the control task, see ENV_EVENT_*. Samples are taken off
+ * the sensor queue by the caller.
+ */
+static void _environmental_control_handle_events(uint32_t events)
+{
+  int64_t fired_us = 0;
+
+  if (events & ENV_EVENT_TIMER) {
+    // 64 bits written by the timer task, a plain read could see half of an update
+    portENTER_CRITICAL(&(self->lock));
+    fired_us = self->timer_fired_us;
+    portEXIT_CRITICAL(&(self->lock));
+
+    cycle_profiler_record_since(STAGE_TIMER_EVENT, fired_us);
+    env_timer_expired();
+  }
+}
+
+/*!
+ * Runs in the FreeRTOS timer task, so it must not block: it only passes the expiry on to
+ * the control task, which owns the trend and the fan run state.
+ */
 void check_for_env_changes_callback(TimerHandle_t xTimer)
 {
-  ESP_LOGE(ENVIRONMENTAL_TAG, "In timer callback.");
+  int64_t fired_us = esp_timer_get_time();
 
-  self->timer_running = false;
-  self->time_series_index = 0;
   // Sanity check that another timer didn't magically fire this callback
   if (*(uint32_t*)pvTimerGetTimerID(xTimer) != self->timer_id) {
-    ESP_LOGE(ENVIRONMENTAL_TAG, "Timer ID did not match.");
+    DLOG(DLOG_ENV_TIMER_ID);
     return;
   }
 
+  portENTER_CRITICAL(&(self->lock));
+  self->timer_fired_us = fired_us;
+  portEXIT_CRITICAL(&(self->lock));
+  xTaskNotify(self->event_task, ENV_EVENT_TIMER, eSetBits);
+  cycle_profiler_record_since(STAGE_TIMER_CALLBACK, fired_us);
+}
+
+static void rtos_start_timer(uint32_t period_s, env_timer_callback_t callback)
+{
+  // The FreeRTOS timer always ends up in env_timer_expired(), through handle_events(). Changing
+  // the period also starts it.
+  xTimerChangePeriod(self->timer_handle, period_s * CONFIG_FREERTOS_HZ, 1);
+}
+
+/*!
+ * End of a fan run: decide whether to keep going based on the trend over the run.
+ * Runs in the control task, between samples.
+ */
+static void env_timer_expired(void)
+{
+  DLOG(DLOG_ENV_TIMER);
+
+  self->timer_running = false;
+
   /* Simple case first -- if the current temp and humidity are below
    * threshold values, then we can turn the fan off and move on. 
+   * The fan itself is switched by its state machine on the next sample.
    */
-  self->over_temp = self->current_sensor_data.bme280_data.temperature > TEMPERATURE_THRESHOLD;
-  self->over_humidity = self->current_sensor_data.bme280_data.humidity > HUMIDITY_THRESHOLD;
-
   if (!(self->over_temp || self->over_humidity)) {
     // Reset the timer run counter
     self->timer_fires_counter = 0;
     // Turn off the fan
-    self->fan->off();
+    self->fan_wanted = false;
   } else {
     /* Now the more complex case -- we are still over temp/humidity.
     * In this case, we need to see if the slopes are negative. 
@@ -162,68 +530,44 @@ void check_for_env_changes_callback(TimerHandle_t xTimer)
     *  -If the slopes are positive, then we cannot correct by using the fan
     *   and should stop trying. 
     */
-    bool has_negative_slope = check_slopes();
-    if (!has_negative_slope) {
-      time(&(self->give_up_time));
+    if (!fan_is_helping()) {
+      self->timebase->get_time(&(self->give_up_time));
       localtime_r(&(self->give_up_time), &(self->give_up_time_info));
       self->timer_fires_counter = 0;
+      self->fan_give_ups++;
 
-      // Turn the fans on
-      self->fan->off();
+      // Turn the fans off
+      self->fan_wanted = false;
 
     } else {
       // We have a negative slope, need to see if we should keep trying
-      if (self->timer_fires_counter == MAX_TIMER_FIRES) {
-        time(&(self->give_up_time));
+      if (self->timer_fires_counter >= self->max_timer_fires) {
+        self->timebase->get_time(&(self->give_up_time));
         localtime_r(&(self->give_up_time), &(self->give_up_time_info));
         self->timer_fires_counter = 0;
+        self->fan_give_ups++;
 
-        // Turn the fans on
-        self->fan->off();
+        // Turn the fans off
+        self->fan_wanted = false;
       } else {
         self->timer_fires_counter++;
       }
     }
   }
-  
-  // Free the time series array
-  free(self->time_series_ptr);
-  return;
 }
 
 static void manage_lights(void) 
 {
-  // The lights will be on during daylight hours, off otherwise
-  if (self->is_daylight && (self->lights->get_state() != LIGHT_ON)) {
-    self->lights->on();
-  } else if (!self->is_daylight && (self->lights->get_state() != LIGHT_OFF)) {
-    self->lights->off();
-  }
+  // The lights follow their rules, on during daylight hours by default
+  actuator_fsm_request(&(self->actuators[ENV_ACTUATOR_LIGHTS]),
+    (self->rule_outputs & RULE_OUTPUT_BIT(RULE_OUTPUT_LIGHTS)) != 0, self->time_now);
 }
 
 static void manage_pdlc(void)
 {
-  bool above_threshold = false;
-
-  if (self->is_daylight) {
-
-    above_threshold = (self->uv_a_integral > UV_A_THRESHOLD) ||
-                      (self->uv_b_integral > UV_B_THRESHOLD) ||
-                      (self->uv_c_integral > UV_C_THRESHOLD);
-
-    if (above_threshold) {
-      if (self->pdlc->get_state() != PDLC_OFF) {
-        self->pdlc->off();
-      }
-    } else {
-      if (self->pdlc->get_state() != PDLC_ON) {
-        self->pdlc->on();
-      }
-    }
-
-  } else if (self->pdlc->get_state() != PDLC_OFF) {
-    self->pdlc->off();
-  }
+  // By default clear during the day until the UV dose is reached, opaque after that and at night
+  actuator_fsm_request(&(self->actuators[ENV_ACTUATOR_PDLC]),
+    (self->rule_outputs & RULE_OUTPUT_BIT(RULE_OUTPUT_PDLC)) != 0, self->time_now);
 }
 
 static void manage_fans(void)
@@ -248,54 +592,347 @@ static void manage_fans(void)
              the timer can be set
   */
   if (!self->timer_running) {
-    // Check thresholds
-    self->over_temp = self->current_sensor_data.bme280_data.temperature > TEMPERATURE_THRESHOLD;
-    self->over_humidity = self->current_sensor_data.bme280_data.humidity > HUMIDITY_THRESHOLD;
-
     if (self->over_temp || self->over_humidity) {
       // See if we should try to correct
 
-      // We'll keep trying if either this is the first time it has run or
-      // if an hour has elapsed since the last time we tried
-      bool keep_trying = (time(&(self->give_up_time)) == time(&global_start_time)) ||
-                         (self->give_up_time_info.tm_hour < self->time_now_info.tm_hour);
+      // We'll keep trying if either we have never given up or if an hour
+      // has elapsed since the last time we did
+      bool keep_trying = (self->give_up_time == 0) ||
+                         ((self->time_now - self->give_up_time) >= FAN_RETRY_HOLDOFF_S);
 
       if (keep_trying) {
         // Start the timer
-        xTimerStart(self->timer_handle, 1);
+        self->timebase->start_timer(self->timer_period, env_timer_expired);
         self->timer_running = true;
 
-        // Allocate our array
-        self->time_series_ptr = (struct bme280_data*) malloc(sizeof(struct bme280_data) * SAMPLES_PER_MINUTE);
-        self->time_series_index = 0;
-
-        // Store the current bme280 data for later comparison
-        self->time_series_ptr[self->time_series_index++] = self->current_sensor_data.bme280_data;
-
         // Turn the fans on
-        self->fan->on();
+        self->fan_wanted = true;
       }
+    } else if (self->fan_wanted) {
+      // A run that was kept going at the timer is no longer needed
+      self->timer_fires_counter = 0;
+      self->fan_wanted = false;
     }
+  }
+
+  actuator_fsm_request(&(self->actuators[ENV_ACTUATOR_FAN]), self->fan_wanted, self->time_now);
+}
+
+/*!
+ * Variable speed fan: one PID loop each on temperature and humidity, the fan follows whichever
+ * asks for more airflow. Runs on every sample.
+ */
+static void manage_fans_pid(void)
+{
+#if CONFIG_FAN_CONTROL_PID
+  float temperature_duty = 0;
+  float humidity_duty = 0;
+  float duty = 0;
+
+  take_fan_gains();
+
+  temperature_duty = pid_update(&(self->fan_pid[FAN_LOOP_TEMPERATURE]),
+                       CONFIG_FAN_TEMPERATURE_SETPOINT_DECI_C / 10.0f,
+                       (float) self->current_sensor_data.bme280_data.temperature, self->sample_interval_s);
+#if CONFIG_FAN_HUMIDITY_TARGET_VPD
+  humidity_duty = pid_update(&(self->fan_pid[FAN_LOOP_HUMIDITY]), CONFIG_VPD_TARGET_CENTI_KPA / 100.0f,
+                    self->current_sensor_data.derived.vpd_kpa, self->sample_interval_s);
+#else
+  humidity_duty = pid_update(&(self->fan_pid[FAN_LOOP_HUMIDITY]),
+                    CONFIG_FAN_HUMIDITY_SETPOINT_DECI_PCT / 10.0f,
+                    (float) self->current_sensor_data.bme280_data.humidity, self->sample_interval_s);
+#endif
+  duty = fmaxf(temperature_duty, humidity_duty);
+
+  // The fan stalls below its minimum duty. Start it once the loop asks for the minimum and
+  // hold it there until the request drops under half of that, so it doesn't chatter.
+  if (self->fan->get_state() == FAN_OFF) {
+    duty = (duty < CONFIG_FAN_MIN_DUTY_PERMILLE) ? 0 : duty;
+  } else if (duty < (CONFIG_FAN_MIN_DUTY_PERMILLE / 2.0f)) {
+    duty = 0;
+  }
+
+  // The state machine enforces the dwell times, the loop only sets the speed while the fan is on
+  if (actuator_fsm_request(&(self->actuators[ENV_ACTUATOR_FAN]), duty > 0, self->time_now) == ACTUATOR_OFF) {
+    duty = 0;
+  } else if (duty < CONFIG_FAN_MIN_DUTY_PERMILLE) {
+    duty = CONFIG_FAN_MIN_DUTY_PERMILLE;
+  }
 
+  self->fan->set_duty((uint16_t) lroundf(duty));
+#endif
+}
+
+static esp_err_t init_fan_loops(void)
+{
+#if CONFIG_FAN_CONTROL_PID
+  esp_err_t return_code = ESP_OK;
+#if CONFIG_FAN_HUMIDITY_TARGET_VPD
+  // The fan raises the deficit, so it runs harder the further the VPD is under its setpoint
+  const pid_gains_struct gains[FAN_LOOP_COUNT] = {
+    [FAN_LOOP_TEMPERATURE] = { FAN_PID_TEMPERATURE_KP, FAN_PID_TEMPERATURE_KI, FAN_PID_TEMPERATURE_KD },
+    [FAN_LOOP_HUMIDITY]    = { FAN_PID_VPD_KP, FAN_PID_VPD_KI, FAN_PID_VPD_KD }
+  };
+  const pid_action_t actions[FAN_LOOP_COUNT] = { PID_ACTION_REVERSE, PID_ACTION_DIRECT };
+#else
+  const pid_gains_struct gains[FAN_LOOP_COUNT] = {
+    [FAN_LOOP_TEMPERATURE] = { FAN_PID_TEMPERATURE_KP, FAN_PID_TEMPERATURE_KI, FAN_PID_TEMPERATURE_KD },
+    [FAN_LOOP_HUMIDITY]    = { FAN_PID_HUMIDITY_KP, FAN_PID_HUMIDITY_KI, FAN_PID_HUMIDITY_KD }
+  };
+  const pid_action_t actions[FAN_LOOP_COUNT] = { PID_ACTION_REVERSE, PID_ACTION_REVERSE };
+#endif
+
+  pid_gains_struct stored[FAN_LOOP_COUNT];
+  size_t length = sizeof(stored);
+
+  // Gains set with persist replace the built in ones, if they are all usable
+  return_code = platform_storage_read(FAN_GAINS_STORAGE_KEY, stored, &length);
+  if ((return_code == ESP_OK) && (length != sizeof(stored))) {
+    return_code = ESP_ERR_INVALID_SIZE;
+  }
+  for (int loop = 0; (return_code == ESP_OK) && (loop < FAN_LOOP_COUNT); loop++) {
+    return_code = pid_check_gains(&(stored[loop]));
+  }
+  if (return_code == ESP_OK) {
+    ESP_LOGI(ENVIRONMENTAL_TAG, "Running the stored fan gains.");
+    memcpy(self->fan_gains, stored, sizeof(stored));
   } else {
-    // Store the current sensor data
-    if (self->time_series_index > (SAMPLES_PER_MINUTE - 1)) {
-      self->time_series_ptr[self->time_series_index++] = self->current_sensor_data.bme280_data;
+    if (return_code != ESP_ERR_NOT_FOUND) {
+      ESP_LOGW(ENVIRONMENTAL_TAG, "Stored fan gains rejected (%s), using the defaults.", esp_err_to_name(return_code));
     }
+    memcpy(self->fan_gains, gains, sizeof(gains));
   }
+  self->fan_gains_pending = 0;
+
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    return_code = pid_init(&(self->fan_pid[loop]), &(self->fan_gains[loop]), actions[loop], 0,
+                    PLATFORM_PWM_DUTY_MAX, CONFIG_FAN_SLEW_PERMILLE_PER_S);
+    if (return_code != ESP_OK) {
+      return return_code;
+    }
+  }
+#endif
+
+  return ESP_OK;
+}
+
+/*!
+ * Hand the gains set since the last sample to the loops
+ */
+static void take_fan_gains(void)
+{
+#if CONFIG_FAN_CONTROL_PID
+  pid_gains_struct gains[FAN_LOOP_COUNT];
+  uint32_t pending = 0;
+
+  portENTER_CRITICAL(&(self->lock));
+  pending = self->fan_gains_pending;
+  self->fan_gains_pending = 0;
+  memcpy(gains, self->fan_gains, sizeof(gains));
+  portEXIT_CRITICAL(&(self->lock));
+
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    if (pending & (1UL << loop)) {
+      pid_set_gains(&(self->fan_pid[loop]), &(gains[loop]));
+    }
+  }
+#endif
+}
+
+static esp_err_t init_actuators(void)
+{
+  esp_err_t return_code = ESP_OK;
+  const actuator_fsm_config_struct fan_config = { CONFIG_FAN_MIN_ON_S, CONFIG_FAN_MIN_OFF_S };
+  const actuator_fsm_config_struct lights_config = { CONFIG_LIGHTS_MIN_ON_S, CONFIG_LIGHTS_MIN_OFF_S };
+  const actuator_fsm_config_struct pdlc_config = { CONFIG_PDLC_MIN_ON_S, CONFIG_PDLC_MIN_OFF_S };
+
+#if CONFIG_FAN_CONTROL_PID
+  // The PID loop sets the fan speed itself
+  return_code = actuator_fsm_init(&(self->actuators[ENV_ACTUATOR_FAN]), "fan", &fan_config, NULL, NULL);
+#else
+  return_code = actuator_fsm_init(&(self->actuators[ENV_ACTUATOR_FAN]), "fan", &fan_config, self->fan->on,
+                  self->fan->off);
+#endif
+  if (return_code == ESP_OK) {
+    return_code = actuator_fsm_init(&(self->actuators[ENV_ACTUATOR_LIGHTS]), "lights", &lights_config,
+                    self->lights->on, self->lights->off);
+  }
+  if (return_code == ESP_OK) {
+    return_code = actuator_fsm_init(&(self->actuators[ENV_ACTUATOR_PDLC]), "pdlc", &pdlc_config, self->pdlc->on,
+                    self->pdlc->off);
+  }
+
+  return return_code;
+}
+
+/*!
+ * Daylight schedule: fixed hours or sunrise to sunset from menuconfig, or the class demo window
+ */
+static esp_err_t init_photoperiod(void)
+{
+  photoperiod_config_struct config = {0};
+
+#if CLASS_DEMO
+  // Anchored to the start of the minute we started in, so the window carries on across the hour
+  config.mode = PHOTOPERIOD_DEMO;
+  config.demo_anchor = global_start_time - global_start_time_info.tm_sec;
+  config.demo_period_s = 60 * ONE_MINUTE;
+  config.demo_on_s = DEMO_DAYLIGHT_S;
+#elif CONFIG_PHOTOPERIOD_SOLAR
+  config.mode = PHOTOPERIOD_SOLAR;
+  config.latitude = strtof(CONFIG_PHOTOPERIOD_LATITUDE, NULL);
+  config.longitude = strtof(CONFIG_PHOTOPERIOD_LONGITUDE, NULL);
+#else
+  config.mode = PHOTOPERIOD_FIXED;
+  config.start_hour = CONFIG_PHOTOPERIOD_START_HOUR;
+  config.end_hour = CONFIG_PHOTOPERIOD_END_HOUR;
+#endif
+
+  return photoperiod_init(&(self->photoperiod), &config, self->timebase->get_time(NULL));
+}
+
+/*!
+ * Temperature and humidity models, fitted relative to their thresholds
+ */
+static esp_err_t init_models(void)
+{
+  esp_err_t return_code = ESP_OK;
+  const float references[FAN_LOOP_COUNT] = {
+    [FAN_LOOP_TEMPERATURE]  = TEMPERATURE_THRESHOLD,
+    [FAN_LOOP_HUMIDITY]     = HUMIDITY_THRESHOLD
+  };
+
+  for (int loop = 0; (loop < FAN_LOOP_COUNT) && (return_code == ESP_OK); loop++) {
+    return_code = thermal_model_init(&(self->models[loop]), CONFIG_ENV_MODEL_STEP_S, MODEL_FORGETTING,
+                    references[loop]);
+    self->forecast[loop] = references[loop];
+    self->forecast_fan[loop] = references[loop];
+    self->forecast_clear[loop] = references[loop];
+  }
+
+  return return_code;
+}
+
+/*!
+ * Feed this sample and the actuator states that led to it to the models, then forecast the
+ * horizon with the fan off and on, and with the fan on and the PDLC clear. Until a model has
+ * seen enough steps its forecasts are the reading itself.
+ */
+static void update_models(void)
+{
+  const float values[FAN_LOOP_COUNT] = {
+    [FAN_LOOP_TEMPERATURE]  = (float) self->current_sensor_data.bme280_data.temperature,
+    [FAN_LOOP_HUMIDITY]     = (float) self->current_sensor_data.bme280_data.humidity
+  };
+  float applied[THERMAL_INPUT_COUNT] = {
+    [THERMAL_INPUT_FAN]   = self->fan->is_pwm ? (self->fan->get_duty() / 1000.0f) :
+                                                ((self->fan->get_state() == FAN_ON) ? 1.0f : 0),
+    [THERMAL_INPUT_PDLC]  = (self->pdlc->get_state() == PDLC_ON) ? 1.0f : 0
+  };
+  float fan_off[THERMAL_INPUT_COUNT] = {
+    [THERMAL_INPUT_FAN]   = 0,
+    [THERMAL_INPUT_PDLC]  = applied[THERMAL_INPUT_PDLC]
+  };
+  float fan_on[THERMAL_INPUT_COUNT] = {
+    [THERMAL_INPUT_FAN]   = 1.0f,
+    [THERMAL_INPUT_PDLC]  = applied[THERMAL_INPUT_PDLC]
+  };
+  const float fan_on_clear[THERMAL_INPUT_COUNT] = { [THERMAL_INPUT_FAN] = 1.0f, [THERMAL_INPUT_PDLC] = 1.0f };
+  const uint32_t horizon_s = CONFIG_ENV_FORECAST_MINUTES * ONE_MINUTE;
+
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    thermal_model_add(&(self->models[loop]), self->time_now, values[loop], applied);
+
+    if (!thermal_model_is_ready(&(self->models[loop]))) {
+      self->forecast[loop] = values[loop];
+      self->forecast_fan[loop] = values[loop];
+      self->forecast_clear[loop] = values[loop];
+      continue;
+    }
+    self->forecast[loop] = thermal_model_forecast(&(self->models[loop]), values[loop], fan_off, horizon_s);
+    self->forecast_fan[loop] = thermal_model_forecast(&(self->models[loop]), values[loop], fan_on, horizon_s);
+    self->forecast_clear[loop] = thermal_model_forecast(&(self->models[loop]), values[loop], fan_on_clear,
+                                   horizon_s);
+  }
+}
+
+/*!
+ * Run this sample through the rule table. The thresholds and their hysteresis live in the rules.
+ */
+static void evaluate_rules(void)
+{
+  const rule_program_struct *program = NULL;
+  // Epoch time compare, the schedule is only worked out again when a transition is due. The day has to be
+  // planned before the hour is taken from it, initializers are not evaluated in any set order.
+  bool daylight = photoperiod_update(&(self->photoperiod), self->time_now);
+  float hour = photoperiod_get_hour(&(self->photoperiod), self->time_now);
+  float inputs[RULE_INPUT_COUNT] = {
+    [RULE_INPUT_TEMPERATURE]  = (float) self->current_sensor_data.bme280_data.temperature,
+    [RULE_INPUT_HUMIDITY]     = (float) self->current_sensor_data.bme280_data.humidity,
+    [RULE_INPUT_UV_A_DOSE]    = uv_dose_get_total(&(self->uv_dose), UV_DOSE_A),
+    [RULE_INPUT_UV_B_DOSE]    = uv_dose_get_total(&(self->uv_dose), UV_DOSE_B),
+    [RULE_INPUT_UV_C_DOSE]    = uv_dose_get_total(&(self->uv_dose), UV_DOSE_C),
+    [RULE_INPUT_SOIL_WETNESS] = (float) self->current_sensor_data.soil_wetness,
+    [RULE_INPUT_HOUR]         = hour,
+    [RULE_INPUT_PHOTOPERIOD]  = daylight ? 1.0f : 0.0f,
+    [RULE_INPUT_TEMPERATURE_FORECAST] = self->forecast[FAN_LOOP_TEMPERATURE],
+    [RULE_INPUT_HUMIDITY_FORECAST]    = self->forecast[FAN_LOOP_HUMIDITY],
+    [RULE_INPUT_TEMPERATURE_FORECAST_CLEAR] = self->forecast_clear[FAN_LOOP_TEMPERATURE],
+    [RULE_INPUT_VPD]          = self->current_sensor_data.derived.vpd_kpa,
+    [RULE_INPUT_DEW_POINT]    = self->current_sensor_data.derived.dew_point_c
+  };
+
+  self->rule_outputs = rule_engine_evaluate(&(self->rules), inputs);
+  self->is_daylight = (self->rule_outputs & RULE_OUTPUT_BIT(RULE_OUTPUT_DAYLIGHT)) != 0;
+  self->over_temp = (self->rule_outputs & RULE_OUTPUT_BIT(RULE_OUTPUT_FAN_TEMPERATURE)) != 0;
+  self->over_humidity = (self->rule_outputs & RULE_OUTPUT_BIT(RULE_OUTPUT_FAN_HUMIDITY)) != 0;
+
+  // Fan run settings from the table that just ran; the timer reads these
+  program = rule_engine_get_program(&(self->rules));
+  self->timer_period = program->fan_run_s;
+  time_series_set_span(&(self->trend), self->timer_period * 1000);
+  self->max_timer_fires = program->max_fan_runs;
+}
+
+/*!
+ * Seconds between two samples, 0 if there is no previous sample
+ */
+static float sample_interval_s(const sensor_data_struct *previous, const sensor_data_struct *current)
+{
+  // Prefer the microsecond acquisition times; replayed traces only carry timestamps
+  if ((previous->acquisition_time_us != 0) && (current->acquisition_time_us != 0)) {
+    return (float)(current->acquisition_time_us - previous->acquisition_time_us) / 1000000.0f;
+  }
+
+  if (previous->timestamp != 0) {
+    return (float)(current->timestamp - previous->timestamp);
+  }
+
+  return 0;
+}
+
+/*!
+ * When a sample was taken, microseconds on the acquisition clock if it has one
+ */
+static int64_t sample_time_us(const sensor_data_struct *sample)
+{
+  if (sample->acquisition_time_us != 0) {
+    return sample->acquisition_time_us;
+  }
+
+  return (int64_t) sample->timestamp * 1000000;
 }
 
 bool check_slopes(void)
 {
-  // We want to check that the slope over the entire timer period is negative
-  self->time_series_index--;
-  double start_humidity = self->time_series_ptr[0].humidity;
-  double end_humidity   = self->time_series_ptr[self->time_series_index].humidity;
-  double start_temp     = self->time_series_ptr[0].temperature;
-  double end_temp       = self->time_series_ptr[self->time_series_index].temperature;
-
-  bool negative_temp_slope = (end_temp < start_temp);
-  bool negative_humidity_slope = (end_humidity < start_humidity);
+  // We want to check that the fitted slope over the entire timer period is negative.
+  // Without enough samples for a fit we can't claim the fan is helping.
+  float temperature_slope = 0;
+  float humidity_slope = 0;
+  bool has_trend = (self->get_trend(&temperature_slope, &humidity_slope) == ESP_OK);
+
+  bool negative_temp_slope = has_trend && (temperature_slope < 0);
+  bool negative_humidity_slope = has_trend && (humidity_slope < 0);
   bool return_value = false;
 
   // Only over humidity
@@ -314,4 +951,23 @@ bool check_slopes(void)
   }
 
   return return_value;
-}
\ No newline at end of file
+}
+
+/*!
+ * Whether another fan run is worth it. With predictive control and a fitted model, the run
+ * has to be keeping the forecast down; otherwise the trend over the run has to be falling.
+ */
+static bool fan_is_helping(void)
+{
+#if CONFIG_ENV_PREDICTIVE_CONTROL
+  if (thermal_model_is_ready(&(self->models[FAN_LOOP_TEMPERATURE])) &&
+      thermal_model_is_ready(&(self->models[FAN_LOOP_HUMIDITY]))) {
+    bool cools = self->forecast_fan[FAN_LOOP_TEMPERATURE] < self->forecast[FAN_LOOP_TEMPERATURE];
+    bool dries = self->forecast_fan[FAN_LOOP_HUMIDITY] < self->forecast[FAN_LOOP_HUMIDITY];
+
+    return (!self->over_temp || cools) && (!self->over_humidity || dries);
+  }
+#endif
+
+  return check_slopes();
+}
@@ -4,6 +4,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/timers.h"
 #include "esp_err.h"
 #include "fan.h"
@@ -11,33 +12,86 @@
 #include "pdlc.h"
 #include "environmental_sensor.h"
 #include "uv_sensor.h"
+#include "time_series.h"
+#include "pid.h"
+#include "actuator_fsm.h"
+#include "rule_engine.h"
+#include "uv_dose.h"
+#include "photoperiod.h"
+#include "thermal_model.h"
+#include "psychrometrics.h"
+#include "json_parser.h"
 
 // For the class demo, we define much shorter timescales for environmental control
 #define CLASS_DEMO true
 
+// Policy defaults, built into the fallback rule table. A table in storage overrides them.
 #define HUMIDITY_THRESHOLD    80.0  // Rh
 #define TEMPERATURE_THRESHOLD 27.0  // degC, ~80F
-#define UV_A_THRESHOLD        150.0 // uWatt / cm^2
-#define UV_B_THRESHOLD        25.0 // uWatt / cm^2
-#define UV_C_THRESHOLD        25.0 // uWatt / cm^2
+#define UV_A_THRESHOLD        150.0 // uJ / cm^2 (uWatt * s / cm^2) per daylight period
+#define UV_B_THRESHOLD        25.0  // uJ / cm^2
+#define UV_C_THRESHOLD        25.0  // uJ / cm^2
 
 #define ENV_TIMER_ID 1337
-#define SAMPLES_PER_MINUTE 60
-#define DAYLIGHT_START 6 // 06:00am
-#define DAYLIGHT_END 18  // 06:00pm (18:00)
+#define DEMO_DAYLIGHT_S (6 * 60) // Class demo daylight: from the start minute through 5 mins past it, every hour
 #define ONE_MINUTE 60
 #define MAX_TIMER_FIRES 3
+#define FAN_RETRY_HOLDOFF_S (60 * 60) // After giving up on the fan, wait this long before running it again
+#define UV_DOSE_MAX_GAP_MS 10000 // Longest gap between samples the UV dose is integrated across
+#define MODEL_FORGETTING 0.98f // Per model step; about the last 50 steps carry the fit
+
+// Task notification bits for the environmental control task, sent with eSetBits
+#define ENV_EVENT_SAMPLE  (1UL << 0)  // A sample is waiting in the sensor queue
+#define ENV_EVENT_TIMER   (1UL << 1)  // The fan run timer expired
+
+// Default variable speed fan gains (CONFIG_FAN_CONTROL_PID), output in permille of fan duty
+#define FAN_PID_TEMPERATURE_KP  300.0f  // per degC over setpoint
+#define FAN_PID_TEMPERATURE_KI  3.0f    // per degC*s
+#define FAN_PID_TEMPERATURE_KD  0.0f
+#define FAN_PID_HUMIDITY_KP     60.0f   // per %Rh over setpoint
+#define FAN_PID_HUMIDITY_KI     0.5f
+#define FAN_PID_HUMIDITY_KD     0.0f
+#define FAN_PID_VPD_KP          2000.0f // per kPa under setpoint (CONFIG_FAN_HUMIDITY_TARGET_VPD)
+#define FAN_PID_VPD_KI          15.0f
+#define FAN_PID_VPD_KD          0.0f
+#define FAN_GAINS_STORAGE_KEY   "fan_gains"  // Gains set with persist, both loops
+
+typedef enum env_actuator {
+  ENV_ACTUATOR_FAN = 0,
+  ENV_ACTUATOR_LIGHTS,
+  ENV_ACTUATOR_PDLC,
+  ENV_ACTUATOR_COUNT
+} env_actuator_t;
+
+typedef enum fan_loop {
+  FAN_LOOP_TEMPERATURE = 0,
+  FAN_LOOP_HUMIDITY,
+  FAN_LOOP_COUNT
+} fan_loop_t;
 
 typedef enum status_state {
   OFF = 0,
   ON = 1
 } status_state_t;
 
+typedef void (*env_timer_callback_t)(void);
+
+/* Where the controller gets its time from. Pass NULL to environmental_control_init() for
+ * time() and a FreeRTOS one-shot timer; the replay harness injects a simulated clock.
+ * An injected start_timer must call back from the task that runs process_env_data. */
+typedef struct env_timebase {
+  time_t  (*get_time)(time_t *now);
+  void    (*start_timer)(uint32_t period_s, env_timer_callback_t callback);
+} env_timebase_struct;
+
 typedef struct sensor_data{
   struct bme280_data  bme280_data;
   UV_converted_values uv_data;
   uint16_t            soil_wetness;
+  derived_metrics_struct derived;           // Worked out once from bme280_data, see environmental_control_derive()
   time_t              timestamp;
+  int64_t             acquisition_time_us;  // esp_timer time base, monotonic
+  int64_t             queued_time_us;       // When the sample was handed to the control task
 } sensor_data_struct;
 
 typedef struct status_data {
@@ -53,34 +107,61 @@ typedef struct Environmental_control {
 
   sensor_data_struct  current_sensor_data;
 
+  const env_timebase_struct *timebase;
   TimerHandle_t       timer_handle;
   uint32_t            timer_id;
+  TaskHandle_t        event_task;           // Gets the ENV_EVENT_* notifications, the task that ran init
+  int64_t             timer_fired_us;       // esp_timer time of the last expiry, set in the timer task under lock
 
   time_t              time_now;
   struct tm           time_now_info;
   time_t              give_up_time;
   struct tm           give_up_time_info;
-  struct bme280_data  *time_series_ptr;
-  int                 time_series_index;
-
-  float               uv_a_integral;
-  float               uv_b_integral;
-  float               uv_c_integral;
+  Time_series         trend;
+  Pid_controller      fan_pid[FAN_LOOP_COUNT];
+  portMUX_TYPE        lock;                 // Guards what other tasks hand over: gains, timer_fired_us
+  pid_gains_struct    fan_gains[FAN_LOOP_COUNT];  // Latest asked for, the loops pick them up on the next sample
+  uint32_t            fan_gains_pending;    // Bit per fan_loop_t
+  Actuator_fsm        actuators[ENV_ACTUATOR_COUNT];
+  Rule_engine         rules;
+  uint32_t            rule_outputs;         // rule_output_t bits from this sample
+  float               sample_interval_s;
+
+  Uv_dose             uv_dose;              // Since the start of the daylight period
+  Photoperiod         photoperiod;
+
+  // Temperature and humidity models, indexed like the fan loops, and their forecasts
+  Thermal_model       models[FAN_LOOP_COUNT];
+  float               forecast[FAN_LOOP_COUNT];       // Highest with the fan off, PDLC as it is
+  float               forecast_fan[FAN_LOOP_COUNT];   // Highest with the fan on, PDLC as it is
+  float               forecast_clear[FAN_LOOP_COUNT]; // Highest with the fan on and the PDLC clear
 
   uint32_t            timer_period;
   uint32_t            timer_fires_counter;
+  uint32_t            max_timer_fires;
+  uint32_t            fan_give_ups;         // Times the fan runs were given up on for the hour
 
   bool                is_daylight;
   bool                timer_running;
   bool                over_temp;
   bool                over_humidity;
+  bool                fan_wanted;           // On/off mode: what the run timer logic asks for
 
   status_data_struct  (*get_statuses)(void);
   void                (*process_env_data)(sensor_data_struct sensor_readings);
+  void                (*handle_events)(uint32_t events);
+  esp_err_t           (*get_trend)(float *temperature_per_minute, float *humidity_per_minute);
+  esp_err_t           (*set_fan_gains)(fan_loop_t loop, pid_gains_struct gains, bool persist);
+  esp_err_t           (*set_rules)(const rule_table_struct *table, bool persist);
+  esp_err_t           (*set_rules_json)(const char *json, size_t length, bool persist);
+  esp_err_t           (*set_rules_tokens)(const jparse_ctx_t *jctx, bool persist);
+  esp_err_t           (*get_uv_dose)(uv_dose_band_t band, uint32_t window_s, float *dose_uj);
 
 
 } Environmental_control;
 
-esp_err_t environmental_control_init(Environmental_control *struct_ptr, Fan *fan, Lights *lights, PDLC *pdlc);
+esp_err_t environmental_control_init(Environmental_control *struct_ptr, Fan *fan, Lights *lights, PDLC *pdlc,
+  const env_timebase_struct *timebase);
+void      environmental_control_derive(sensor_data_struct *sample);
 
 #endif /* ENVIRONMENTAL_CONTROL_H */
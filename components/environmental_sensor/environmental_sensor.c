@@ -1,7 +1,10 @@
 
 #include "environmental_sensor.h"
+#include <inttypes.h>
 #include "bme280.h"
-#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "platform_i2c.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "string.h"
@@ -29,7 +32,8 @@ static esp_err_t          _environmental_sensor_get_readings(struct bme280_data*
 /*!
  * Public init function
  */
-esp_err_t enviromental_sensor_init(Environmental_sensor *struct_ptr, uint32_t timeout_ticks, i2c_port_t i2c_port_num)
+esp_err_t enviromental_sensor_init(Environmental_sensor *struct_ptr, uint32_t timeout_ticks,
+  platform_i2c_port_t i2c_port_num)
 {
   esp_err_t return_code = ESP_OK;
   BME280_INTF_RET_TYPE bme_return = BME280_OK;
@@ -99,14 +103,14 @@ BME280_INTF_RET_TYPE bme280_i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32
 
   if (length > BUFFER_SIZE) {
     ESP_LOGE(BME_TAG, "Read data length exceeds buffer length in bme280_i2c_read: Buffer length = %d, requested "
-      "read length = %lu", BUFFER_SIZE, length);
+      "read length = %" PRIu32, BUFFER_SIZE, length);
     
     return BME280_E_INVALID_LEN;
   }
 
   memset(&(self->read_buffer[0]), 0, BUFFER_SIZE);
 
-  return_code = i2c_master_write_read_device(self->i2c_port_num, self->i2c_device_addr, &reg_addr, 1,
+  return_code = platform_i2c_write_read(self->i2c_port_num, self->i2c_device_addr, &reg_addr, 1,
           reg_data, length, self->i2c_timeout_ticks);
 
   // Copy over the data to the internal struct buffer
@@ -135,7 +139,7 @@ BME280_INTF_RET_TYPE bme280_i2c_write(uint8_t reg_addr, const uint8_t *reg_data,
 
   memcpy(&(self->write_buffer[1]), reg_data, length);
 
-  return i2c_master_write_to_device(self->i2c_port_num, self->i2c_device_addr, &(self->write_buffer[0]), 
+  return platform_i2c_write(self->i2c_port_num, self->i2c_device_addr, &(self->write_buffer[0]), 
     actual_write_length, self->i2c_timeout_ticks);
 }
 
@@ -4,7 +4,7 @@
 #include <stdint.h>
 #include "bme280.h"
 #include "esp_err.h"
-#include "driver/i2c.h"
+#include "platform_i2c.h"
 
 #define BME_280_I2C_ADDR 0x77
 
@@ -16,7 +16,7 @@ typedef struct Environmental_sensor {
 
   struct bme280_data compensated_readings;
 
-  i2c_port_t i2c_port_num;
+  platform_i2c_port_t i2c_port_num;
   uint32_t i2c_timeout_ticks;
   uint32_t delay_period;
   uint8_t i2c_device_addr;
@@ -28,6 +28,7 @@ typedef struct Environmental_sensor {
 
 } Environmental_sensor;
 
-esp_err_t enviromental_sensor_init(Environmental_sensor *struct_ptr, uint32_t timeout_ticks, i2c_port_t i2c_port_num);
+esp_err_t enviromental_sensor_init(Environmental_sensor *struct_ptr, uint32_t timeout_ticks,
+  platform_i2c_port_t i2c_port_num);
 
 #endif /* ENVIRONMENTAL_SENSOR_H */
\ No newline at end of file
@@ -1,7 +1,8 @@
 #include <stdio.h>
 #include "esp_err.h"
 #include "esp_log.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
+#include "deferred_log.h"
 #include "fan.h"
 
 
@@ -12,14 +13,17 @@ static Fan *self;
 const char* FAN_TAG = "FAN";
 
 // Private functions
+static void assign_functions(void);
 
 // Public functions privided via struct fn pointers
 static void _fan_on(void);
 static void _fan_off(void);
 static fan_state_t _fan_get_state(void);
+static esp_err_t _fan_set_duty(uint16_t duty_permille);
+static uint16_t _fan_get_duty(void);
 
-esp_err_t fan_init(Fan* struct_ptr, gpio_num_t gpio_pin_fan_1,
-                   gpio_num_t gpio_pin_fan_2)
+esp_err_t fan_init(Fan* struct_ptr, platform_gpio_num_t gpio_pin_fan_1,
+                   platform_gpio_num_t gpio_pin_fan_2)
 {
   esp_err_t return_code = ESP_OK;
 
@@ -27,23 +31,12 @@ esp_err_t fan_init(Fan* struct_ptr, gpio_num_t gpio_pin_fan_1,
   self = struct_ptr;
   self->gpio_pin_num_fan_1 = gpio_pin_fan_1;
   self->gpio_pin_num_fan_2 = gpio_pin_fan_2;
-  self->on = _fan_on;
-  self->off = _fan_off;
-  self->get_state = _fan_get_state;
+  self->is_pwm = false;
+  assign_functions();
 
-  // Disable interrupt
-  self->fet_gpio_config.intr_type = GPIO_INTR_DISABLE;
-  // Set as output mode
-  self->fet_gpio_config.mode = GPIO_MODE_OUTPUT;
-  // Bit mask of the pin to be set
-  self->fet_gpio_config.pin_bit_mask = (((uint64_t)1) << ((uint64_t)gpio_pin_fan_1)) 
-                                     | (((uint64_t)1) << ((uint64_t)gpio_pin_fan_2));
-  // Disable pull-down mode
-  self->fet_gpio_config.pull_down_en = 0;
-  // Disable pull-up mode
-  self->fet_gpio_config.pull_up_en = 0;
-  // Configure GPIO with the given settings
-  return_code = gpio_config(&(self->fet_gpio_config));
+  // Both FET pins as outputs, no pull-up/pull-down
+  return_code = platform_gpio_config_output(PLATFORM_GPIO_BIT(gpio_pin_fan_1) | PLATFORM_GPIO_BIT(gpio_pin_fan_2),
+                  false, false);
 
   if (return_code != ESP_OK) {
     ESP_LOGE(FAN_TAG, "Failed to configure FAN GPIO pin.");
@@ -55,27 +48,121 @@ esp_err_t fan_init(Fan* struct_ptr, gpio_num_t gpio_pin_fan_1,
   return return_code;
 }
 
+/*!
+ * Variable speed init: both FETs are driven from PWM channels instead of plain GPIO
+ */
+esp_err_t fan_init_pwm(Fan* struct_ptr, platform_gpio_num_t gpio_pin_fan_1,
+                       platform_gpio_num_t gpio_pin_fan_2, uint32_t frequency_hz)
+{
+  esp_err_t return_code = ESP_OK;
+
+  // Assign struct fields
+  self = struct_ptr;
+  self->gpio_pin_num_fan_1 = gpio_pin_fan_1;
+  self->gpio_pin_num_fan_2 = gpio_pin_fan_2;
+  self->is_pwm = true;
+  assign_functions();
+
+  return_code = platform_pwm_init(FAN_1_PWM_CHANNEL, gpio_pin_fan_1, frequency_hz);
+  if (return_code == ESP_OK) {
+    return_code = platform_pwm_init(FAN_2_PWM_CHANNEL, gpio_pin_fan_2, frequency_hz);
+  }
+
+  if (return_code != ESP_OK) {
+    ESP_LOGE(FAN_TAG, "Failed to configure FAN PWM.");
+  }
+
+  // Set the initial state to off
+  self->off();
+
+  return return_code;
+}
+
+static void assign_functions(void)
+{
+  self->on = _fan_on;
+  self->off = _fan_off;
+  self->get_state = _fan_get_state;
+  self->set_duty = _fan_set_duty;
+  self->get_duty = _fan_get_duty;
+}
+
 static void _fan_on(void)
 {
-  gpio_set_level(self->gpio_pin_num_fan_1, (uint32_t)FAN_ON);
-  gpio_set_level(self->gpio_pin_num_fan_2, (uint32_t)FAN_ON);
+  if (self->is_pwm) {
+    self->set_duty(PLATFORM_PWM_DUTY_MAX);
+    return;
+  }
+
+  platform_gpio_set_level(self->gpio_pin_num_fan_1, (uint32_t)FAN_ON);
+  platform_gpio_set_level(self->gpio_pin_num_fan_2, (uint32_t)FAN_ON);
 
-  ESP_LOGI(FAN_TAG, "Fan on.");
+  DLOG(DLOG_FAN_ON);
 
   self->current_state = FAN_ON;
+  self->duty_permille = PLATFORM_PWM_DUTY_MAX;
 }
 
 static void _fan_off(void)
 {
-  gpio_set_level(self->gpio_pin_num_fan_1, (uint32_t)FAN_OFF);
-  gpio_set_level(self->gpio_pin_num_fan_2, (uint32_t)FAN_OFF);
+  if (self->is_pwm) {
+    self->set_duty(0);
+    return;
+  }
+
+  platform_gpio_set_level(self->gpio_pin_num_fan_1, (uint32_t)FAN_OFF);
+  platform_gpio_set_level(self->gpio_pin_num_fan_2, (uint32_t)FAN_OFF);
 
-  ESP_LOGI(FAN_TAG, "Fan off.");
+  DLOG(DLOG_FAN_OFF);
 
   self->current_state = FAN_OFF;
+  self->duty_permille = 0;
 }
 
 static fan_state_t _fan_get_state(void)
 {
   return self->current_state;
-}
\ No newline at end of file
+}
+
+/*!
+ * Fan speed in permille. Without PWM anything above zero is full speed.
+ */
+static esp_err_t _fan_set_duty(uint16_t duty_permille)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (duty_permille > PLATFORM_PWM_DUTY_MAX) {
+    duty_permille = PLATFORM_PWM_DUTY_MAX;
+  }
+
+  if (!self->is_pwm) {
+    if (duty_permille > 0) {
+      self->on();
+    } else {
+      self->off();
+    }
+    return ESP_OK;
+  }
+
+  return_code = platform_pwm_set_duty(FAN_1_PWM_CHANNEL, duty_permille);
+  if (return_code == ESP_OK) {
+    return_code = platform_pwm_set_duty(FAN_2_PWM_CHANNEL, duty_permille);
+  }
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  if (duty_permille != self->duty_permille) {
+    DLOG(DLOG_FAN_DUTY, (uint32_t) duty_permille);
+  }
+
+  self->duty_permille = duty_permille;
+  self->current_state = (duty_permille > 0) ? FAN_ON : FAN_OFF;
+
+  return ESP_OK;
+}
+
+static uint16_t _fan_get_duty(void)
+{
+  return self->duty_permille;
+}
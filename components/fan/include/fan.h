@@ -2,7 +2,12 @@
 #define FAN_H
 
 #include "esp_err.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
+#include "platform_pwm.h"
+
+// PWM channels for the two fan FETs in variable speed mode
+#define FAN_1_PWM_CHANNEL 0
+#define FAN_2_PWM_CHANNEL 1
 
 typedef enum fan_state {
   FAN_OFF = 0,
@@ -10,18 +15,23 @@ typedef enum fan_state {
 } fan_state_t;
 
 typedef struct Fan {
-  gpio_num_t    gpio_pin_num_fan_1;
-  gpio_num_t    gpio_pin_num_fan_2;
-  gpio_config_t fet_gpio_config;
+  platform_gpio_num_t gpio_pin_num_fan_1;
+  platform_gpio_num_t gpio_pin_num_fan_2;
 
-  fan_state_t   current_state;
+  fan_state_t         current_state;
+  bool                is_pwm;
+  uint16_t            duty_permille;
 
-  void          (*on)(void);
-  void          (*off)(void);
-  fan_state_t   (*get_state)(void);
+  void                (*on)(void);
+  void                (*off)(void);
+  fan_state_t         (*get_state)(void);
+  esp_err_t           (*set_duty)(uint16_t duty_permille);
+  uint16_t            (*get_duty)(void);
 } Fan;
 
-esp_err_t fan_init(Fan* struct_ptr, gpio_num_t gpio_pin_fan_1,
-                   gpio_num_t gpio_pin_fan_2);
+esp_err_t fan_init(Fan* struct_ptr, platform_gpio_num_t gpio_pin_fan_1,
+                   platform_gpio_num_t gpio_pin_fan_2);
+esp_err_t fan_init_pwm(Fan* struct_ptr, platform_gpio_num_t gpio_pin_fan_1,
+                       platform_gpio_num_t gpio_pin_fan_2, uint32_t frequency_hz);
 
 #endif /* FAN_H */
\ No newline at end of file
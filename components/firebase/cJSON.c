@@ -57,6 +57,7 @@
 #endif
 
 #include "cJSON.h"
+#include "json_number.h"
 
 /* define our own boolean type */
 #ifdef true
@@ -548,9 +549,8 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
     double d = item->valuedouble;
     int length = 0;
     size_t i = 0;
-    unsigned char number_buffer[26] = {0}; /* temporary buffer to print the number into */
-    unsigned char decimal_point = get_decimal_point();
-    double test = 0.0;
+    unsigned char number_buffer[JSON_NUMBER_BUFFER_SIZE] = {0}; /* temporary buffer to print the number into */
+    int decimals = (item->type & cJSON_DecimalsMask) >> cJSON_DecimalsShift;
 
     if (output_buffer == NULL)
     {
@@ -562,21 +562,18 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
     {
         length = sprintf((char*)number_buffer, "null");
     }
-	else if(d == (double)item->valueint)
-	{
-		length = sprintf((char*)number_buffer, "%d", item->valueint);
-	}
+    else if (d == (double)item->valueint)
+    {
+        length = json_number_integer(item->valueint, (char*)number_buffer);
+    }
+    else if (decimals != 0)
+    {
+        length = json_number_fixed(d, decimals - 1, (char*)number_buffer);
+    }
     else
     {
-        /* Try 15 decimal places of precision to avoid nonsignificant nonzero digits */
-        length = sprintf((char*)number_buffer, "%1.15g", d);
-
-        /* Check whether the original double can be recovered */
-        if ((sscanf((char*)number_buffer, "%lg", &test) != 1) || !compare_double((double)test, d))
-        {
-            /* If not, print with 17 decimal places of precision */
-            length = sprintf((char*)number_buffer, "%1.17g", d);
-        }
+        /* Shortest digits that read back as d, without going through the (soft double) printf */
+        length = json_number_shortest(d, (char*)number_buffer);
     }
 
     /* sprintf failed or buffer overrun occurred */
@@ -592,16 +589,9 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
         return false;
     }
 
-    /* copy the printed number to the output and replace locale
-     * dependent decimal point with '.' */
+    /* copy the printed number to the output, the decimal point is always '.' */
     for (i = 0; i < ((size_t)length); i++)
     {
-        if (number_buffer[i] == decimal_point)
-        {
-            output_pointer[i] = '.';
-            continue;
-        }
-
         output_pointer[i] = number_buffer[i];
     }
     output_pointer[i] = '\0';
@@ -1877,21 +1867,267 @@ CJSON_PUBLIC(cJSON *) cJSON_GetArrayItem(const cJSON *array, int index)
     return get_array_item(array, (size_t)index);
 }
 
+/* Key index: an object whose lookups have to walk CJSON_INDEX_MIN_ITEMS members or more gets an open
+ * addressing hash table of its members, kept in its (otherwise unused) valuestring. Members are entered
+ * in list order, so the first match along a probe sequence is the first match in the list, as without
+ * the index. Appending and detaching keep it up to date, other changes to the members drop it.
+ * Lookups on an object can build its index, so they are no longer read only. */
+#ifndef CJSON_INDEX_MIN_ITEMS
+#define CJSON_INDEX_MIN_ITEMS 16
+#endif
+
+typedef struct object_index_slot
+{
+    unsigned int hash;
+    cJSON *item;
+} object_index_slot;
+
+typedef struct object_index
+{
+    size_t mask;
+    size_t count;
+    /* mask + 1 object_index_slot follow */
+} object_index;
+
+#define index_slots(index) ((object_index_slot*)((index) + 1))
+
+/* FNV-1a of the lower-cased key, so case-insensitive matches share a hash */
+static unsigned int hash_key(const unsigned char *key)
+{
+    unsigned int hash = 2166136261U;
+
+    for (; *key != '\0'; key++)
+    {
+        hash = (hash ^ (unsigned int)tolower(*key)) * 16777619U;
+    }
+
+    return hash;
+}
+
+static object_index *get_object_index(const cJSON * const object)
+{
+    if (((object->type & 0xFF) != cJSON_Object) || (object->type & cJSON_IsReference))
+    {
+        return NULL;
+    }
+
+    return (object_index*)object->valuestring;
+}
+
+static void drop_object_index(cJSON * const object)
+{
+    if ((object != NULL) && (get_object_index(object) != NULL))
+    {
+        global_hooks.deallocate(object->valuestring);
+        object->valuestring = NULL;
+    }
+}
+
+static void insert_into_index(object_index * const index, cJSON * const item, const unsigned int hash)
+{
+    object_index_slot *slots = index_slots(index);
+    size_t position = hash & index->mask;
+
+    while (slots[position].item != NULL)
+    {
+        position = (position + 1) & index->mask;
+    }
+    slots[position].hash = hash;
+    slots[position].item = item;
+    index->count++;
+}
+
+/* Add a member appended to the object, or drop the index if it would get more than half full */
+static void index_appended_item(cJSON * const object, cJSON * const item)
+{
+    object_index *index = get_object_index(object);
+
+    if (index == NULL)
+    {
+        return;
+    }
+
+    if ((item->string == NULL) || ((index->count + 1) * 2 > index->mask + 1))
+    {
+        drop_object_index(object);
+        return;
+    }
+
+    insert_into_index(index, item, hash_key((const unsigned char*)item->string));
+}
+
+/* Take a member out, moving the ones after it back so no probe sequence is broken */
+static void index_detached_item(cJSON * const object, const cJSON * const item)
+{
+    object_index *index = get_object_index(object);
+    object_index_slot *slots = NULL;
+    size_t position = 0;
+    size_t next = 0;
+    size_t home = 0;
+
+    if ((index == NULL) || (item->string == NULL))
+    {
+        return;
+    }
+
+    slots = index_slots(index);
+    position = hash_key((const unsigned char*)item->string) & index->mask;
+    while ((slots[position].item != NULL) && (slots[position].item != item))
+    {
+        position = (position + 1) & index->mask;
+    }
+    if (slots[position].item == NULL)
+    {
+        return;
+    }
+
+    next = position;
+    for (;;)
+    {
+        next = (next + 1) & index->mask;
+        if (slots[next].item == NULL)
+        {
+            break;
+        }
+
+        /* stays put if its home is cyclically in (position, next] */
+        home = slots[next].hash & index->mask;
+        if ((position <= next) ? ((position < home) && (home <= next)) : ((position < home) || (home <= next)))
+        {
+            continue;
+        }
+        slots[position] = slots[next];
+        position = next;
+    }
+    slots[position].item = NULL;
+    index->count--;
+}
+
+/* Put replacement in item's slot when the key hashes the same, otherwise drop the index */
+static void index_replaced_item(cJSON * const object, const cJSON * const item, cJSON * const replacement)
+{
+    object_index *index = get_object_index(object);
+    object_index_slot *slots = NULL;
+    unsigned int hash = 0;
+    size_t position = 0;
+
+    if (index == NULL)
+    {
+        return;
+    }
+
+    if ((item->string == NULL) || (replacement->string == NULL) ||
+        ((hash = hash_key((const unsigned char*)item->string)) != hash_key((const unsigned char*)replacement->string)))
+    {
+        drop_object_index(object);
+        return;
+    }
+
+    slots = index_slots(index);
+    for (position = hash & index->mask; slots[position].item != NULL; position = (position + 1) & index->mask)
+    {
+        if (slots[position].item == item)
+        {
+            slots[position].item = replacement;
+            return;
+        }
+    }
+}
+
+static void build_object_index(cJSON * const object)
+{
+    object_index *index = NULL;
+    cJSON *current_element = NULL;
+    size_t count = 0;
+    size_t size = 1;
+
+    for (current_element = object->child; current_element != NULL; current_element = current_element->next)
+    {
+        /* members without a name end the case-sensitive walk, keep that behaviour */
+        if (current_element->string == NULL)
+        {
+            return;
+        }
+        count++;
+    }
+
+    while (size < count * 2)
+    {
+        size *= 2;
+    }
+
+    index = (object_index*)global_hooks.allocate(sizeof(object_index) + (size * sizeof(object_index_slot)));
+    if (index == NULL)
+    {
+        return;
+    }
+    memset(index_slots(index), 0, size * sizeof(object_index_slot));
+    index->mask = size - 1;
+    index->count = 0;
+
+    for (current_element = object->child; current_element != NULL; current_element = current_element->next)
+    {
+        insert_into_index(index, current_element, hash_key((const unsigned char*)current_element->string));
+    }
+
+    object->valuestring = (char*)index;
+}
+
+static cJSON *find_in_index(const object_index * const index, const char * const name, const cJSON_bool case_sensitive)
+{
+    const object_index_slot *slots = index_slots(index);
+    unsigned int hash = hash_key((const unsigned char*)name);
+    size_t position = 0;
+    cJSON *item = NULL;
+
+    for (position = hash & index->mask; slots[position].item != NULL; position = (position + 1) & index->mask)
+    {
+        item = slots[position].item;
+        /* interned keys: the name the member was added with */
+        if (item->string == name)
+        {
+            return item;
+        }
+        if ((slots[position].hash == hash) &&
+            (case_sensitive ? (strcmp(name, item->string) == 0) :
+                              (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)item->string) == 0)))
+        {
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+CJSON_PUBLIC(void) cJSON_DropObjectIndex(cJSON *object)
+{
+    drop_object_index(object);
+}
+
 static cJSON *get_object_item(const cJSON * const object, const char * const name, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = NULL;
+    object_index *index = NULL;
+    size_t walked = 0;
 
     if ((object == NULL) || (name == NULL))
     {
         return NULL;
     }
 
+    index = get_object_index(object);
+    if (index != NULL)
+    {
+        return find_in_index(index, name, case_sensitive);
+    }
+
     current_element = object->child;
     if (case_sensitive)
     {
         while ((current_element != NULL) && (current_element->string != NULL) && (strcmp(name, current_element->string) != 0))
         {
             current_element = current_element->next;
+            walked++;
         }
     }
     else
@@ -1899,9 +2135,15 @@ static cJSON *get_object_item(const cJSON * const object, const char * const nam
         while ((current_element != NULL) && (case_insensitive_strcmp((const unsigned char*)name, (const unsigned char*)(current_element->string)) != 0))
         {
             current_element = current_element->next;
+            walked++;
         }
     }
 
+    if ((walked >= CJSON_INDEX_MIN_ITEMS) && ((object->type & 0xFF) == cJSON_Object) && !(object->type & cJSON_IsReference))
+    {
+        build_object_index((cJSON*)(size_t)object);
+    }
+
     if ((current_element == NULL) || (current_element->string == NULL)) {
         return NULL;
     }
@@ -1982,6 +2224,7 @@ static cJSON_bool add_item_to_array(cJSON *array, cJSON *item)
             array->child->prev = item;
         }
     }
+    index_appended_item(array, item);
 
     return true;
 }
@@ -2136,6 +2379,18 @@ CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObject(cJSON * const object, const char *
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON*) cJSON_AddNumberToObjectFixed(cJSON * const object, const char * const name, const double number, const int decimals)
+{
+    cJSON *number_item = cJSON_CreateNumberFixed(number, decimals);
+    if (add_item_to_object(object, name, number_item, &global_hooks, false))
+    {
+        return number_item;
+    }
+
+    cJSON_Delete(number_item);
+    return NULL;
+}
+
 CJSON_PUBLIC(cJSON*) cJSON_AddStringToObject(cJSON * const object, const char * const name, const char * const string)
 {
     cJSON *string_item = cJSON_CreateString(string);
@@ -2191,6 +2446,8 @@ CJSON_PUBLIC(cJSON *) cJSON_DetachItemViaPointer(cJSON *parent, cJSON * const it
         return NULL;
     }
 
+    index_detached_item(parent, item);
+
     if (item != parent->child)
     {
         /* not the first element */
@@ -2275,6 +2532,9 @@ CJSON_PUBLIC(cJSON_bool) cJSON_InsertItemInArray(cJSON *array, int which, cJSON
         return add_item_to_array(array, newitem);
     }
 
+    /* the index holds members in list order */
+    drop_object_index(array);
+
     newitem->next = after_inserted;
     newitem->prev = after_inserted->prev;
     after_inserted->prev = newitem;
@@ -2301,6 +2561,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_ReplaceItemViaPointer(cJSON * const parent, cJSON
         return true;
     }
 
+    index_replaced_item(parent, item, replacement);
+
     replacement->next = item->next;
     replacement->prev = item->prev;
 
@@ -2452,6 +2714,17 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateNumber(double num)
     return item;
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_CreateNumberFixed(double num, int decimals)
+{
+    cJSON *item = cJSON_CreateNumber(num);
+    if (item && (decimals >= 0) && (decimals <= JSON_NUMBER_MAX_DECIMALS))
+    {
+        item->type |= (decimals + 1) << cJSON_DecimalsShift;
+    }
+
+    return item;
+}
+
 CJSON_PUBLIC(cJSON *) cJSON_CreateString(const char *string)
 {
     cJSON *item = cJSON_New_Item(&global_hooks);
@@ -2725,7 +2998,8 @@ CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
     newitem->type = item->type & (~cJSON_IsReference);
     newitem->valueint = item->valueint;
     newitem->valuedouble = item->valuedouble;
-    if (item->valuestring)
+    /* an object's valuestring is its key index, the copy builds its own */
+    if (item->valuestring && ((item->type & 0xFF) != cJSON_Object))
     {
         newitem->valuestring = (char*)cJSON_strdup((unsigned char*)item->valuestring, &global_hooks);
         if (!newitem->valuestring)
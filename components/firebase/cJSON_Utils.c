@@ -298,6 +298,40 @@ static cJSON_bool decode_array_index_from_pointer(const unsigned char * const po
     return 1;
 }
 
+/* Longest pointer token (with its terminator) looked up through cJSON's key index, longer ones are compared in place */
+#define POINTER_KEY_SIZE 64
+
+/* Copy the next path element of a JSON pointer, with ~0 and ~1 decoded, into key. False if it doesn't fit or has an invalid escape. */
+static cJSON_bool decode_pointer_token(const unsigned char *pointer, unsigned char *key, const size_t size)
+{
+    size_t length = 0;
+
+    for (; (*pointer != '\0') && (*pointer != '/'); pointer++)
+    {
+        if (length + 1 >= size)
+        {
+            return false;
+        }
+
+        if (*pointer == '~')
+        {
+            if ((pointer[1] != '0') && (pointer[1] != '1'))
+            {
+                return false;
+            }
+            key[length++] = (pointer[1] == '0') ? '~' : '/';
+            pointer++;
+        }
+        else
+        {
+            key[length++] = *pointer;
+        }
+    }
+    key[length] = '\0';
+
+    return true;
+}
+
 static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer, const cJSON_bool case_sensitive)
 {
     cJSON *current_element = object;
@@ -323,11 +357,20 @@ static cJSON *get_item_from_pointer(cJSON * const object, const char * pointer,
         }
         else if (cJSON_IsObject(current_element))
         {
-            current_element = current_element->child;
-            /* GetObjectItem. */
-            while ((current_element != NULL) && !compare_pointers((unsigned char*)current_element->string, (const unsigned char*)pointer, case_sensitive))
+            unsigned char key[POINTER_KEY_SIZE];
+
+            if (decode_pointer_token((const unsigned char*)pointer, key, sizeof(key)))
             {
-                current_element = current_element->next;
+                /* GetObjectItem, through the key index for large objects. */
+                current_element = case_sensitive ? cJSON_GetObjectItemCaseSensitive(current_element, (const char*)key) : cJSON_GetObjectItem(current_element, (const char*)key);
+            }
+            else
+            {
+                current_element = current_element->child;
+                while ((current_element != NULL) && !compare_pointers((unsigned char*)current_element->string, (const unsigned char*)pointer, case_sensitive))
+                {
+                    current_element = current_element->next;
+                }
             }
         }
         else
@@ -374,7 +417,7 @@ static void decode_pointer_inplace(unsigned char *string)
             }
             else if (string[1] == '1')
             {
-                decoded_string[1] = '/';
+                decoded_string[0] = '/';
             }
             else
             {
@@ -384,6 +427,10 @@ static void decode_pointer_inplace(unsigned char *string)
 
             string++;
         }
+        else
+        {
+            decoded_string[0] = string[0];
+        }
     }
 
     decoded_string[0] = '\0';
@@ -480,8 +527,8 @@ cleanup:
     return detached_item;
 }
 
-/* sort lists using mergesort */
-static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
+/* sort lists using mergesort, in place; used when there is no memory for sort_list's array */
+static cJSON *sort_list_in_place(cJSON *list, const cJSON_bool case_sensitive)
 {
     cJSON *first = list;
     cJSON *second = list;
@@ -527,8 +574,8 @@ static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
     }
 
     /* Recursively sort the sub-lists. */
-    first = sort_list(first, case_sensitive);
-    second = sort_list(second, case_sensitive);
+    first = sort_list_in_place(first, case_sensitive);
+    second = sort_list_in_place(second, case_sensitive);
     result = NULL;
 
     /* Merge the sub-lists */
@@ -592,6 +639,116 @@ static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
     return result;
 }
 
+/* lists up to this long are sorted on the stack */
+#define SORT_SMALL_LIST 16
+
+/* sort lists by member name: a stable bottom-up mergesort over an array of the items,
+ * which are then relinked. Unlike recursing on the list this checks for sorted input once
+ * and doesn't walk the list to split it at every level. */
+static cJSON *sort_list(cJSON *list, const cJSON_bool case_sensitive)
+{
+    cJSON *small_items[2 * SORT_SMALL_LIST];
+    cJSON **items = NULL;
+    cJSON **buffer = NULL;
+    cJSON **swap = NULL;
+    cJSON *current_item = list;
+    size_t count = 1;
+    size_t width = 0;
+    size_t index = 0;
+
+    if ((list == NULL) || (list->next == NULL))
+    {
+        /* One entry is sorted already. */
+        return list;
+    }
+
+    while ((current_item->next != NULL) && (compare_strings((unsigned char*)current_item->string, (unsigned char*)current_item->next->string, case_sensitive) < 0))
+    {
+        /* Test for list sorted. */
+        current_item = current_item->next;
+        count++;
+    }
+    if (current_item->next == NULL)
+    {
+        /* Leave sorted lists unmodified. */
+        return list;
+    }
+
+    for (current_item = current_item->next; current_item != NULL; current_item = current_item->next)
+    {
+        count++;
+    }
+
+    items = (count <= SORT_SMALL_LIST) ? small_items : (cJSON**)cJSON_malloc(2 * count * sizeof(cJSON*));
+    if (items == NULL)
+    {
+        list = sort_list_in_place(list, case_sensitive);
+        for (current_item = list; current_item->next != NULL; current_item = current_item->next)
+        {
+        }
+        list->prev = current_item;
+        return list;
+    }
+    buffer = items + count;
+
+    for ((void)(index = 0), current_item = list; current_item != NULL; (void)(index++), current_item = current_item->next)
+    {
+        items[index] = current_item;
+    }
+
+    for (width = 1; width < count; width *= 2)
+    {
+        /* merge runs of 'width' items pairwise from items into buffer */
+        for (index = 0; index < count; index += 2 * width)
+        {
+            size_t left = index;
+            size_t middle = ((index + width) < count) ? (index + width) : count;
+            size_t right = middle;
+            size_t end = ((index + 2 * width) < count) ? (index + 2 * width) : count;
+            size_t out = index;
+
+            while ((left < middle) && (right < end))
+            {
+                /* take from the left run on ties to keep equal names in document order */
+                if (compare_strings((unsigned char*)items[right]->string, (unsigned char*)items[left]->string, case_sensitive) < 0)
+                {
+                    buffer[out++] = items[right++];
+                }
+                else
+                {
+                    buffer[out++] = items[left++];
+                }
+            }
+            while (left < middle)
+            {
+                buffer[out++] = items[left++];
+            }
+            while (right < end)
+            {
+                buffer[out++] = items[right++];
+            }
+        }
+        swap = items;
+        items = buffer;
+        buffer = swap;
+    }
+
+    /* relink; the head's prev points at the tail as everywhere else in cJSON */
+    for (index = 0; index < count; index++)
+    {
+        items[index]->prev = (index > 0) ? items[index - 1] : items[count - 1];
+        items[index]->next = ((index + 1) < count) ? items[index + 1] : NULL;
+    }
+    list = items[0];
+
+    if ((items != small_items) && (buffer != small_items))
+    {
+        cJSON_free((items < buffer) ? items : buffer);
+    }
+
+    return list;
+}
+
 static void sort_object(cJSON * const object, const cJSON_bool case_sensitive)
 {
     if (object == NULL)
@@ -599,6 +756,7 @@ static void sort_object(cJSON * const object, const cJSON_bool case_sensitive)
         return;
     }
     object->child = sort_list(object->child, case_sensitive);
+    cJSON_DropObjectIndex(object);
 }
 
 static cJSON_bool compare_json(cJSON *a, cJSON *b, const cJSON_bool case_sensitive)
@@ -1216,6 +1374,9 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
         {
             cJSON *from_child = NULL;
             cJSON *to_child = NULL;
+            size_t path_length = strlen((const char*)path);
+            unsigned char *new_path = NULL;
+            size_t new_path_size = 0;
             sort_object(from, case_sensitive);
             sort_object(to, case_sensitive);
 
@@ -1241,16 +1402,25 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
                 if (diff == 0)
                 {
                     /* both object keys are the same */
-                    size_t path_length = strlen((const char*)path);
                     size_t from_child_name_length = pointer_encoded_length((unsigned char*)from_child->string);
-                    unsigned char *new_path = (unsigned char*)cJSON_malloc(path_length + from_child_name_length + sizeof("/"));
 
-                    sprintf((char*)new_path, "%s/", path);
+                    /* one path buffer for all the members, grown for longer names */
+                    if ((path_length + from_child_name_length + sizeof("/")) > new_path_size)
+                    {
+                        cJSON_free(new_path);
+                        new_path_size = path_length + from_child_name_length + sizeof("/") + 32;
+                        new_path = (unsigned char*)cJSON_malloc(new_path_size);
+                        if (new_path == NULL)
+                        {
+                            return;
+                        }
+                        memcpy(new_path, path, path_length);
+                        new_path[path_length] = '/';
+                    }
                     encode_string_as_pointer(new_path + path_length + 1, (unsigned char*)from_child->string);
 
                     /* create a patch for the element */
                     create_patches(patches, new_path, from_child, to_child, case_sensitive);
-                    cJSON_free(new_path);
 
                     from_child = from_child->next;
                     to_child = to_child->next;
@@ -1270,6 +1440,7 @@ static void create_patches(cJSON * const patches, const unsigned char * const pa
                     to_child = to_child->next;
                 }
             }
+            cJSON_free(new_path);
             return;
         }
 
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "platform_http.h"
+#include "platform_storage.h"
+#include "json_schema.h"
+#include "cycle_profiler.h"
+#include "command_stream.h"
+
+// Where in an event stream line the parser is
+typedef enum line_state {
+  LINE_FIELD = 0,       // Field name, up to the colon
+  LINE_EVENT_START,     // Just after "event:", a space may follow
+  LINE_EVENT,
+  LINE_DATA_START,
+  LINE_DATA,
+  LINE_IGNORE           // Comment, or a field that isn't needed
+} line_state_t;
+
+// Gains for the fan loops, a loop left out keeps its kp NAN
+typedef struct command_fan_gains {
+  pid_gains_struct  loops[FAN_LOOP_COUNT];
+} command_fan_gains_struct;
+
+// The members of a command besides the rule table, which goes straight to the controller
+typedef struct command {
+  uint32_t                  id;
+  int64_t                   sent_ms;      // Server time, ms since the epoch
+  bool                      persist;
+  bool                      dump_profile; // Log the latency histograms
+  command_fan_gains_struct  fan_gains;
+} command_struct;
+
+static const json_field_struct gains_fields[] = {
+  JSON_FIELD_NUMBER("kp", JSON_FIELD_FLOAT, pid_gains_struct, kp, true, 0, COMMAND_FAN_GAIN_MAX),
+  JSON_FIELD_NUMBER("ki", JSON_FIELD_FLOAT, pid_gains_struct, ki, true, 0, COMMAND_FAN_GAIN_MAX),
+  JSON_FIELD_NUMBER("kd", JSON_FIELD_FLOAT, pid_gains_struct, kd, true, 0, COMMAND_FAN_GAIN_MAX)
+};
+static const json_schema_struct gains_schema = JSON_SCHEMA(gains_fields);
+
+static const json_field_struct fan_gains_fields[] = {
+  JSON_FIELD_STRUCT("temperature", command_fan_gains_struct, loops[FAN_LOOP_TEMPERATURE], false, &gains_schema),
+  JSON_FIELD_STRUCT("humidity", command_fan_gains_struct, loops[FAN_LOOP_HUMIDITY], false, &gains_schema)
+};
+static const json_schema_struct fan_gains_schema = JSON_SCHEMA(fan_gains_fields);
+
+static const json_field_struct command_fields[] = {
+  JSON_FIELD_NUMBER("id", JSON_FIELD_UINT, command_struct, id, true, 1, UINT32_MAX),
+  JSON_FIELD_NUMBER("sent_ms", JSON_FIELD_INT, command_struct, sent_ms, false, 0, 1e15),
+  JSON_FIELD_BOOLEAN("persist", command_struct, persist, false),
+  JSON_FIELD_BOOLEAN("dump_profile", command_struct, dump_profile, false),
+  JSON_FIELD_STRUCT("fan_gains", command_struct, fan_gains, false, &fan_gains_schema)
+};
+static const json_schema_struct command_schema = JSON_SCHEMA(command_fields);
+
+// Static private object pointer
+static Command_stream *self;
+
+// Logger tag
+static const char *COMMAND_TAG = "Commands";
+
+// Private functions
+static void on_stream_data(const char *data, int length, void *context);
+static size_t append_value(const char *data, size_t length);
+static void start_value(void);
+static void end_line(void);
+static void dispatch_event(void);
+static void handle_command(void);
+static esp_err_t apply_command(jparse_ctx_t *jctx);
+#if !CONFIG_FAN_CONTROL_PID
+static bool has_fan_gains(const command_struct *command);
+#endif
+static void reset_event(void);
+static bool is_command_event(void);
+
+// Public functions
+static void _command_stream_run(void);
+static command_stream_stats_struct _command_stream_get_stats(void);
+
+// SSL cert
+extern const char cert_start[] asm("_binary_certificate_pem_start");
+
+
+/*!
+ * Public init function
+ */
+esp_err_t command_stream_init(Command_stream *stream, const char *url, Environmental_control *controller)
+{
+  size_t length = sizeof(uint32_t);
+  esp_err_t return_code = ESP_OK;
+
+  if ((stream == NULL) || (url == NULL) || (controller == NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  self = stream;
+
+  self->url = url;
+  self->certificate = cert_start;
+  self->controller = controller;
+  memset(&(self->stats), 0, sizeof(command_stream_stats_struct));
+  memset(&(self->jctx), 0, sizeof(jparse_ctx_t));
+  json_tok_pool_init(&(self->pool), self->tokens, COMMAND_TOKENS, COMMAND_MAX_TOKENS);
+  reset_event();
+
+  // Firebase sends the current command on every connect, the one already applied before a restart too
+  return_code = platform_storage_read(COMMAND_STORAGE_KEY, &(self->stats.last_id), &length);
+  if ((return_code == ESP_OK) && (length != sizeof(uint32_t))) {
+    return_code = ESP_ERR_INVALID_SIZE;
+  }
+  if (return_code != ESP_OK) {
+    if (return_code != ESP_ERR_NOT_FOUND) {
+      ESP_LOGW(COMMAND_TAG, "Stored command id rejected: %s", esp_err_to_name(return_code));
+    }
+    self->stats.last_id = 0;
+  }
+
+  self->run = _command_stream_run;
+  self->get_stats = _command_stream_get_stats;
+
+  return ESP_OK;
+}
+
+/*!
+ * Stay subscribed: reconnect whenever the stream ends, backing off while it won't connect
+ */
+static void _command_stream_run(void)
+{
+  esp_err_t return_code = ESP_OK;
+  uint32_t retry_ms = COMMAND_RETRY_MIN_MS;
+  int status_code = 0;
+  platform_http_request_struct request = {
+    .url = self->url,
+    .cert_pem = self->certificate,
+    .accept = "text/event-stream",
+    .on_data = on_stream_data,
+    .context = self
+  };
+
+  while (1) {
+    // An event cut off by the last connection is dropped
+    json_parse_end(&(self->jctx));
+    reset_event();
+    self->line_state = LINE_FIELD;
+    self->field_length = 0;
+    self->after_cr = false;
+    self->received = 0;
+    status_code = 0;
+
+    return_code = platform_http_stream(&request, COMMAND_IDLE_TIMEOUT_MS, &status_code);
+    if (status_code == 200) {
+      self->stats.connects++;
+    }
+    ESP_LOGW(COMMAND_TAG, "Command stream ended: %s, status %d, %u bytes", esp_err_to_name(return_code),
+      status_code, (unsigned) self->received);
+
+    if (self->received > 0) {
+      retry_ms = COMMAND_RETRY_MIN_MS;
+    }
+    vTaskDelay(pdMS_TO_TICKS(retry_ms));
+    retry_ms = (retry_ms < (COMMAND_RETRY_MAX_MS / 2)) ? (retry_ms * 2) : COMMAND_RETRY_MAX_MS;
+  }
+}
+
+static command_stream_stats_struct _command_stream_get_stats(void)
+{
+  return self->stats;
+}
+
+/*!
+ * Event stream data, in chunks that split lines and events anywhere
+ */
+static void on_stream_data(const char *data, int length, void *context)
+{
+  size_t i = 0;
+  char c = 0;
+
+  self->received += (size_t) length;
+
+  while (i < (size_t) length) {
+    c = data[i];
+
+    // CR, LF and CR LF all end a line
+    if (self->after_cr && (c == '\n')) {
+      self->after_cr = false;
+      i++;
+      continue;
+    }
+    self->after_cr = (c == '\r');
+    if ((c == '\r') || (c == '\n')) {
+      end_line();
+      i++;
+      continue;
+    }
+
+    if (self->event_start_us == 0) {
+      self->event_start_us = esp_timer_get_time();
+    }
+
+    switch (self->line_state) {
+      case LINE_FIELD:
+        if (c == ':') {
+          start_value();
+        } else if (self->field_length < (COMMAND_FIELD_SIZE - 1)) {
+          self->field[self->field_length++] = c;
+        } else {
+          // Too long to be one we want
+          self->field_length = COMMAND_FIELD_SIZE;
+        }
+        break;
+      case LINE_EVENT_START:
+      case LINE_DATA_START:
+        self->line_state = (self->line_state == LINE_EVENT_START) ? LINE_EVENT : LINE_DATA;
+        if (c != ' ') {
+          continue;
+        }
+        break;
+      case LINE_EVENT:
+      case LINE_DATA:
+        i += append_value(&data[i], (size_t) length - i);
+        continue;
+      default:
+        break;
+    }
+    i++;
+  }
+
+  // Tokenize what is in so far, so only the tail is left when the event ends
+  if ((self->data_length > 0) && !self->overflow && (self->parse_result == JSON_PARSE_PARTIAL)) {
+    self->parse_result = json_parse_feed(&(self->jctx), self->data, (int) self->data_length);
+  }
+}
+
+/*!
+ * Copy the value up to the end of the line, or of the chunk. Returns the bytes used.
+ */
+static size_t append_value(const char *data, size_t length)
+{
+  size_t run = 0;
+  size_t room = 0;
+
+  while ((run < length) && (data[run] != '\r') && (data[run] != '\n')) {
+    run++;
+  }
+
+  if (self->line_state == LINE_EVENT) {
+    room = COMMAND_EVENT_SIZE - 1 - self->event_length;
+    memcpy(&(self->event[self->event_length]), data, (run < room) ? run : room);
+    self->event_length += (run < room) ? run : room;
+    self->event[self->event_length] = '\0';
+  } else if (run > (sizeof(self->data) - self->data_length)) {
+    self->overflow = true;
+  } else if (!self->overflow) {
+    memcpy(&(self->data[self->data_length]), data, run);
+    self->data_length += run;
+  }
+
+  return run;
+}
+
+/*!
+ * Colon after a field name. Only put and patch data is kept; the event name comes first.
+ */
+static void start_value(void)
+{
+  if (self->field_length < COMMAND_FIELD_SIZE) {
+    self->field[self->field_length] = '\0';
+  } else {
+    self->field[0] = '\0';
+  }
+
+  if (strcmp(self->field, "event") == 0) {
+    self->event_length = 0;
+    self->event[0] = '\0';
+    self->line_state = LINE_EVENT_START;
+  } else if ((strcmp(self->field, "data") == 0) && is_command_event()) {
+    if (self->data_length == 0) {
+      json_parse_begin(&(self->jctx), &(self->pool));
+      self->parse_result = JSON_PARSE_PARTIAL;
+    } else if (self->data_length < sizeof(self->data)) {
+      // Data lines are joined with a newline
+      self->data[self->data_length++] = '\n';
+    } else {
+      self->overflow = true;
+    }
+    self->line_state = LINE_DATA_START;
+  } else {
+    self->line_state = LINE_IGNORE;
+  }
+}
+
+/*!
+ * A blank line ends the event
+ */
+static void end_line(void)
+{
+  if ((self->line_state == LINE_FIELD) && (self->field_length == 0)) {
+    dispatch_event();
+  }
+
+  self->line_state = LINE_FIELD;
+  self->field_length = 0;
+}
+
+static void dispatch_event(void)
+{
+  if (is_command_event()) {
+    handle_command();
+  } else if (strcmp(self->event, "keep-alive") == 0) {
+    self->stats.keep_alives++;
+  } else if ((strcmp(self->event, "cancel") == 0) || (strcmp(self->event, "auth_revoked") == 0)) {
+    // The server closes the stream after these
+    ESP_LOGW(COMMAND_TAG, "Stream cancelled by the server (%s)", self->event);
+  }
+
+  json_parse_end(&(self->jctx));
+  reset_event();
+}
+
+/*!
+ * A put or patch event, its data tokenized but for what arrived with the blank line
+ */
+static void handle_command(void)
+{
+  esp_err_t return_code = ESP_ERR_INVALID_ARG;
+
+  self->stats.commands++;
+
+  if ((self->data_length > 0) && !self->overflow && (self->parse_result == JSON_PARSE_PARTIAL)) {
+    self->parse_result = json_parse_feed(&(self->jctx), self->data, (int) self->data_length);
+  }
+
+  if (self->overflow) {
+    ESP_LOGW(COMMAND_TAG, "Command over %u bytes dropped", (unsigned) sizeof(self->data));
+  } else if ((self->data_length == 0) || (self->parse_result != OS_SUCCESS)) {
+    ESP_LOGW(COMMAND_TAG, "Unreadable command event");
+  } else {
+    return_code = apply_command(&(self->jctx));
+  }
+
+  if (return_code != ESP_OK) {
+    self->stats.rejected++;
+  }
+}
+
+/*!
+ * {"path": "/", "data": <command>}: check the whole command, then hand the rule table to the
+ * controller, which switches to it in one go
+ */
+static esp_err_t apply_command(jparse_ctx_t *jctx)
+{
+  esp_err_t return_code = ESP_OK;
+  command_struct command = { 0 };
+  char path[COMMAND_PATH_SIZE];
+  struct timeval now;
+  int64_t latency_ms = 0;
+
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    command.fan_gains.loops[loop].kp = NAN;
+  }
+
+  if (json_obj_get_string(jctx, "path", path, sizeof(path)) != OS_SUCCESS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (strcmp(path, "/") != 0) {
+    ESP_LOGW(COMMAND_TAG, "Ignoring a write to %s, commands are written whole", path);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+  if (json_obj_get_object(jctx, "data") != OS_SUCCESS) {
+    // The command was deleted
+    return ESP_OK;
+  }
+
+  return_code = json_schema_decode_tokens(&command_schema, jctx, &command);
+  if (return_code != ESP_OK) {
+    ESP_LOGW(COMMAND_TAG, "Bad command: %s", esp_err_to_name(return_code));
+    return return_code;
+  }
+
+  if (command.id <= self->stats.last_id) {
+    self->stats.duplicates++;
+    return ESP_OK;
+  }
+
+#if !CONFIG_FAN_CONTROL_PID
+  // Turned down before the rules are applied, so nothing of the command is
+  if (has_fan_gains(&command)) {
+    ESP_LOGW(COMMAND_TAG, "Command %" PRIu32 " rejected: fan gains need the variable speed fan", command.id);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+#endif
+
+  if (json_obj_get_object(jctx, "rules") == OS_SUCCESS) {
+    return_code = self->controller->set_rules_tokens(jctx, command.persist);
+    if (return_code != ESP_OK) {
+      ESP_LOGW(COMMAND_TAG, "Command %" PRIu32 " rejected: %s", command.id, esp_err_to_name(return_code));
+      return return_code;
+    }
+  }
+
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    if (isnan(command.fan_gains.loops[loop].kp)) {
+      continue;
+    }
+    return_code = self->controller->set_fan_gains((fan_loop_t) loop, command.fan_gains.loops[loop], command.persist);
+    if (return_code != ESP_OK) {
+      ESP_LOGW(COMMAND_TAG, "Command %" PRIu32 " fan gains not set: %s", command.id,
+        esp_err_to_name(return_code));
+      return return_code;
+    }
+  }
+
+  if (command.dump_profile) {
+    cycle_profiler_request_dump();
+  }
+
+  self->stats.last_id = command.id;
+  self->stats.applied++;
+  cycle_profiler_record_since(STAGE_COMMAND_APPLY, self->event_start_us);
+
+  // Only as good as the two clocks agree
+  if (command.sent_ms > 0) {
+    gettimeofday(&now, NULL);
+    latency_ms = ((int64_t) now.tv_sec * 1000) + (now.tv_usec / 1000) - command.sent_ms;
+    if (latency_ms >= 0) {
+      cycle_profiler_record(STAGE_COMMAND_LATENCY, latency_ms * 1000);
+    }
+  }
+
+  // Stored after the timing is taken, a flash write can take a while
+  if (platform_storage_write(COMMAND_STORAGE_KEY, &(self->stats.last_id), sizeof(uint32_t)) != ESP_OK) {
+    ESP_LOGW(COMMAND_TAG, "Could not store the command id, a restart may apply command %" PRIu32 " again",
+      command.id);
+  }
+
+  ESP_LOGI(COMMAND_TAG, "Command %" PRIu32 " applied", command.id);
+
+  return ESP_OK;
+}
+
+#if !CONFIG_FAN_CONTROL_PID
+static bool has_fan_gains(const command_struct *command)
+{
+  for (int loop = 0; loop < FAN_LOOP_COUNT; loop++) {
+    if (!isnan(command->fan_gains.loops[loop].kp)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
+static void reset_event(void)
+{
+  self->event[0] = '\0';
+  self->event_length = 0;
+  self->data_length = 0;
+  self->overflow = false;
+  self->event_start_us = 0;
+  self->parse_result = -OS_FAIL;
+}
+
+static bool is_command_event(void)
+{
+  return (strcmp(self->event, "put") == 0) || (strcmp(self->event, "patch") == 0);
+}
@@ -1,23 +1,57 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_http_client.h"
 #include "esp_log.h"
-#include "esp_tls.h"
+#include "platform_http.h"
 #include "cJSON.h"
+#include "json_arena.h"
+#include "deferred_log.h"
+#include "cycle_profiler.h"
+#include "sdkconfig.h"
 #include "firebase.h"
 
+// Places worth sending, about the sensors' resolution
+#define TEMPERATURE_DECIMALS  2
+#define PRESSURE_DECIMALS     1
+#define HUMIDITY_DECIMALS     2
+#define VPD_DECIMALS          3
+#define UV_DECIMALS           3
+
+static const char *event_names[UPLINK_EVENT_COUNT] = {
+  [UPLINK_EVENT_NONE]             = "Sample",
+  [UPLINK_EVENT_OVER_TEMPERATURE] = "Over temp",
+  [UPLINK_EVENT_OVER_HUMIDITY]    = "Over humidity",
+  [UPLINK_EVENT_FAN_GIVE_UP]      = "Fan give-up",
+  [UPLINK_EVENT_ACTUATOR]         = "Actuator"
+};
+
+static const char *actuator_names[ENV_ACTUATOR_COUNT] = {
+  [ENV_ACTUATOR_FAN]    = "Fan",
+  [ENV_ACTUATOR_LIGHTS] = "Lights",
+  [ENV_ACTUATOR_PDLC]   = "PDLC"
+};
+
 // Static private object pointer
 static Firebase* self;
 
+// Every message is built, printed and sent out of this, then dropped in one go
+static uint8_t arena_buffer[CONFIG_JSON_ARENA_SIZE];
+
 // Logger tag
 static const char *HTTP_TAG = "HTTP";
 
 // Private functions
 static char* assemble_json_string(firebase_data_struct *data);
-static esp_err_t http_event_handler(esp_http_client_event_t *evt);
+static char* assemble_event_string(firebase_data_struct *data);
+static const char* event_name(const uplink_event_struct *event);
+static void add_latency_summary(cJSON *json);
+static void add_arena_usage(cJSON *json);
+static void add_uplink_usage(cJSON *json);
+static void http_on_data(const char *data, int length, void *context);
+static bool on_response_value(json_stream_event_t event, const json_stream_value_struct *value, void *context);
 
 // Public functions
 static esp_err_t _firebase_send_data(firebase_data_struct *data);
@@ -31,27 +65,50 @@ extern const char cert_end[]   asm("_binary_certificate_pem_end");
 /*!
  * Public init function
  */
-void firebase_init(Firebase* fb_struct_ptr, const char* url, QueueHandle_t* sensor_queue)
+void firebase_init(Firebase* fb_struct_ptr, const char* url, Uplink_queue* uplink)
 {
   self = fb_struct_ptr;
 
   self->firebase_url = url;
   self->certificate = cert_start;
-  self->sensor_queue = sensor_queue;
+  self->uplink = uplink;
+  self->message_count = 0;
+  self->last_push_id[0] = '\0';
+  json_arena_init(&self->arena, arena_buffer, sizeof(arena_buffer));
 
   self->send_data = _firebase_send_data;
 }
 
 
 /*!
- * Http event handler
+ * Http response data handler
  */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
-    if (evt->event_id == HTTP_EVENT_ON_DATA) {
-      // Handle data received from Firebase response if needed
-      ESP_LOGI(HTTP_TAG, "HTTP_EVENT_ON_DATA: %s", (char *)evt->data);
-    }
-    return ESP_OK;
+static void http_on_data(const char *data, int length, void *context)
+{
+  DLOG(DLOG_HTTP_ON_DATA, length);
+  // Parsed chunk by chunk, nothing is buffered; a bad reply is reported once it is all in
+  json_stream_feed((Json_stream *) context, data, (size_t) length);
+}
+
+/*!
+ * Firebase answers a POST with {"name": "<key of the new record>"} or {"error": "<why>"}
+ */
+static bool on_response_value(json_stream_event_t event, const json_stream_value_struct *value, void *context)
+{
+  Firebase *firebase = (Firebase *) context;
+
+  if ((event != JSON_STREAM_STRING) || (value->depth != 1) || (value->key == NULL)) {
+    return true;
+  }
+
+  if (strcmp(value->key, "name") == 0) {
+    snprintf(firebase->last_push_id, sizeof(firebase->last_push_id), "%s", value->string);
+  } else if (strcmp(value->key, "error") == 0) {
+    ESP_LOGW(HTTP_TAG, "Firebase error: %s%s", value->string, value->partial ? "..." : "");
+    return false;
+  }
+
+  return true;
 }
 
 
@@ -61,28 +118,58 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
 static esp_err_t _firebase_send_data(firebase_data_struct *data) 
 {
   char *serialized_string = NULL;
-
-  esp_http_client_config_t config = {
-      .url = self->firebase_url,
-      .method = HTTP_METHOD_POST,
-      .event_handler = http_event_handler,
-      .cert_pem = cert_start
+  int64_t stage_start_us = 0;
+  int status_code = 0;
+  platform_http_request_struct request = {
+    .url = self->firebase_url,
+    .cert_pem = self->certificate,
+    .content_type = "application/json",
+    .on_data = http_on_data,
+    .context = &self->response
   };
 
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-
-  esp_http_client_set_header(client, "Content-Type", "application/json");
+  if (json_arena_begin(&self->arena) != ESP_OK) {
+    ESP_LOGE(HTTP_TAG, "JSON arena already in use");
+    return ESP_ERR_INVALID_STATE;
+  }
 
-  serialized_string = assemble_json_string(data);
+  stage_start_us = esp_timer_get_time();
+  if (data->uplink_class == UPLINK_CLASS_TELEMETRY) {
+    serialized_string = assemble_json_string(data);
+  } else {
+    serialized_string = assemble_event_string(data);
+  }
+  cycle_profiler_record_since(STAGE_SERIALIZE, stage_start_us);
+  if (serialized_string == NULL) {
+    json_arena_end(&self->arena);
+    ESP_LOGE(HTTP_TAG, "Failed to serialize the message");
+    return ESP_ERR_NO_MEM;
+  }
 
-  esp_http_client_set_post_field(client, serialized_string, strlen(serialized_string));
+  request.body = serialized_string;
+  request.body_length = strlen(serialized_string);
+  json_stream_init(&self->response, on_response_value, self);
 
-  esp_err_t err = esp_http_client_perform(client);
+  stage_start_us = esp_timer_get_time();
+  esp_err_t err = platform_http_post(&request, &status_code);
   if (err != ESP_OK) {
       ESP_LOGE(HTTP_TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+  } else {
+      cycle_profiler_record_since(STAGE_HTTP, stage_start_us);
+      if (status_code >= 300) {
+        ESP_LOGW(HTTP_TAG, "HTTP POST returned status %d", status_code);
+        err = ESP_FAIL;
+      }
+      if ((self->response.offset > 0) && (json_stream_finish(&self->response) != ESP_OK)) {
+        ESP_LOGW(HTTP_TAG, "Unreadable response, byte %u of %u", (unsigned) self->response.error_offset,
+          (unsigned) self->response.offset);
+      }
   }
 
-  esp_http_client_cleanup(client);
+  // Only does anything if the text didn't fit in the arena
+  cJSON_free(serialized_string);
+  json_arena_end(&self->arena);
+
   return err;
 }
 
@@ -129,27 +216,37 @@ static char* assemble_json_string(firebase_data_struct *data)
   sensors = cJSON_AddArrayToObject(json, "Sensors");
   // Now we'll fill out the sensors array, starting with Temp
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "Temp", data->sensor_data.bme280_data.temperature);
+  cJSON_AddNumberToObjectFixed(sensor, "Temp", data->sensor_data.bme280_data.temperature, TEMPERATURE_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // Pressure
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "Pres", data->sensor_data.bme280_data.pressure);
+  cJSON_AddNumberToObjectFixed(sensor, "Pres", data->sensor_data.bme280_data.pressure, PRESSURE_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // Humidity
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "Rh", data->sensor_data.bme280_data.humidity);
+  cJSON_AddNumberToObjectFixed(sensor, "Rh", data->sensor_data.bme280_data.humidity, HUMIDITY_DECIMALS);
+  cJSON_AddItemToArray(sensors, sensor);
+  // Derived from temperature and humidity
+  sensor = cJSON_CreateObject();
+  cJSON_AddNumberToObjectFixed(sensor, "VPD", data->sensor_data.derived.vpd_kpa, VPD_DECIMALS);
+  cJSON_AddItemToArray(sensors, sensor);
+  sensor = cJSON_CreateObject();
+  cJSON_AddNumberToObjectFixed(sensor, "Dew pt", data->sensor_data.derived.dew_point_c, TEMPERATURE_DECIMALS);
+  cJSON_AddItemToArray(sensors, sensor);
+  sensor = cJSON_CreateObject();
+  cJSON_AddNumberToObjectFixed(sensor, "Abs hum", data->sensor_data.derived.absolute_humidity_g_m3, HUMIDITY_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // UV A
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "UV A", data->sensor_data.uv_data.UV_A);
+  cJSON_AddNumberToObjectFixed(sensor, "UV A", data->sensor_data.uv_data.UV_A, UV_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // UV B
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "UV B", data->sensor_data.uv_data.UV_B);
+  cJSON_AddNumberToObjectFixed(sensor, "UV B", data->sensor_data.uv_data.UV_B, UV_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // UV A
   sensor = cJSON_CreateObject();
-  cJSON_AddNumberToObject(sensor, "UV C", data->sensor_data.uv_data.UV_C);
+  cJSON_AddNumberToObjectFixed(sensor, "UV C", data->sensor_data.uv_data.UV_C, UV_DECIMALS);
   cJSON_AddItemToArray(sensors, sensor);
   // Soil sensor
   sensor = cJSON_CreateObject();
@@ -174,9 +271,136 @@ static char* assemble_json_string(firebase_data_struct *data)
   // And finally, the timestamp
   cJSON_AddNumberToObject(json, "timestamp", data->sensor_data.timestamp);
 
-  string = cJSON_Print(json);
+  // Piggyback the latency histograms on every Nth message
+  if ((self->message_count++ % CONFIG_PROFILER_PUBLISH_EVERY) == 0) {
+    add_latency_summary(json);
+    add_arena_usage(json);
+    add_uplink_usage(json);
+  }
 
-  cJSON_Delete(json);
+  string = json_arena_print(&self->arena, json, true);
+
+  json_arena_delete(&self->arena, json);
 
   return string;
 }
+
+/*
+Event JSON, for alarms and actuator transitions
+
+{ "name": "Smart Greenhouse",
+  "Event": {
+      "type": "Over temp",
+      "on": true,
+      "Temp": 31.5,
+      "Rh": 72.1
+   },
+   "timestamp": 1234567,
+}
+*/
+
+/*!
+ * Function to generate a serialized JSON string for an alarm or transition
+ */
+static char* assemble_event_string(firebase_data_struct *data)
+{
+  char *string = NULL;
+  cJSON *json = cJSON_CreateObject();
+  cJSON *event = NULL;
+
+  cJSON_AddStringToObject(json, "name", "Smart Greenhouse");
+
+  event = cJSON_AddObjectToObject(json, "Event");
+  cJSON_AddStringToObject(event, "type", event_name(&(data->event)));
+  cJSON_AddBoolToObject(event, "on", data->event.on);
+  if (data->uplink_class == UPLINK_CLASS_ALARM) {
+    // The reading that raised or cleared it
+    cJSON_AddNumberToObjectFixed(event, "Temp", data->sensor_data.bme280_data.temperature, TEMPERATURE_DECIMALS);
+    cJSON_AddNumberToObjectFixed(event, "Rh", data->sensor_data.bme280_data.humidity, HUMIDITY_DECIMALS);
+  }
+
+  cJSON_AddNumberToObject(json, "timestamp", data->sensor_data.timestamp);
+
+  string = json_arena_print(&self->arena, json, true);
+
+  json_arena_delete(&self->arena, json);
+
+  return string;
+}
+
+/*!
+ * Actuator transitions are named for the actuator
+ */
+static const char* event_name(const uplink_event_struct *event)
+{
+  if ((event->type == UPLINK_EVENT_ACTUATOR) && (event->actuator < ENV_ACTUATOR_COUNT)) {
+    return actuator_names[event->actuator];
+  }
+
+  return (event->type < UPLINK_EVENT_COUNT) ? event_names[event->type] : "?";
+}
+
+/*!
+ * Add a per-stage latency summary to the message
+ */
+static void add_latency_summary(cJSON *json)
+{
+  stage_summary_struct summary;
+  cJSON *latency = cJSON_AddObjectToObject(json, "Latency");
+  cJSON *stage = NULL;
+
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    cycle_profiler_get_summary(i, &summary);
+    if (summary.count == 0) {
+      continue;
+    }
+
+    stage = cJSON_AddObjectToObject(latency, summary.name);
+    cJSON_AddNumberToObject(stage, "n", summary.count);
+    cJSON_AddNumberToObject(stage, "mean", summary.mean_us);
+    cJSON_AddNumberToObject(stage, "p50", summary.p50_us);
+    cJSON_AddNumberToObject(stage, "p99", summary.p99_us);
+    cJSON_AddNumberToObject(stage, "max", summary.max_us);
+  }
+}
+
+/*!
+ * Add the JSON arena usage, as of the previous message, to the message
+ */
+static void add_arena_usage(cJSON *json)
+{
+  cJSON *arena = cJSON_AddObjectToObject(json, "Arena");
+
+  cJSON_AddNumberToObject(arena, "size", self->arena.size);
+  cJSON_AddNumberToObject(arena, "last", self->arena.last_peak);
+  cJSON_AddNumberToObject(arena, "high", self->arena.high_water);
+  cJSON_AddNumberToObject(arena, "spills", self->arena.spills);
+}
+
+/*!
+ * Add the per-class uplink counters to the message
+ */
+static void add_uplink_usage(cJSON *json)
+{
+  uplink_class_stats_struct stats;
+  cJSON *uplink = NULL;
+  cJSON *uplink_class = NULL;
+
+  if (self->uplink == NULL) {
+    return;
+  }
+
+  uplink = cJSON_AddObjectToObject(json, "Uplink");
+  for (int i = 0; i < UPLINK_CLASS_COUNT; i++) {
+    stats = self->uplink->get_stats(i);
+
+    uplink_class = cJSON_AddObjectToObject(uplink, uplink_class_name(i));
+    cJSON_AddNumberToObject(uplink_class, "n", stats.delivered);
+    cJSON_AddNumberToObject(uplink_class, "drop", stats.dropped);
+    cJSON_AddNumberToObject(uplink_class, "merged", stats.coalesced);
+    cJSON_AddNumberToObject(uplink_class, "retries", stats.retries);
+    cJSON_AddNumberToObject(uplink_class, "mean",
+      (stats.delivered > 0) ? (double) (stats.total_latency_us / stats.delivered) : 0);
+    cJSON_AddNumberToObject(uplink_class, "max", stats.max_latency_us);
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef COMMAND_STREAM_H
+#define COMMAND_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "json_parser.h"
+#include "environmental_control.h"
+
+#define COMMAND_FIELD_SIZE        8       // Longest event stream field name matched, with the terminator
+#define COMMAND_EVENT_SIZE        16      // Longest event name kept, with the terminator
+#define COMMAND_PATH_SIZE         64
+#define COMMAND_TOKENS            128     // Tokens a command is parsed into before the pool has to grow
+#define COMMAND_MAX_TOKENS        1024
+#define COMMAND_IDLE_TIMEOUT_MS   75000   // Firebase sends a keep-alive every 30 s
+#define COMMAND_RETRY_MIN_MS      1000    // Wait before reconnecting, doubled for each failed attempt
+#define COMMAND_RETRY_MAX_MS      60000
+#define COMMAND_FAN_GAIN_MAX      100000  // Largest fan loop gain a command may set
+#define COMMAND_STORAGE_KEY       "command_id"  // Id of the last command applied, kept across restarts
+
+typedef struct command_stream_stats {
+  uint32_t connects;
+  uint32_t commands;      // put and patch events
+  uint32_t applied;
+  uint32_t duplicates;    // Not newer than the last one applied, like the value sent on every connect
+  uint32_t rejected;      // Unreadable, or turned down by the controller
+  uint32_t keep_alives;
+  uint32_t last_id;       // Of the last command applied
+} command_stream_stats_struct;
+
+/* Downlink: an event stream (Server-Sent Events) subscription to a Realtime Database path.
+ * A command is written there whole, as
+ *   {"id": 7, "sent_ms": {".sv": "timestamp"}, "persist": false, "rules": {<rule table>}}
+ * and applied to the controller as soon as it arrives: the rule table replaces the running
+ * one from the next sample, or not at all. id must grow from one command to the next, rules
+ * and persist are optional, as is "dump_profile": true to log the latency histograms.
+ * "fan_gains": {"temperature": {"kp": 300, "ki": 3, "kd": 0}, "humidity": {...}} retunes either
+ * fan loop (CONFIG_FAN_CONTROL_PID), kept across a reboot along with the rules when persist is set.
+ * The last id applied is stored, so the command sent on connecting after a restart is not
+ * applied again, undoing "persist": false.
+ * Each event is parsed as it comes in, nothing is polled. */
+typedef struct Command_stream {
+  const char                  *url;
+  const char                  *certificate;
+  Environmental_control       *controller;
+
+  // Event being received
+  uint8_t                     line_state;
+  bool                        after_cr;
+  char                        field[COMMAND_FIELD_SIZE];
+  size_t                      field_length;
+  char                        event[COMMAND_EVENT_SIZE];
+  size_t                      event_length;
+  char                        data[CONFIG_COMMAND_MAX_LENGTH];
+  size_t                      data_length;
+  bool                        overflow;             // The data didn't fit, the event is dropped
+  int64_t                     event_start_us;       // First byte of the event, 0 between events
+  size_t                      received;             // Bytes over the current connection
+
+  // The data is tokenized as it arrives, into tokens kept from one event to the next
+  jparse_ctx_t                jctx;
+  json_tok_pool_t             pool;
+  json_tok_t                  tokens[COMMAND_TOKENS];
+  int                         parse_result;
+
+  command_stream_stats_struct stats;
+
+  void                        (*run)(void);
+  command_stream_stats_struct (*get_stats)(void);
+} Command_stream;
+
+esp_err_t command_stream_init(Command_stream *stream, const char *url, Environmental_control *controller);
+
+#endif /* COMMAND_STREAM_H */
@@ -4,6 +4,11 @@
 #include <esp_err.h>
 #include <freertos/queue.h>
 #include "environmental_control.h"
+#include "json_arena.h"
+#include "json_stream.h"
+#include "uplink_queue.h"
+
+#define FIREBASE_PUSH_ID_SIZE 32
 // #include "environmental_sensor.h"
 // #include "uv_sensor.h"
 
@@ -29,20 +34,21 @@
 //   status_state_t pdlc_state; 
 // } status_data_struct;
 
-typedef struct Firebase_data {
-  sensor_data_struct sensor_data;
-  status_data_struct status_data;
-} firebase_data_struct;
-
 typedef struct Firebase {
   const char* firebase_url;
   const char* certificate;
 
-  QueueHandle_t* sensor_queue;
+  Uplink_queue* uplink;
+
+  uint32_t message_count;
+
+  Json_arena arena;
+  Json_stream response;                         // Parses the reply as it arrives
+  char last_push_id[FIREBASE_PUSH_ID_SIZE];     // Key Firebase gave the last message
 
   esp_err_t (*send_data)(firebase_data_struct *data);
 } Firebase;
 
-void firebase_init(Firebase* fb_struct_ptr, const char* url, QueueHandle_t* sensor_queue);
+void firebase_init(Firebase* fb_struct_ptr, const char* url, Uplink_queue* uplink);
 
 #endif /* FIREBASE_H */
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "cJSON.h"
+
+#define JSON_ARENA_ALIGNMENT  sizeof(void *)
+
+/* Bump allocator for building and parsing one JSON document. cJSON allocates from it through
+ * its hooks while it is active for the calling task; freeing inside it does nothing and the
+ * whole document goes at once with json_arena_end(). Allocations that don't fit, and those of
+ * any other task, go to the heap as before. */
+typedef struct json_arena {
+  uint8_t       *buffer;
+  size_t        size;
+  size_t        used;
+  size_t        last_peak;          // Bytes used by the previous document
+  size_t        high_water;         // Most used by any document since init
+  uint32_t      documents;
+  uint32_t      spills;             // Allocations that went to the heap because the arena was full
+  uint32_t      document_spills;    // The same, for the current document
+  TaskHandle_t  owner;              // Task the arena is active for, NULL when inactive
+} Json_arena;
+
+esp_err_t json_arena_init(Json_arena *arena, void *buffer, size_t size);
+void      *json_arena_alloc(Json_arena *arena, size_t size);
+size_t    json_arena_remaining(const Json_arena *arena);
+
+/*!
+ * Route cJSON allocations of the calling task into the arena until json_arena_end(),
+ * which resets it. One arena can be active at a time.
+ */
+esp_err_t json_arena_begin(Json_arena *arena);
+void      json_arena_end(Json_arena *arena);
+
+/*!
+ * cJSON_Delete() for a tree built in the arena: nothing to do unless part of it spilled
+ * onto the heap
+ */
+void      json_arena_delete(Json_arena *arena, cJSON *item);
+
+/*!
+ * Print into the rest of the arena, falling back to cJSON_Print() if it doesn't fit. Free the
+ * result with cJSON_free() before json_arena_end().
+ */
+char      *json_arena_print(Json_arena *arena, const cJSON *item, bool format);
+
+#endif /* JSON_ARENA_H */
@@ -0,0 +1,28 @@
+#ifndef JSON_NUMBER_H
+#define JSON_NUMBER_H
+
+#include <stdint.h>
+
+// Longest text either function writes, with the terminating nul
+#define JSON_NUMBER_BUFFER_SIZE   26
+#define JSON_NUMBER_MAX_DECIMALS  9
+
+/*!
+ * Shortest digits that read back as exactly value (Grisu2, Loitsch 2010: round-trips always,
+ * shortest for all but a few values in a thousand). Finite values only.
+ * Writes at most JSON_NUMBER_BUFFER_SIZE bytes and returns the length.
+ */
+int json_number_shortest(double value, char *buffer);
+
+/*!
+ * value rounded to at most decimals (0 .. JSON_NUMBER_MAX_DECIMALS) places, trailing zeros
+ * dropped. Rounds the double's exact binary value, ties to even, so it agrees with printf's
+ * %.*f: 2.675 is stored as 2.67499.. and prints as 2.67. Zero never carries a sign, so -0.0
+ * and values that round to zero print as 0. Values too large to scale fall back to
+ * json_number_shortest().
+ */
+int json_number_fixed(double value, int decimals, char *buffer);
+
+int json_number_integer(int64_t value, char *buffer);
+
+#endif /* JSON_NUMBER_H */
@@ -0,0 +1,78 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define JSON_STREAM_MAX_DEPTH     32    // Objects and arrays open at once
+#define JSON_STREAM_KEY_SIZE      64    // Longest member name, with the terminator
+#define JSON_STREAM_TOKEN_SIZE    128   // Strings longer than this come in parts; numbers must fit
+
+typedef enum json_stream_event {
+  JSON_STREAM_OBJECT_START = 0,
+  JSON_STREAM_OBJECT_END,
+  JSON_STREAM_ARRAY_START,
+  JSON_STREAM_ARRAY_END,
+  JSON_STREAM_STRING,
+  JSON_STREAM_NUMBER,
+  JSON_STREAM_BOOL,
+  JSON_STREAM_NULL
+} json_stream_event_t;
+
+// What a callback gets. The pointers are only good until it returns.
+typedef struct json_stream_value {
+  const char  *key;           // Member name for values in an object, NULL otherwise and on *_END
+  uint8_t     depth;          // Containers around the value, 0 for the document itself
+  const char  *string;        // JSON_STREAM_STRING, decoded and nul terminated
+  size_t      string_length;
+  bool        partial;        // More of the same string follows in the next event
+  double      number;         // JSON_STREAM_NUMBER
+  bool        boolean;        // JSON_STREAM_BOOL
+} json_stream_value_struct;
+
+// Return false to stop parsing; the rest of the document is then ignored
+typedef bool (*json_stream_cb_t)(json_stream_event_t event, const json_stream_value_struct *value, void *context);
+
+/* Incremental (SAX style) JSON parser: feed it the document in chunks of any size as they
+ * arrive and it calls back for every value. Memory is this struct, whatever the size of the
+ * document. One document per init. */
+typedef struct json_stream {
+  json_stream_cb_t  callback;
+  void              *context;
+
+  uint8_t           state;
+  uint8_t           number_part;        // Where in the number grammar a number being read is
+  uint8_t           after_string;       // State a finished string returns to
+  uint8_t           depth;
+  uint32_t          array_levels;       // Bit n set when level n is an array
+  bool              has_key;
+  char              key[JSON_STREAM_KEY_SIZE];
+  char              token[JSON_STREAM_TOKEN_SIZE];
+  size_t            token_length;
+  uint32_t          code_point;         // \uXXXX being read
+  uint8_t           hex_digits;
+  uint32_t          high_surrogate;     // First half of a surrogate pair, waiting for the second
+  const char        *literal;           // true/false/null being matched
+  uint8_t           literal_matched;
+
+  size_t            offset;             // Bytes fed so far
+  size_t            error_offset;       // Where parsing failed
+} Json_stream;
+
+esp_err_t json_stream_init(Json_stream *stream, json_stream_cb_t callback, void *context);
+
+/*!
+ * Parse the next chunk. ESP_FAIL on a syntax error, ESP_ERR_INVALID_SIZE when a member name
+ * or number is over its buffer or the nesting over JSON_STREAM_MAX_DEPTH, and ESP_ERR_INVALID_STATE
+ * for chunks after an error. error_offset then says where.
+ */
+esp_err_t json_stream_feed(Json_stream *stream, const char *data, size_t length);
+
+/*!
+ * End of input: ESP_OK if a whole document was parsed (or the callback stopped it)
+ */
+esp_err_t json_stream_finish(Json_stream *stream);
+
+#endif /* JSON_STREAM_H */
@@ -0,0 +1,86 @@
+#ifndef UPLINK_QUEUE_H
+#define UPLINK_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "environmental_control.h"
+
+#define UPLINK_ALARM_DEPTH        8
+#define UPLINK_TRANSITION_DEPTH   8
+#define UPLINK_TELEMETRY_DEPTH    10
+#define UPLINK_RETRY_DELAY_MS     1000    // Pause after a failed send before the next one
+#define UPLINK_MAX_RETRIES        3       // Per alarm or transition, so one the server refuses can't hold the rest
+
+// In the order they go out: a queued message of a lower class waits for every higher one
+typedef enum uplink_class {
+  UPLINK_CLASS_ALARM = 0,       // Over temperature or humidity raised or cleared, fan runs given up
+  UPLINK_CLASS_TRANSITION,      // An actuator switched
+  UPLINK_CLASS_TELEMETRY,       // Routine samples
+  UPLINK_CLASS_COUNT
+} uplink_class_t;
+
+typedef enum uplink_event {
+  UPLINK_EVENT_NONE = 0,        // Telemetry
+  UPLINK_EVENT_OVER_TEMPERATURE,
+  UPLINK_EVENT_OVER_HUMIDITY,
+  UPLINK_EVENT_FAN_GIVE_UP,
+  UPLINK_EVENT_ACTUATOR,
+  UPLINK_EVENT_COUNT
+} uplink_event_t;
+
+typedef struct uplink_event_data {
+  uint8_t             type;           // uplink_event_t
+  uint8_t             actuator;       // env_actuator_t, for UPLINK_EVENT_ACTUATOR
+  bool                on;             // Alarm raised or actuator on
+} uplink_event_struct;
+
+typedef struct Firebase_data {
+  sensor_data_struct  sensor_data;
+  status_data_struct  status_data;
+  uint8_t             uplink_class;   // uplink_class_t
+  uplink_event_struct event;          // Alarms and transitions; the sample is the one that caused it
+  uint8_t             retries;        // Sends that failed so far
+  int64_t             queued_time_us; // When the message was handed to the Firebase task
+} firebase_data_struct;
+
+typedef struct uplink_class_stats {
+  uint32_t            queued;
+  uint32_t            delivered;
+  uint32_t            dropped;        // Oldest pushed out of a full queue, or a failed send not retried
+  uint32_t            coalesced;      // Telemetry folded into the newest queued sample
+  uint32_t            retries;
+  uint32_t            max_depth;
+  uint32_t            max_latency_us; // Queued -> sent
+  uint64_t            total_latency_us;
+} uplink_class_stats_struct;
+
+typedef struct uplink_ring {
+  firebase_data_struct  *slots;
+  uint8_t               size;
+  uint8_t               head;         // Oldest
+  uint8_t               count;
+} uplink_ring_struct;
+
+/* Uplink queue with a ring per class, one producer and one consumer. Alarms and transitions
+ * are taken ahead of any telemetry, so behind a backlog they wait at most for the send in
+ * progress. When the telemetry ring is full a new sample replaces the newest one queued, as
+ * the latest reading of every field; a full alarm or transition ring drops its oldest. */
+typedef struct Uplink_queue {
+  uplink_ring_struct        rings[UPLINK_CLASS_COUNT];
+  uplink_class_stats_struct stats[UPLINK_CLASS_COUNT];
+  SemaphoreHandle_t         ready;    // Given on every push
+  portMUX_TYPE              lock;
+
+  esp_err_t                 (*push)(const firebase_data_struct *message);
+  bool                      (*pop)(firebase_data_struct *message, TickType_t ticks_to_wait);
+  void                      (*delivered)(const firebase_data_struct *message, esp_err_t result);
+  uplink_class_stats_struct (*get_stats)(uplink_class_t uplink_class);
+} Uplink_queue;
+
+esp_err_t   uplink_queue_init(Uplink_queue *queue);
+const char  *uplink_class_name(uplink_class_t uplink_class);
+
+#endif /* UPLINK_QUEUE_H */
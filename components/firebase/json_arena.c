@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "cJSON.h"
+#include "json_arena.h"
+
+// The arena cJSON's hooks allocate from. Stays set after json_arena_end() so late frees of
+// arena memory are still recognised.
+static Json_arena *hooked_arena = NULL;
+
+// Private functions
+static void *arena_malloc(size_t size);
+static void arena_free(void *pointer);
+static bool owns(const Json_arena *arena, const void *pointer);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t json_arena_init(Json_arena *arena, void *buffer, size_t size)
+{
+  if ((buffer == NULL) || (size < JSON_ARENA_ALIGNMENT)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(arena, 0, sizeof(Json_arena));
+  arena->buffer = buffer;
+  arena->size = size;
+
+  return ESP_OK;
+}
+
+/*!
+ * Next size bytes, aligned for any cJSON member, or NULL when they don't fit
+ */
+void *json_arena_alloc(Json_arena *arena, size_t size)
+{
+  size_t start = (arena->used + JSON_ARENA_ALIGNMENT - 1) & ~(JSON_ARENA_ALIGNMENT - 1);
+
+  if ((size == 0) || (start > arena->size) || (size > arena->size - start)) {
+    return NULL;
+  }
+
+  arena->used = start + size;
+
+  return arena->buffer + start;
+}
+
+size_t json_arena_remaining(const Json_arena *arena)
+{
+  size_t start = (arena->used + JSON_ARENA_ALIGNMENT - 1) & ~(JSON_ARENA_ALIGNMENT - 1);
+
+  return (start < arena->size) ? arena->size - start : 0;
+}
+
+esp_err_t json_arena_begin(Json_arena *arena)
+{
+  cJSON_Hooks hooks = {
+    .malloc_fn = arena_malloc,
+    .free_fn = arena_free
+  };
+
+  if ((hooked_arena != NULL) && (hooked_arena->owner != NULL)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (hooked_arena != arena) {
+    hooked_arena = arena;
+    cJSON_InitHooks(&hooks);
+  }
+
+  arena->used = 0;
+  arena->document_spills = 0;
+  arena->owner = xTaskGetCurrentTaskHandle();
+
+  return ESP_OK;
+}
+
+/*!
+ * Close the document: record its peak and drop everything in the arena at once
+ */
+void json_arena_end(Json_arena *arena)
+{
+  arena->owner = NULL;
+  arena->last_peak = arena->used;
+  if (arena->used > arena->high_water) {
+    arena->high_water = arena->used;
+  }
+  arena->documents++;
+  arena->used = 0;
+}
+
+void json_arena_delete(Json_arena *arena, cJSON *item)
+{
+  if (arena->document_spills > 0) {
+    cJSON_Delete(item);
+  }
+}
+
+char *json_arena_print(Json_arena *arena, const cJSON *item, bool format)
+{
+  size_t length = json_arena_remaining(arena);
+  size_t used = arena->used;
+  char *buffer = json_arena_alloc(arena, length);
+
+  if ((buffer != NULL) && cJSON_PrintPreallocated((cJSON *) item, buffer, (int) length, format)) {
+    // Give back what the text didn't need
+    arena->used = (size_t) (buffer - (char *) arena->buffer) + strlen(buffer) + 1;
+    return buffer;
+  }
+
+  arena->used = used;
+
+  return format ? cJSON_Print(item) : cJSON_PrintUnformatted(item);
+}
+
+/*!
+ * cJSON allocation hook: the arena for the task it is active for, the heap otherwise
+ */
+static void *arena_malloc(size_t size)
+{
+  Json_arena *arena = hooked_arena;
+  void *pointer = NULL;
+
+  if ((arena != NULL) && (arena->owner != NULL) && (arena->owner == xTaskGetCurrentTaskHandle())) {
+    pointer = json_arena_alloc(arena, size);
+    if (pointer != NULL) {
+      return pointer;
+    }
+    arena->spills++;
+    arena->document_spills++;
+  }
+
+  return malloc(size);
+}
+
+/*!
+ * cJSON free hook: arena memory goes with json_arena_end()
+ */
+static void arena_free(void *pointer)
+{
+  if (!owns(hooked_arena, pointer)) {
+    free(pointer);
+  }
+}
+
+static bool owns(const Json_arena *arena, const void *pointer)
+{
+  return (arena != NULL) && ((const uint8_t *) pointer >= arena->buffer) &&
+         ((const uint8_t *) pointer < arena->buffer + arena->size);
+}
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "json_number.h"
+
+#define SIGNIFICAND_BITS  52
+#define HIDDEN_BIT        (1ULL << SIGNIFICAND_BITS)
+#define SIGNIFICAND_MASK  (HIDDEN_BIT - 1)
+#define EXPONENT_BIAS     (1023 + SIGNIFICAND_BITS)
+#define MIN_EXPONENT      (1 - EXPONENT_BIAS)
+#define MAX_PLAIN_DIGITS  21    // Longer than this, or smaller than 1e-6, and it goes to 1.234e56 form
+#define MAX_FIXED_SCALED  9007199254740992.0  // 2^53, the last integer a double holds exactly
+
+// 64 bit significand and binary exponent: f * 2^e
+typedef struct diy_fp {
+  uint64_t  f;
+  int       e;
+} diy_fp_struct;
+
+// Normalized 10^k for k = -348, -340 .. 340, the 'cached powers' of Grisu
+static const diy_fp_struct cached_powers[] = {
+  {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+  {0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+  {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+  {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+  {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+  {0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+  {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+  {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+  {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+  {0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+  {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+  {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+  {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+  {0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+  {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+  {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+  {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+  {0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+  {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+  {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+  {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+  {0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+  {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+  {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+  {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+  {0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+  {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+  {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+  {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+static const uint64_t powers_of_ten[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+  1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Private functions
+static diy_fp_struct multiply(diy_fp_struct x, diy_fp_struct y);
+static diy_fp_struct normalize(diy_fp_struct x);
+static void grisu2(double value, char *digits, int *length, int *power);
+static void generate_digits(diy_fp_struct w, diy_fp_struct upper, uint64_t delta, char *digits, int *length,
+  int *power);
+static void round_last_digit(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+  uint64_t distance);
+static int format(char *buffer, int length, int power);
+static int write_exponent(int exponent, char *buffer);
+static int write_unsigned(uint64_t value, char *buffer);
+static uint64_t round_scaled(double magnitude, int decimals);
+static bool bit_128(uint64_t high, uint64_t low, int index);
+static bool any_below_128(uint64_t high, uint64_t low, int index);
+
+
+int json_number_shortest(double value, char *buffer)
+{
+  int length = 0;
+  int power = 0;
+  int sign = 0;
+
+  if (value < 0) {
+    buffer[0] = '-';
+    value = -value;
+    sign = 1;
+  }
+
+  if (value == 0) {
+    buffer[sign] = '0';
+    buffer[sign + 1] = '\0';
+    return sign + 1;
+  }
+
+  grisu2(value, buffer + sign, &length, &power);
+
+  return sign + format(buffer + sign, length, power);
+}
+
+int json_number_fixed(double value, int decimals, char *buffer)
+{
+  double magnitude = (value < 0) ? -value : value;
+  double scaled = 0;
+  uint64_t digits = 0;
+  uint64_t fraction = 0;
+  int length = 0;
+
+  if ((decimals < 0) || (decimals > JSON_NUMBER_MAX_DECIMALS)) {
+    return json_number_shortest(value, buffer);
+  }
+
+  // Only a range check, round_scaled() does the rounding
+  scaled = (magnitude * (double) powers_of_ten[decimals]) + 0.5;
+  if (!(scaled < MAX_FIXED_SCALED)) {
+    return json_number_shortest(value, buffer);
+  }
+
+  digits = round_scaled(magnitude, decimals);
+  fraction = digits % powers_of_ten[decimals];
+  digits /= powers_of_ten[decimals];
+  // Trailing zeros say nothing
+  while ((decimals > 0) && (fraction % 10 == 0)) {
+    fraction /= 10;
+    decimals--;
+  }
+
+  // Zero is unsigned, -0.0 and -0.001 to two places alike
+  if ((value < 0) && ((digits != 0) || (fraction != 0))) {
+    buffer[length++] = '-';
+  }
+  length += write_unsigned(digits, buffer + length);
+
+  if (decimals > 0) {
+    buffer[length++] = '.';
+    for (int i = decimals - 1; i >= 0; i--) {
+      buffer[length + i] = (char) ('0' + (fraction % 10));
+      fraction /= 10;
+    }
+    length += decimals;
+    buffer[length] = '\0';
+  }
+
+  return length;
+}
+
+int json_number_integer(int64_t value, char *buffer)
+{
+  if (value < 0) {
+    buffer[0] = '-';
+    return 1 + write_unsigned(0 - (uint64_t) value, buffer + 1);
+  }
+
+  return write_unsigned((uint64_t) value, buffer);
+}
+
+/*!
+ * Upper 64 bits of the 128 bit product, rounded
+ */
+static diy_fp_struct multiply(diy_fp_struct x, diy_fp_struct y)
+{
+  const uint64_t mask = 0xffffffffULL;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & mask;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & mask;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (1ULL << 31);
+  diy_fp_struct product = {
+    .f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32),
+    .e = x.e + y.e + 64
+  };
+
+  return product;
+}
+
+static diy_fp_struct normalize(diy_fp_struct x)
+{
+  while ((x.f & (1ULL << 63)) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+
+  return x;
+}
+
+/*!
+ * Digits of value > 0 and the power of ten after the last of them: value ~ digits * 10^power.
+ * Scales value and the midpoints to its neighbours by a cached 10^-k that puts the exponent
+ * in [-60, -32], then generates digits until they are inside the (narrowed) neighbour range.
+ */
+static void grisu2(double value, char *digits, int *length, int *power)
+{
+  uint64_t bits = 0;
+  int biased_exponent = 0;
+  diy_fp_struct v;
+  diy_fp_struct upper;
+  diy_fp_struct lower;
+  diy_fp_struct cached;
+  double estimate = 0;
+  int k = 0;
+  int index = 0;
+
+  memcpy(&bits, &value, sizeof(bits));
+  biased_exponent = (int) ((bits >> SIGNIFICAND_BITS) & 0x7ff);
+  if (biased_exponent != 0) {
+    v.f = (bits & SIGNIFICAND_MASK) + HIDDEN_BIT;
+    v.e = biased_exponent - EXPONENT_BIAS;
+  } else {
+    v.f = bits & SIGNIFICAND_MASK;
+    v.e = MIN_EXPONENT;
+  }
+
+  // Midpoints to the neighbouring doubles; the lower gap is half as wide at a power of two
+  upper.f = (v.f << 1) + 1;
+  upper.e = v.e - 1;
+  while ((upper.f & (HIDDEN_BIT << 1)) == 0) {
+    upper.f <<= 1;
+    upper.e--;
+  }
+  upper.f <<= 64 - SIGNIFICAND_BITS - 2;
+  upper.e -= 64 - SIGNIFICAND_BITS - 2;
+  if (v.f == HIDDEN_BIT) {
+    lower.f = (v.f << 2) - 1;
+    lower.e = v.e - 2;
+  } else {
+    lower.f = (v.f << 1) - 1;
+    lower.e = v.e - 1;
+  }
+  lower.f <<= lower.e - upper.e;
+  lower.e = upper.e;
+
+  // Smallest cached power that brings upper's exponent to -61 or above
+  estimate = ((-61 - upper.e) * 0.30102999566398114) + 347;
+  k = (int) estimate;
+  if (estimate - k > 0) {
+    k++;
+  }
+  index = (k >> 3) + 1;
+  *power = 348 - (index * 8);
+  cached = cached_powers[index];
+
+  v = multiply(normalize(v), cached);
+  upper = multiply(upper, cached);
+  lower = multiply(lower, cached);
+  // Allow for the rounding of the products
+  lower.f++;
+  upper.f--;
+
+  generate_digits(v, upper, upper.f - lower.f, digits, length, power);
+}
+
+/*!
+ * Integer part of upper first, then the fraction, stopping as soon as what is left is inside
+ * delta, the width of the range
+ */
+static void generate_digits(diy_fp_struct w, diy_fp_struct upper, uint64_t delta, char *digits, int *length,
+  int *power)
+{
+  const int shift = -upper.e;
+  const uint64_t one = 1ULL << shift;
+  const uint64_t distance = upper.f - w.f;
+  uint32_t integral = (uint32_t) (upper.f >> shift);
+  uint64_t fractional = upper.f & (one - 1);
+  uint64_t rest = 0;
+  int kappa = 1;
+  uint32_t digit = 0;
+
+  while ((kappa < 10) && (integral >= powers_of_ten[kappa])) {
+    kappa++;
+  }
+
+  *length = 0;
+  while (kappa > 0) {
+    digit = integral / (uint32_t) powers_of_ten[kappa - 1];
+    integral %= (uint32_t) powers_of_ten[kappa - 1];
+    if ((digit != 0) || (*length != 0)) {
+      digits[(*length)++] = (char) ('0' + digit);
+    }
+    kappa--;
+
+    rest = ((uint64_t) integral << shift) + fractional;
+    if (rest <= delta) {
+      *power += kappa;
+      round_last_digit(digits, *length, delta, rest, powers_of_ten[kappa] << shift, distance);
+      return;
+    }
+  }
+
+  for (;;) {
+    fractional *= 10;
+    delta *= 10;
+    digit = (uint32_t) (fractional >> shift);
+    if ((digit != 0) || (*length != 0)) {
+      digits[(*length)++] = (char) ('0' + digit);
+    }
+    fractional &= one - 1;
+    kappa--;
+
+    if (fractional < delta) {
+      *power += kappa;
+      round_last_digit(digits, *length, delta, fractional, one,
+                       (-kappa < 20) ? distance * powers_of_ten[-kappa] : 0);
+      return;
+    }
+  }
+}
+
+/*!
+ * Step the last digit down while that stays in range and gets closer to the value itself
+ */
+static void round_last_digit(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+  uint64_t distance)
+{
+  while ((rest < distance) && (delta - rest >= ten_kappa) &&
+         ((rest + ten_kappa < distance) || (distance - rest > rest + ten_kappa - distance))) {
+    digits[length - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+/*!
+ * digits * 10^power as 1234, 12.34, 0.001234 or 1.234e56
+ */
+static int format(char *buffer, int length, int power)
+{
+  int point = length + power;   // 10^(point - 1) <= value < 10^point
+
+  if ((power >= 0) && (point <= MAX_PLAIN_DIGITS)) {
+    memset(buffer + length, '0', (size_t) power);
+    buffer[point] = '\0';
+    return point;
+  }
+
+  if ((point > 0) && (point <= MAX_PLAIN_DIGITS)) {
+    memmove(buffer + point + 1, buffer + point, (size_t) (length - point));
+    buffer[point] = '.';
+    buffer[length + 1] = '\0';
+    return length + 1;
+  }
+
+  if ((point > -6) && (point <= 0)) {
+    int offset = 2 - point;
+
+    memmove(buffer + offset, buffer, (size_t) length);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    memset(buffer + 2, '0', (size_t) (offset - 2));
+    buffer[length + offset] = '\0';
+    return length + offset;
+  }
+
+  if (length == 1) {
+    buffer[1] = 'e';
+    return 2 + write_exponent(point - 1, buffer + 2);
+  }
+
+  memmove(buffer + 2, buffer + 1, (size_t) (length - 1));
+  buffer[1] = '.';
+  buffer[length + 1] = 'e';
+
+  return length + 2 + write_exponent(point - 1, buffer + length + 2);
+}
+
+static int write_exponent(int exponent, char *buffer)
+{
+  if (exponent < 0) {
+    buffer[0] = '-';
+    return 1 + write_unsigned((uint64_t) -exponent, buffer + 1);
+  }
+
+  return write_unsigned((uint64_t) exponent, buffer);
+}
+
+static int write_unsigned(uint64_t value, char *buffer)
+{
+  char reversed[20];
+  int count = 0;
+
+  do {
+    reversed[count++] = (char) ('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+
+  for (int i = 0; i < count; i++) {
+    buffer[i] = reversed[count - 1 - i];
+  }
+  buffer[count] = '\0';
+
+  return count;
+}
+
+/*!
+ * magnitude * 10^decimals to the nearest integer, ties to even, worked out from the exact binary
+ * value as printf does: 2.675 is 2.67499999999999982236431605997495353221893310546875, so 267.
+ * The caller has checked the result is under 2^53.
+ */
+static uint64_t round_scaled(double magnitude, int decimals)
+{
+  uint64_t bits = 0;
+  uint64_t significand = 0;
+  uint64_t whole = 0;
+  uint64_t fraction = 0;
+  uint64_t cross = 0;
+  uint64_t high = 0;
+  uint64_t low = 0;
+  uint64_t quotient = 0;
+  int biased_exponent = 0;
+  int shift = 0;
+
+  memcpy(&bits, &magnitude, sizeof(bits));
+  biased_exponent = (int) ((bits >> SIGNIFICAND_BITS) & 0x7ff);
+  significand = bits & SIGNIFICAND_MASK;
+  if (biased_exponent != 0) {
+    significand += HIDDEN_BIT;
+    shift = EXPONENT_BIAS - biased_exponent;
+  } else {
+    shift = -MIN_EXPONENT;
+  }
+
+  if (shift <= 0) {
+    return (significand << -shift) * powers_of_ten[decimals];
+  }
+  if (shift >= 128) {
+    // Under 2^-74, far below half of the last place
+    return 0;
+  }
+
+  // magnitude = whole + fraction / 2^shift
+  whole = (shift < 64) ? (significand >> shift) : 0;
+  fraction = (shift < 64) ? (significand & ((1ULL << shift) - 1)) : significand;
+
+  // fraction * 10^decimals, under 2^83, in two words
+  cross = (fraction >> 32) * powers_of_ten[decimals];
+  low = (fraction & 0xffffffffULL) * powers_of_ten[decimals];
+  high = cross >> 32;
+  low += cross << 32;
+  if (low < (cross << 32)) {
+    high++;
+  }
+
+  quotient = (shift < 64) ? ((low >> shift) | (high << (64 - shift))) : (high >> (shift - 64));
+  quotient += whole * powers_of_ten[decimals];
+  if (bit_128(high, low, shift - 1) && (any_below_128(high, low, shift - 1) || (quotient & 1))) {
+    quotient++;
+  }
+
+  return quotient;
+}
+
+static bool bit_128(uint64_t high, uint64_t low, int index)
+{
+  return ((index < 64) ? (low >> index) : (high >> (index - 64))) & 1;
+}
+
+/*!
+ * Whether any of the bits below index are set
+ */
+static bool any_below_128(uint64_t high, uint64_t low, int index)
+{
+  if (index <= 64) {
+    return (index == 64) ? (low != 0) : ((low & ((1ULL << index) - 1)) != 0);
+  }
+
+  return (low != 0) || ((high & ((1ULL << (index - 64)) - 1)) != 0);
+}
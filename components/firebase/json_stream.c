@@ -0,0 +1,544 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include "esp_err.h"
+#include "json_stream.h"
+
+#define UTF8_MAX_BYTES  4
+
+typedef enum stream_state {
+  STATE_VALUE = 0,        // A value must come next
+  STATE_ARRAY_FIRST,      // After '[': a value or ']'
+  STATE_OBJECT_FIRST,     // After '{': a member name or '}'
+  STATE_KEY,              // After ',' in an object: a member name
+  STATE_COLON,
+  STATE_AFTER_VALUE,      // ',' or the end of the container
+  STATE_STRING,
+  STATE_ESCAPE,
+  STATE_UNICODE,
+  STATE_NUMBER,
+  STATE_LITERAL,
+  STATE_DONE,             // Whole document parsed, only whitespace may follow
+  STATE_STOPPED,          // The callback asked to stop
+  STATE_ERROR
+} stream_state_t;
+
+// Where a number is in the RFC 8259 grammar: [-] (0 | [1-9][0-9]*) [. [0-9]+] [(e|E) [+|-] [0-9]+]
+typedef enum number_part {
+  NUMBER_SIGN = 0,        // After '-', a digit must follow
+  NUMBER_ZERO,            // Integer part "0", no more digits may follow
+  NUMBER_INTEGER,
+  NUMBER_POINT,           // After '.', a digit must follow
+  NUMBER_FRACTION,
+  NUMBER_EXPONENT_MARK,   // After 'e', a sign or a digit
+  NUMBER_EXPONENT_SIGN,   // After the exponent sign, a digit must follow
+  NUMBER_EXPONENT,
+  NUMBER_INVALID
+} number_part_t;
+
+// Private functions
+static number_part_t next_number_part(number_part_t part, char c);
+static bool is_number_char(char c);
+static esp_err_t step(Json_stream *stream, char c, bool *consumed);
+static esp_err_t begin_value(Json_stream *stream, char c);
+static esp_err_t close_container(Json_stream *stream, char c);
+static esp_err_t append(Json_stream *stream, const char *bytes, size_t length);
+static esp_err_t append_code_point(Json_stream *stream, uint32_t code_point);
+static esp_err_t finish_string(Json_stream *stream);
+static esp_err_t finish_number(Json_stream *stream);
+static void deliver(Json_stream *stream, json_stream_event_t event, json_stream_value_struct *value);
+static bool in_array(const Json_stream *stream);
+/*!
+ * The part of the number grammar c moves a number to, NUMBER_INVALID if it can't follow
+ */
+static number_part_t next_number_part(number_part_t part, char c)
+{
+  bool digit = (c >= '0') && (c <= '9');
+
+  switch (part) {
+    case NUMBER_SIGN:
+      return !digit ? NUMBER_INVALID : ((c == '0') ? NUMBER_ZERO : NUMBER_INTEGER);
+    case NUMBER_ZERO:
+    case NUMBER_INTEGER:
+      if (digit) {
+        return (part == NUMBER_INTEGER) ? NUMBER_INTEGER : NUMBER_INVALID;
+      }
+      if (c == '.') {
+        return NUMBER_POINT;
+      }
+      return ((c == 'e') || (c == 'E')) ? NUMBER_EXPONENT_MARK : NUMBER_INVALID;
+    case NUMBER_POINT:
+    case NUMBER_FRACTION:
+      if (digit) {
+        return NUMBER_FRACTION;
+      }
+      return ((part == NUMBER_FRACTION) && ((c == 'e') || (c == 'E'))) ? NUMBER_EXPONENT_MARK : NUMBER_INVALID;
+    case NUMBER_EXPONENT_MARK:
+      if ((c == '+') || (c == '-')) {
+        return NUMBER_EXPONENT_SIGN;
+      }
+      return digit ? NUMBER_EXPONENT : NUMBER_INVALID;
+    case NUMBER_EXPONENT_SIGN:
+    case NUMBER_EXPONENT:
+      return digit ? NUMBER_EXPONENT : NUMBER_INVALID;
+    default:
+      return NUMBER_INVALID;
+  }
+}
+
+static bool is_number_char(char c)
+{
+  return ((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.') || (c == 'e') || (c == 'E');
+}
+
+static bool is_whitespace(char c);
+static int hex_value(char c);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t json_stream_init(Json_stream *stream, json_stream_cb_t callback, void *context)
+{
+  if (callback == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(stream, 0, sizeof(Json_stream));
+  stream->callback = callback;
+  stream->context = context;
+  stream->state = STATE_VALUE;
+
+  return ESP_OK;
+}
+
+esp_err_t json_stream_feed(Json_stream *stream, const char *data, size_t length)
+{
+  esp_err_t return_code = ESP_OK;
+  bool consumed = true;
+  size_t i = 0;
+
+  if (stream->state == STATE_ERROR) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  while ((i < length) && (stream->state != STATE_STOPPED)) {
+    return_code = step(stream, data[i], &consumed);
+    if (return_code != ESP_OK) {
+      stream->error_offset = stream->offset + i;
+      stream->state = STATE_ERROR;
+      return return_code;
+    }
+    if (consumed) {
+      i++;
+    }
+  }
+
+  stream->offset += length;
+
+  return ESP_OK;
+}
+
+esp_err_t json_stream_finish(Json_stream *stream)
+{
+  esp_err_t return_code = ESP_OK;
+
+  // A number is only known to have ended when something follows it
+  if ((stream->state == STATE_NUMBER) && (stream->depth == 0)) {
+    return_code = finish_number(stream);
+    if (return_code != ESP_OK) {
+      stream->error_offset = stream->offset;
+      stream->state = STATE_ERROR;
+      return return_code;
+    }
+  }
+
+  switch (stream->state) {
+    case STATE_DONE:
+    case STATE_STOPPED:
+      return ESP_OK;
+    case STATE_ERROR:
+      return ESP_ERR_INVALID_STATE;
+    default:
+      // Cut short
+      stream->error_offset = stream->offset;
+      stream->state = STATE_ERROR;
+      return ESP_FAIL;
+  }
+}
+
+/*!
+ * One character. consumed is cleared when it ended a number and still has to be looked at.
+ */
+static esp_err_t step(Json_stream *stream, char c, bool *consumed)
+{
+  static const char simple_escapes[] = "\"\\/bfnrt";
+  static const char escaped_bytes[] = "\"\\/\b\f\n\r\t";
+  const char *escape = NULL;
+  int digit = 0;
+  esp_err_t return_code = ESP_OK;
+
+  *consumed = true;
+
+  switch (stream->state) {
+    case STATE_VALUE:
+    case STATE_ARRAY_FIRST:
+      if (is_whitespace(c)) {
+        return ESP_OK;
+      }
+      if ((stream->state == STATE_ARRAY_FIRST) && (c == ']')) {
+        return close_container(stream, c);
+      }
+      return begin_value(stream, c);
+
+    case STATE_OBJECT_FIRST:
+    case STATE_KEY:
+      if (is_whitespace(c)) {
+        return ESP_OK;
+      }
+      if ((stream->state == STATE_OBJECT_FIRST) && (c == '}')) {
+        return close_container(stream, c);
+      }
+      if (c != '"') {
+        return ESP_FAIL;
+      }
+      stream->token_length = 0;
+      stream->after_string = STATE_COLON;
+      stream->state = STATE_STRING;
+      return ESP_OK;
+
+    case STATE_COLON:
+      if (is_whitespace(c)) {
+        return ESP_OK;
+      }
+      if (c != ':') {
+        return ESP_FAIL;
+      }
+      stream->state = STATE_VALUE;
+      return ESP_OK;
+
+    case STATE_AFTER_VALUE:
+      if (is_whitespace(c)) {
+        return ESP_OK;
+      }
+      if (c == ',') {
+        stream->state = in_array(stream) ? STATE_VALUE : STATE_KEY;
+        return ESP_OK;
+      }
+      if ((c == ']') || (c == '}')) {
+        return close_container(stream, c);
+      }
+      return ESP_FAIL;
+
+    case STATE_STRING:
+      // Only the second half of a surrogate pair may follow the first
+      if ((stream->high_surrogate != 0) && (c != '\\')) {
+        return ESP_FAIL;
+      }
+      if (c == '"') {
+        return finish_string(stream);
+      }
+      if (c == '\\') {
+        stream->state = STATE_ESCAPE;
+        return ESP_OK;
+      }
+      if ((unsigned char) c < 0x20) {
+        return ESP_FAIL;
+      }
+      return append(stream, &c, 1);
+
+    case STATE_ESCAPE:
+      if (c == 'u') {
+        stream->code_point = 0;
+        stream->hex_digits = 0;
+        stream->state = STATE_UNICODE;
+        return ESP_OK;
+      }
+      escape = strchr(simple_escapes, c);
+      if ((c == '\0') || (escape == NULL) || (stream->high_surrogate != 0)) {
+        return ESP_FAIL;
+      }
+      stream->state = STATE_STRING;
+      return append(stream, &escaped_bytes[escape - simple_escapes], 1);
+
+    case STATE_UNICODE:
+      digit = hex_value(c);
+      if (digit < 0) {
+        return ESP_FAIL;
+      }
+      stream->code_point = (stream->code_point << 4) | (uint32_t) digit;
+      if (++stream->hex_digits < 4) {
+        return ESP_OK;
+      }
+
+      stream->state = STATE_STRING;
+      if (stream->high_surrogate != 0) {
+        if ((stream->code_point < 0xdc00) || (stream->code_point > 0xdfff)) {
+          return ESP_FAIL;
+        }
+        return_code = append_code_point(stream, 0x10000 + ((stream->high_surrogate - 0xd800) << 10) +
+                                                (stream->code_point - 0xdc00));
+        stream->high_surrogate = 0;
+        return return_code;
+      }
+      if ((stream->code_point >= 0xd800) && (stream->code_point <= 0xdbff)) {
+        stream->high_surrogate = stream->code_point;
+        return ESP_OK;
+      }
+      if ((stream->code_point >= 0xdc00) && (stream->code_point <= 0xdfff)) {
+        return ESP_FAIL;
+      }
+      return append_code_point(stream, stream->code_point);
+
+    case STATE_NUMBER:
+      if (is_number_char(c)) {
+        // Checked as it comes in, strtod would take 00, 1. or -.5 as well
+        stream->number_part = next_number_part(stream->number_part, c);
+        if (stream->number_part == NUMBER_INVALID) {
+          return ESP_FAIL;
+        }
+        if (stream->token_length + 1 >= JSON_STREAM_TOKEN_SIZE) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        stream->token[stream->token_length++] = c;
+        return ESP_OK;
+      }
+      *consumed = false;
+      return finish_number(stream);
+
+    case STATE_LITERAL:
+      if (c != stream->literal[stream->literal_matched]) {
+        return ESP_FAIL;
+      }
+      if (stream->literal[++stream->literal_matched] == '\0') {
+        json_stream_value_struct value = { .boolean = (stream->literal[0] == 't') };
+
+        deliver(stream, (stream->literal[0] == 'n') ? JSON_STREAM_NULL : JSON_STREAM_BOOL, &value);
+      }
+      return ESP_OK;
+
+    case STATE_DONE:
+      return is_whitespace(c) ? ESP_OK : ESP_FAIL;
+
+    default:
+      return ESP_ERR_INVALID_STATE;
+  }
+}
+
+static esp_err_t begin_value(Json_stream *stream, char c)
+{
+  json_stream_value_struct value = {
+    .key = stream->has_key ? stream->key : NULL,
+    .depth = stream->depth
+  };
+
+  switch (c) {
+    case '{':
+    case '[':
+      if (stream->depth >= JSON_STREAM_MAX_DEPTH) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      if (c == '[') {
+        stream->array_levels |= (1UL << stream->depth);
+      } else {
+        stream->array_levels &= ~(1UL << stream->depth);
+      }
+      stream->depth++;
+      stream->has_key = false;
+      stream->state = (c == '[') ? STATE_ARRAY_FIRST : STATE_OBJECT_FIRST;
+      if (!stream->callback((c == '[') ? JSON_STREAM_ARRAY_START : JSON_STREAM_OBJECT_START, &value,
+                            stream->context)) {
+        stream->state = STATE_STOPPED;
+      }
+      return ESP_OK;
+
+    case '"':
+      stream->token_length = 0;
+      stream->after_string = STATE_AFTER_VALUE;
+      stream->state = STATE_STRING;
+      return ESP_OK;
+
+    case 't':
+    case 'f':
+    case 'n':
+      stream->literal = (c == 't') ? "true" : ((c == 'f') ? "false" : "null");
+      stream->literal_matched = 1;
+      stream->state = STATE_LITERAL;
+      return ESP_OK;
+
+    default:
+      if ((c != '-') && ((c < '0') || (c > '9'))) {
+        return ESP_FAIL;
+      }
+      stream->token[0] = c;
+      stream->token_length = 1;
+      stream->number_part = (c == '-') ? NUMBER_SIGN : ((c == '0') ? NUMBER_ZERO : NUMBER_INTEGER);
+      stream->state = STATE_NUMBER;
+      return ESP_OK;
+  }
+}
+
+static esp_err_t close_container(Json_stream *stream, char c)
+{
+  json_stream_value_struct value = {0};
+
+  if ((stream->depth == 0) || ((c == ']') != in_array(stream))) {
+    return ESP_FAIL;
+  }
+
+  stream->depth--;
+  stream->has_key = false;
+  deliver(stream, (c == ']') ? JSON_STREAM_ARRAY_END : JSON_STREAM_OBJECT_END, &value);
+
+  return ESP_OK;
+}
+
+/*!
+ * Add to the string being read. Member names must fit in the key buffer; values that don't
+ * fit in the token buffer go to the callback in parts.
+ */
+static esp_err_t append(Json_stream *stream, const char *bytes, size_t length)
+{
+  json_stream_value_struct value = {
+    .key = stream->has_key ? stream->key : NULL,
+    .depth = stream->depth,
+    .partial = true
+  };
+
+  if (stream->after_string == STATE_COLON) {
+    if (stream->token_length + length >= JSON_STREAM_KEY_SIZE) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+  } else if (stream->token_length + length >= JSON_STREAM_TOKEN_SIZE) {
+    stream->token[stream->token_length] = '\0';
+    value.string = stream->token;
+    value.string_length = stream->token_length;
+    stream->token_length = 0;
+    if (!stream->callback(JSON_STREAM_STRING, &value, stream->context)) {
+      stream->state = STATE_STOPPED;
+      return ESP_OK;
+    }
+  }
+
+  memcpy(stream->token + stream->token_length, bytes, length);
+  stream->token_length += length;
+
+  return ESP_OK;
+}
+
+static esp_err_t append_code_point(Json_stream *stream, uint32_t code_point)
+{
+  char bytes[UTF8_MAX_BYTES];
+  size_t length = 0;
+
+  if (code_point < 0x80) {
+    bytes[length++] = (char) code_point;
+  } else if (code_point < 0x800) {
+    bytes[length++] = (char) (0xc0 | (code_point >> 6));
+    bytes[length++] = (char) (0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    bytes[length++] = (char) (0xe0 | (code_point >> 12));
+    bytes[length++] = (char) (0x80 | ((code_point >> 6) & 0x3f));
+    bytes[length++] = (char) (0x80 | (code_point & 0x3f));
+  } else {
+    bytes[length++] = (char) (0xf0 | (code_point >> 18));
+    bytes[length++] = (char) (0x80 | ((code_point >> 12) & 0x3f));
+    bytes[length++] = (char) (0x80 | ((code_point >> 6) & 0x3f));
+    bytes[length++] = (char) (0x80 | (code_point & 0x3f));
+  }
+
+  return append(stream, bytes, length);
+}
+
+static esp_err_t finish_string(Json_stream *stream)
+{
+  json_stream_value_struct value = {0};
+
+  stream->token[stream->token_length] = '\0';
+
+  // A member name: keep it for the value that follows
+  if (stream->after_string == STATE_COLON) {
+    memcpy(stream->key, stream->token, stream->token_length + 1);
+    stream->has_key = true;
+    stream->state = STATE_COLON;
+    return ESP_OK;
+  }
+
+  value.string = stream->token;
+  value.string_length = stream->token_length;
+  deliver(stream, JSON_STREAM_STRING, &value);
+
+  return ESP_OK;
+}
+
+static esp_err_t finish_number(Json_stream *stream)
+{
+  json_stream_value_struct value = {0};
+  char *point = NULL;
+  char *end = NULL;
+
+  // Cut off where a digit still had to follow
+  if ((stream->number_part != NUMBER_ZERO) && (stream->number_part != NUMBER_INTEGER) &&
+      (stream->number_part != NUMBER_FRACTION) && (stream->number_part != NUMBER_EXPONENT)) {
+    return ESP_FAIL;
+  }
+
+  // strtod reads the decimal point of the current locale, as in cJSON
+  stream->token[stream->token_length] = '\0';
+  point = strchr(stream->token, '.');
+  if (point != NULL) {
+    *point = localeconv()->decimal_point[0];
+  }
+  value.number = strtod(stream->token, &end);
+  if (end != stream->token + stream->token_length) {
+    return ESP_FAIL;
+  }
+
+  deliver(stream, JSON_STREAM_NUMBER, &value);
+
+  return ESP_OK;
+}
+
+/*!
+ * Hand a finished value to the callback and move on to what may follow it
+ */
+static void deliver(Json_stream *stream, json_stream_event_t event, json_stream_value_struct *value)
+{
+  if ((event != JSON_STREAM_OBJECT_END) && (event != JSON_STREAM_ARRAY_END)) {
+    value->key = stream->has_key ? stream->key : NULL;
+  }
+  value->depth = stream->depth;
+
+  stream->has_key = false;
+  stream->state = (stream->depth == 0) ? STATE_DONE : STATE_AFTER_VALUE;
+
+  if (!stream->callback(event, value, stream->context)) {
+    stream->state = STATE_STOPPED;
+  }
+}
+
+static bool in_array(const Json_stream *stream)
+{
+  return (stream->depth > 0) && ((stream->array_levels & (1UL << (stream->depth - 1))) != 0);
+}
+
+static bool is_whitespace(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+static int hex_value(char c)
+{
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+  if ((c >= 'a') && (c <= 'f')) {
+    return c - 'a' + 10;
+  }
+  if ((c >= 'A') && (c <= 'F')) {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
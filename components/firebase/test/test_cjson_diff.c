@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "cJSON_Utils.h"
+#include "unity.h"
+
+#define DIFF_TEST_ROUNDS    1000
+#define DIFF_TEST_NAMES     (sizeof(diff_test_names) / sizeof(diff_test_names[0]))
+
+// Unique ignoring case, with pointer escapes and more than the 16 members that sort on the stack
+static const char *diff_test_names[] = {
+  "a", "Bc", "b", "Ad", "zone", "Zq", "z~1", "x/y", "", "alpha", "Alphx", "beta", "gamma", "delta", "eps",
+  "k1", "k2", "k3", "K4", "q", "rule_0", "rule_1", "rule_2"
+};
+
+static uint32_t diff_test_seed;
+
+static uint32_t diff_test_random(void)
+{
+  diff_test_seed = diff_test_seed * 1103515245u + 12345u;
+  return diff_test_seed >> 8;
+}
+
+// A random document, without nulls when a merge patch has to carry it (null there means remove)
+static cJSON *diff_test_document(int depth, bool nulls)
+{
+  uint32_t kind = diff_test_random() % ((depth > 2) ? 4 : 6);
+  cJSON *item;
+
+  switch (kind) {
+    case 0:
+      return cJSON_CreateNumber(diff_test_random() % 5);
+    case 1:
+      return cJSON_CreateString((diff_test_random() % 2) ? "x" : "y");
+    case 2:
+      return nulls ? cJSON_CreateNull() : cJSON_CreateNumber(-1);
+    case 3:
+      return cJSON_CreateBool(diff_test_random() % 2);
+    case 4: {
+      uint32_t count = diff_test_random() % 4;
+      item = cJSON_CreateArray();
+      for (uint32_t i = 0; i < count; i++) {
+        cJSON_AddItemToArray(item, diff_test_document(depth + 1, nulls));
+      }
+      return item;
+    }
+    default: {
+      uint32_t count = diff_test_random() % ((depth == 0) ? 30 : 8);
+      item = cJSON_CreateObject();
+      for (uint32_t i = 0; i < count; i++) {
+        const char *name = diff_test_names[diff_test_random() % DIFF_TEST_NAMES];
+        if (cJSON_GetObjectItemCaseSensitive(item, name) == NULL) {
+          cJSON_AddItemToObject(item, name, diff_test_document(depth + 1, nulls));
+        }
+      }
+      return item;
+    }
+  }
+}
+
+// Patches generated from one document to another have to turn a copy of the first into the second
+static void check_patch_round_trip(const cJSON *from, const cJSON *to, bool case_sensitive)
+{
+  cJSON *from_copy = cJSON_Duplicate(from, true);
+  cJSON *to_copy = cJSON_Duplicate(to, true);
+  cJSON *target = cJSON_Duplicate(from, true);
+  cJSON *patches = case_sensitive ? cJSONUtils_GeneratePatchesCaseSensitive(from_copy, to_copy)
+                                  : cJSONUtils_GeneratePatches(from_copy, to_copy);
+  int result = case_sensitive ? cJSONUtils_ApplyPatchesCaseSensitive(target, patches)
+                              : cJSONUtils_ApplyPatches(target, patches);
+
+  TEST_ASSERT_EQUAL_INT(0, result);
+  TEST_ASSERT(cJSON_Compare(target, to, case_sensitive));
+  // Generating sorts both sides, which must not change what they hold
+  TEST_ASSERT(cJSON_Compare(from_copy, from, true));
+  TEST_ASSERT(cJSON_Compare(to_copy, to, true));
+
+  cJSON_Delete(patches);
+  cJSON_Delete(target);
+  cJSON_Delete(to_copy);
+  cJSON_Delete(from_copy);
+}
+
+static void check_merge_patch_round_trip(const cJSON *from, const cJSON *to)
+{
+  cJSON *from_copy = cJSON_Duplicate(from, true);
+  cJSON *to_copy = cJSON_Duplicate(to, true);
+  cJSON *patch = cJSONUtils_GenerateMergePatchCaseSensitive(from_copy, to_copy);
+  cJSON *target = cJSON_Duplicate(from, true);
+
+  if (patch == NULL) {
+    // Nothing to merge
+    TEST_ASSERT(cJSON_Compare(from, to, true));
+  } else {
+    target = cJSONUtils_MergePatchCaseSensitive(target, patch);
+    TEST_ASSERT(cJSON_Compare(target, to, true));
+  }
+
+  cJSON_Delete(patch);
+  cJSON_Delete(target);
+  cJSON_Delete(to_copy);
+  cJSON_Delete(from_copy);
+}
+
+TEST_CASE("cJSON patches reproduce the target document", "[firebase][cjson]")
+{
+  diff_test_seed = 7;
+  for (int round = 0; round < DIFF_TEST_ROUNDS; round++) {
+    cJSON *from = diff_test_document(0, true);
+    cJSON *to = diff_test_document(0, true);
+    cJSON *merge_from = diff_test_document(0, false);
+    cJSON *merge_to = diff_test_document(0, false);
+
+    check_patch_round_trip(from, to, true);
+    check_patch_round_trip(from, to, false);
+    check_patch_round_trip(from, from, true);
+    check_merge_patch_round_trip(merge_from, merge_to);
+
+    cJSON_Delete(merge_to);
+    cJSON_Delete(merge_from);
+    cJSON_Delete(to);
+    cJSON_Delete(from);
+  }
+}
+
+TEST_CASE("cJSON compare ignores member order", "[firebase][cjson]")
+{
+  diff_test_seed = 11;
+  for (int round = 0; round < DIFF_TEST_ROUNDS; round++) {
+    cJSON *document = diff_test_document(0, true);
+    cJSON *sorted = cJSON_Duplicate(document, true);
+
+    cJSONUtils_SortObjectCaseSensitive(sorted);
+    TEST_ASSERT(cJSON_Compare(document, sorted, true));
+    TEST_ASSERT(cJSON_Compare(sorted, document, false));
+    if (cJSON_IsObject(sorted) && (sorted->child != NULL)) {
+      cJSON_AddNumberToObject(sorted, "not in the original", 1);
+      TEST_ASSERT_FALSE(cJSON_Compare(document, sorted, true));
+    }
+
+    cJSON_Delete(sorted);
+    cJSON_Delete(document);
+  }
+}
+
+TEST_CASE("cJSON sort is stable and keeps the list whole", "[firebase][cjson]")
+{
+  cJSON *object = cJSON_Parse("{\"b\": 1, \"A\": 2, \"c\": [3, 1, 2], \"a\": 4, \"B\": 5}");
+  cJSON *member;
+  char *printed;
+
+  TEST_ASSERT(object != NULL);
+
+  // Names equal ignoring case keep their document order; arrays keep theirs
+  cJSONUtils_SortObject(object);
+  printed = cJSON_PrintUnformatted(object);
+  TEST_ASSERT_EQUAL_STRING("{\"A\":2,\"a\":4,\"b\":1,\"B\":5,\"c\":[3,1,2]}", printed);
+  free(printed);
+
+  // The head's prev is the tail again, so appends after a sort are kept
+  TEST_ASSERT(object->child->prev == cJSON_GetObjectItemCaseSensitive(object, "c"));
+  cJSON_AddNumberToObject(object, "d", 6);
+  TEST_ASSERT_EQUAL_INT(6, cJSON_GetArraySize(object));
+  for (member = object->child; member->next != NULL; member = member->next) {
+  }
+  TEST_ASSERT_EQUAL_STRING("d", member->string);
+  TEST_ASSERT(object->child->prev == member);
+
+  cJSONUtils_SortObjectCaseSensitive(object);
+  printed = cJSON_PrintUnformatted(object);
+  TEST_ASSERT_EQUAL_STRING("{\"A\":2,\"B\":5,\"a\":4,\"b\":1,\"c\":[3,1,2],\"d\":6}", printed);
+  free(printed);
+
+  cJSON_Delete(object);
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "cJSON.h"
+#include "cJSON_Utils.h"
+#include "unity.h"
+
+#define INDEX_TEST_TRIALS   60
+#define INDEX_TEST_OPS      600
+#define INDEX_TEST_KEYS     60    // Few enough that most ops hit an existing member
+
+static uint32_t index_test_seed;
+
+static uint32_t index_test_random(void)
+{
+  index_test_seed = index_test_seed * 1103515245u + 12345u;
+  return index_test_seed >> 8;
+}
+
+// Mixed case, so the case-insensitive lookups see several spellings of one key
+static void index_test_key(char *buffer)
+{
+  sprintf(buffer, "%s%" PRIu32, (index_test_random() % 4 == 0) ? "Zone" : "zone",
+          index_test_random() % INDEX_TEST_KEYS);
+}
+
+// The member list walk the index has to agree with, duplicates included
+static cJSON *linear_lookup(const cJSON *object, const char *name, bool case_sensitive)
+{
+  for (cJSON *member = object->child; member != NULL; member = member->next) {
+    if (member->string == NULL) {
+      if (case_sensitive) {
+        return NULL;
+      }
+      continue;
+    }
+    if (case_sensitive ? (strcmp(member->string, name) == 0) : (strcasecmp(member->string, name) == 0)) {
+      return member;
+    }
+  }
+  return NULL;
+}
+
+static void check_lookups(const cJSON *object, int lookups)
+{
+  char key[32];
+
+  for (int i = 0; i < lookups; i++) {
+    bool case_sensitive = index_test_random() % 2;
+    cJSON *found;
+
+    index_test_key(key);
+    found = case_sensitive ? cJSON_GetObjectItemCaseSensitive(object, key) : cJSON_GetObjectItem(object, key);
+    TEST_ASSERT(found == linear_lookup(object, key, case_sensitive));
+  }
+}
+
+TEST_CASE("cJSON key index matches a linear lookup through edits", "[firebase][cjson]")
+{
+  char key[32];
+  char pointer[40];
+
+  index_test_seed = 12345;
+  for (int trial = 0; trial < INDEX_TEST_TRIALS; trial++) {
+    cJSON *object = cJSON_CreateObject();
+
+    for (int op = 0; op < INDEX_TEST_OPS; op++) {
+      index_test_key(key);
+      switch (index_test_random() % 10) {
+        case 0:
+        case 1:
+          // Appends duplicates as well as new keys
+          cJSON_AddNumberToObject(object, key, op);
+          break;
+        case 2:
+          cJSON_Delete(cJSON_DetachItemFromObject(object, key));
+          break;
+        case 3:
+          cJSON_Delete(cJSON_DetachItemFromObjectCaseSensitive(object, key));
+          break;
+        case 4:
+        case 5: {
+          // A replacement for a missing key stays the caller's
+          cJSON *item = cJSON_CreateNumber(-op);
+          bool replaced = (op % 2) ? cJSON_ReplaceItemInObject(object, key, item)
+                                   : cJSON_ReplaceItemInObjectCaseSensitive(object, key, item);
+          if (!replaced) {
+            cJSON_Delete(item);
+          }
+          break;
+        }
+        case 6: {
+          // A middle insert drops the index
+          int size = cJSON_GetArraySize(object);
+          if (size > 0) {
+            cJSON *item = cJSON_CreateNumber(op);
+            item->string = strdup(key);
+            cJSON_InsertItemInArray(object, index_test_random() % size, item);
+          }
+          break;
+        }
+        default:
+          break;
+      }
+      check_lookups(object, 3);
+
+      if (op % 100 == 0) {
+        // Duplicates leave the index behind and build their own
+        cJSON *copy = cJSON_Duplicate(object, true);
+        char *printed = cJSON_PrintUnformatted(object);
+        char *copy_printed = cJSON_PrintUnformatted(copy);
+
+        TEST_ASSERT_EQUAL_STRING(printed, copy_printed);
+        check_lookups(copy, 3);
+        free(printed);
+        free(copy_printed);
+        cJSON_Delete(copy);
+      }
+    }
+
+    cJSONUtils_SortObject(object);
+    check_lookups(object, 3);
+    index_test_key(key);
+    sprintf(pointer, "/%s", key);
+    TEST_ASSERT(cJSONUtils_GetPointer(object, pointer) == linear_lookup(object, key, false));
+    cJSON_DropObjectIndex(object);
+    check_lookups(object, 3);
+    cJSON_Delete(object);
+  }
+}
+
+TEST_CASE("cJSON key index serves parsed and interned keys", "[firebase][cjson]")
+{
+  static char keys[500][16];
+  cJSON *object = cJSON_CreateObject();
+  cJSON *parsed;
+  char *printed;
+
+  for (int i = 0; i < 500; i++) {
+    sprintf(keys[i], "rule_%03d", i);
+    cJSON_AddNumberToObject(object, keys[i], i);
+  }
+  printed = cJSON_PrintUnformatted(object);
+  parsed = cJSON_Parse(printed);
+  TEST_ASSERT(parsed != NULL);
+
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 500; i++) {
+      cJSON *item = cJSON_GetObjectItemCaseSensitive(parsed, keys[i]);
+      TEST_ASSERT(item != NULL && item->valueint == i);
+      TEST_ASSERT(cJSON_GetObjectItem(object, keys[i]) == linear_lookup(object, keys[i], false));
+    }
+  }
+  TEST_ASSERT(cJSON_GetObjectItem(parsed, "RULE_007") == linear_lookup(parsed, "rule_007", true));
+  TEST_ASSERT(cJSON_GetObjectItemCaseSensitive(parsed, "RULE_007") == NULL);
+  TEST_ASSERT(cJSON_GetObjectItem(parsed, "rule_500") == NULL);
+
+  free(printed);
+  cJSON_Delete(parsed);
+  cJSON_Delete(object);
+}
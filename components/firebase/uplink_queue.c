@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "uplink_queue.h"
+
+static firebase_data_struct alarm_slots[UPLINK_ALARM_DEPTH];
+static firebase_data_struct transition_slots[UPLINK_TRANSITION_DEPTH];
+static firebase_data_struct telemetry_slots[UPLINK_TELEMETRY_DEPTH];
+
+static const char *class_names[UPLINK_CLASS_COUNT] = {
+  [UPLINK_CLASS_ALARM]      = "Alarm",
+  [UPLINK_CLASS_TRANSITION] = "Transition",
+  [UPLINK_CLASS_TELEMETRY]  = "Telemetry"
+};
+
+// Static private object pointer
+static Uplink_queue *self;
+
+// Private functions
+static void ring_init(uplink_ring_struct *ring, firebase_data_struct *slots, uint8_t size);
+static firebase_data_struct *ring_slot(const uplink_ring_struct *ring, uint8_t index);
+
+// Public functions
+static esp_err_t _uplink_queue_push(const firebase_data_struct *message);
+static bool _uplink_queue_pop(firebase_data_struct *message, TickType_t ticks_to_wait);
+static void _uplink_queue_delivered(const firebase_data_struct *message, esp_err_t result);
+static uplink_class_stats_struct _uplink_queue_get_stats(uplink_class_t uplink_class);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t uplink_queue_init(Uplink_queue *queue)
+{
+  if (queue == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  self = queue;
+
+  ring_init(&(self->rings[UPLINK_CLASS_ALARM]), alarm_slots, UPLINK_ALARM_DEPTH);
+  ring_init(&(self->rings[UPLINK_CLASS_TRANSITION]), transition_slots, UPLINK_TRANSITION_DEPTH);
+  ring_init(&(self->rings[UPLINK_CLASS_TELEMETRY]), telemetry_slots, UPLINK_TELEMETRY_DEPTH);
+  memset(self->stats, 0, sizeof(self->stats));
+  portMUX_INITIALIZE(&(self->lock));
+
+  self->ready = xSemaphoreCreateBinary();
+  if (self->ready == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  self->push = _uplink_queue_push;
+  self->pop = _uplink_queue_pop;
+  self->delivered = _uplink_queue_delivered;
+  self->get_stats = _uplink_queue_get_stats;
+
+  return ESP_OK;
+}
+
+const char *uplink_class_name(uplink_class_t uplink_class)
+{
+  return ((unsigned) uplink_class < UPLINK_CLASS_COUNT) ? class_names[uplink_class] : "?";
+}
+
+/*!
+ * Queue a message in its class. Never blocks: something queued gives way when the ring is full.
+ */
+static esp_err_t _uplink_queue_push(const firebase_data_struct *message)
+{
+  uplink_ring_struct *ring = NULL;
+  uplink_class_stats_struct *stats = NULL;
+  firebase_data_struct *newest = NULL;
+  int64_t queued_time_us = 0;
+
+  if ((message == NULL) || (message->uplink_class >= UPLINK_CLASS_COUNT)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  ring = &(self->rings[message->uplink_class]);
+  stats = &(self->stats[message->uplink_class]);
+
+  portENTER_CRITICAL(&(self->lock));
+  stats->queued++;
+  if ((ring->count == ring->size) && (message->uplink_class == UPLINK_CLASS_TELEMETRY)) {
+    // The newest sample has every field at its latest; it keeps its place and its queued time
+    newest = ring_slot(ring, ring->count - 1);
+    queued_time_us = newest->queued_time_us;
+    memcpy(newest, message, sizeof(firebase_data_struct));
+    newest->queued_time_us = queued_time_us;
+    stats->coalesced++;
+  } else {
+    if (ring->count == ring->size) {
+      ring->head = (ring->head + 1) % ring->size;
+      ring->count--;
+      stats->dropped++;
+    }
+    memcpy(ring_slot(ring, ring->count), message, sizeof(firebase_data_struct));
+    ring->count++;
+    if (ring->count > stats->max_depth) {
+      stats->max_depth = ring->count;
+    }
+  }
+  portEXIT_CRITICAL(&(self->lock));
+
+  xSemaphoreGive(self->ready);
+
+  return ESP_OK;
+}
+
+/*!
+ * Oldest message of the highest class waiting. False if none came within ticks_to_wait.
+ */
+static bool _uplink_queue_pop(firebase_data_struct *message, TickType_t ticks_to_wait)
+{
+  uplink_ring_struct *ring = NULL;
+  bool found = false;
+
+  while (1) {
+    portENTER_CRITICAL(&(self->lock));
+    for (int i = 0; (i < UPLINK_CLASS_COUNT) && !found; i++) {
+      ring = &(self->rings[i]);
+      if (ring->count > 0) {
+        memcpy(message, ring_slot(ring, 0), sizeof(firebase_data_struct));
+        ring->head = (ring->head + 1) % ring->size;
+        ring->count--;
+        found = true;
+      }
+    }
+    portEXIT_CRITICAL(&(self->lock));
+
+    // A push between the check and the take leaves the semaphore given, so none is missed
+    if (found || (xSemaphoreTake(self->ready, ticks_to_wait) != pdTRUE)) {
+      return found;
+    }
+  }
+}
+
+/*!
+ * Record how a popped message went. Alarms and transitions that failed go back to the front
+ * of their class, up to UPLINK_MAX_RETRIES times and unless it has filled up since.
+ */
+static void _uplink_queue_delivered(const firebase_data_struct *message, esp_err_t result)
+{
+  uplink_ring_struct *ring = NULL;
+  uplink_class_stats_struct *stats = NULL;
+  uint32_t latency_us = 0;
+
+  if ((message == NULL) || (message->uplink_class >= UPLINK_CLASS_COUNT)) {
+    return;
+  }
+
+  ring = &(self->rings[message->uplink_class]);
+  stats = &(self->stats[message->uplink_class]);
+  latency_us = (uint32_t) (esp_timer_get_time() - message->queued_time_us);
+
+  portENTER_CRITICAL(&(self->lock));
+  if (result == ESP_OK) {
+    stats->delivered++;
+    stats->total_latency_us += latency_us;
+    if (latency_us > stats->max_latency_us) {
+      stats->max_latency_us = latency_us;
+    }
+  } else if ((message->uplink_class != UPLINK_CLASS_TELEMETRY) && (message->retries < UPLINK_MAX_RETRIES) &&
+             (ring->count < ring->size)) {
+    ring->head = (ring->head + ring->size - 1) % ring->size;
+    memcpy(ring_slot(ring, 0), message, sizeof(firebase_data_struct));
+    ring_slot(ring, 0)->retries++;
+    ring->count++;
+    stats->retries++;
+  } else {
+    stats->dropped++;
+  }
+  portEXIT_CRITICAL(&(self->lock));
+}
+
+static uplink_class_stats_struct _uplink_queue_get_stats(uplink_class_t uplink_class)
+{
+  uplink_class_stats_struct stats = { 0 };
+
+  if ((unsigned) uplink_class < UPLINK_CLASS_COUNT) {
+    portENTER_CRITICAL(&(self->lock));
+    stats = self->stats[uplink_class];
+    portEXIT_CRITICAL(&(self->lock));
+  }
+
+  return stats;
+}
+
+static void ring_init(uplink_ring_struct *ring, firebase_data_struct *slots, uint8_t size)
+{
+  ring->slots = slots;
+  ring->size = size;
+  ring->head = 0;
+  ring->count = 0;
+}
+
+/*!
+ * index-th message from the oldest
+ */
+static firebase_data_struct *ring_slot(const uplink_ring_struct *ring, uint8_t index)
+{
+  return &(ring->slots[(ring->head + index) % ring->size]);
+}
@@ -30,22 +30,60 @@ extern "C"
 #define OS_SUCCESS  0
 #define OS_FAIL     -1
 
+/* json_parse_feed(): the document isn't complete yet, feed it again with more */
+#define JSON_PARSE_PARTIAL  2
+
 typedef jsmn_parser json_parser_t;
 typedef jsmntok_t json_tok_t;
 
+/* Tokens for parses to reuse. Starts on the caller's buffer (or empty) and grows on the heap,
+ * doubling, only when a document needs more; later parses keep the grown array, so the steady
+ * state allocates nothing. One parse at a time per pool. */
+typedef struct {
+    json_tok_t *tokens;
+    int capacity;
+    int max_count;              /* Most tokens to grow to, 0 for no limit */
+    json_tok_t *buffer;         /* The caller's, never freed */
+    int grows;                  /* Times the pool had to grow */
+} json_tok_pool_t;
+
+/* Member of the object json_obj_get_*() last looked up twice in, by name hash */
+typedef struct {
+    uint32_t hash;
+    int key;                    /* Token of the member name, -1 for an empty slot */
+} json_obj_index_entry_t;
+
 typedef struct {
     json_parser_t parser;
     const char *js;
     json_tok_t *tokens;
     json_tok_t *cur;
     int num_tokens;
+    json_tok_pool_t *pool;      /* Where the tokens come from, NULL if they are the context's own */
+    json_tok_t *searched;       /* Object of the last lookup */
+    json_tok_t *indexed;        /* Object the index is built for, NULL for none */
+    json_obj_index_entry_t *index;
+    int index_capacity;         /* Power of two, grown as needed and kept until the parse ends */
 } jparse_ctx_t;
 
+void json_tok_pool_init(json_tok_pool_t *pool, json_tok_t *buffer, int count, int max_count);
+void json_tok_pool_free(json_tok_pool_t *pool);
+
 int json_parse_start(jparse_ctx_t *jctx, const char *js, int len);
 int json_parse_end(jparse_ctx_t *jctx);
 int json_parse_start_static(jparse_ctx_t *jctx, const char *js, int len, json_tok_t *buffer_tokens, int buffer_tokens_max_count);
 int json_parse_end_static(jparse_ctx_t *jctx);
 
+/* One pass over the document into the pool's tokens. End with json_parse_end(), which leaves
+ * the tokens with the pool. */
+int json_parse_start_pool(jparse_ctx_t *jctx, const char *js, int len, json_tok_pool_t *pool);
+
+/* Chunked input: begin, then feed the document received so far (contiguous, it may move
+ * between calls) each time more arrives. Parsing resumes where the last feed stopped. Returns
+ * OS_SUCCESS once a whole document is in, JSON_PARSE_PARTIAL until then. */
+int json_parse_begin(jparse_ctx_t *jctx, json_tok_pool_t *pool);
+int json_parse_feed(jparse_ctx_t *jctx, const char *js, int len);
+
 int json_obj_get_array(jparse_ctx_t *jctx, const char *name, int *num_elem);
 int json_obj_leave_array(jparse_ctx_t *jctx);
 int json_obj_get_object(jparse_ctx_t *jctx, const char *name);
@@ -23,6 +23,9 @@
 #include <jsmn.h>
 #include <json_parser.h>
 
+#define JSON_TOK_POOL_FIRST     16      /* Tokens an empty pool starts with */
+#define JSON_OBJ_INDEX_MIN      8       /* Members an object needs before lookups in it are indexed */
+
 static bool token_matches_str(jparse_ctx_t *ctx, json_tok_t *tok, const char *str)
 {
     const char *js = ctx->js;
@@ -102,6 +105,80 @@ static int json_tok_to_string(jparse_ctx_t *jctx, json_tok_t *tok, char *val, in
     return OS_SUCCESS;
 }
 
+/* FNV-1a */
+static uint32_t json_key_hash(const char *key, int len)
+{
+    uint32_t hash = 2166136261u;
+    while (len--) {
+        hash = (hash ^ (uint8_t) *key++) * 16777619u;
+    }
+    return hash;
+}
+
+/* Hash the members of jctx->cur into the index, first of any duplicate names winning as in a
+ * linear search. Leaves no index if there is no memory for it. */
+static void json_obj_index_build(jparse_ctx_t *jctx)
+{
+    json_tok_t *tok = jctx->cur;
+    int size = tok->size;
+    int capacity = JSON_OBJ_INDEX_MIN * 2;
+    int mask, slot;
+    uint32_t hash;
+
+    jctx->indexed = NULL;
+    while (capacity < size * 2) {
+        capacity *= 2;
+    }
+    if (capacity > jctx->index_capacity) {
+        json_obj_index_entry_t *index = realloc(jctx->index, capacity * sizeof(json_obj_index_entry_t));
+        if (!index) {
+            return;
+        }
+        jctx->index = index;
+        jctx->index_capacity = capacity;
+    }
+    capacity = jctx->index_capacity;
+    mask = capacity - 1;
+    memset(jctx->index, 0xff, capacity * sizeof(json_obj_index_entry_t));
+
+    while (size--) {
+        tok++;
+        hash = json_key_hash(jctx->js + tok->start, tok->end - tok->start);
+        slot = hash & mask;
+        while (jctx->index[slot].key >= 0) {
+            json_tok_t *other = &jctx->tokens[jctx->index[slot].key];
+            if (jctx->index[slot].hash == hash && (other->end - other->start) == (tok->end - tok->start)
+                    && memcmp(jctx->js + other->start, jctx->js + tok->start, tok->end - tok->start) == 0) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (jctx->index[slot].key < 0) {
+            jctx->index[slot].hash = hash;
+            jctx->index[slot].key = tok - jctx->tokens;
+        }
+        tok = json_skip_elem(tok);
+    }
+    jctx->indexed = jctx->cur;
+}
+
+static json_tok_t *json_obj_index_search(jparse_ctx_t *jctx, const char *key)
+{
+    int len = strlen(key);
+    uint32_t hash = json_key_hash(key, len);
+    int mask = jctx->index_capacity - 1;
+    int slot = hash & mask;
+
+    while (jctx->index[slot].key >= 0) {
+        json_tok_t *tok = &jctx->tokens[jctx->index[slot].key];
+        if (jctx->index[slot].hash == hash && token_matches_str(jctx, tok, key)) {
+            return tok;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
 static json_tok_t *json_obj_search(jparse_ctx_t *jctx, const char *key)
 {
     json_tok_t *tok = jctx->cur;
@@ -113,6 +190,15 @@ static json_tok_t *json_obj_search(jparse_ctx_t *jctx, const char *key)
         return NULL;
     }
 
+    /* Reading several members of a wide object: index it on the second lookup */
+    if (jctx->indexed != tok && jctx->searched == tok && size >= JSON_OBJ_INDEX_MIN) {
+        json_obj_index_build(jctx);
+    }
+    jctx->searched = tok;
+    if (jctx->indexed == tok) {
+        return json_obj_index_search(jctx, key);
+    }
+
     while (size--) {
         tok++;
         if (token_matches_str(jctx, tok, key)) {
@@ -403,72 +489,155 @@ int json_arr_get_strlen(jparse_ctx_t *jctx, uint32_t index, int *strlen)
     return OS_SUCCESS;
 }
 
-int json_parse_start(jparse_ctx_t *jctx, const char *js, int len)
+void json_tok_pool_init(json_tok_pool_t *pool, json_tok_t *buffer, int count, int max_count)
 {
-    memset(jctx, 0, sizeof(jparse_ctx_t));
-    jsmn_init(&jctx->parser);
-    int num_tokens = jsmn_parse(&jctx->parser, js, len, NULL, 0);
-    if (num_tokens <= 0) {
-        return -OS_FAIL;
+    memset(pool, 0, sizeof(json_tok_pool_t));
+    pool->buffer = buffer;
+    pool->tokens = buffer;
+    pool->capacity = buffer ? count : 0;
+    pool->max_count = max_count;
+}
+
+void json_tok_pool_free(json_tok_pool_t *pool)
+{
+    if (pool->tokens != pool->buffer) {
+        free(pool->tokens);
+    }
+    memset(pool, 0, sizeof(json_tok_pool_t));
+}
+
+/* Double the pool, moving off the caller's buffer onto the heap the first time */
+static int json_tok_pool_grow(json_tok_pool_t *pool)
+{
+    int capacity = (pool->capacity > 0) ? pool->capacity * 2 : JSON_TOK_POOL_FIRST;
+    json_tok_t *tokens;
+
+    if (pool->max_count > 0) {
+        if (pool->capacity >= pool->max_count) {
+            return -OS_FAIL;
+        }
+        if (capacity > pool->max_count) {
+            capacity = pool->max_count;
+        }
+    }
+    if (pool->tokens == pool->buffer) {
+        tokens = malloc(capacity * sizeof(json_tok_t));
+        if (tokens && pool->capacity > 0) {
+            memcpy(tokens, pool->tokens, pool->capacity * sizeof(json_tok_t));
+        }
+    } else {
+        tokens = realloc(pool->tokens, capacity * sizeof(json_tok_t));
     }
-    jctx->num_tokens = num_tokens;
-    jctx->tokens = calloc(num_tokens, sizeof(json_tok_t));
-    if (!jctx->tokens) {
+    if (!tokens) {
         return -OS_FAIL;
     }
+    pool->tokens = tokens;
+    pool->capacity = capacity;
+    pool->grows++;
+    return OS_SUCCESS;
+}
+
+/* jsmn_parse() into the pool. When it runs out of tokens the pool grows and jsmn resumes where
+ * it stopped, so the document is scanned once. */
+static int json_parse_pool_tokens(jparse_ctx_t *jctx, const char *js, int len)
+{
+    json_tok_pool_t *pool = jctx->pool;
+    int ret = JSMN_ERROR_NOMEM;
+
+    /* jsmn only counts when it has no tokens at all */
+    if (pool->capacity > 0 && pool->tokens) {
+        ret = jsmn_parse(&jctx->parser, js, len, pool->tokens, pool->capacity);
+    }
+    while (ret == JSMN_ERROR_NOMEM) {
+        if (json_tok_pool_grow(pool) != OS_SUCCESS) {
+            return JSMN_ERROR_NOMEM;
+        }
+        ret = jsmn_parse(&jctx->parser, js, len, pool->tokens, pool->capacity);
+    }
     jctx->js = js;
+    jctx->tokens = pool->tokens;
+    jctx->cur = jctx->tokens;
+    jctx->searched = NULL;
+    jctx->indexed = NULL;
+    jctx->num_tokens = (ret > 0) ? ret : (int) jctx->parser.toknext;
+    return ret;
+}
+
+int json_parse_start_pool(jparse_ctx_t *jctx, const char *js, int len, json_tok_pool_t *pool)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
     jsmn_init(&jctx->parser);
-    int ret = jsmn_parse(&jctx->parser, js, len, jctx->tokens, jctx->num_tokens);
-    if (ret <= 0) {
-        free(jctx->tokens);
+    jctx->pool = pool;
+    if (json_parse_pool_tokens(jctx, js, len) <= 0) {
         memset(jctx, 0, sizeof(jparse_ctx_t));
         return -OS_FAIL;
     }
-    jctx->cur = jctx->tokens;
+    return OS_SUCCESS;
+}
+
+int json_parse_start(jparse_ctx_t *jctx, const char *js, int len)
+{
+    json_tok_pool_t pool;
+
+    json_tok_pool_init(&pool, NULL, 0, 0);
+    if (json_parse_start_pool(jctx, js, len, &pool) != OS_SUCCESS) {
+        json_tok_pool_free(&pool);
+        return -OS_FAIL;
+    }
+    /* The tokens are the context's own now, for json_parse_end() to free */
+    jctx->pool = NULL;
     return OS_SUCCESS;
 }
 
 int json_parse_end(jparse_ctx_t *jctx)
 {
-    if (jctx->tokens) {
+    if (jctx->tokens && !jctx->pool) {
         free(jctx->tokens);
     }
+    free(jctx->index);
     memset(jctx, 0, sizeof(jparse_ctx_t));
     return OS_SUCCESS;
 }
 
 int json_parse_start_static(jparse_ctx_t *jctx, const char *js, int len, json_tok_t *buffer_tokens, int buffer_tokens_max_count)
 {
-    // Init
-    memset(buffer_tokens, 0, buffer_tokens_max_count * sizeof(json_tok_t));
-    memset(jctx, 0, sizeof(jparse_ctx_t));
+    json_tok_pool_t pool;
 
-    // Check fit
-    jsmn_init(&jctx->parser);
-    int num_tokens = jsmn_parse(&jctx->parser, js, len, NULL, 0);
-    if (num_tokens <= 0 || num_tokens > buffer_tokens_max_count) {
-        return -OS_FAIL;
-    }
-
-    // Set struct
-    jctx->num_tokens = num_tokens;
-    jctx->tokens = buffer_tokens;
-    jctx->js = js;
-
-    // Parse
-    jsmn_init(&jctx->parser);
-    int ret = jsmn_parse(&jctx->parser, js, len, jctx->tokens, jctx->num_tokens);
-    if (ret <= 0) {
+    /* A pool that can't grow past the buffer */
+    json_tok_pool_init(&pool, buffer_tokens, buffer_tokens_max_count, buffer_tokens_max_count);
+    if (buffer_tokens_max_count <= 0 || json_parse_start_pool(jctx, js, len, &pool) != OS_SUCCESS) {
         memset(jctx, 0, sizeof(jparse_ctx_t));
         return -OS_FAIL;
     }
-    jctx->cur = jctx->tokens;
+    jctx->pool = NULL;
     return OS_SUCCESS;
 }
 
 int json_parse_end_static(jparse_ctx_t *jctx)
 {
+    free(jctx->index);
     memset(jctx, 0, sizeof(jparse_ctx_t));
     return OS_SUCCESS;
 }
 
+int json_parse_begin(jparse_ctx_t *jctx, json_tok_pool_t *pool)
+{
+    memset(jctx, 0, sizeof(jparse_ctx_t));
+    jsmn_init(&jctx->parser);
+    jctx->pool = pool;
+    return pool ? OS_SUCCESS : -OS_FAIL;
+}
+
+int json_parse_feed(jparse_ctx_t *jctx, const char *js, int len)
+{
+    int ret;
+
+    if (!jctx->pool) {
+        return -OS_FAIL;
+    }
+    ret = json_parse_pool_tokens(jctx, js, len);
+    if (ret == JSMN_ERROR_PART || ret == 0) {
+        return JSON_PARSE_PARTIAL;
+    }
+    return (ret > 0) ? OS_SUCCESS : -OS_FAIL;
+}
@@ -0,0 +1,234 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "json_parser.h"
+#include "unity.h"
+
+#define json_test_str   "{\n\"str_val\" :    \"JSON Parser\",\n" \
+            "\t\"float_val\" : 2.0,\n" \
+            "\"int_val\" : 2017,\n" \
+            "\"bool_val\" : false,\n" \
+            "\"supported_el\" :\t [\"bool\",\"int\","\
+            "\"float\",\"str\"" \
+            ",\"object\",\"array\"],\n" \
+            "\"features\" : { \"objects\":true, "\
+            "\"arrays\":\"yes\"},\n"\
+            "\"int_64\":109174583252}"
+
+TEST_CASE("json_parser basic tests", "[json_parser]")
+{
+    jparse_ctx_t jctx;
+    int ret = json_parse_start(&jctx, json_test_str, strlen(json_test_str));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, ret);
+
+    char str_val[64];
+    int int_val, num_elem;
+    int64_t int64_val;
+    bool bool_val;
+    float float_val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(&jctx, "str_val", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("JSON Parser", str_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_float(&jctx, "float_val", &float_val));
+    TEST_ASSERT(fabs(float_val - 2.0f) < 0.0001f)
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "int_val", &int_val));
+    TEST_ASSERT_EQUAL_INT(2017, int_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_bool(&jctx, "bool_val", &bool_val));
+    TEST_ASSERT_EQUAL(false, bool_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(&jctx, "supported_el", &num_elem));
+    const char *expected_values[] = {"bool", "int", "float", "str", "object", "array"};
+    TEST_ASSERT_EQUAL(sizeof(expected_values) / sizeof(expected_values[0]), num_elem);
+    for (int i = 0; i < num_elem; ++i) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_string(&jctx, i, str_val, sizeof(str_val)));
+        TEST_ASSERT_EQUAL_STRING(expected_values[i], str_val);
+    }
+    json_obj_leave_array(&jctx);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, "features"));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_bool(&jctx, "objects", &bool_val));
+    TEST_ASSERT_EQUAL(true, bool_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(&jctx, "arrays", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("yes", str_val);
+    json_obj_leave_object(&jctx);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int64(&jctx, "int_64", &int64_val));
+    TEST_ASSERT(int64_val == 109174583252);
+
+    json_parse_end(&jctx);
+}
+
+#define json_feed_str   "{\"id\": 123456, \"ratio\": -12.625e-1, \"name\": \"split across chunks\", " \
+            "\"list\": [1, 22, 333, {\"deep\": [true, false, null]}], \"big\": 109174583252}"
+
+/* Feed json_feed_str the way a stream receives it, in chunks of 1 to max_chunk bytes */
+static int feed_in_chunks(jparse_ctx_t *jctx, json_tok_pool_t *pool, char *received, int max_chunk, uint32_t seed)
+{
+    int len = strlen(json_feed_str);
+    int fed = 0;
+    int chunk;
+    int ret = -OS_FAIL;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_begin(jctx, pool));
+    while (fed < len) {
+        seed = seed * 1103515245 + 12345;
+        chunk = 1 + (int) ((seed >> 16) % max_chunk);
+        if (chunk > len - fed) {
+            chunk = len - fed;
+        }
+        memcpy(received + fed, json_feed_str + fed, chunk);
+        fed += chunk;
+        ret = json_parse_feed(jctx, received, fed);
+        if (fed < len) {
+            TEST_ASSERT_EQUAL(JSON_PARSE_PARTIAL, ret);
+        }
+    }
+    return ret;
+}
+
+static void check_feed_doc(jparse_ctx_t *jctx)
+{
+    char str_val[32];
+    int int_val, num_elem;
+    int64_t int64_val;
+    float float_val;
+    bool bool_val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(jctx, "id", &int_val));
+    TEST_ASSERT_EQUAL_INT(123456, int_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_float(jctx, "ratio", &float_val));
+    TEST_ASSERT(fabs(float_val + 1.2625f) < 0.0001f);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_string(jctx, "name", str_val, sizeof(str_val)));
+    TEST_ASSERT_EQUAL_STRING("split across chunks", str_val);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(jctx, "list", &num_elem));
+    TEST_ASSERT_EQUAL_INT(4, num_elem);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_int(jctx, 2, &int_val));
+    TEST_ASSERT_EQUAL_INT(333, int_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_object(jctx, 3));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_array(jctx, "deep", &num_elem));
+    TEST_ASSERT_EQUAL_INT(3, num_elem);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_arr_get_bool(jctx, 1, &bool_val));
+    TEST_ASSERT_EQUAL(false, bool_val);
+    json_obj_leave_array(jctx);
+    json_arr_leave_object(jctx);
+    json_obj_leave_array(jctx);
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int64(jctx, "big", &int64_val));
+    TEST_ASSERT(int64_val == 109174583252);
+}
+
+TEST_CASE("json_parser feeds a document in chunks", "[json_parser]")
+{
+    static char received[sizeof(json_feed_str)];
+    json_tok_t tokens[8];
+    json_tok_pool_t pool;
+    jparse_ctx_t jctx;
+    int grows;
+
+    json_tok_pool_init(&pool, tokens, sizeof(tokens) / sizeof(tokens[0]), 0);
+
+    /* One byte at a time splits every number, string and literal */
+    TEST_ASSERT_EQUAL(OS_SUCCESS, feed_in_chunks(&jctx, &pool, received, 1, 0));
+    check_feed_doc(&jctx);
+    json_parse_end(&jctx);
+    grows = pool.grows;
+    TEST_ASSERT(grows > 0);
+
+    for (uint32_t seed = 1; seed <= 50; seed++) {
+        memset(received, 0, sizeof(received));
+        TEST_ASSERT_EQUAL(OS_SUCCESS, feed_in_chunks(&jctx, &pool, received, 1 + (seed % 16), seed));
+        check_feed_doc(&jctx);
+        json_parse_end(&jctx);
+    }
+
+    /* The later parses reused what the first one grew */
+    TEST_ASSERT_EQUAL_INT(grows, pool.grows);
+    json_tok_pool_free(&pool);
+}
+
+TEST_CASE("json_parser fails when the token pool is exhausted", "[json_parser]")
+{
+    json_tok_t tokens[4];
+    json_tok_pool_t pool;
+    jparse_ctx_t jctx;
+    int len = strlen(json_feed_str);
+
+    /* Capped at its buffer */
+    json_tok_pool_init(&pool, tokens, sizeof(tokens) / sizeof(tokens[0]), sizeof(tokens) / sizeof(tokens[0]));
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_parse_start_pool(&jctx, json_feed_str, len, &pool));
+    TEST_ASSERT_EQUAL_INT(0, pool.grows);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_begin(&jctx, &pool));
+    TEST_ASSERT_EQUAL(-OS_FAIL, json_parse_feed(&jctx, json_feed_str, len));
+    json_parse_end(&jctx);
+
+    /* Allowed to grow, but not far enough */
+    json_tok_pool_init(&pool, tokens, sizeof(tokens) / sizeof(tokens[0]), 12);
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_parse_start_pool(&jctx, json_feed_str, len, &pool));
+    TEST_ASSERT_EQUAL_INT(12, pool.capacity);
+    json_tok_pool_free(&pool);
+
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_parse_start_static(&jctx, json_feed_str, len, tokens,
+                                                              sizeof(tokens) / sizeof(tokens[0])));
+
+    /* A small document still fits */
+    json_tok_pool_init(&pool, tokens, sizeof(tokens) / sizeof(tokens[0]), sizeof(tokens) / sizeof(tokens[0]));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start_pool(&jctx, "{\"a\": 1}", 8, &pool));
+    json_parse_end(&jctx);
+    json_tok_pool_free(&pool);
+}
+
+#define json_dup_str    "{\"dup\": 1, \"a\": 2, \"ab\": 3, \"kind\": 4, \"c\": 5, \"dup\": 6, \"d\": 7, " \
+            "\"inner\": {\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k0\": 40, \"k4\": 4, \"k5\": 5, \"k6\": 6}, " \
+            "\"kind\": \"str\", \"e\": 9, \"dup\": 10}"
+
+TEST_CASE("json_parser index lookups with duplicate keys", "[json_parser]")
+{
+    jparse_ctx_t jctx;
+    char str_val[8];
+    int int_val;
+
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_parse_start(&jctx, json_dup_str, strlen(json_dup_str)));
+
+    /* The first of the duplicates wins, as in a linear search, before and after the index is built */
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "dup", &int_val));
+        TEST_ASSERT_EQUAL_INT(1, int_val);
+    }
+    TEST_ASSERT(jctx.indexed != NULL);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "ab", &int_val));
+    TEST_ASSERT_EQUAL_INT(3, int_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "a", &int_val));
+    TEST_ASSERT_EQUAL_INT(2, int_val);
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "e", &int_val));
+    TEST_ASSERT_EQUAL_INT(9, int_val);
+
+    /* The later "kind" is a string, but lookups only ever see the first */
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "kind", &int_val));
+    TEST_ASSERT_EQUAL_INT(4, int_val);
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_obj_get_string(&jctx, "kind", str_val, sizeof(str_val)));
+
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "missing", &int_val));
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "k0", &int_val));
+
+    /* A nested object gets its own index, and the outer one's is rebuilt on the way back */
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_object(&jctx, "inner"));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "k0", &int_val));
+        TEST_ASSERT_EQUAL_INT(0, int_val);
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "k6", &int_val));
+        TEST_ASSERT_EQUAL_INT(6, int_val);
+    }
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "dup", &int_val));
+    TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_leave_object(&jctx));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "dup", &int_val));
+        TEST_ASSERT_EQUAL_INT(1, int_val);
+    }
+    TEST_ASSERT_NOT_EQUAL(OS_SUCCESS, json_obj_get_int(&jctx, "k1", &int_val));
+
+    json_parse_end(&jctx);
+}
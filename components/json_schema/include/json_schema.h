@@ -0,0 +1,95 @@
+#ifndef JSON_SCHEMA_H
+#define JSON_SCHEMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "json_parser.h"
+
+#define JSON_SCHEMA_MAX_FIELDS  32    // Members one schema can describe, decoding a larger one fails
+
+typedef enum json_field_type {
+  JSON_FIELD_BOOL = 0,        // bool
+  JSON_FIELD_INT,             // Signed integer of size 1, 2, 4 or 8
+  JSON_FIELD_UINT,            // Unsigned integer of size 1, 2, 4 or 8
+  JSON_FIELD_FLOAT,           // float, or double for size 8
+  JSON_FIELD_STRING,          // char[size], nul terminated, escapes left as they are
+  JSON_FIELD_OBJECT,          // Struct described by schema
+  JSON_FIELD_ARRAY            // Up to max_count elements, size apart, each described by element
+} json_field_type_t;
+
+struct json_schema;
+
+/* Where one member of a JSON object goes in the C struct, and what is accepted for it */
+typedef struct json_field {
+  const char                *name;
+  uint8_t                   type;           // json_field_type_t
+  bool                      required;
+  bool                      ranged;         // Numbers: reject values outside min..max
+  uint16_t                  offset;         // Of the member in the struct
+  uint16_t                  size;           // Of the member; for arrays, of one element
+  double                    min;
+  double                    max;
+  const struct json_schema  *schema;        // JSON_FIELD_OBJECT
+  const struct json_field   *element;       // JSON_FIELD_ARRAY, its offset is ignored
+  uint16_t                  max_count;      // JSON_FIELD_ARRAY
+  uint16_t                  count_offset;   // JSON_FIELD_ARRAY: unsigned integer the element count goes in
+  uint8_t                   count_size;
+} json_field_struct;
+
+typedef struct json_schema {
+  const json_field_struct   *fields;
+  uint8_t                   field_count;
+} json_schema_struct;
+
+#define JSON_SCHEMA(field_table)  { (field_table), sizeof(field_table) / sizeof((field_table)[0]) }
+
+#define JSON_MEMBER_SIZE(struct_type, member)  sizeof(((struct_type *) 0)->member)
+
+// Descriptor table entries for a member of struct_type
+#define JSON_FIELD_NUMBER(json_name, field_type, struct_type, member, is_required, minimum, maximum) \
+  { .name = (json_name), .type = (field_type), .required = (is_required), .ranged = true, \
+    .offset = offsetof(struct_type, member), .size = JSON_MEMBER_SIZE(struct_type, member), \
+    .min = (minimum), .max = (maximum) }
+#define JSON_FIELD_BOOLEAN(json_name, struct_type, member, is_required) \
+  { .name = (json_name), .type = JSON_FIELD_BOOL, .required = (is_required), \
+    .offset = offsetof(struct_type, member), .size = JSON_MEMBER_SIZE(struct_type, member) }
+#define JSON_FIELD_TEXT(json_name, struct_type, member, is_required) \
+  { .name = (json_name), .type = JSON_FIELD_STRING, .required = (is_required), \
+    .offset = offsetof(struct_type, member), .size = JSON_MEMBER_SIZE(struct_type, member) }
+#define JSON_FIELD_STRUCT(json_name, struct_type, member, is_required, member_schema) \
+  { .name = (json_name), .type = JSON_FIELD_OBJECT, .required = (is_required), \
+    .offset = offsetof(struct_type, member), .size = JSON_MEMBER_SIZE(struct_type, member), \
+    .schema = (member_schema) }
+#define JSON_FIELD_LIST(json_name, struct_type, member, is_required, element_field, count_member) \
+  { .name = (json_name), .type = JSON_FIELD_ARRAY, .required = (is_required), \
+    .offset = offsetof(struct_type, member), .size = JSON_MEMBER_SIZE(struct_type, member[0]), \
+    .element = (element_field), \
+    .max_count = JSON_MEMBER_SIZE(struct_type, member) / JSON_MEMBER_SIZE(struct_type, member[0]), \
+    .count_offset = offsetof(struct_type, count_member), \
+    .count_size = JSON_MEMBER_SIZE(struct_type, count_member) }
+
+// Array elements
+#define JSON_ELEMENT_STRUCT(element_type, element_schema) \
+  { .type = JSON_FIELD_OBJECT, .size = sizeof(element_type), .schema = (element_schema) }
+#define JSON_ELEMENT_NUMBER(field_type, element_type, minimum, maximum) \
+  { .type = (field_type), .ranged = true, .size = sizeof(element_type), .min = (minimum), .max = (maximum) }
+
+/*!
+ * Decode a JSON object into the struct at out in one pass over its tokens, checking types and
+ * ranges on the way. Members the schema doesn't name are skipped, null ones are left alone.
+ * ESP_ERR_INVALID_ARG for bad JSON or a wrong type, ESP_ERR_INVALID_SIZE for a number out of
+ * range, a string too long or too many elements, ESP_ERR_NOT_FOUND for a missing required
+ * member. On an error out may be partly written, so decode into a copy where that matters.
+ * Tokens come from pool, or the heap for NULL.
+ */
+esp_err_t json_schema_decode(const json_schema_struct *schema, const char *json, size_t length,
+  json_tok_pool_t *pool, void *out);
+
+/*!
+ * The same, for the object at jctx->cur of a document already parsed
+ */
+esp_err_t json_schema_decode_tokens(const json_schema_struct *schema, const jparse_ctx_t *jctx, void *out);
+
+#endif /* JSON_SCHEMA_H */
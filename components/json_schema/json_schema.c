@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "json_parser.h"
+#include "json_schema.h"
+
+// Logger tag
+static const char *JSON_SCHEMA_TAG = "JSON schema";
+
+// Private functions
+static esp_err_t decode_object(const json_schema_struct *schema, const jparse_ctx_t *jctx, int *index,
+  uint8_t *out);
+static esp_err_t decode_value(const json_field_struct *field, const jparse_ctx_t *jctx, int *index,
+  uint8_t *at);
+static esp_err_t decode_number(const json_field_struct *field, const jparse_ctx_t *jctx, const json_tok_t *token,
+  uint8_t *at);
+static void store_unsigned(uint8_t *at, uint8_t size, uint64_t value);
+static void store_signed(uint8_t *at, uint8_t size, int64_t value);
+static bool token_is(const jparse_ctx_t *jctx, const json_tok_t *token, const char *text);
+static bool is_null(const jparse_ctx_t *jctx, const json_tok_t *token);
+static int skip(const jparse_ctx_t *jctx, int index);
+
+
+esp_err_t json_schema_decode(const json_schema_struct *schema, const char *json, size_t length,
+  json_tok_pool_t *pool, void *out)
+{
+  jparse_ctx_t jctx;
+  esp_err_t return_code = ESP_OK;
+  int parsed = (pool != NULL) ? json_parse_start_pool(&jctx, json, (int) length, pool) :
+                                json_parse_start(&jctx, json, (int) length);
+
+  if (parsed != OS_SUCCESS) {
+    ESP_LOGD(JSON_SCHEMA_TAG, "Not a JSON document");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  return_code = json_schema_decode_tokens(schema, &jctx, out);
+  json_parse_end(&jctx);
+
+  return return_code;
+}
+
+esp_err_t json_schema_decode_tokens(const json_schema_struct *schema, const jparse_ctx_t *jctx, void *out)
+{
+  int index = (int) (jctx->cur - jctx->tokens);
+
+  return decode_object(schema, jctx, &index, (uint8_t *) out);
+}
+
+/*!
+ * The object at token *index, leaving *index on the token after it. Each member name is matched
+ * against the schema's fields and its value decoded where it is, so the tokens are walked once.
+ */
+static esp_err_t decode_object(const json_schema_struct *schema, const jparse_ctx_t *jctx, int *index,
+  uint8_t *out)
+{
+  const json_tok_t *object = &jctx->tokens[*index];
+  uint32_t seen = 0;
+  esp_err_t return_code = ESP_OK;
+
+  if (schema->field_count > JSON_SCHEMA_MAX_FIELDS) {
+    // seen has a bit per field
+    ESP_LOGE(JSON_SCHEMA_TAG, "Schema has %d fields, at most %d are supported", (int) schema->field_count,
+      JSON_SCHEMA_MAX_FIELDS);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (object->type != JSMN_OBJECT) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  (*index)++;
+  for (int member = 0; member < object->size; member++) {
+    const json_tok_t *key = &jctx->tokens[*index];
+    const json_field_struct *field = NULL;
+    int length = key->end - key->start;
+
+    for (int i = 0; (i < schema->field_count) && (field == NULL); i++) {
+      if ((strncmp(jctx->js + key->start, schema->fields[i].name, length) == 0) &&
+          (schema->fields[i].name[length] == '\0')) {
+        field = &(schema->fields[i]);
+        seen |= 1UL << i;
+      }
+    }
+
+    (*index)++;
+    if ((field == NULL) || is_null(jctx, &jctx->tokens[*index])) {
+      if (field != NULL) {
+        seen &= ~(1UL << (field - schema->fields));
+      }
+      *index = skip(jctx, *index);
+      continue;
+    }
+
+    return_code = decode_value(field, jctx, index, out + field->offset);
+    if (return_code != ESP_OK) {
+      ESP_LOGD(JSON_SCHEMA_TAG, "\"%s\": %s", field->name, esp_err_to_name(return_code));
+      return return_code;
+    }
+  }
+
+  for (int i = 0; i < schema->field_count; i++) {
+    if (schema->fields[i].required && ((seen & (1UL << i)) == 0)) {
+      ESP_LOGD(JSON_SCHEMA_TAG, "\"%s\" missing", schema->fields[i].name);
+      return ESP_ERR_NOT_FOUND;
+    }
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t decode_value(const json_field_struct *field, const jparse_ctx_t *jctx, int *index,
+  uint8_t *at)
+{
+  const json_tok_t *token = &jctx->tokens[*index];
+  esp_err_t return_code = ESP_OK;
+
+  switch (field->type) {
+    case JSON_FIELD_OBJECT:
+      return decode_object(field->schema, jctx, index, at);
+
+    case JSON_FIELD_ARRAY:
+      if (token->type != JSMN_ARRAY) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      if (token->size > field->max_count) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      (*index)++;
+      for (int element = 0; element < token->size; element++) {
+        return_code = decode_value(field->element, jctx, index, at + (element * field->size));
+        if (return_code != ESP_OK) {
+          return return_code;
+        }
+      }
+      // The count goes in a member of the struct the array is in
+      store_unsigned(at - field->offset + field->count_offset, field->count_size, (uint64_t) token->size);
+      return ESP_OK;
+
+    case JSON_FIELD_STRING:
+      if (token->type != JSMN_STRING) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      if ((token->end - token->start) >= field->size) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      memcpy(at, jctx->js + token->start, token->end - token->start);
+      at[token->end - token->start] = '\0';
+      break;
+
+    case JSON_FIELD_BOOL:
+      if ((token->type == JSMN_PRIMITIVE) && token_is(jctx, token, "true")) {
+        *(bool *) at = true;
+      } else if ((token->type == JSMN_PRIMITIVE) && token_is(jctx, token, "false")) {
+        *(bool *) at = false;
+      } else {
+        return ESP_ERR_INVALID_ARG;
+      }
+      break;
+
+    default:
+      return_code = decode_number(field, jctx, token, at);
+      break;
+  }
+
+  (*index)++;
+
+  return return_code;
+}
+
+/*!
+ * Integers must be written as integers and fit the member as well as the range
+ */
+static esp_err_t decode_number(const json_field_struct *field, const jparse_ctx_t *jctx, const json_tok_t *token,
+  uint8_t *at)
+{
+  const char *start = jctx->js + token->start;
+  char *end = NULL;
+  long long integer = 0;
+  unsigned long long natural = 0;
+  double value = 0;
+  bool fits = true;
+
+  if ((token->type != JSMN_PRIMITIVE) || ((*start != '-') && ((*start < '0') || (*start > '9')))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  errno = 0;
+  switch (field->type) {
+    case JSON_FIELD_INT:
+      integer = strtoll(start, &end, 10);
+      value = (double) integer;
+      fits = (field->size >= sizeof(integer)) ||
+             ((integer >= -(1LL << (field->size * 8 - 1))) && (integer < (1LL << (field->size * 8 - 1))));
+      break;
+
+    case JSON_FIELD_UINT:
+      if (*start == '-') {
+        // strtoull() would wrap it
+        strtoll(start, &end, 10);
+        fits = false;
+        break;
+      }
+      natural = strtoull(start, &end, 10);
+      value = (double) natural;
+      fits = (field->size >= sizeof(natural)) || ((natural >> (field->size * 8)) == 0);
+      break;
+
+    default:
+      value = strtod(start, &end);
+      fits = isfinite(value);
+      break;
+  }
+
+  if (end != jctx->js + token->end) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!fits || (errno == ERANGE) || (field->ranged && ((value < field->min) || (value > field->max)))) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  if (field->type == JSON_FIELD_INT) {
+    store_signed(at, field->size, integer);
+  } else if (field->type == JSON_FIELD_UINT) {
+    store_unsigned(at, field->size, natural);
+  } else if (field->size == sizeof(double)) {
+    *(double *) at = value;
+  } else {
+    *(float *) at = (float) value;
+  }
+
+  return ESP_OK;
+}
+
+static void store_unsigned(uint8_t *at, uint8_t size, uint64_t value)
+{
+  switch (size) {
+    case 1: *(uint8_t *) at = (uint8_t) value; break;
+    case 2: *(uint16_t *) at = (uint16_t) value; break;
+    case 4: *(uint32_t *) at = (uint32_t) value; break;
+    default: *(uint64_t *) at = value; break;
+  }
+}
+
+static void store_signed(uint8_t *at, uint8_t size, int64_t value)
+{
+  switch (size) {
+    case 1: *(int8_t *) at = (int8_t) value; break;
+    case 2: *(int16_t *) at = (int16_t) value; break;
+    case 4: *(int32_t *) at = (int32_t) value; break;
+    default: *(int64_t *) at = value; break;
+  }
+}
+
+static bool token_is(const jparse_ctx_t *jctx, const json_tok_t *token, const char *text)
+{
+  size_t length = strlen(text);
+
+  return ((size_t) (token->end - token->start) == length) && (strncmp(jctx->js + token->start, text, length) == 0);
+}
+
+static bool is_null(const jparse_ctx_t *jctx, const json_tok_t *token)
+{
+  return (token->type == JSMN_PRIMITIVE) && token_is(jctx, token, "null");
+}
+
+/*!
+ * Token after the value at index and everything inside it
+ */
+static int skip(const jparse_ctx_t *jctx, int index)
+{
+  int end = jctx->tokens[index].end;
+
+  for (index++; (index < jctx->num_tokens) && (jctx->tokens[index].start < end); index++) {
+  }
+
+  return index;
+}
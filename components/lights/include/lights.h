@@ -2,7 +2,7 @@
 #define LIGHTS_H
 
 #include "esp_err.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
 
 typedef enum light_state {
   LIGHT_OFF = 0,
@@ -10,16 +10,15 @@ typedef enum light_state {
 } light_state_t;
 
 typedef struct Lights {
-  gpio_num_t    gpio_pin_num;
-  gpio_config_t fet_gpio_config;
+  platform_gpio_num_t gpio_pin_num;
 
-  light_state_t current_state;
+  light_state_t       current_state;
 
-  void          (*on)(void);
-  void          (*off)(void);
-  light_state_t (*get_state)(void);
+  void                (*on)(void);
+  void                (*off)(void);
+  light_state_t       (*get_state)(void);
 } Lights;
 
-esp_err_t lights_init(Lights* struct_ptr, gpio_num_t gpio_pin);
+esp_err_t lights_init(Lights* struct_ptr, platform_gpio_num_t gpio_pin);
 
 #endif /* LIGHTS_H */
\ No newline at end of file
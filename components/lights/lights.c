@@ -1,7 +1,8 @@
 #include <stdio.h>
 #include "esp_err.h"
 #include "esp_log.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
+#include "deferred_log.h"
 #include "lights.h"
 
 
@@ -18,7 +19,7 @@ static void _lights_on(void);
 static void _lights_off(void);
 static light_state_t _lights_get_state(void);
 
-esp_err_t lights_init(Lights* struct_ptr, gpio_num_t gpio_pin)
+esp_err_t lights_init(Lights* struct_ptr, platform_gpio_num_t gpio_pin)
 {
   esp_err_t return_code = ESP_OK;
 
@@ -29,18 +30,8 @@ esp_err_t lights_init(Lights* struct_ptr, gpio_num_t gpio_pin)
   self->off = _lights_off;
   self->get_state = _lights_get_state;
 
-  // Disable interrupt
-  self->fet_gpio_config.intr_type = GPIO_INTR_DISABLE;
-  // Set as output mode
-  self->fet_gpio_config.mode = GPIO_MODE_OUTPUT;
-  // Bit mask of the pin to be set
-  self->fet_gpio_config.pin_bit_mask = (((uint64_t)1) << ((uint64_t)gpio_pin));
-  // Disable pull-down mode
-  self->fet_gpio_config.pull_down_en = 0;
-  // Disable pull-up mode
-  self->fet_gpio_config.pull_up_en = 0;
-  // Configure GPIO with the given settings
-  return_code = gpio_config(&(self->fet_gpio_config));
+  // FET pin as an output, no pull-up/pull-down
+  return_code = platform_gpio_config_output(PLATFORM_GPIO_BIT(gpio_pin), false, false);
 
   if (return_code != ESP_OK) {
     ESP_LOGE(LIGHT_TAG, "Failed to configure Lights GPIO pin.");
@@ -54,18 +45,18 @@ esp_err_t lights_init(Lights* struct_ptr, gpio_num_t gpio_pin)
 
 static void _lights_on(void)
 {
-  gpio_set_level(self->gpio_pin_num, (uint32_t)LIGHT_ON);
+  platform_gpio_set_level(self->gpio_pin_num, (uint32_t)LIGHT_ON);
 
-  ESP_LOGI(LIGHT_TAG, "Lights on.");
+  DLOG(DLOG_LIGHTS_ON);
 
   self->current_state = LIGHT_ON;
 }
 
 static void _lights_off(void)
 {
-  gpio_set_level(self->gpio_pin_num, (uint32_t)LIGHT_OFF);
+  platform_gpio_set_level(self->gpio_pin_num, (uint32_t)LIGHT_OFF);
 
-  ESP_LOGI(LIGHT_TAG, "Lights off.");
+  DLOG(DLOG_LIGHTS_OFF);
 
   self->current_state = LIGHT_OFF;
 }
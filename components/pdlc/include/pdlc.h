@@ -2,7 +2,7 @@
 #define PDLC_H
 
 #include "esp_err.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
 
 #define TOGGLE_DELAY 500
 
@@ -12,16 +12,15 @@ typedef enum pdlc_state {
 } pdlc_state_t;
 
 typedef struct PDLC {
-  gpio_num_t    gpio_pin_num;
-  gpio_config_t fet_gpio_config;
+  platform_gpio_num_t gpio_pin_num;
 
-  pdlc_state_t  current_state;
+  pdlc_state_t        current_state;
 
-  void          (*on)(void);
-  void          (*off)(void);
-  pdlc_state_t  (*get_state)(void);
+  void                (*on)(void);
+  void                (*off)(void);
+  pdlc_state_t        (*get_state)(void);
 } PDLC;
 
-esp_err_t pdlc_init(PDLC* struct_ptr, gpio_num_t gpio_pin);
+esp_err_t pdlc_init(PDLC* struct_ptr, platform_gpio_num_t gpio_pin);
 
 #endif /* PDLC_H */
\ No newline at end of file
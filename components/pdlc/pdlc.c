@@ -2,7 +2,8 @@
 #include <unistd.h>
 #include "esp_err.h"
 #include "esp_log.h"
-#include "driver/gpio.h"
+#include "platform_gpio.h"
+#include "deferred_log.h"
 #include "pdlc.h"
 
 
@@ -19,7 +20,7 @@ static void _pdlc_on(void);
 static void _pdlc_off(void);
 static pdlc_state_t _pdlc_get_state(void);
 
-esp_err_t pdlc_init(PDLC* struct_ptr, gpio_num_t gpio_pin)
+esp_err_t pdlc_init(PDLC* struct_ptr, platform_gpio_num_t gpio_pin)
 {
   esp_err_t return_code = ESP_OK;
 
@@ -30,18 +31,8 @@ esp_err_t pdlc_init(PDLC* struct_ptr, gpio_num_t gpio_pin)
   self->off = _pdlc_off;
   self->get_state = _pdlc_get_state;
 
-  // Disable interrupt
-  self->fet_gpio_config.intr_type = GPIO_INTR_DISABLE;
-  // Set as output mode
-  self->fet_gpio_config.mode = GPIO_MODE_OUTPUT;
-  // Bit mask of the pin to be set
-  self->fet_gpio_config.pin_bit_mask = (((uint64_t)1) << ((uint64_t)gpio_pin));
-  // Disable pull-down mode
-  self->fet_gpio_config.pull_down_en = 1;
-  // Disable pull-up mode
-  self->fet_gpio_config.pull_up_en = 1;
-  // Configure GPIO with the given settings
-  return_code = gpio_config(&(self->fet_gpio_config));
+  // FET pin as an output, with pull-up and pull-down enabled
+  return_code = platform_gpio_config_output(PLATFORM_GPIO_BIT(gpio_pin), true, true);
 
   if (return_code != ESP_OK) {
     ESP_LOGE(PDLC_TAG, "Failed to configure PDLC GPIO pin.");
@@ -56,9 +47,9 @@ esp_err_t pdlc_init(PDLC* struct_ptr, gpio_num_t gpio_pin)
 static void _pdlc_on(void)
 {
   // Have to cycle through the modes
-  gpio_set_level(self->gpio_pin_num, (uint32_t)PDLC_ON);
+  platform_gpio_set_level(self->gpio_pin_num, (uint32_t)PDLC_ON);
 
-  ESP_LOGI(PDLC_TAG, "PDLC on.");
+  DLOG(DLOG_PDLC_ON);
 
   self->current_state = PDLC_ON;
 }
@@ -66,9 +57,9 @@ static void _pdlc_on(void)
 static void _pdlc_off(void)
 {
   // Have to cycle through the modes
-  gpio_set_level(self->gpio_pin_num, (uint32_t)PDLC_OFF);
+  platform_gpio_set_level(self->gpio_pin_num, (uint32_t)PDLC_OFF);
 
-  ESP_LOGI(PDLC_TAG, "PDLC off.");
+  DLOG(DLOG_PDLC_OFF);
 
   self->current_state = PDLC_OFF;
 }
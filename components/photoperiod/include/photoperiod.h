@@ -0,0 +1,52 @@
+#ifndef PHOTOPERIOD_H
+#define PHOTOPERIOD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+typedef enum photoperiod_mode {
+  PHOTOPERIOD_FIXED = 0,    // Same local clock hours every day
+  PHOTOPERIOD_SOLAR,        // Local sunrise to sunset
+  PHOTOPERIOD_DEMO          // A short window repeating on a short period, for the class demo
+} photoperiod_mode_t;
+
+typedef struct photoperiod_config {
+  photoperiod_mode_t  mode;
+
+  // PHOTOPERIOD_FIXED, local time
+  uint8_t             start_hour;
+  uint8_t             end_hour;
+
+  // PHOTOPERIOD_SOLAR, degrees, north and east positive
+  float               latitude;
+  float               longitude;
+
+  // PHOTOPERIOD_DEMO: on for demo_on_s at the start of every demo_period_s, counted from demo_anchor
+  time_t              demo_anchor;
+  uint32_t            demo_period_s;
+  uint32_t            demo_on_s;
+} photoperiod_config_struct;
+
+/* The on/off schedule is worked out as epoch times when a transition is due (a few
+ * times a day). In between, the per-sample check is a comparison against
+ * next_transition, plus one against valid_from in case the clock is stepped back. */
+typedef struct Photoperiod {
+  photoperiod_config_struct config;
+  bool      is_on;
+  time_t    valid_from;
+  time_t    next_transition;
+  time_t    on_time;          // Today's window, equal when there is none (e.g. polar night)
+  time_t    off_time;
+  time_t    midnight;         // Start and end of the local day the window belongs to
+  time_t    next_midnight;
+} Photoperiod;
+
+esp_err_t photoperiod_init(Photoperiod *photoperiod, const photoperiod_config_struct *config, time_t now);
+bool      photoperiod_update(Photoperiod *photoperiod, time_t now);
+float     photoperiod_get_hour(const Photoperiod *photoperiod, time_t now);
+esp_err_t photoperiod_solar_day(float latitude, float longitude, time_t local_noon, time_t *sunrise,
+            time_t *sunset);
+
+#endif /* PHOTOPERIOD_H */
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "photoperiod.h"
+
+#define SECONDS_PER_DAY       86400
+#define JULIAN_UNIX_EPOCH     2440587.5   // Julian date of 1970-01-01 00:00 UTC
+#define JULIAN_J2000          2451545.0
+#define SUN_ALTITUDE_DEG      -0.833      // Refraction and the sun's radius: sunrise is when the top edge shows
+#define EARTH_TILT_DEG        23.4397
+#define DEG_TO_RAD(deg)       ((deg) * M_PI / 180.0)
+#define RAD_TO_DEG(rad)       ((rad) * 180.0 / M_PI)
+
+// Private functions
+static void schedule(Photoperiod *photoperiod, time_t now);
+static void plan_day(Photoperiod *photoperiod, time_t now);
+static time_t local_time_of_day(time_t day, int hour);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t photoperiod_init(Photoperiod *photoperiod, const photoperiod_config_struct *config, time_t now)
+{
+  switch (config->mode) {
+    case PHOTOPERIOD_FIXED:
+      if ((config->start_hour > config->end_hour) || (config->end_hour > 24)) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      break;
+
+    case PHOTOPERIOD_SOLAR:
+      if (!(fabsf(config->latitude) <= 90.0f) || !(fabsf(config->longitude) <= 180.0f)) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      break;
+
+    case PHOTOPERIOD_DEMO:
+      if ((config->demo_period_s == 0) || (config->demo_on_s > config->demo_period_s)) {
+        return ESP_ERR_INVALID_ARG;
+      }
+      break;
+
+    default:
+      return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(photoperiod, 0, sizeof(Photoperiod));
+  photoperiod->config = *config;
+  schedule(photoperiod, now);
+
+  return ESP_OK;
+}
+
+/*!
+ * Whether the photoperiod is on at now. Only does real work when a transition is due.
+ */
+bool photoperiod_update(Photoperiod *photoperiod, time_t now)
+{
+  if ((now >= photoperiod->next_transition) || (now < photoperiod->valid_from)) {
+    schedule(photoperiod, now);
+  }
+
+  return photoperiod->is_on;
+}
+
+/*!
+ * Hours since local midnight, from the day worked out at the last transition. On the days
+ * the clocks change this is elapsed time, an hour off the wall clock after the change.
+ */
+float photoperiod_get_hour(const Photoperiod *photoperiod, time_t now)
+{
+  return (float)(now - photoperiod->midnight) / 3600.0f;
+}
+
+/*!
+ * Sunrise and sunset around local_noon, using the sunrise equation (within a minute or two
+ * away from the poles). With the sun up all day the window is the 24 h around solar noon;
+ * with it down all day, sunrise and sunset are both solar noon.
+ */
+esp_err_t photoperiod_solar_day(float latitude, float longitude, time_t local_noon, time_t *sunrise,
+  time_t *sunset)
+{
+  double day_number = 0;
+  double mean_noon = 0;
+  double anomaly = 0;
+  double center = 0;
+  double ecliptic_longitude = 0;
+  double transit = 0;
+  double sin_declination = 0;
+  double cos_declination = 0;
+  double cos_hour_angle = 0;
+  double hour_angle = 0;
+
+  if (!(fabsf(latitude) <= 90.0f) || !(fabsf(longitude) <= 180.0f)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Days since J2000 and mean solar noon at this longitude
+  day_number = round(((double) local_noon / SECONDS_PER_DAY) + JULIAN_UNIX_EPOCH - JULIAN_J2000);
+  mean_noon = day_number - (longitude / 360.0);
+
+  // Where the sun is on the ecliptic, and when it crosses the meridian
+  anomaly = fmod(357.5291 + (0.98560028 * mean_noon), 360.0);
+  center = (1.9148 * sin(DEG_TO_RAD(anomaly))) + (0.0200 * sin(DEG_TO_RAD(2 * anomaly))) +
+           (0.0003 * sin(DEG_TO_RAD(3 * anomaly)));
+  ecliptic_longitude = fmod(anomaly + center + 180.0 + 102.9372, 360.0);
+  transit = JULIAN_J2000 + mean_noon + (0.0053 * sin(DEG_TO_RAD(anomaly))) -
+            (0.0069 * sin(DEG_TO_RAD(2 * ecliptic_longitude)));
+
+  sin_declination = sin(DEG_TO_RAD(ecliptic_longitude)) * sin(DEG_TO_RAD(EARTH_TILT_DEG));
+  cos_declination = cos(asin(sin_declination));
+  cos_hour_angle = (sin(DEG_TO_RAD(SUN_ALTITUDE_DEG)) - (sin(DEG_TO_RAD(latitude)) * sin_declination)) /
+                   (cos(DEG_TO_RAD(latitude)) * cos_declination);
+
+  if (cos_hour_angle >= 1.0) {
+    hour_angle = 0;       // Polar night
+  } else if (cos_hour_angle <= -1.0) {
+    hour_angle = 180.0;   // Midnight sun
+  } else {
+    hour_angle = RAD_TO_DEG(acos(cos_hour_angle));
+  }
+
+  *sunrise = (time_t) llround((transit - (hour_angle / 360.0) - JULIAN_UNIX_EPOCH) * SECONDS_PER_DAY);
+  *sunset = (time_t) llround((transit + (hour_angle / 360.0) - JULIAN_UNIX_EPOCH) * SECONDS_PER_DAY);
+
+  return ESP_OK;
+}
+
+/*!
+ * Work out the state at now and when it next changes. A new local day always counts as a change.
+ */
+static void schedule(Photoperiod *photoperiod, time_t now)
+{
+  time_t window_start = 0;
+  time_t phase = 0;
+
+  if ((now >= photoperiod->next_midnight) || (now < photoperiod->midnight)) {
+    plan_day(photoperiod, now);
+  }
+
+  if (photoperiod->config.mode == PHOTOPERIOD_DEMO) {
+    // Seconds into the current demo period, also right before the anchor
+    phase = (now - photoperiod->config.demo_anchor) % (time_t) photoperiod->config.demo_period_s;
+    if (phase < 0) {
+      phase += photoperiod->config.demo_period_s;
+    }
+    window_start = now - phase;
+
+    photoperiod->is_on = (phase < (time_t) photoperiod->config.demo_on_s);
+    photoperiod->valid_from = photoperiod->is_on ? window_start : (window_start + photoperiod->config.demo_on_s);
+    photoperiod->next_transition = photoperiod->is_on ? (window_start + photoperiod->config.demo_on_s) :
+                                                        (window_start + photoperiod->config.demo_period_s);
+  } else if (now < photoperiod->on_time) {
+    photoperiod->is_on = false;
+    photoperiod->valid_from = photoperiod->midnight;
+    photoperiod->next_transition = photoperiod->on_time;
+  } else if (now < photoperiod->off_time) {
+    photoperiod->is_on = true;
+    photoperiod->valid_from = photoperiod->on_time;
+    photoperiod->next_transition = photoperiod->off_time;
+  } else {
+    photoperiod->is_on = false;
+    photoperiod->valid_from = photoperiod->off_time;
+    photoperiod->next_transition = photoperiod->next_midnight;
+  }
+
+  // Never carry a state over into the next day
+  if (photoperiod->valid_from < photoperiod->midnight) {
+    photoperiod->valid_from = photoperiod->midnight;
+  }
+  if (photoperiod->next_transition > photoperiod->next_midnight) {
+    photoperiod->next_transition = photoperiod->next_midnight;
+  }
+}
+
+/*!
+ * The local day now falls in, and its on/off window as epoch times
+ */
+static void plan_day(Photoperiod *photoperiod, time_t now)
+{
+  time_t sunrise = 0;
+  time_t sunset = 0;
+
+  photoperiod->midnight = local_time_of_day(now, 0);
+  photoperiod->next_midnight = local_time_of_day(now, 24);
+
+  switch (photoperiod->config.mode) {
+    case PHOTOPERIOD_FIXED:
+      photoperiod->on_time = local_time_of_day(now, photoperiod->config.start_hour);
+      photoperiod->off_time = local_time_of_day(now, photoperiod->config.end_hour);
+      break;
+
+    case PHOTOPERIOD_SOLAR:
+      photoperiod_solar_day(photoperiod->config.latitude, photoperiod->config.longitude,
+        local_time_of_day(now, 12), &sunrise, &sunset);
+      photoperiod->on_time = (sunrise > photoperiod->midnight) ? sunrise : photoperiod->midnight;
+      photoperiod->off_time = (sunset < photoperiod->next_midnight) ? sunset : photoperiod->next_midnight;
+      if (photoperiod->off_time < photoperiod->on_time) {
+        photoperiod->off_time = photoperiod->on_time;
+      }
+      break;
+
+    default:
+      photoperiod->on_time = photoperiod->midnight;
+      photoperiod->off_time = photoperiod->midnight;
+      break;
+  }
+}
+
+/*!
+ * Epoch time of hour:00 local on the day of day; hour 24 is the next midnight
+ */
+static time_t local_time_of_day(time_t day, int hour)
+{
+  struct tm info;
+
+  localtime_r(&day, &info);
+  info.tm_hour = hour;
+  info.tm_min = 0;
+  info.tm_sec = 0;
+  info.tm_isdst = -1;
+
+  return mktime(&info);
+}
@@ -0,0 +1,40 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum pid_action {
+  PID_ACTION_DIRECT = 0,  // Output rises while the measurement is below the setpoint (heating)
+  PID_ACTION_REVERSE      // Output rises while the measurement is above the setpoint (cooling)
+} pid_action_t;
+
+typedef struct pid_gains {
+  float kp;   // Output per unit of error
+  float ki;   // Output per unit of error per second
+  float kd;   // Output per unit of error per second of change
+} pid_gains_struct;
+
+typedef struct Pid_controller {
+  pid_gains_struct  gains;
+  pid_action_t      action;
+  float             output_min;
+  float             output_max;
+  float             slew_per_s;         // Largest output change per second, 0 for no limit
+
+  // The integral is kept in output units so gains can change without a bump
+  float             integral;
+  float             previous_measurement;
+  float             output;
+  bool              has_previous;
+} Pid_controller;
+
+esp_err_t pid_init(Pid_controller *pid, const pid_gains_struct *gains, pid_action_t action,
+  float output_min, float output_max, float slew_per_s);
+esp_err_t pid_check_gains(const pid_gains_struct *gains);
+esp_err_t pid_set_gains(Pid_controller *pid, const pid_gains_struct *gains);
+void      pid_reset(Pid_controller *pid);
+float     pid_update(Pid_controller *pid, float setpoint, float measurement, float dt_s);
+
+#endif /* PID_H */
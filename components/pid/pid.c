@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <math.h>
+#include "esp_err.h"
+#include "pid.h"
+
+// Private functions
+static float clamp(float value, float min, float max);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t pid_init(Pid_controller *pid, const pid_gains_struct *gains, pid_action_t action,
+  float output_min, float output_max, float slew_per_s)
+{
+  if ((output_min >= output_max) || (slew_per_s < 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pid->action = action;
+  pid->output_min = output_min;
+  pid->output_max = output_max;
+  pid->slew_per_s = slew_per_s;
+  pid_reset(pid);
+
+  return pid_set_gains(pid, gains);
+}
+
+/*!
+ * Gains have to be finite and not negative; a NaN would stick in the integral for good
+ */
+esp_err_t pid_check_gains(const pid_gains_struct *gains)
+{
+  if (!isfinite(gains->kp) || !isfinite(gains->ki) || !isfinite(gains->kd) ||
+      (gains->kp < 0) || (gains->ki < 0) || (gains->kd < 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t pid_set_gains(Pid_controller *pid, const pid_gains_struct *gains)
+{
+  esp_err_t return_code = pid_check_gains(gains);
+
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  pid->gains = *gains;
+
+  return ESP_OK;
+}
+
+void pid_reset(Pid_controller *pid)
+{
+  pid->integral = 0;
+  pid->previous_measurement = 0;
+  pid->output = pid->output_min;
+  pid->has_previous = false;
+}
+
+/*!
+ * One step of the loop. The derivative acts on the measurement so setpoint changes don't kick
+ * the output; the integral stops growing while the output is pinned by the limits or the slew
+ * rate (anti-windup). A step with no elapsed time holds the previous output.
+ */
+float pid_update(Pid_controller *pid, float setpoint, float measurement, float dt_s)
+{
+  float sign = (pid->action == PID_ACTION_REVERSE) ? -1.0f : 1.0f;
+  float error = sign * (setpoint - measurement);
+  float proportional = 0;
+  float derivative = 0;
+  float integral = 0;
+  float unlimited = 0;
+  float output = 0;
+
+  if (dt_s <= 0) {
+    return pid->output;
+  }
+
+  proportional = pid->gains.kp * error;
+  if (pid->has_previous) {
+    derivative = -sign * pid->gains.kd * ((measurement - pid->previous_measurement) / dt_s);
+  }
+  integral = pid->integral + (pid->gains.ki * error * dt_s);
+
+  unlimited = proportional + integral + derivative;
+  output = clamp(unlimited, pid->output_min, pid->output_max);
+  if (pid->slew_per_s > 0) {
+    output = clamp(output, pid->output - (pid->slew_per_s * dt_s), pid->output + (pid->slew_per_s * dt_s));
+  }
+
+  // Only keep the new integral if it isn't pushing further into a limit
+  if (!(((unlimited > output) && (error > 0)) || ((unlimited < output) && (error < 0)))) {
+    pid->integral = clamp(integral, pid->output_min, pid->output_max);
+  }
+
+  pid->previous_measurement = measurement;
+  pid->has_previous = true;
+  pid->output = output;
+
+  return output;
+}
+
+static float clamp(float value, float min, float max)
+{
+  return fminf(fmaxf(value, min), max);
+}
@@ -0,0 +1,26 @@
+#ifndef PLATFORM_ADC_H
+#define PLATFORM_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Same values as adc_atten_t
+typedef enum platform_adc_atten {
+  PLATFORM_ADC_ATTEN_DB_0   = 0,
+  PLATFORM_ADC_ATTEN_DB_2_5 = 1,
+  PLATFORM_ADC_ATTEN_DB_6   = 2,
+  PLATFORM_ADC_ATTEN_DB_11  = 3
+} platform_adc_atten_t;
+
+typedef struct platform_adc_channel *platform_adc_handle_t;
+
+/*!
+ * Set up a one-shot channel, 12 bit, with eFuse calibration. Returns ESP_ERR_NOT_SUPPORTED
+ * (with a usable handle) if the chip has no calibration data.
+ */
+esp_err_t platform_adc_init(int adc_unit, int adc_channel, platform_adc_atten_t atten,
+  platform_adc_handle_t *handle);
+esp_err_t platform_adc_read_calibrated(platform_adc_handle_t handle, int *millivolts);
+
+#endif /* PLATFORM_ADC_H */
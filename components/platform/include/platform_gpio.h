@@ -0,0 +1,15 @@
+#ifndef PLATFORM_GPIO_H
+#define PLATFORM_GPIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef int platform_gpio_num_t;
+
+#define PLATFORM_GPIO_BIT(pin) (((uint64_t)1) << ((uint64_t)(pin)))
+
+esp_err_t platform_gpio_config_output(uint64_t pin_bit_mask, bool pull_up, bool pull_down);
+esp_err_t platform_gpio_set_level(platform_gpio_num_t pin, uint32_t level);
+
+#endif /* PLATFORM_GPIO_H */
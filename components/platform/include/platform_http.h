@@ -0,0 +1,33 @@
+#ifndef PLATFORM_HTTP_H
+#define PLATFORM_HTTP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Called for each chunk of the response body
+typedef void (*platform_http_data_cb_t)(const char *data, int length, void *context);
+
+typedef struct platform_http_request {
+  const char              *url;
+  const char              *cert_pem;
+  const char              *content_type;
+  const char              *accept;          // Accept header, NULL to leave it out
+  const char              *body;
+  size_t                  body_length;
+  platform_http_data_cb_t on_data;
+  void                    *context;
+} platform_http_request_struct;
+
+esp_err_t platform_http_post(const platform_http_request_struct *request, int *status_code);
+
+/*!
+ * GET a response that stays open, like an event stream, following redirects. The body goes to
+ * on_data as it arrives until the server closes it (ESP_OK) or nothing comes for idle_timeout_ms
+ * (ESP_ERR_TIMEOUT). status_code is set once the headers are in; a status other than 200 ends
+ * the stream there.
+ */
+esp_err_t platform_http_stream(const platform_http_request_struct *request, uint32_t idle_timeout_ms,
+  int *status_code);
+
+#endif /* PLATFORM_HTTP_H */
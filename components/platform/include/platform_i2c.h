@@ -0,0 +1,17 @@
+#ifndef PLATFORM_I2C_H
+#define PLATFORM_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+typedef int platform_i2c_port_t;
+
+esp_err_t platform_i2c_master_init(platform_i2c_port_t port, int sda_gpio, int scl_gpio, uint32_t clk_speed_hz);
+esp_err_t platform_i2c_write(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, TickType_t timeout_ticks);
+esp_err_t platform_i2c_write_read(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, uint8_t *read_data, size_t read_length, TickType_t timeout_ticks);
+
+#endif /* PLATFORM_I2C_H */
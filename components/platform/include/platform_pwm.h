@@ -0,0 +1,20 @@
+#ifndef PLATFORM_PWM_H
+#define PLATFORM_PWM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "platform_gpio.h"
+
+// Duty cycles are given in permille
+#define PLATFORM_PWM_DUTY_MAX 1000
+
+typedef int platform_pwm_channel_t;
+
+/*!
+ * Route a PWM channel to a pin. All channels share one timer, so every channel
+ * runs at the frequency of the most recent init.
+ */
+esp_err_t platform_pwm_init(platform_pwm_channel_t channel, platform_gpio_num_t pin, uint32_t frequency_hz);
+esp_err_t platform_pwm_set_duty(platform_pwm_channel_t channel, uint32_t duty_permille);
+
+#endif /* PLATFORM_PWM_H */
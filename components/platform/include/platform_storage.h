@@ -0,0 +1,18 @@
+#ifndef PLATFORM_STORAGE_H
+#define PLATFORM_STORAGE_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+// Longest key the backends accept (NVS limit, without the terminator)
+#define PLATFORM_STORAGE_KEY_LENGTH 15
+
+/*!
+ * Small persistent blobs by key. A write replaces the whole blob or, on failure, leaves
+ * the old one in place. Reads return ESP_ERR_NOT_FOUND for a key that was never written.
+ * length is the buffer size going in and the blob size coming out.
+ */
+esp_err_t platform_storage_read(const char *key, void *data, size_t *length);
+esp_err_t platform_storage_write(const char *key, const void *data, size_t length);
+
+#endif /* PLATFORM_STORAGE_H */
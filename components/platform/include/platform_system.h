@@ -0,0 +1,13 @@
+#ifndef PLATFORM_SYSTEM_H
+#define PLATFORM_SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+esp_err_t platform_status_led_init(int gpio);
+void      platform_status_led_set(uint8_t red, uint8_t green, uint8_t blue, bool led_state);
+uint32_t  platform_random(void);
+void      platform_restart(void);
+
+#endif /* PLATFORM_SYSTEM_H */
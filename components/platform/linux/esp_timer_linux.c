@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define TIMER_TASK_STACK_SIZE 4096
+
+struct esp_timer {
+  esp_timer_cb_t    callback;
+  void              *arg;
+  const char        *name;
+  int64_t           alarm_us;
+  uint64_t          period_us;    // 0 for one-shot
+  bool              skip_unhandled_events;
+  bool              is_active;
+  struct esp_timer  *next;        // Active list, sorted by alarm time
+};
+
+static SemaphoreHandle_t  list_lock = NULL;
+static TaskHandle_t       timer_task_handle = NULL;
+static struct esp_timer   *active_list = NULL;
+static struct timespec    boot_time;
+
+// Logger tag
+static const char *TIMER_TAG = "esp_timer";
+
+// Private functions
+static esp_err_t timer_task_init(void);
+static void timer_task(void *arg);
+static void insert_timer(struct esp_timer *timer);
+static void remove_timer(struct esp_timer *timer);
+static esp_err_t start_timer(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us);
+
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+  struct esp_timer *timer = NULL;
+  esp_err_t return_code = ESP_OK;
+
+  if ((create_args == NULL) || (create_args->callback == NULL) || (out_handle == NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  return_code = timer_task_init();
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  timer = calloc(1, sizeof(struct esp_timer));
+  if (timer == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  timer->callback = create_args->callback;
+  timer->arg = create_args->arg;
+  timer->name = create_args->name;
+  timer->skip_unhandled_events = create_args->skip_unhandled_events;
+  *out_handle = timer;
+
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+  return start_timer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+  return start_timer(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  xSemaphoreTake(list_lock, portMAX_DELAY);
+  if (timer->is_active) {
+    remove_timer(timer);
+  } else {
+    return_code = ESP_ERR_INVALID_STATE;
+  }
+  xSemaphoreGive(list_lock);
+
+  return return_code;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (timer->is_active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  free(timer);
+
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+  return (timer != NULL) && timer->is_active;
+}
+
+/*!
+ * Microseconds since the first call, from the host's monotonic clock
+ */
+int64_t esp_timer_get_time(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if ((boot_time.tv_sec == 0) && (boot_time.tv_nsec == 0)) {
+    boot_time = now;
+  }
+
+  return ((int64_t)(now.tv_sec - boot_time.tv_sec) * 1000000) + ((now.tv_nsec - boot_time.tv_nsec) / 1000);
+}
+
+static esp_err_t start_timer(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (timer == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  xSemaphoreTake(list_lock, portMAX_DELAY);
+  if (timer->is_active) {
+    return_code = ESP_ERR_INVALID_STATE;
+  } else {
+    timer->alarm_us = esp_timer_get_time() + (int64_t) timeout_us;
+    timer->period_us = period_us;
+    insert_timer(timer);
+  }
+  xSemaphoreGive(list_lock);
+
+  // Let the timer task recompute how long to sleep
+  if (return_code == ESP_OK) {
+    xTaskNotifyGive(timer_task_handle);
+  }
+
+  return return_code;
+}
+
+static esp_err_t timer_task_init(void)
+{
+  esp_err_t return_code = ESP_OK;
+
+  // First caller creates the lock; creation has to be atomic with respect to other tasks
+  vTaskSuspendAll();
+  if (list_lock == NULL) {
+    list_lock = xSemaphoreCreateMutex();
+  }
+  xTaskResumeAll();
+
+  if (list_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  xSemaphoreTake(list_lock, portMAX_DELAY);
+  if (timer_task_handle == NULL) {
+    esp_timer_get_time();
+    // Highest priority, like the real esp_timer task
+    if (xTaskCreate(timer_task, "esp_timer", TIMER_TASK_STACK_SIZE, NULL, configMAX_PRIORITIES - 1,
+          &timer_task_handle) != pdPASS) {
+      ESP_LOGE(TIMER_TAG, "Failed to create the timer task.");
+      return_code = ESP_ERR_NO_MEM;
+    }
+  }
+  xSemaphoreGive(list_lock);
+
+  return return_code;
+}
+
+/*!
+ * Fire expired timers in alarm order, then sleep until the next one is due
+ */
+static void timer_task(void *arg)
+{
+  struct esp_timer *timer = NULL;
+  TickType_t wait_ticks = portMAX_DELAY;
+  int64_t now = 0;
+
+  while (1) {
+    xSemaphoreTake(list_lock, portMAX_DELAY);
+    now = esp_timer_get_time();
+    timer = active_list;
+
+    if ((timer != NULL) && (timer->alarm_us <= now)) {
+      remove_timer(timer);
+      if (timer->period_us != 0) {
+        timer->alarm_us += (int64_t) timer->period_us;
+        if (timer->skip_unhandled_events && (timer->alarm_us <= now)) {
+          timer->alarm_us = now + (int64_t) timer->period_us;
+        }
+        insert_timer(timer);
+      }
+      xSemaphoreGive(list_lock);
+
+      // Run the callback unlocked, it may restart its own timer
+      timer->callback(timer->arg);
+      continue;
+    }
+
+    // Round up so we never wake before the alarm
+    wait_ticks = (timer == NULL) ? portMAX_DELAY :
+                 (TickType_t)(((timer->alarm_us - now) + (portTICK_PERIOD_MS * 1000) - 1) /
+                              (portTICK_PERIOD_MS * 1000));
+    xSemaphoreGive(list_lock);
+
+    ulTaskNotifyTake(pdTRUE, wait_ticks);
+  }
+}
+
+static void insert_timer(struct esp_timer *timer)
+{
+  struct esp_timer **link = &active_list;
+
+  while ((*link != NULL) && ((*link)->alarm_us <= timer->alarm_us)) {
+    link = &((*link)->next);
+  }
+
+  timer->next = *link;
+  *link = timer;
+  timer->is_active = true;
+}
+
+static void remove_timer(struct esp_timer *timer)
+{
+  struct esp_timer **link = &active_list;
+
+  while ((*link != NULL) && (*link != timer)) {
+    link = &((*link)->next);
+  }
+
+  if (*link == timer) {
+    *link = timer->next;
+  }
+  timer->next = NULL;
+  timer->is_active = false;
+}
@@ -0,0 +1,79 @@
+#ifndef PLATFORM_SIM_H
+#define PLATFORM_SIM_H
+
+/* Host (linux target) side of the platform layer: the simulated greenhouse the
+ * sensor models read from, and hooks for inspecting what the firmware drove. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "platform_gpio.h"
+
+#define SIM_GPIO_COUNT        64
+#define SIM_GPIO_EVENT_COUNT  256
+
+// What the simulated sensors report
+typedef struct sim_environment {
+  double temperature_c;
+  double humidity_pct;
+  double pressure_pa;
+  double uv_a;              // uW/cm^2
+  double uv_b;              // uW/cm^2
+  double uv_c;              // uW/cm^2
+  double soil_wetness_pct;
+} sim_environment_struct;
+
+typedef struct sim_world_config {
+  platform_gpio_num_t fan_gpio;     // -1 if not connected
+  platform_gpio_num_t lights_gpio;
+  platform_gpio_num_t pdlc_gpio;
+  int                 soil_adc_unit;
+  int                 soil_adc_channel;
+  uint32_t            time_scale;   // Simulated seconds per real second
+  uint32_t            start_hour;   // Time of day the simulation starts at
+} sim_world_config_struct;
+
+// A device on the simulated I2C bus. Writes set the register pointer from the first byte.
+typedef struct sim_i2c_device {
+  uint8_t   address;
+  esp_err_t (*write)(const uint8_t *data, size_t length);
+  esp_err_t (*read)(uint8_t *data, size_t length);
+} sim_i2c_device_struct;
+
+typedef struct sim_gpio_event {
+  int64_t             time_us;
+  platform_gpio_num_t pin;
+  uint32_t            level;
+  uint32_t            duty_permille;
+} sim_gpio_event_struct;
+
+typedef struct sim_net_stats {
+  uint32_t requests;
+  uint64_t bytes;
+  uint32_t last_length;
+} sim_net_stats_struct;
+
+// Greenhouse model
+void      sim_world_init(const sim_world_config_struct *config);
+void      sim_world_get_environment(sim_environment_struct *environment);
+int       sim_world_soil_probe_mv(void);
+
+// Register-level sensor models
+extern const sim_i2c_device_struct sim_bme280;
+extern const sim_i2c_device_struct sim_as7331;
+
+// Fake ADC -- a channel with no source reads 0 mV
+esp_err_t sim_adc_attach(int adc_unit, int adc_channel, int (*read_mv)(void));
+
+// Recorded GPIO
+uint32_t  sim_gpio_get_level(platform_gpio_num_t pin);
+uint32_t  sim_gpio_get_duty(platform_gpio_num_t pin);
+uint32_t  sim_gpio_get_transitions(platform_gpio_num_t pin);
+size_t    sim_gpio_get_events(sim_gpio_event_struct *events, size_t max_events);
+
+// Loopback network
+sim_net_stats_struct sim_net_get_stats(void);
+size_t    sim_net_get_last_body(char *buffer, size_t buffer_length);
+
+#endif /* PLATFORM_SIM_H */
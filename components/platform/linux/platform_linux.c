@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "platform_gpio.h"
+#include "platform_i2c.h"
+#include "platform_pwm.h"
+#include "platform_adc.h"
+#include "platform_http.h"
+#include "platform_storage.h"
+#include "platform_system.h"
+#include "platform_sim.h"
+
+#define MAX_ADC_CHANNELS    4
+#define MAX_PWM_CHANNELS    8
+#define NET_BODY_LENGTH     4096
+#define NET_RESPONSE_LENGTH 32
+#define NET_STREAM_CHUNK    512
+#define NET_STREAM_POLL_MS  20
+#define STORAGE_PATH_LENGTH 256
+
+struct platform_adc_channel {
+  int adc_unit;
+  int adc_channel;
+  int (*read_mv)(void);
+};
+
+// Board wiring: the devices on the simulated I2C bus
+static const sim_i2c_device_struct *i2c_devices[] = {
+  &sim_bme280,
+  &sim_as7331
+};
+static bool i2c_is_initialized = false;
+
+// Recorded GPIO
+static uint32_t               gpio_levels[SIM_GPIO_COUNT];
+static uint32_t               gpio_duties[SIM_GPIO_COUNT];   // Permille, 0/1000 for plain outputs
+static uint32_t               gpio_transitions[SIM_GPIO_COUNT];
+static uint64_t               gpio_output_mask = 0;
+static sim_gpio_event_struct  gpio_events[SIM_GPIO_EVENT_COUNT];
+static uint32_t               gpio_event_count = 0;
+static FILE                   *gpio_trace_file = NULL;
+
+// PWM channel -> pin
+static platform_gpio_num_t    pwm_pins[MAX_PWM_CHANNELS] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+// Fake ADC
+static struct platform_adc_channel adc_channels[MAX_ADC_CHANNELS];
+static int adc_channel_count = 0;
+
+// Loopback network
+static sim_net_stats_struct   net_stats;
+static char                   net_last_body[NET_BODY_LENGTH];
+static FILE                   *net_uplink_file = NULL;
+
+// Logger tag
+static const char *PLATFORM_TAG = "Platform sim";
+
+// Private functions
+static const sim_i2c_device_struct *find_i2c_device(uint8_t device_addr);
+static FILE *open_trace_file(const char *variable);
+static esp_err_t record_output(platform_gpio_num_t pin, uint32_t duty_permille);
+static esp_err_t storage_path(const char *key, const char *suffix, char *path, size_t path_length);
+
+
+//
+// GPIO
+
+esp_err_t platform_gpio_config_output(uint64_t pin_bit_mask, bool pull_up, bool pull_down)
+{
+  gpio_output_mask |= pin_bit_mask;
+
+  // Optional CSV of every output transition, for plotting a run
+  if (gpio_trace_file == NULL) {
+    gpio_trace_file = open_trace_file("SIM_GPIO_TRACE");
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t platform_gpio_set_level(platform_gpio_num_t pin, uint32_t level)
+{
+  return record_output(pin, (level != 0) ? PLATFORM_PWM_DUTY_MAX : 0);
+}
+
+uint32_t sim_gpio_get_level(platform_gpio_num_t pin)
+{
+  return ((pin < 0) || (pin >= SIM_GPIO_COUNT)) ? 0 : gpio_levels[pin];
+}
+
+uint32_t sim_gpio_get_duty(platform_gpio_num_t pin)
+{
+  return ((pin < 0) || (pin >= SIM_GPIO_COUNT)) ? 0 : gpio_duties[pin];
+}
+
+uint32_t sim_gpio_get_transitions(platform_gpio_num_t pin)
+{
+  return ((pin < 0) || (pin >= SIM_GPIO_COUNT)) ? 0 : gpio_transitions[pin];
+}
+
+/*!
+ * Copy out the most recent level changes, oldest first
+ */
+size_t sim_gpio_get_events(sim_gpio_event_struct *events, size_t max_events)
+{
+  size_t count = 0;
+  uint32_t first = 0;
+
+  vTaskSuspendAll();
+  count = (gpio_event_count < SIM_GPIO_EVENT_COUNT) ? gpio_event_count : SIM_GPIO_EVENT_COUNT;
+  count = (count < max_events) ? count : max_events;
+  first = gpio_event_count - count;
+  for (size_t i = 0; i < count; i++) {
+    events[i] = gpio_events[(first + i) % SIM_GPIO_EVENT_COUNT];
+  }
+  xTaskResumeAll();
+
+  return count;
+}
+
+
+//
+// PWM -- recorded as a duty cycle on the pin
+
+esp_err_t platform_pwm_init(platform_pwm_channel_t channel, platform_gpio_num_t pin, uint32_t frequency_hz)
+{
+  if ((channel < 0) || (channel >= MAX_PWM_CHANNELS) || (pin < 0) || (pin >= SIM_GPIO_COUNT)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pwm_pins[channel] = pin;
+  platform_gpio_config_output(PLATFORM_GPIO_BIT(pin), false, false);
+
+  return record_output(pin, 0);
+}
+
+esp_err_t platform_pwm_set_duty(platform_pwm_channel_t channel, uint32_t duty_permille)
+{
+  if ((channel < 0) || (channel >= MAX_PWM_CHANNELS) || (pwm_pins[channel] < 0)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  return record_output(pwm_pins[channel], (duty_permille > PLATFORM_PWM_DUTY_MAX) ? PLATFORM_PWM_DUTY_MAX :
+                                                                                     duty_permille);
+}
+
+
+//
+// I2C
+
+esp_err_t platform_i2c_master_init(platform_i2c_port_t port, int sda_gpio, int scl_gpio, uint32_t clk_speed_hz)
+{
+  i2c_is_initialized = true;
+  ESP_LOGI(PLATFORM_TAG, "Simulated I2C bus %d with %d devices", port,
+    (int)(sizeof(i2c_devices) / sizeof(i2c_devices[0])));
+
+  return ESP_OK;
+}
+
+esp_err_t platform_i2c_write(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, TickType_t timeout_ticks)
+{
+  const sim_i2c_device_struct *device = find_i2c_device(device_addr);
+
+  if (!i2c_is_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // No device at this address, nobody ACKs
+  if (device == NULL) {
+    return ESP_FAIL;
+  }
+
+  return device->write(write_data, write_length);
+}
+
+esp_err_t platform_i2c_write_read(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, uint8_t *read_data, size_t read_length, TickType_t timeout_ticks)
+{
+  esp_err_t return_code = platform_i2c_write(port, device_addr, write_data, write_length, timeout_ticks);
+
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return find_i2c_device(device_addr)->read(read_data, read_length);
+}
+
+static const sim_i2c_device_struct *find_i2c_device(uint8_t device_addr)
+{
+  for (size_t i = 0; i < (sizeof(i2c_devices) / sizeof(i2c_devices[0])); i++) {
+    if (i2c_devices[i]->address == device_addr) {
+      return i2c_devices[i];
+    }
+  }
+
+  return NULL;
+}
+
+
+//
+// ADC
+
+esp_err_t platform_adc_init(int adc_unit, int adc_channel, platform_adc_atten_t atten,
+  platform_adc_handle_t *handle)
+{
+  struct platform_adc_channel *channel = NULL;
+
+  // Re-use a channel a source was attached to before init
+  for (int i = 0; i < adc_channel_count; i++) {
+    if ((adc_channels[i].adc_unit == adc_unit) && (adc_channels[i].adc_channel == adc_channel)) {
+      *handle = &(adc_channels[i]);
+      return ESP_OK;
+    }
+  }
+
+  if (adc_channel_count >= MAX_ADC_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  channel = &(adc_channels[adc_channel_count++]);
+  channel->adc_unit = adc_unit;
+  channel->adc_channel = adc_channel;
+  channel->read_mv = NULL;
+  *handle = channel;
+
+  return ESP_OK;
+}
+
+esp_err_t platform_adc_read_calibrated(platform_adc_handle_t handle, int *millivolts)
+{
+  *millivolts = (handle->read_mv != NULL) ? handle->read_mv() : 0;
+
+  return ESP_OK;
+}
+
+esp_err_t sim_adc_attach(int adc_unit, int adc_channel, int (*read_mv)(void))
+{
+  platform_adc_handle_t handle = NULL;
+  esp_err_t return_code = platform_adc_init(adc_unit, adc_channel, PLATFORM_ADC_ATTEN_DB_11, &handle);
+
+  if (return_code == ESP_OK) {
+    handle->read_mv = read_mv;
+  }
+
+  return return_code;
+}
+
+
+//
+// HTTP -- loopback, answers every POST the way the Realtime Database does, streams from a file
+
+esp_err_t platform_http_post(const platform_http_request_struct *request, int *status_code)
+{
+  char response[NET_RESPONSE_LENGTH];
+  size_t copy_length = 0;
+  int response_length = 0;
+
+  if ((request == NULL) || (request->body == NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (net_uplink_file == NULL) {
+    net_uplink_file = open_trace_file("SIM_UPLINK_FILE");
+  }
+
+  if (CONFIG_SIM_NET_LATENCY_MS > 0) {
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_SIM_NET_LATENCY_MS));
+  }
+
+  copy_length = (request->body_length < (NET_BODY_LENGTH - 1)) ? request->body_length : (NET_BODY_LENGTH - 1);
+  memcpy(net_last_body, request->body, copy_length);
+  net_last_body[copy_length] = '\0';
+  net_stats.requests++;
+  net_stats.bytes += request->body_length;
+  net_stats.last_length = (uint32_t) request->body_length;
+
+  if (net_uplink_file != NULL) {
+    fwrite(request->body, 1, request->body_length, net_uplink_file);
+    fputc('\n', net_uplink_file);
+    fflush(net_uplink_file);
+  }
+
+  response_length = snprintf(response, sizeof(response), "{\"name\":\"-Sim%08lu\"}",
+                      (unsigned long) net_stats.requests);
+  if (request->on_data != NULL) {
+    request->on_data(response, response_length, request->context);
+  }
+
+  if (status_code != NULL) {
+    *status_code = 200;
+  }
+
+  return ESP_OK;
+}
+
+/*!
+ * The event stream is whatever is written to the file named by SIM_DOWNLINK_FILE. A FIFO works
+ * as a live stream; a plain file is sent again from the start on every connection, the way
+ * Firebase first sends the current value. Without it the stream stays open and idle.
+ */
+esp_err_t platform_http_stream(const platform_http_request_struct *request, uint32_t idle_timeout_ms,
+  int *status_code)
+{
+  const char *path = getenv("SIM_DOWNLINK_FILE");
+  char buffer[NET_STREAM_CHUNK];
+  uint32_t idle_ms = 0;
+  ssize_t length = 0;
+  int fd = -1;
+
+  if (request == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (CONFIG_SIM_NET_LATENCY_MS > 0) {
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_SIM_NET_LATENCY_MS));
+  }
+
+  if (path != NULL) {
+    // Non-blocking, a read must not hold up the other tasks' threads
+    fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+      ESP_LOGE(PLATFORM_TAG, "Could not open %s (SIM_DOWNLINK_FILE).", path);
+      return ESP_FAIL;
+    }
+  }
+
+  if (status_code != NULL) {
+    *status_code = 200;
+  }
+
+  while (idle_ms < idle_timeout_ms) {
+    length = (fd >= 0) ? read(fd, buffer, sizeof(buffer)) : 0;
+    if (length > 0) {
+      idle_ms = 0;
+      if (request->on_data != NULL) {
+        request->on_data(buffer, (int) length, request->context);
+      }
+      continue;
+    }
+    if ((length < 0) && (errno != EAGAIN)) {
+      close(fd);
+      return ESP_FAIL;
+    }
+
+    // End of the file, or nothing written to the FIFO yet
+    vTaskDelay(pdMS_TO_TICKS(NET_STREAM_POLL_MS));
+    idle_ms += NET_STREAM_POLL_MS;
+  }
+
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  return ESP_ERR_TIMEOUT;
+}
+
+sim_net_stats_struct sim_net_get_stats(void)
+{
+  return net_stats;
+}
+
+size_t sim_net_get_last_body(char *buffer, size_t buffer_length)
+{
+  size_t length = strlen(net_last_body);
+
+  if (buffer_length == 0) {
+    return 0;
+  }
+
+  length = (length < (buffer_length - 1)) ? length : (buffer_length - 1);
+  memcpy(buffer, net_last_body, length);
+  buffer[length] = '\0';
+
+  return length;
+}
+
+
+//
+// Storage -- one file per key under $SIM_STORAGE_DIR (default: the working directory)
+
+esp_err_t platform_storage_read(const char *key, void *data, size_t *length)
+{
+  char path[STORAGE_PATH_LENGTH];
+  FILE *file = NULL;
+  long file_length = 0;
+  esp_err_t return_code = ESP_OK;
+
+  return_code = storage_path(key, "", path, sizeof(path));
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  fseek(file, 0, SEEK_END);
+  file_length = ftell(file);
+  rewind(file);
+
+  if ((file_length < 0) || ((size_t) file_length > *length)) {
+    return_code = ESP_ERR_INVALID_SIZE;
+  } else if (fread(data, 1, (size_t) file_length, file) != (size_t) file_length) {
+    return_code = ESP_FAIL;
+  } else {
+    *length = (size_t) file_length;
+  }
+  fclose(file);
+
+  return return_code;
+}
+
+esp_err_t platform_storage_write(const char *key, const void *data, size_t length)
+{
+  char path[STORAGE_PATH_LENGTH];
+  char temporary_path[STORAGE_PATH_LENGTH];
+  FILE *file = NULL;
+  bool written = false;
+  esp_err_t return_code = ESP_OK;
+
+  return_code = storage_path(key, "", path, sizeof(path));
+  if (return_code == ESP_OK) {
+    return_code = storage_path(key, ".tmp", temporary_path, sizeof(temporary_path));
+  }
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  // Write aside and rename over the old file, so a failed write leaves the old blob
+  file = fopen(temporary_path, "wb");
+  if (file == NULL) {
+    ESP_LOGE(PLATFORM_TAG, "Could not open %s.", temporary_path);
+    return ESP_FAIL;
+  }
+  written = (fwrite(data, 1, length, file) == length);
+  written = (fclose(file) == 0) && written;
+
+  if (!written || (rename(temporary_path, path) != 0)) {
+    ESP_LOGE(PLATFORM_TAG, "Failed to store %s.", path);
+    remove(temporary_path);
+    return ESP_FAIL;
+  }
+
+  return ESP_OK;
+}
+
+
+//
+// System
+
+esp_err_t platform_status_led_init(int gpio)
+{
+  return ESP_OK;
+}
+
+void platform_status_led_set(uint8_t red, uint8_t green, uint8_t blue, bool led_state)
+{
+}
+
+uint32_t platform_random(void)
+{
+  return (uint32_t) random();
+}
+
+void platform_restart(void)
+{
+  ESP_LOGE(PLATFORM_TAG, "Restart requested, exiting.");
+  exit(EXIT_FAILURE);
+}
+
+static FILE *open_trace_file(const char *variable)
+{
+  const char *path = getenv(variable);
+  FILE *file = NULL;
+
+  if (path == NULL) {
+    return NULL;
+  }
+
+  file = fopen(path, "w");
+  if (file == NULL) {
+    ESP_LOGE(PLATFORM_TAG, "Could not open %s (%s).", path, variable);
+  }
+
+  return file;
+}
+
+/*!
+ * Level changes count as transitions; duty changes on a PWM pin that stays on only update the duty
+ */
+static esp_err_t record_output(platform_gpio_num_t pin, uint32_t duty_permille)
+{
+  sim_gpio_event_struct *event = NULL;
+  uint32_t level = (duty_permille != 0);
+
+  if ((pin < 0) || (pin >= SIM_GPIO_COUNT) || !(gpio_output_mask & PLATFORM_GPIO_BIT(pin))) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  vTaskSuspendAll();
+  if (gpio_levels[pin] != level) {
+    gpio_transitions[pin]++;
+  }
+  gpio_levels[pin] = level;
+  gpio_duties[pin] = duty_permille;
+
+  event = &(gpio_events[gpio_event_count % SIM_GPIO_EVENT_COUNT]);
+  event->time_us = esp_timer_get_time();
+  event->pin = pin;
+  event->level = level;
+  event->duty_permille = duty_permille;
+  gpio_event_count++;
+  xTaskResumeAll();
+
+  if (gpio_trace_file != NULL) {
+    fprintf(gpio_trace_file, "%lld,%d,%u,%u\n", (long long) event->time_us, pin, (unsigned) level,
+      (unsigned) duty_permille);
+    fflush(gpio_trace_file);
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t storage_path(const char *key, const char *suffix, char *path, size_t path_length)
+{
+  const char *directory = getenv("SIM_STORAGE_DIR");
+  int length = 0;
+
+  if ((key == NULL) || (key[0] == '\0') || (strlen(key) > PLATFORM_STORAGE_KEY_LENGTH) || (strchr(key, '/') != NULL)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  length = snprintf(path, path_length, "%s/%s.nvs%s", (directory != NULL) ? directory : ".", key, suffix);
+  if ((length < 0) || ((size_t) length >= path_length)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  return ESP_OK;
+}
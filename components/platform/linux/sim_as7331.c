@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "platform_sim.h"
+
+/* AS7331 register map. The part has two register banks: configuration state (OSR,
+ * AGEN, CREG1..3) and measurement state, where register 0 reads back OSR then STATUS
+ * and the results are 16 bit, LSB first. Setting SS in measurement state latches the
+ * current UV irradiance as counts, using the same LSB sizes the driver converts with. */
+
+#define AS7331_SIM_ADDRESS      0x74
+
+#define REG_OSR                 0x00
+#define REG_AGEN                0x02
+#define REG_CREG1               0x06
+#define REG_CREG2               0x07
+#define REG_CREG3               0x08
+#define CONFIG_REGISTER_COUNT   0x0C
+#define MEASUREMENT_BYTE_COUNT  14      // OSR/STATUS, TEMP, MRES1..3, OUTCONVL/H
+
+#define OSR_SS                  0x80
+#define OSR_SW_RES              0x08
+#define OSR_DOS_MASK            0x07
+#define OSR_DOS_CONFIG          0x02
+#define OSR_DOS_MEASUREMENT     0x03
+#define AGEN_DEFAULT            0x21
+#define STATUS_ADCOF            (1 << 5)
+
+// nW/cm^2 per count
+#define LSB_A                   20.75
+#define LSB_B                   23.07
+#define LSB_C                   10.13
+
+static uint8_t config_registers[CONFIG_REGISTER_COUNT];
+static uint8_t measurement_bytes[MEASUREMENT_BYTE_COUNT];
+static uint8_t register_pointer = 0;
+static bool    is_measurement_state = false;
+static bool    is_reset = false;
+
+// Private functions
+static esp_err_t as7331_write(const uint8_t *data, size_t length);
+static esp_err_t as7331_read(uint8_t *data, size_t length);
+static void reset(void);
+static void write_osr(uint8_t value);
+static void latch_measurement(void);
+static uint16_t to_counts(double irradiance, double lsb, uint8_t *status);
+
+const sim_i2c_device_struct sim_as7331 = {
+  .address = AS7331_SIM_ADDRESS,
+  .write = as7331_write,
+  .read = as7331_read
+};
+
+
+static esp_err_t as7331_write(const uint8_t *data, size_t length)
+{
+  if (!is_reset) {
+    reset();
+  }
+
+  if (length == 0) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  register_pointer = data[0];
+
+  for (size_t i = 1; i < length; i++, register_pointer++) {
+    uint8_t value = data[i];
+
+    if (register_pointer == REG_OSR) {
+      write_osr(value);
+    } else if ((register_pointer == REG_AGEN) && (value & OSR_SW_RES)) {
+      // The firmware resets through AGEN; treat it like OSR.SW_RES
+      reset();
+    } else if (!is_measurement_state && (register_pointer >= REG_CREG1) &&
+               (register_pointer < CONFIG_REGISTER_COUNT)) {
+      config_registers[register_pointer] = value;
+    }
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t as7331_read(uint8_t *data, size_t length)
+{
+  size_t offset = 0;
+
+  if (!is_reset) {
+    reset();
+  }
+
+  if (!is_measurement_state) {
+    for (size_t i = 0; i < length; i++) {
+      offset = register_pointer + i;
+      data[i] = (offset < CONFIG_REGISTER_COUNT) ? config_registers[offset] : 0;
+    }
+    return ESP_OK;
+  }
+
+  // Measurement registers are two bytes wide
+  for (size_t i = 0; i < length; i++) {
+    offset = (register_pointer * 2) + i;
+    data[i] = (offset < MEASUREMENT_BYTE_COUNT) ? measurement_bytes[offset] : 0;
+  }
+
+  return ESP_OK;
+}
+
+static void reset(void)
+{
+  memset(config_registers, 0, sizeof(config_registers));
+  memset(measurement_bytes, 0, sizeof(measurement_bytes));
+
+  config_registers[REG_OSR] = OSR_DOS_CONFIG;
+  config_registers[REG_AGEN] = AGEN_DEFAULT;
+  is_measurement_state = false;
+  is_reset = true;
+}
+
+static void write_osr(uint8_t value)
+{
+  if (value & OSR_SW_RES) {
+    reset();
+    return;
+  }
+
+  is_measurement_state = ((value & OSR_DOS_MASK) == OSR_DOS_MEASUREMENT);
+
+  // Conversions complete instantly, so SS always reads back clear
+  config_registers[REG_OSR] = value & ~OSR_SS;
+  measurement_bytes[0] = config_registers[REG_OSR];
+
+  if (is_measurement_state && (value & OSR_SS)) {
+    latch_measurement();
+  }
+}
+
+static void latch_measurement(void)
+{
+  sim_environment_struct environment;
+  uint8_t status = 0;
+  uint16_t counts[3];
+
+  sim_world_get_environment(&environment);
+
+  counts[0] = to_counts(environment.uv_a, LSB_A, &status);
+  counts[1] = to_counts(environment.uv_b, LSB_B, &status);
+  counts[2] = to_counts(environment.uv_c, LSB_C, &status);
+
+  measurement_bytes[1] = status;
+  for (int i = 0; i < 3; i++) {
+    measurement_bytes[4 + (i * 2)] = (uint8_t)(counts[i] & 0xFF);
+    measurement_bytes[5 + (i * 2)] = (uint8_t)(counts[i] >> 8);
+  }
+}
+
+static uint16_t to_counts(double irradiance, double lsb, uint8_t *status)
+{
+  double counts = (irradiance * 1000.0) / lsb;
+
+  if (counts <= 0) {
+    return 0;
+  }
+
+  if (counts > 65535.0) {
+    *status |= STATUS_ADCOF;
+    return 65535;
+  }
+
+  return (uint16_t)(counts + 0.5);
+}
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "platform_sim.h"
+
+/* BME280 register map. A forced-mode measurement latches the current environment,
+ * converted to raw ADC values by inverting the Bosch compensation formulas against
+ * the calibration data below (the datasheet's example part), so the driver's
+ * compensation gives back what the model reported. */
+
+#define BME280_SIM_ADDRESS      0x77
+
+#define REG_CALIB_00            0x88
+#define REG_CHIP_ID             0xD0
+#define REG_RESET               0xE0
+#define REG_CALIB_26            0xE1
+#define REG_CTRL_HUM            0xF2
+#define REG_STATUS              0xF3
+#define REG_CTRL_MEAS           0xF4
+#define REG_CONFIG              0xF5
+#define REG_PRESS_MSB           0xF7
+#define REG_TEMP_MSB            0xFA
+#define REG_HUM_MSB             0xFD
+
+#define CHIP_ID                 0x60
+#define SOFT_RESET_COMMAND      0xB6
+#define MODE_MASK               0x03
+#define MODE_SLEEP              0x00
+#define MODE_NORMAL             0x03
+
+#define RAW_20_BIT_MAX          0xFFFFF
+#define RAW_16_BIT_MAX          0xFFFF
+
+typedef struct calibration {
+  uint16_t  t1;
+  int16_t   t2;
+  int16_t   t3;
+  uint16_t  p1;
+  int16_t   p2;
+  int16_t   p3;
+  int16_t   p4;
+  int16_t   p5;
+  int16_t   p6;
+  int16_t   p7;
+  int16_t   p8;
+  int16_t   p9;
+  uint8_t   h1;
+  int16_t   h2;
+  uint8_t   h3;
+  int16_t   h4;
+  int16_t   h5;
+  int8_t    h6;
+} calibration_struct;
+
+static const calibration_struct calibration = {
+  .t1 = 27504, .t2 = 26435, .t3 = -1000,
+  .p1 = 36477, .p2 = -10685, .p3 = 3024, .p4 = 2855, .p5 = 140, .p6 = -7, .p7 = 15500, .p8 = -14600,
+  .p9 = 6000,
+  .h1 = 75, .h2 = 362, .h3 = 0, .h4 = 313, .h5 = 50, .h6 = 30
+};
+
+static uint8_t registers[256];
+static uint8_t register_pointer = 0;
+static bool    is_reset = false;
+
+// Private functions
+static esp_err_t bme280_write(const uint8_t *data, size_t length);
+static esp_err_t bme280_read(uint8_t *data, size_t length);
+static void reset(void);
+static void write_register(uint8_t reg, uint8_t value);
+static void latch_measurement(void);
+static double compensate_temperature(uint32_t raw, double *t_fine);
+static double compensate_pressure(uint32_t raw, double t_fine);
+static double compensate_humidity(uint32_t raw, double t_fine);
+static uint32_t invert_temperature(double temperature, double *t_fine);
+static uint32_t invert_pressure(double pressure, double t_fine);
+static uint32_t invert_humidity(double humidity, double t_fine);
+static void put_le16(uint8_t reg, uint16_t value);
+
+const sim_i2c_device_struct sim_bme280 = {
+  .address = BME280_SIM_ADDRESS,
+  .write = bme280_write,
+  .read = bme280_read
+};
+
+
+/*!
+ * First byte is the register address, the rest are data. Bursts after the first data
+ * byte come as (address, data) pairs, which is how the Bosch driver writes them.
+ */
+static esp_err_t bme280_write(const uint8_t *data, size_t length)
+{
+  if (!is_reset) {
+    reset();
+  }
+
+  if (length == 0) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  register_pointer = data[0];
+  if (length < 2) {
+    return ESP_OK;
+  }
+
+  write_register(data[0], data[1]);
+  for (size_t i = 2; (i + 1) < length; i += 2) {
+    write_register(data[i], data[i + 1]);
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t bme280_read(uint8_t *data, size_t length)
+{
+  if (!is_reset) {
+    reset();
+  }
+
+  // In normal mode every data read sees a fresh measurement
+  if ((register_pointer == REG_PRESS_MSB) && ((registers[REG_CTRL_MEAS] & MODE_MASK) == MODE_NORMAL)) {
+    latch_measurement();
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    data[i] = registers[register_pointer++];
+  }
+
+  return ESP_OK;
+}
+
+static void reset(void)
+{
+  memset(registers, 0, sizeof(registers));
+
+  registers[REG_CHIP_ID] = CHIP_ID;
+
+  // 0x88..0xA1
+  put_le16(REG_CALIB_00 + 0, calibration.t1);
+  put_le16(REG_CALIB_00 + 2, (uint16_t) calibration.t2);
+  put_le16(REG_CALIB_00 + 4, (uint16_t) calibration.t3);
+  put_le16(REG_CALIB_00 + 6, calibration.p1);
+  put_le16(REG_CALIB_00 + 8, (uint16_t) calibration.p2);
+  put_le16(REG_CALIB_00 + 10, (uint16_t) calibration.p3);
+  put_le16(REG_CALIB_00 + 12, (uint16_t) calibration.p4);
+  put_le16(REG_CALIB_00 + 14, (uint16_t) calibration.p5);
+  put_le16(REG_CALIB_00 + 16, (uint16_t) calibration.p6);
+  put_le16(REG_CALIB_00 + 18, (uint16_t) calibration.p7);
+  put_le16(REG_CALIB_00 + 20, (uint16_t) calibration.p8);
+  put_le16(REG_CALIB_00 + 22, (uint16_t) calibration.p9);
+  registers[REG_CALIB_00 + 25] = calibration.h1;
+
+  // 0xE1..0xE7, H4 and H5 are 12 bit and share 0xE5
+  put_le16(REG_CALIB_26 + 0, (uint16_t) calibration.h2);
+  registers[REG_CALIB_26 + 2] = calibration.h3;
+  registers[REG_CALIB_26 + 3] = (uint8_t)(calibration.h4 >> 4);
+  registers[REG_CALIB_26 + 4] = (uint8_t)((calibration.h4 & 0x0F) | ((calibration.h5 & 0x0F) << 4));
+  registers[REG_CALIB_26 + 5] = (uint8_t)(calibration.h5 >> 4);
+  registers[REG_CALIB_26 + 6] = (uint8_t) calibration.h6;
+
+  // Data registers read 0x80000 / 0x8000 until the first measurement, like the real part
+  registers[REG_PRESS_MSB] = 0x80;
+  registers[REG_TEMP_MSB] = 0x80;
+  registers[REG_HUM_MSB] = 0x80;
+
+  is_reset = true;
+}
+
+static void write_register(uint8_t reg, uint8_t value)
+{
+  switch (reg) {
+    case REG_RESET:
+      if (value == SOFT_RESET_COMMAND) {
+        reset();
+      }
+      break;
+
+    case REG_CTRL_HUM:
+    case REG_CONFIG:
+      registers[reg] = value;
+      break;
+
+    case REG_CTRL_MEAS:
+      registers[reg] = value;
+      // Forced mode measures once and drops back to sleep; conversion is instant here
+      if (((value & MODE_MASK) != MODE_SLEEP) && ((value & MODE_MASK) != MODE_NORMAL)) {
+        latch_measurement();
+        registers[reg] = value & ~MODE_MASK;
+      }
+      break;
+
+    default:
+      // Read-only
+      break;
+  }
+}
+
+static void latch_measurement(void)
+{
+  sim_environment_struct environment;
+  double t_fine = 0;
+  uint32_t raw_temperature = 0;
+  uint32_t raw_pressure = 0;
+  uint32_t raw_humidity = 0;
+
+  sim_world_get_environment(&environment);
+
+  raw_temperature = invert_temperature(environment.temperature_c, &t_fine);
+  raw_pressure = invert_pressure(environment.pressure_pa, t_fine);
+  raw_humidity = invert_humidity(environment.humidity_pct, t_fine);
+
+  registers[REG_PRESS_MSB + 0] = (uint8_t)(raw_pressure >> 12);
+  registers[REG_PRESS_MSB + 1] = (uint8_t)(raw_pressure >> 4);
+  registers[REG_PRESS_MSB + 2] = (uint8_t)((raw_pressure & 0x0F) << 4);
+  registers[REG_TEMP_MSB + 0] = (uint8_t)(raw_temperature >> 12);
+  registers[REG_TEMP_MSB + 1] = (uint8_t)(raw_temperature >> 4);
+  registers[REG_TEMP_MSB + 2] = (uint8_t)((raw_temperature & 0x0F) << 4);
+  registers[REG_HUM_MSB + 0] = (uint8_t)(raw_humidity >> 8);
+  registers[REG_HUM_MSB + 1] = (uint8_t) raw_humidity;
+}
+
+// Compensation, as in the Bosch driver's double precision path
+
+static double compensate_temperature(uint32_t raw, double *t_fine)
+{
+  double var1 = (((double) raw) / 16384.0 - ((double) calibration.t1) / 1024.0) * ((double) calibration.t2);
+  double var2 = (((double) raw) / 131072.0 - ((double) calibration.t1) / 8192.0);
+
+  var2 = (var2 * var2) * ((double) calibration.t3);
+  // The driver truncates t_fine to an integer
+  *t_fine = (double)(int32_t)(var1 + var2);
+
+  return (var1 + var2) / 5120.0;
+}
+
+static double compensate_pressure(uint32_t raw, double t_fine)
+{
+  double var1 = (t_fine / 2.0) - 64000.0;
+  double var2 = var1 * var1 * ((double) calibration.p6) / 32768.0;
+  double var3 = 0;
+  double pressure = 0;
+
+  var2 = var2 + var1 * ((double) calibration.p5) * 2.0;
+  var2 = (var2 / 4.0) + (((double) calibration.p4) * 65536.0);
+  var3 = ((double) calibration.p3) * var1 * var1 / 524288.0;
+  var1 = (var3 + ((double) calibration.p2) * var1) / 524288.0;
+  var1 = (1.0 + var1 / 32768.0) * ((double) calibration.p1);
+
+  pressure = 1048576.0 - (double) raw;
+  pressure = (pressure - (var2 / 4096.0)) * 6250.0 / var1;
+  var1 = ((double) calibration.p9) * pressure * pressure / 2147483648.0;
+  var2 = pressure * ((double) calibration.p8) / 32768.0;
+
+  return pressure + (var1 + var2 + ((double) calibration.p7)) / 16.0;
+}
+
+static double compensate_humidity(uint32_t raw, double t_fine)
+{
+  double var1 = t_fine - 76800.0;
+  double var2 = (((double) calibration.h4) * 64.0 + (((double) calibration.h5) / 16384.0) * var1);
+  double var3 = raw - var2;
+  double var4 = ((double) calibration.h2) / 65536.0;
+  double var5 = (1.0 + (((double) calibration.h3) / 67108864.0) * var1);
+  double var6 = 1.0 + (((double) calibration.h6) / 67108864.0) * var1 * var5;
+
+  var6 = var3 * var4 * (var5 * var6);
+
+  return var6 * (1.0 - ((double) calibration.h1) * var6 / 524288.0);
+}
+
+// Inversion by bisection -- all three are monotonic over the raw range
+
+static uint32_t invert_temperature(double temperature, double *t_fine)
+{
+  uint32_t low = 0;
+  uint32_t high = RAW_20_BIT_MAX;
+
+  while (low < high) {
+    uint32_t middle = low + ((high - low) / 2);
+
+    if (compensate_temperature(middle, t_fine) < temperature) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  compensate_temperature(low, t_fine);
+
+  return low;
+}
+
+static uint32_t invert_pressure(double pressure, double t_fine)
+{
+  uint32_t low = 0;
+  uint32_t high = RAW_20_BIT_MAX;
+
+  // Pressure falls as the raw value rises
+  while (low < high) {
+    uint32_t middle = low + ((high - low) / 2);
+
+    if (compensate_pressure(middle, t_fine) > pressure) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static uint32_t invert_humidity(double humidity, double t_fine)
+{
+  uint32_t low = 0;
+  uint32_t high = RAW_16_BIT_MAX;
+
+  while (low < high) {
+    uint32_t middle = low + ((high - low) / 2);
+
+    if (compensate_humidity(middle, t_fine) < humidity) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static void put_le16(uint8_t reg, uint16_t value)
+{
+  registers[reg] = (uint8_t)(value & 0xFF);
+  registers[(uint8_t)(reg + 1)] = (uint8_t)(value >> 8);
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "platform_pwm.h"
+#include "platform_sim.h"
+
+/* A small lumped model of the greenhouse, good enough to exercise the control loop:
+ * the air relaxes toward the outside conditions through the walls (and much faster
+ * with the fan on), the sun heats it and drives transpiration through the PDLC,
+ * and the soil slowly dries out. Sunlight follows a 06:00-18:00 half sine. */
+
+#define SECONDS_PER_DAY       86400.0
+#define MAX_STEP_S            10.0
+
+#define WALL_TIME_CONSTANT_S  1800.0
+#define FAN_TIME_CONSTANT_S   240.0
+#define SOLAR_GAIN_C_PER_S    (10.0 / WALL_TIME_CONSTANT_S)   // +10 degC at full sun, clear film
+#define LIGHTS_GAIN_C_PER_S   (0.5 / WALL_TIME_CONSTANT_S)
+#define TRANSPIRATION_PER_S   0.015                           // %Rh / s at full sun
+#define SOIL_DRYING_PER_S     (2.0 / 3600.0)                  // %/s, doubles at full sun
+#define PDLC_CLEAR            0.9                             // Transmission, film powered
+#define PDLC_OPAQUE           0.25
+
+#define OUTSIDE_MEAN_C        18.0
+#define OUTSIDE_SWING_C       6.0
+#define OUTSIDE_HUMIDITY_PCT  55.0
+
+// Peak in-greenhouse irradiance behind clear film, uW/cm^2
+#define UV_A_PEAK             900.0
+#define UV_B_PEAK             60.0
+#define UV_C_PEAK             2.0
+#define LIGHTS_UV_A           20.0
+
+// Capacitive soil probe output, dry to saturated
+#define SOIL_PROBE_DRY_MV     2715
+#define SOIL_PROBE_WET_MV     1300
+
+static sim_world_config_struct world_config = {
+  .fan_gpio = -1,
+  .lights_gpio = -1,
+  .pdlc_gpio = -1,
+  .soil_adc_unit = -1,
+  .soil_adc_channel = -1,
+  .time_scale = 1,
+  .start_hour = 10
+};
+
+static sim_environment_struct state = {
+  .temperature_c = 20.0,
+  .humidity_pct = 60.0,
+  .pressure_pa = 101325.0,
+  .soil_wetness_pct = 70.0
+};
+static double   simulated_time_s = 0;
+static int64_t  last_update_us = -1;
+
+// Logger tag
+static const char *WORLD_TAG = "Sim world";
+
+// Private functions
+static void step(double dt, double time_of_day_s);
+static double sunlight(double time_of_day_s);
+static double actuator(platform_gpio_num_t pin);
+
+
+/*!
+ * Public init function -- config tells the model which pins drive the actuators
+ */
+void sim_world_init(const sim_world_config_struct *config)
+{
+  world_config = *config;
+  if (world_config.time_scale == 0) {
+    world_config.time_scale = 1;
+  }
+
+  if ((world_config.soil_adc_unit >= 0) && (world_config.soil_adc_channel >= 0)) {
+    sim_adc_attach(world_config.soil_adc_unit, world_config.soil_adc_channel, sim_world_soil_probe_mv);
+  }
+
+  simulated_time_s = 0;
+  last_update_us = esp_timer_get_time();
+
+  ESP_LOGI(WORLD_TAG, "Simulated greenhouse starting at %02" PRIu32 ":00, %" PRIu32 "x real time",
+    world_config.start_hour, world_config.time_scale);
+}
+
+/*!
+ * Advance the model to now and return the conditions the sensors see. Called from the
+ * sensors task only.
+ */
+void sim_world_get_environment(sim_environment_struct *environment)
+{
+  int64_t now_us = esp_timer_get_time();
+  double elapsed_s = 0;
+  double time_of_day_s = 0;
+  double sun = 0;
+  double transmission = 0;
+
+  if (last_update_us < 0) {
+    last_update_us = now_us;
+  }
+
+  elapsed_s = ((double)(now_us - last_update_us) / 1000000.0) * world_config.time_scale;
+  last_update_us = now_us;
+
+  // Fixed-size steps keep the Euler integration stable at high time scales
+  while (elapsed_s > 0) {
+    double dt = (elapsed_s > MAX_STEP_S) ? MAX_STEP_S : elapsed_s;
+
+    simulated_time_s += dt;
+    time_of_day_s = fmod((world_config.start_hour * 3600.0) + simulated_time_s, SECONDS_PER_DAY);
+    step(dt, time_of_day_s);
+    elapsed_s -= dt;
+  }
+
+  time_of_day_s = fmod((world_config.start_hour * 3600.0) + simulated_time_s, SECONDS_PER_DAY);
+  sun = sunlight(time_of_day_s);
+  transmission = (actuator(world_config.pdlc_gpio) > 0) ? PDLC_CLEAR : PDLC_OPAQUE;
+
+  state.pressure_pa = 101325.0 + (150.0 * sin((2.0 * M_PI * simulated_time_s) / (1.5 * SECONDS_PER_DAY)));
+  state.uv_a = (UV_A_PEAK * sun * transmission) + (LIGHTS_UV_A * actuator(world_config.lights_gpio));
+  state.uv_b = UV_B_PEAK * sun * transmission;
+  state.uv_c = UV_C_PEAK * sun * transmission;
+
+  *environment = state;
+}
+
+int sim_world_soil_probe_mv(void)
+{
+  return SOIL_PROBE_DRY_MV -
+         (int)((state.soil_wetness_pct * (SOIL_PROBE_DRY_MV - SOIL_PROBE_WET_MV)) / 100.0);
+}
+
+static void step(double dt, double time_of_day_s)
+{
+  double sun = sunlight(time_of_day_s);
+  double fan = actuator(world_config.fan_gpio);
+  double transmission = (actuator(world_config.pdlc_gpio) > 0) ? PDLC_CLEAR : PDLC_OPAQUE;
+  double outside_c = OUTSIDE_MEAN_C +
+                     (OUTSIDE_SWING_C * sin((2.0 * M_PI * (time_of_day_s - (9.0 * 3600.0))) / SECONDS_PER_DAY));
+  double exchange = (1.0 / WALL_TIME_CONSTANT_S) + (fan / FAN_TIME_CONSTANT_S);
+
+  state.temperature_c += dt * (((outside_c - state.temperature_c) * exchange) +
+                               (SOLAR_GAIN_C_PER_S * sun * transmission) +
+                               (LIGHTS_GAIN_C_PER_S * actuator(world_config.lights_gpio)));
+
+  state.humidity_pct += dt * (((OUTSIDE_HUMIDITY_PCT - state.humidity_pct) * exchange) +
+                              (TRANSPIRATION_PER_S * sun * transmission));
+  state.humidity_pct = (state.humidity_pct > 100.0) ? 100.0 : state.humidity_pct;
+
+  state.soil_wetness_pct -= dt * SOIL_DRYING_PER_S * (1.0 + sun);
+  state.soil_wetness_pct = (state.soil_wetness_pct < 5.0) ? 5.0 : state.soil_wetness_pct;
+}
+
+static double sunlight(double time_of_day_s)
+{
+  double hour = time_of_day_s / 3600.0;
+
+  if ((hour <= 6.0) || (hour >= 18.0)) {
+    return 0;
+  }
+
+  return sin((M_PI * (hour - 6.0)) / 12.0);
+}
+
+static double actuator(platform_gpio_num_t pin)
+{
+  // PWM outputs count in proportion to their duty cycle
+  return (pin < 0) ? 0 : ((double) sim_gpio_get_duty(pin) / PLATFORM_PWM_DUTY_MAX);
+}
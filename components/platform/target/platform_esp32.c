@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "soc/soc_caps.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "driver/ledc.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_http_client.h"
+#include "nvs.h"
+#include "led_strip.h"
+#include "platform_gpio.h"
+#include "platform_i2c.h"
+#include "platform_pwm.h"
+#include "platform_adc.h"
+#include "platform_http.h"
+#include "platform_storage.h"
+#include "platform_system.h"
+
+#define MAX_ADC_CHANNELS 4
+
+// 10-bit LEDC duty: 25 kHz needs a 25.6 MHz source, well inside what the APB clock allows
+#define PWM_RESOLUTION  LEDC_TIMER_10_BIT
+#define PWM_FULL_SCALE  (1UL << 10)
+
+struct platform_adc_channel {
+  adc_oneshot_unit_handle_t unit_handle;
+  adc_cali_handle_t         calibration_handle;
+  adc_channel_t             channel;
+  bool                      is_calibrated;
+};
+
+// One-shot units can only be created once, channels share them
+static adc_oneshot_unit_handle_t adc_units[SOC_ADC_PERIPH_NUM];
+static struct platform_adc_channel adc_channels[MAX_ADC_CHANNELS];
+static int adc_channel_count = 0;
+
+static led_strip_handle_t led_strip;
+
+// Event streams are read this much at a time
+#define HTTP_STREAM_CHUNK   512
+#define HTTP_MAX_REDIRECTS  3
+
+// NVS namespace for everything stored through platform_storage
+#define STORAGE_NAMESPACE "greenhouse"
+
+// Logger tag
+static const char *PLATFORM_TAG = "Platform";
+
+// Private functions
+static esp_err_t http_event_handler(esp_http_client_event_t *evt);
+static esp_err_t http_open_stream(esp_http_client_handle_t client, int *status_code);
+
+
+//
+// GPIO
+
+esp_err_t platform_gpio_config_output(uint64_t pin_bit_mask, bool pull_up, bool pull_down)
+{
+  gpio_config_t config = {
+    .intr_type = GPIO_INTR_DISABLE,
+    .mode = GPIO_MODE_OUTPUT,
+    .pin_bit_mask = pin_bit_mask,
+    .pull_down_en = pull_down ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+    .pull_up_en = pull_up ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE
+  };
+
+  return gpio_config(&config);
+}
+
+esp_err_t platform_gpio_set_level(platform_gpio_num_t pin, uint32_t level)
+{
+  return gpio_set_level((gpio_num_t) pin, level);
+}
+
+
+//
+// PWM
+
+esp_err_t platform_pwm_init(platform_pwm_channel_t channel, platform_gpio_num_t pin, uint32_t frequency_hz)
+{
+  esp_err_t return_code = ESP_OK;
+  ledc_timer_config_t timer_config = {
+    .speed_mode = LEDC_LOW_SPEED_MODE,
+    .duty_resolution = PWM_RESOLUTION,
+    .timer_num = LEDC_TIMER_0,
+    .freq_hz = frequency_hz,
+    .clk_cfg = LEDC_AUTO_CLK
+  };
+  ledc_channel_config_t channel_config = {
+    .gpio_num = pin,
+    .speed_mode = LEDC_LOW_SPEED_MODE,
+    .channel = (ledc_channel_t) channel,
+    .intr_type = LEDC_INTR_DISABLE,
+    .timer_sel = LEDC_TIMER_0,
+    .duty = 0,
+    .hpoint = 0
+  };
+
+  if ((channel < 0) || (channel >= LEDC_CHANNEL_MAX)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  return_code = ledc_timer_config(&timer_config);
+  if (return_code != ESP_OK) {
+    ESP_LOGE(PLATFORM_TAG, "LEDC timer config failed: %s", esp_err_to_name(return_code));
+    return return_code;
+  }
+
+  return ledc_channel_config(&channel_config);
+}
+
+esp_err_t platform_pwm_set_duty(platform_pwm_channel_t channel, uint32_t duty_permille)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (duty_permille > PLATFORM_PWM_DUTY_MAX) {
+    duty_permille = PLATFORM_PWM_DUTY_MAX;
+  }
+
+  return_code = ledc_set_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t) channel,
+                  (duty_permille * PWM_FULL_SCALE) / PLATFORM_PWM_DUTY_MAX);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return ledc_update_duty(LEDC_LOW_SPEED_MODE, (ledc_channel_t) channel);
+}
+
+
+//
+// I2C
+
+esp_err_t platform_i2c_master_init(platform_i2c_port_t port, int sda_gpio, int scl_gpio, uint32_t clk_speed_hz)
+{
+  esp_err_t return_code = ESP_OK;
+  i2c_config_t conf = {
+    .mode = I2C_MODE_MASTER,
+    .sda_io_num = sda_gpio,
+    .scl_io_num = scl_gpio,
+    .sda_pullup_en = GPIO_PULLUP_ENABLE,
+    .scl_pullup_en = GPIO_PULLUP_ENABLE,
+    .master.clk_speed = clk_speed_hz
+  };
+
+  return_code = i2c_param_config((i2c_port_t) port, &conf);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  // Master mode doesn't use the driver's Rx/Tx buffers
+  return i2c_driver_install((i2c_port_t) port, I2C_MODE_MASTER, 0, 0, 0);
+}
+
+esp_err_t platform_i2c_write(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, TickType_t timeout_ticks)
+{
+  return i2c_master_write_to_device((i2c_port_t) port, device_addr, write_data, write_length, timeout_ticks);
+}
+
+esp_err_t platform_i2c_write_read(platform_i2c_port_t port, uint8_t device_addr, const uint8_t *write_data,
+  size_t write_length, uint8_t *read_data, size_t read_length, TickType_t timeout_ticks)
+{
+  return i2c_master_write_read_device((i2c_port_t) port, device_addr, write_data, write_length, read_data,
+    read_length, timeout_ticks);
+}
+
+
+//
+// ADC
+
+esp_err_t platform_adc_init(int adc_unit, int adc_channel, platform_adc_atten_t atten,
+  platform_adc_handle_t *handle)
+{
+  esp_err_t return_code = ESP_OK;
+  struct platform_adc_channel *channel = NULL;
+  adc_oneshot_unit_init_cfg_t init_config = {
+    .unit_id = (adc_unit_t) adc_unit,
+    .clk_src = 0,   // Use default clock source
+    .ulp_mode = ADC_ULP_MODE_DISABLE
+  };
+  adc_oneshot_chan_cfg_t channel_config = {
+    .atten = (adc_atten_t) atten,
+    .bitwidth = ADC_BITWIDTH_12
+  };
+  // We'll use curve fitting as it is more accurate and supported by our chip
+  adc_cali_curve_fitting_config_t cali_config = {
+    .unit_id = (adc_unit_t) adc_unit,
+    .chan = (adc_channel_t) adc_channel,
+    .atten = (adc_atten_t) atten,
+    .bitwidth = ADC_BITWIDTH_12
+  };
+
+  if ((adc_unit < 0) || (adc_unit >= SOC_ADC_PERIPH_NUM) || (adc_channel_count >= MAX_ADC_CHANNELS)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Set up the ADC unit as one-shot
+  if (adc_units[adc_unit] == NULL) {
+    return_code = adc_oneshot_new_unit(&init_config, &(adc_units[adc_unit]));
+    if (return_code != ESP_OK) {
+      return return_code;
+    }
+  }
+
+  channel = &(adc_channels[adc_channel_count]);
+  channel->unit_handle = adc_units[adc_unit];
+  channel->channel = (adc_channel_t) adc_channel;
+
+  return_code = adc_oneshot_config_channel(channel->unit_handle, channel->channel, &channel_config);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  adc_channel_count++;
+  *handle = channel;
+
+  // Calibrate for the offset to Vref written to the eFuse
+  return_code = adc_cali_create_scheme_curve_fitting(&cali_config, &(channel->calibration_handle));
+  channel->is_calibrated = (return_code == ESP_OK);
+
+  return return_code;
+}
+
+esp_err_t platform_adc_read_calibrated(platform_adc_handle_t handle, int *millivolts)
+{
+  int raw_counts = 0;
+  esp_err_t return_code = ESP_OK;
+
+  if (handle->is_calibrated) {
+    return adc_oneshot_get_calibrated_result(handle->unit_handle, handle->calibration_handle, handle->channel,
+      millivolts);
+  }
+
+  return_code = adc_oneshot_read(handle->unit_handle, handle->channel, &raw_counts);
+  *millivolts = raw_counts;
+
+  return return_code;
+}
+
+
+//
+// HTTP
+
+esp_err_t platform_http_post(const platform_http_request_struct *request, int *status_code)
+{
+  esp_err_t return_code = ESP_OK;
+  esp_http_client_config_t config = {
+    .url = request->url,
+    .method = HTTP_METHOD_POST,
+    .event_handler = http_event_handler,
+    .user_data = (void *) request,
+    .cert_pem = request->cert_pem
+  };
+  esp_http_client_handle_t client = esp_http_client_init(&config);
+
+  if (client == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (request->content_type != NULL) {
+    esp_http_client_set_header(client, "Content-Type", request->content_type);
+  }
+  esp_http_client_set_post_field(client, request->body, (int) request->body_length);
+
+  return_code = esp_http_client_perform(client);
+  if ((return_code == ESP_OK) && (status_code != NULL)) {
+    *status_code = esp_http_client_get_status_code(client);
+  }
+
+  esp_http_client_cleanup(client);
+
+  return return_code;
+}
+
+/*!
+ * Open, fetch the headers and follow up to HTTP_MAX_REDIRECTS redirects. Firebase sends event
+ * streams to a different server with a 307.
+ */
+static esp_err_t http_open_stream(esp_http_client_handle_t client, int *status_code)
+{
+  esp_err_t return_code = ESP_OK;
+
+  for (int redirects = 0; redirects <= HTTP_MAX_REDIRECTS; redirects++) {
+    return_code = esp_http_client_open(client, 0);
+    if (return_code != ESP_OK) {
+      return return_code;
+    }
+
+    esp_http_client_fetch_headers(client);
+    *status_code = esp_http_client_get_status_code(client);
+    if ((*status_code != 301) && (*status_code != 302) && (*status_code != 307) && (*status_code != 308)) {
+      return ESP_OK;
+    }
+
+    esp_http_client_set_redirection(client);
+    esp_http_client_close(client);
+  }
+
+  return ESP_FAIL;
+}
+
+esp_err_t platform_http_stream(const platform_http_request_struct *request, uint32_t idle_timeout_ms,
+  int *status_code)
+{
+  esp_err_t return_code = ESP_OK;
+  char buffer[HTTP_STREAM_CHUNK];
+  int length = 0;
+  int status = 0;
+  esp_http_client_config_t config = {
+    .url = request->url,
+    .method = HTTP_METHOD_GET,
+    .cert_pem = request->cert_pem,
+    .timeout_ms = (int) idle_timeout_ms
+  };
+  esp_http_client_handle_t client = esp_http_client_init(&config);
+
+  if (client == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  if (request->accept != NULL) {
+    esp_http_client_set_header(client, "Accept", request->accept);
+  }
+
+  return_code = http_open_stream(client, &status);
+  if (status_code != NULL) {
+    *status_code = status;
+  }
+
+  // The socket timeout is the idle timeout, keep-alives from the server count as traffic
+  while ((return_code == ESP_OK) && (status == 200)) {
+    length = esp_http_client_read(client, buffer, sizeof(buffer));
+    if (length > 0) {
+      if (request->on_data != NULL) {
+        request->on_data(buffer, length, request->context);
+      }
+    } else if ((length == 0) && esp_http_client_is_complete_data_received(client)) {
+      break;
+    } else {
+      return_code = ((length == 0) || (length == -ESP_ERR_HTTP_EAGAIN)) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+  }
+
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+
+  return return_code;
+}
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+  const platform_http_request_struct *request = (const platform_http_request_struct *) evt->user_data;
+
+  if ((evt->event_id == HTTP_EVENT_ON_DATA) && (request->on_data != NULL)) {
+    request->on_data((const char *) evt->data, evt->data_len, request->context);
+  }
+
+  return ESP_OK;
+}
+
+
+//
+// Storage -- NVS, which needs nvs_flash_init() first
+
+esp_err_t platform_storage_read(const char *key, void *data, size_t *length)
+{
+  esp_err_t return_code = ESP_OK;
+  nvs_handle_t handle;
+
+  return_code = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &handle);
+  if (return_code == ESP_ERR_NVS_NOT_FOUND) {
+    // Nothing has ever been written to the namespace
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return_code = nvs_get_blob(handle, key, data, length);
+  nvs_close(handle);
+
+  if (return_code == ESP_ERR_NVS_NOT_FOUND) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (return_code == ESP_ERR_NVS_INVALID_LENGTH) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  return return_code;
+}
+
+esp_err_t platform_storage_write(const char *key, const void *data, size_t length)
+{
+  esp_err_t return_code = ESP_OK;
+  nvs_handle_t handle;
+
+  return_code = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  // NVS only drops the old entry once the new one is fully written
+  return_code = nvs_set_blob(handle, key, data, length);
+  if (return_code == ESP_OK) {
+    return_code = nvs_commit(handle);
+  }
+  nvs_close(handle);
+
+  if (return_code != ESP_OK) {
+    ESP_LOGE(PLATFORM_TAG, "Failed to store %s: %s", key, esp_err_to_name(return_code));
+  }
+
+  return return_code;
+}
+
+
+//
+// System
+
+esp_err_t platform_status_led_init(int gpio)
+{
+  esp_err_t return_code = ESP_OK;
+  /* LED strip initialization with the GPIO and pixels number*/
+  led_strip_config_t strip_config = {
+      .strip_gpio_num = gpio,
+      .max_leds = 1, // at least one LED on board
+  };
+  led_strip_rmt_config_t rmt_config = {
+      .resolution_hz = 10 * 1000 * 1000, // 10MHz
+  };
+
+  return_code = led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip);
+  if (return_code != ESP_OK) {
+    ESP_LOGE(PLATFORM_TAG, "Failed to create the status LED device.");
+    return return_code;
+  }
+
+  /* Set all LED off to clear all pixels */
+  return led_strip_clear(led_strip);
+}
+
+void platform_status_led_set(uint8_t red, uint8_t green, uint8_t blue, bool led_state)
+{
+  /* If the addressable LED is enabled */
+  if (led_state) {
+    /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
+    led_strip_set_pixel(led_strip, 0, red, green, blue);
+    /* Refresh the strip to send data */
+    led_strip_refresh(led_strip);
+  } else {
+    /* Set all LED off to clear all pixels */
+    led_strip_clear(led_strip);
+  }
+}
+
+uint32_t platform_random(void)
+{
+  return esp_random();
+}
+
+void platform_restart(void)
+{
+  esp_restart();
+}
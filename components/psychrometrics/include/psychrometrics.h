@@ -0,0 +1,30 @@
+#ifndef PSYCHROMETRICS_H
+#define PSYCHROMETRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Saturation table range, 1 degC apart. Temperatures outside it are clamped to the ends.
+#define PSYCHRO_TABLE_MIN_C     -40
+#define PSYCHRO_TABLE_MAX_C     60
+#define PSYCHRO_TABLE_SIZE      (PSYCHRO_TABLE_MAX_C - PSYCHRO_TABLE_MIN_C + 1)
+
+// Air moisture worked out from one temperature and humidity reading
+typedef struct derived_metrics {
+  float     saturation_vp_kpa;      // Saturation vapour pressure at the air temperature
+  float     vapour_pressure_kpa;    // Actual vapour pressure
+  float     vpd_kpa;                // Vapour pressure deficit, saturation - actual
+  float     dew_point_c;
+  float     absolute_humidity_g_m3;
+} derived_metrics_struct;
+
+/* Saturation vapour pressure over water, the Magnus form of Alduchov and Eskridge (1996):
+ *   es(T) = 0.61094 * exp(17.625 T / (T + 243.04)) kPa
+ * evaluated from a table of es and its slope with cubic Hermite interpolation, so no
+ * expf()/logf() on the sample path. Within 1e-6 relative of the formula across the table. */
+float     psychrometrics_saturation_vp(float temperature_c);
+float     psychrometrics_dew_point(float vapour_pressure_kpa);
+void      psychrometrics_derive(float temperature_c, float humidity_pct, derived_metrics_struct *metrics);
+
+#endif /* PSYCHROMETRICS_H */
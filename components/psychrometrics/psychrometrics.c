@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "psychrometrics.h"
+
+#define KELVIN_OFFSET           273.15f
+#define MAGNUS_A                0.61094f  // kPa, the table was generated from these
+#define MAGNUS_B                17.625f
+#define MAGNUS_C                243.04f
+#define LN_2                    0.69314718f
+#define SQRT_2                  1.41421356f
+#define ABSOLUTE_HUMIDITY_SCALE 2166.8f   // g*K/(m^3*kPa): 1e6 / 461.5 J/(kg*K), the gas constant of water vapour
+
+// es(T) in kPa for T = PSYCHRO_TABLE_MIN_C, +1, ... PSYCHRO_TABLE_MAX_C
+static const float saturation_table[PSYCHRO_TABLE_SIZE] = {
+  1.8968440e-02f, 2.1034712e-02f, 2.3302553e-02f, 2.5789256e-02f, 2.8513383e-02f, 3.1494842e-02f,
+  3.4754968e-02f, 3.8316605e-02f, 4.2204194e-02f, 4.6443865e-02f, 5.1063527e-02f, 5.6092972e-02f,
+  6.1563975e-02f, 6.7510400e-02f, 7.3968313e-02f, 8.0976092e-02f, 8.8574555e-02f, 9.6807075e-02f,
+  1.0571971e-01f, 1.1536135e-01f, 1.2578382e-01f, 1.3704207e-01f, 1.4919428e-01f, 1.6230204e-01f,
+  1.7643047e-01f, 1.9164844e-01f, 2.0802869e-01f, 2.2564801e-01f, 2.4458744e-01f, 2.6493240e-01f,
+  2.8677296e-01f, 3.1020395e-01f, 3.3532522e-01f, 3.6224179e-01f, 3.9106411e-01f, 4.2190825e-01f,
+  4.5489610e-01f, 4.9015564e-01f, 5.2782114e-01f, 5.6803340e-01f, 6.1094000e-01f, 6.5669555e-01f,
+  7.0546194e-01f, 7.5740857e-01f, 8.1271268e-01f, 8.7155955e-01f, 9.3414282e-01f, 1.0006647e+00f,
+  1.0713365e+00f, 1.1463785e+00f, 1.2260206e+00f, 1.3105026e+00f, 1.4000741e+00f, 1.4949955e+00f,
+  1.5955377e+00f, 1.7019828e+00f, 1.8146243e+00f, 1.9337673e+00f, 2.0597291e+00f, 2.1928394e+00f,
+  2.3334406e+00f, 2.4818884e+00f, 2.6385518e+00f, 2.8038136e+00f, 2.9780712e+00f, 3.1617360e+00f,
+  3.3552350e+00f, 3.5590100e+00f, 3.7735188e+00f, 3.9992354e+00f, 4.2366503e+00f, 4.4862706e+00f,
+  4.7486212e+00f, 5.0242444e+00f, 5.3137007e+00f, 5.6175693e+00f, 5.9364483e+00f, 6.2709550e+00f,
+  6.6217269e+00f, 6.9894214e+00f, 7.3747168e+00f, 7.7783122e+00f, 8.2009287e+00f, 8.6433090e+00f,
+  9.1062184e+00f, 9.5904450e+00f, 1.0096800e+01f, 1.0626119e+01f, 1.1179261e+01f, 1.1757111e+01f,
+  1.2360577e+01f, 1.2990594e+01f, 1.3648122e+01f, 1.4334150e+01f, 1.5049690e+01f, 1.5795785e+01f,
+  1.6573504e+01f, 1.7383944e+01f, 1.8228232e+01f, 1.9107524e+01f, 2.0023004e+01f
+};
+
+// des/dT in kPa/degC at the same temperatures
+static const float slope_table[PSYCHRO_TABLE_SIZE] = {
+  1.9709485e-03f, 2.1642769e-03f, 2.3742869e-03f, 2.6022117e-03f, 2.8493586e-03f, 3.1171136e-03f,
+  3.4069439e-03f, 3.7204021e-03f, 4.0591298e-03f, 4.4248611e-03f, 4.8194267e-03f, 5.2447579e-03f,
+  5.7028905e-03f, 6.1959689e-03f, 6.7262504e-03f, 7.2961096e-03f, 7.9080426e-03f, 8.5646714e-03f,
+  9.2687488e-03f, 1.0023163e-02f, 1.0830940e-02f, 1.1695255e-02f, 1.2619427e-02f, 1.3606933e-02f,
+  1.4661409e-02f, 1.5786655e-02f, 1.6986639e-02f, 1.8265505e-02f, 1.9627576e-02f, 2.1077362e-02f,
+  2.2619559e-02f, 2.4259064e-02f, 2.6000970e-02f, 2.7850579e-02f, 2.9813404e-02f, 3.1895177e-02f,
+  3.4101849e-02f, 3.6439604e-02f, 3.8914855e-02f, 4.1534259e-02f, 4.4304713e-02f, 4.7233369e-02f,
+  5.0327633e-02f, 5.3595171e-02f, 5.7043920e-02f, 6.0682086e-02f, 6.4518156e-02f, 6.8560899e-02f,
+  7.2819374e-02f, 7.7302935e-02f, 8.2021235e-02f, 8.6984235e-02f, 9.2202204e-02f, 9.7685730e-02f,
+  1.0344572e-01f, 1.0949341e-01f, 1.1584037e-01f, 1.2249850e-01f, 1.2948005e-01f, 1.3679761e-01f,
+  1.4446414e-01f, 1.5249292e-01f, 1.6089763e-01f, 1.6969231e-01f, 1.7889134e-01f, 1.8850951e-01f,
+  1.9856199e-01f, 2.0906430e-01f, 2.2003239e-01f, 2.3148258e-01f, 2.4343160e-01f, 2.5589655e-01f,
+  2.6889498e-01f, 2.8244481e-01f, 2.9656440e-01f, 3.1127251e-01f, 3.2658832e-01f, 3.4253143e-01f,
+  3.5912189e-01f, 3.7638014e-01f, 3.9432707e-01f, 4.1298402e-01f, 4.3237274e-01f, 4.5251542e-01f,
+  4.7343472e-01f, 4.9515371e-01f, 5.1769593e-01f, 5.4108535e-01f, 5.6534640e-01f, 5.9050396e-01f,
+  6.1658337e-01f, 6.4361039e-01f, 6.7161128e-01f, 7.0061273e-01f, 7.3064189e-01f, 7.6172637e-01f,
+  7.9389424e-01f, 8.2717403e-01f, 8.6159472e-01f, 8.9718575e-01f, 9.3397704e-01f
+};
+
+// Private functions
+static float interpolate(int index, float fraction);
+static float log_approx(float value);
+static float clamp(float value, float min, float max);
+
+
+float psychrometrics_saturation_vp(float temperature_c)
+{
+  float position = clamp(temperature_c, PSYCHRO_TABLE_MIN_C, PSYCHRO_TABLE_MAX_C) - PSYCHRO_TABLE_MIN_C;
+  int index = (int) position;
+
+  if (index > PSYCHRO_TABLE_SIZE - 2) {
+    index = PSYCHRO_TABLE_SIZE - 2;
+  }
+
+  return interpolate(index, position - index);
+}
+
+/*!
+ * Temperature at which vapour_pressure_kpa saturates, the Magnus formula turned around:
+ *   Td = c * ln(e / a) / (b - ln(e / a))
+ * with a polynomial log. Clamped to the table range like the saturation pressure.
+ */
+float psychrometrics_dew_point(float vapour_pressure_kpa)
+{
+  float exponent = 0;
+  float dew_point = 0;
+
+  if (!(vapour_pressure_kpa > saturation_table[0])) {
+    return PSYCHRO_TABLE_MIN_C;
+  }
+
+  exponent = log_approx(vapour_pressure_kpa / MAGNUS_A);
+  dew_point = MAGNUS_C * exponent / (MAGNUS_B - exponent);
+
+  return clamp(dew_point, PSYCHRO_TABLE_MIN_C, PSYCHRO_TABLE_MAX_C);
+}
+
+/*!
+ * Everything in derived_metrics_struct from one reading. Humidity is clamped to 0 - 100 %.
+ */
+void psychrometrics_derive(float temperature_c, float humidity_pct, derived_metrics_struct *metrics)
+{
+  float fraction = clamp(humidity_pct, 0, 100.0f) / 100.0f;
+
+  metrics->saturation_vp_kpa = psychrometrics_saturation_vp(temperature_c);
+  metrics->vapour_pressure_kpa = metrics->saturation_vp_kpa * fraction;
+  metrics->vpd_kpa = metrics->saturation_vp_kpa - metrics->vapour_pressure_kpa;
+  metrics->dew_point_c = psychrometrics_dew_point(metrics->vapour_pressure_kpa);
+  metrics->absolute_humidity_g_m3 = ABSOLUTE_HUMIDITY_SCALE * metrics->vapour_pressure_kpa /
+                                    (temperature_c + KELVIN_OFFSET);
+}
+
+/*!
+ * Cubic Hermite between table entries index and index + 1, fraction of the way along.
+ * The entries are 1 degC apart, so the slopes need no scaling.
+ */
+static float interpolate(int index, float fraction)
+{
+  float p0 = saturation_table[index];
+  float p1 = saturation_table[index + 1];
+  float m0 = slope_table[index];
+  float m1 = slope_table[index + 1];
+  float c2 = (3.0f * (p1 - p0)) - (2.0f * m0) - m1;
+  float c3 = (2.0f * (p0 - p1)) + m0 + m1;
+
+  return p0 + (fraction * (m0 + (fraction * (c2 + (fraction * c3)))));
+}
+
+/*!
+ * Natural log of a positive, finite value to about 1e-7 relative. value = m * 2^k with m in
+ * [sqrt(2)/2, sqrt(2)), then ln(m) = 2 atanh(s), s = (m - 1) / (m + 1), from four series terms
+ * (|s| < 0.172, so the first one left out is under 2e-8).
+ */
+static float log_approx(float value)
+{
+  uint32_t bits = 0;
+  int32_t power = 0;
+  float mantissa = 0;
+  float s = 0;
+  float s2 = 0;
+
+  memcpy(&bits, &value, sizeof(bits));
+  power = (int32_t) ((bits >> 23) & 0xff) - 127;
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  memcpy(&mantissa, &bits, sizeof(mantissa));
+  if (mantissa >= SQRT_2) {
+    mantissa *= 0.5f;
+    power++;
+  }
+
+  s = (mantissa - 1.0f) / (mantissa + 1.0f);
+  s2 = s * s;
+
+  return (power * LN_2) + (2.0f * s * (1.0f + (s2 * ((1.0f / 3.0f) + (s2 * ((1.0f / 5.0f) + (s2 / 7.0f)))))));
+}
+
+static float clamp(float value, float min, float max)
+{
+  if (value < min) {
+    return min;
+  }
+  if (value > max) {
+    return max;
+  }
+
+  return value;
+}
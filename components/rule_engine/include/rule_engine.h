@@ -0,0 +1,131 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#define RULE_TABLE_VERSION    2
+#define RULE_MAX_RULES        16
+#define RULE_MAX_CONDITIONS   4
+#define RULE_MAX_PREDICATES   32  // Distinct conditions across a table, one bit each
+#define RULE_STORAGE_KEY      "rules"
+
+// What the controller measures each sample
+typedef enum rule_input {
+  RULE_INPUT_TEMPERATURE = 0, // degC
+  RULE_INPUT_HUMIDITY,        // %Rh
+  RULE_INPUT_UV_A_DOSE,       // uJ/cm^2 since the start of the daylight period
+  RULE_INPUT_UV_B_DOSE,
+  RULE_INPUT_UV_C_DOSE,
+  RULE_INPUT_SOIL_WETNESS,    // %
+  RULE_INPUT_HOUR,            // Hours since local midnight, 13.5 = 1:30pm (one off on DST change days)
+  RULE_INPUT_PHOTOPERIOD,     // 1 inside the scheduled daylight period, 0 outside
+  RULE_INPUT_TEMPERATURE_FORECAST, // degC, highest over the forecast horizon with the fan off, PDLC as it is
+  RULE_INPUT_HUMIDITY_FORECAST,    // %Rh, likewise
+  RULE_INPUT_TEMPERATURE_FORECAST_CLEAR, // degC, highest with the fan on and the PDLC clear
+  RULE_INPUT_VPD,             // kPa, vapour pressure deficit
+  RULE_INPUT_DEW_POINT,       // degC
+  RULE_INPUT_COUNT
+} rule_input_t;
+
+typedef enum rule_op {
+  RULE_OP_AT_LEAST = 0,       // Input >= threshold, cleared below threshold - hysteresis
+  RULE_OP_BELOW,              // Input < threshold, cleared at threshold + hysteresis and up
+  RULE_OP_COUNT
+} rule_op_t;
+
+// What the rules decide. Every output is off unless a rule turns it on.
+typedef enum rule_output {
+  RULE_OUTPUT_DAYLIGHT = 0,   // UV dose is integrated while this is on
+  RULE_OUTPUT_LIGHTS,
+  RULE_OUTPUT_PDLC,
+  RULE_OUTPUT_FAN_TEMPERATURE, // Run the fan to bring the temperature down
+  RULE_OUTPUT_FAN_HUMIDITY,    // Run the fan to bring the humidity down
+  RULE_OUTPUT_COUNT
+} rule_output_t;
+
+#define RULE_OUTPUT_BIT(output) (1UL << (output))
+
+typedef enum rule_action {
+  RULE_ACTION_OFF = 0,
+  RULE_ACTION_ON
+} rule_action_t;
+
+typedef struct rule_condition {
+  uint8_t   input;            // rule_input_t
+  uint8_t   op;               // rule_op_t
+  float     threshold;
+  float     hysteresis;       // >= 0, in the units of the input
+} rule_condition_struct;
+
+// All conditions must hold. A rule without conditions always matches.
+typedef struct rule {
+  uint8_t               output;           // rule_output_t
+  uint8_t               action;           // rule_action_t
+  uint8_t               condition_count;
+  rule_condition_struct conditions[RULE_MAX_CONDITIONS];
+} rule_struct;
+
+/* The editable form, and what is kept in storage (header plus rule_count rules).
+ * For each output the first matching rule wins, so an OFF rule ahead of an ON rule
+ * acts as an override. */
+typedef struct rule_table {
+  uint16_t    version;        // RULE_TABLE_VERSION
+  uint16_t    rule_count;
+  uint16_t    fan_run_s;      // Length of one on/off fan run
+  uint16_t    max_fan_runs;   // Runs in a row before giving up for the hour
+  rule_struct rules[RULE_MAX_RULES];
+} rule_table_struct;
+
+typedef struct rule_predicate {
+  uint8_t   input;
+  float     set_level;
+  float     clear_level;
+  bool      is_below;
+} rule_predicate_struct;
+
+// One row of the decision table: matches when every bit in mask is set
+typedef struct rule_row {
+  uint32_t  mask;
+  uint8_t   output;
+  uint8_t   action;
+} rule_row_struct;
+
+/* Compiled table. Each distinct condition is tested once per sample into a bit,
+ * and each rule is a mask compare, so a sample costs at most RULE_MAX_PREDICATES
+ * comparisons plus RULE_MAX_RULES mask tests however the rules are written. */
+typedef struct rule_program {
+  rule_predicate_struct predicates[RULE_MAX_PREDICATES];
+  rule_row_struct       rows[RULE_MAX_RULES];
+  uint8_t               predicate_count;
+  uint8_t               row_count;
+  uint16_t              fan_run_s;
+  uint16_t              max_fan_runs;
+  uint32_t              generation;
+} rule_program_struct;
+
+/* Two compiled programs: the one being evaluated and the next one. A new table is
+ * compiled next to the running one and switched in at the start of the following
+ * evaluation, so a sample never sees half of a table. */
+typedef struct Rule_engine {
+  rule_program_struct programs[2];
+  rule_program_struct scratch;        // A load compiles here, so a failed one leaves programs[!active] alone
+  uint8_t             active;
+  bool                pending;        // programs[!active] is ready to take over
+  bool                loading;        // A load is compiling into programs[!active]
+  uint32_t            predicate_state; // Latched predicate bits of the active program
+  uint32_t            generation;
+  portMUX_TYPE        lock;
+} Rule_engine;
+
+esp_err_t                   rule_engine_init(Rule_engine *engine, const rule_table_struct *defaults);
+esp_err_t                   rule_engine_load(Rule_engine *engine, const rule_table_struct *table);
+esp_err_t                   rule_engine_store(Rule_engine *engine, const rule_table_struct *table);
+uint32_t                    rule_engine_evaluate(Rule_engine *engine, const float inputs[RULE_INPUT_COUNT]);
+const rule_program_struct*  rule_engine_get_program(const Rule_engine *engine);
+size_t                      rule_table_size(const rule_table_struct *table);
+
+#endif /* RULE_ENGINE_H */
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "platform_storage.h"
+#include "rule_engine.h"
+
+// Logger tag
+static const char *RULE_ENGINE_TAG = "Rule engine";
+
+// Private functions
+static esp_err_t compile(const rule_table_struct *table, rule_program_struct *program);
+static esp_err_t add_predicate(rule_program_struct *program, const rule_condition_struct *condition,
+  uint32_t *mask);
+
+
+/*!
+ * Public init function. Runs the table in storage if there is a valid one, the defaults otherwise.
+ */
+esp_err_t rule_engine_init(Rule_engine *engine, const rule_table_struct *defaults)
+{
+  // Too big for the caller's stack, and only needed until it's compiled
+  static rule_table_struct stored;
+  size_t length = sizeof(stored);
+  esp_err_t return_code = ESP_OK;
+
+  memset(engine, 0, sizeof(Rule_engine));
+  portMUX_INITIALIZE(&(engine->lock));
+
+  return_code = platform_storage_read(RULE_STORAGE_KEY, &stored, &length);
+  if ((return_code == ESP_OK) &&
+      ((length < offsetof(rule_table_struct, rules)) || (length != rule_table_size(&stored)))) {
+    return_code = ESP_ERR_INVALID_SIZE;
+  }
+  if (return_code == ESP_OK) {
+    return_code = compile(&stored, &(engine->programs[0]));
+  }
+
+  if (return_code == ESP_OK) {
+    ESP_LOGI(RULE_ENGINE_TAG, "Running %u stored rules.", stored.rule_count);
+  } else {
+    if (return_code != ESP_ERR_NOT_FOUND) {
+      ESP_LOGW(RULE_ENGINE_TAG, "Stored rules rejected (%s), using the defaults.", esp_err_to_name(return_code));
+    }
+
+    return_code = compile(defaults, &(engine->programs[0]));
+    if (return_code != ESP_OK) {
+      ESP_LOGE(RULE_ENGINE_TAG, "Default rules rejected: %s", esp_err_to_name(return_code));
+      return return_code;
+    }
+  }
+
+  engine->generation = 1;
+  engine->programs[0].generation = engine->generation;
+
+  return ESP_OK;
+}
+
+/*!
+ * Compile a table next to the running one. It takes over at the start of the next
+ * rule_engine_evaluate(); until then the old table keeps running. A table that doesn't
+ * compile changes nothing, not even a table still waiting to take over. Safe to call
+ * from any task, one load at a time.
+ */
+esp_err_t rule_engine_load(Rule_engine *engine, const rule_table_struct *table)
+{
+  esp_err_t return_code = ESP_OK;
+  rule_program_struct *next = NULL;
+
+  portENTER_CRITICAL(&(engine->lock));
+  if (engine->loading) {
+    portEXIT_CRITICAL(&(engine->lock));
+    return ESP_ERR_INVALID_STATE;
+  }
+  engine->loading = true;
+  portEXIT_CRITICAL(&(engine->lock));
+
+  return_code = compile(table, &(engine->scratch));
+  if (return_code != ESP_OK) {
+    portENTER_CRITICAL(&(engine->lock));
+    engine->loading = false;
+    portEXIT_CRITICAL(&(engine->lock));
+    return return_code;
+  }
+
+  // A table that was loaded but not picked up yet is replaced by this one. Nothing is
+  // pending while it's copied, so the evaluation doesn't switch to it half written.
+  portENTER_CRITICAL(&(engine->lock));
+  engine->pending = false;
+  next = &(engine->programs[!engine->active]);
+  portEXIT_CRITICAL(&(engine->lock));
+
+  *next = engine->scratch;
+
+  portENTER_CRITICAL(&(engine->lock));
+  next->generation = ++(engine->generation);
+  engine->pending = true;
+  engine->loading = false;
+  portEXIT_CRITICAL(&(engine->lock));
+
+  return ESP_OK;
+}
+
+/*!
+ * Load a table and keep it for the next boot. A table that doesn't compile is neither run nor stored.
+ */
+esp_err_t rule_engine_store(Rule_engine *engine, const rule_table_struct *table)
+{
+  esp_err_t return_code = rule_engine_load(engine, table);
+
+  if (return_code != ESP_OK) {
+    return return_code;
+  }
+
+  return platform_storage_write(RULE_STORAGE_KEY, table, rule_table_size(table));
+}
+
+/*!
+ * Run the decision table on one sample. Returns the rule_output_t bits that are on.
+ */
+uint32_t rule_engine_evaluate(Rule_engine *engine, const float inputs[RULE_INPUT_COUNT])
+{
+  const rule_program_struct *program = NULL;
+  uint32_t state = 0;
+  uint32_t decided = 0;
+  uint32_t outputs = 0;
+
+  portENTER_CRITICAL(&(engine->lock));
+  if (engine->pending) {
+    engine->active = !engine->active;
+    engine->pending = false;
+    // Different predicates, the latched bits don't carry over
+    engine->predicate_state = 0;
+  }
+  portEXIT_CRITICAL(&(engine->lock));
+
+  program = &(engine->programs[engine->active]);
+  state = engine->predicate_state;
+
+  for (uint8_t i = 0; i < program->predicate_count; i++) {
+    const rule_predicate_struct *predicate = &(program->predicates[i]);
+    float value = inputs[predicate->input];
+    uint32_t bit = 1UL << i;
+    // Once set, a predicate holds until the input passes the clear level
+    float level = (state & bit) ? predicate->clear_level : predicate->set_level;
+    bool is_set = predicate->is_below ? (value < level) : (value >= level);
+
+    state = is_set ? (state | bit) : (state & ~bit);
+  }
+  engine->predicate_state = state;
+
+  // First matching row decides each output
+  for (uint8_t i = 0; i < program->row_count; i++) {
+    const rule_row_struct *row = &(program->rows[i]);
+    uint32_t output_bit = RULE_OUTPUT_BIT(row->output);
+
+    if ((decided & output_bit) || ((state & row->mask) != row->mask)) {
+      continue;
+    }
+
+    decided |= output_bit;
+    if (row->action == RULE_ACTION_ON) {
+      outputs |= output_bit;
+    }
+  }
+
+  return outputs;
+}
+
+/*!
+ * The program rule_engine_evaluate() last ran. Only meaningful to the task that calls it.
+ */
+const rule_program_struct* rule_engine_get_program(const Rule_engine *engine)
+{
+  return &(engine->programs[engine->active]);
+}
+
+/*!
+ * Bytes a table takes in storage
+ */
+size_t rule_table_size(const rule_table_struct *table)
+{
+  return offsetof(rule_table_struct, rules) + ((size_t) table->rule_count * sizeof(rule_struct));
+}
+
+static esp_err_t compile(const rule_table_struct *table, rule_program_struct *program)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (table->version != RULE_TABLE_VERSION) {
+    return ESP_ERR_INVALID_VERSION;
+  }
+  if ((table->rule_count > RULE_MAX_RULES) || (table->fan_run_s == 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(program, 0, sizeof(rule_program_struct));
+  program->fan_run_s = table->fan_run_s;
+  program->max_fan_runs = table->max_fan_runs;
+
+  for (uint16_t i = 0; i < table->rule_count; i++) {
+    const rule_struct *rule = &(table->rules[i]);
+    rule_row_struct *row = &(program->rows[i]);
+
+    if ((rule->output >= RULE_OUTPUT_COUNT) || (rule->action > RULE_ACTION_ON) ||
+        (rule->condition_count > RULE_MAX_CONDITIONS)) {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    row->output = rule->output;
+    row->action = rule->action;
+    for (uint8_t j = 0; j < rule->condition_count; j++) {
+      return_code = add_predicate(program, &(rule->conditions[j]), &(row->mask));
+      if (return_code != ESP_OK) {
+        return return_code;
+      }
+    }
+  }
+  program->row_count = (uint8_t) table->rule_count;
+
+  return ESP_OK;
+}
+
+/*!
+ * Conditions that are written the same way share one predicate bit
+ */
+static esp_err_t add_predicate(rule_program_struct *program, const rule_condition_struct *condition,
+  uint32_t *mask)
+{
+  rule_predicate_struct predicate = {0};
+
+  if ((condition->input >= RULE_INPUT_COUNT) || (condition->op >= RULE_OP_COUNT) ||
+      !isfinite(condition->threshold) || !isfinite(condition->hysteresis) || (condition->hysteresis < 0)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  predicate.input = condition->input;
+  predicate.is_below = (condition->op == RULE_OP_BELOW);
+  predicate.set_level = condition->threshold;
+  predicate.clear_level = predicate.is_below ? (condition->threshold + condition->hysteresis) :
+                                               (condition->threshold - condition->hysteresis);
+
+  for (uint8_t i = 0; i < program->predicate_count; i++) {
+    const rule_predicate_struct *existing = &(program->predicates[i]);
+
+    if ((existing->input == predicate.input) && (existing->is_below == predicate.is_below) &&
+        (existing->set_level == predicate.set_level) && (existing->clear_level == predicate.clear_level)) {
+      *mask |= 1UL << i;
+      return ESP_OK;
+    }
+  }
+
+  if (program->predicate_count == RULE_MAX_PREDICATES) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  program->predicates[program->predicate_count] = predicate;
+  *mask |= 1UL << program->predicate_count;
+  program->predicate_count++;
+
+  return ESP_OK;
+}
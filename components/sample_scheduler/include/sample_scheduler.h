@@ -0,0 +1,55 @@
+#ifndef SAMPLE_SCHEDULER_H
+#define SAMPLE_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+// Supported sampling rates, in milli-Hertz (0.1 Hz to 100 Hz)
+#define SAMPLE_RATE_MIN_MILLIHZ 100
+#define SAMPLE_RATE_MAX_MILLIHZ 100000
+
+typedef struct sample_stats {
+  uint32_t cycles;            // Cycles started by the sampling task
+  uint32_t overruns;          // Cycles that finished after the next deadline
+  uint32_t missed_deadlines;  // Deadlines skipped because the previous cycle was still running
+  int64_t  last_jitter_us;    // Start latency of the latest cycle relative to its deadline
+  int64_t  min_jitter_us;
+  int64_t  max_jitter_us;
+  int64_t  total_jitter_us;   // Divide by cycles for the mean
+  int64_t  max_cycle_time_us;
+} sample_stats_struct;
+
+typedef struct Sample_scheduler {
+  esp_timer_handle_t  timer_handle;
+  TaskHandle_t        task_handle;
+  portMUX_TYPE        lock;
+
+  uint32_t            rate_millihz;
+  int64_t             period_us;
+
+  // Absolute deadlines on the esp_timer time base
+  int64_t             next_deadline_us;
+  int64_t             released_deadline_us;
+  int64_t             cycle_deadline_us;
+  int64_t             cycle_start_us;
+
+  bool                running;
+
+  sample_stats_struct stats;              // Under lock, other tasks take a copy with get_stats()
+
+  esp_err_t           (*start)(void);
+  esp_err_t           (*stop)(void);
+  esp_err_t           (*set_rate)(uint32_t rate_millihz);
+  bool                (*wait_for_cycle)(TickType_t timeout_ticks, int64_t *cycle_start_us);
+  void                (*end_cycle)(void);
+  sample_stats_struct (*get_stats)(void);
+  void                (*reset_stats)(void);
+} Sample_scheduler;
+
+esp_err_t sample_scheduler_init(Sample_scheduler *struct_ptr, uint32_t rate_millihz, TaskHandle_t task_handle);
+
+#endif /* SAMPLE_SCHEDULER_H */
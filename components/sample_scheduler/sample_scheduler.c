@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sample_scheduler.h"
+
+// Static private object pointer
+static Sample_scheduler *self;
+
+// Logger tag
+static const char *SCHEDULER_TAG = "Sample scheduler";
+
+// Private functions
+static void sample_timer_callback(void *arg);
+static int64_t rate_to_period_us(uint32_t rate_millihz);
+
+// Public functions provided via struct fn pointers
+static esp_err_t _sample_scheduler_start(void);
+static esp_err_t _sample_scheduler_stop(void);
+static esp_err_t _sample_scheduler_set_rate(uint32_t rate_millihz);
+static bool _sample_scheduler_wait_for_cycle(TickType_t timeout_ticks, int64_t *cycle_start_us);
+static void _sample_scheduler_end_cycle(void);
+static sample_stats_struct _sample_scheduler_get_stats(void);
+static void _sample_scheduler_reset_stats(void);
+
+
+/*!
+ * Public init function. The task handle is the task that will call wait_for_cycle().
+ */
+esp_err_t sample_scheduler_init(Sample_scheduler *struct_ptr, uint32_t rate_millihz, TaskHandle_t task_handle)
+{
+  esp_err_t return_code = ESP_OK;
+  esp_timer_create_args_t timer_args = {
+    .callback = sample_timer_callback,
+    .arg = NULL,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "Sample timer",
+    .skip_unhandled_events = false
+  };
+
+  if ((rate_millihz < SAMPLE_RATE_MIN_MILLIHZ) || (rate_millihz > SAMPLE_RATE_MAX_MILLIHZ)) {
+    ESP_LOGE(SCHEDULER_TAG, "Sample rate %" PRIu32 " mHz out of range.", rate_millihz);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Assign private object pointer
+  self = struct_ptr;
+
+  // Assign struct fields
+  memset(self, 0, sizeof(Sample_scheduler));
+  portMUX_INITIALIZE(&(self->lock));
+  self->task_handle = task_handle;
+  self->rate_millihz = rate_millihz;
+  self->period_us = rate_to_period_us(rate_millihz);
+  self->running = false;
+  self->start = _sample_scheduler_start;
+  self->stop = _sample_scheduler_stop;
+  self->set_rate = _sample_scheduler_set_rate;
+  self->wait_for_cycle = _sample_scheduler_wait_for_cycle;
+  self->end_cycle = _sample_scheduler_end_cycle;
+  self->get_stats = _sample_scheduler_get_stats;
+  self->reset_stats = _sample_scheduler_reset_stats;
+
+  self->reset_stats();
+
+  // One-shot timer, re-armed against an absolute deadline on each expiry so that
+  // callback latency never accumulates into the sample period
+  return_code = esp_timer_create(&timer_args, &(self->timer_handle));
+  if (return_code != ESP_OK) {
+    ESP_LOGE(SCHEDULER_TAG, "Failed to create sample timer.");
+  }
+
+  return return_code;
+}
+
+/*!
+ * Start releasing cycles, the first one period from now
+ */
+static esp_err_t _sample_scheduler_start(void)
+{
+  esp_err_t return_code = ESP_OK;
+
+  if (self->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  portENTER_CRITICAL(&(self->lock));
+  self->next_deadline_us = esp_timer_get_time() + self->period_us;
+  self->running = true;
+  portEXIT_CRITICAL(&(self->lock));
+
+  return_code = esp_timer_start_once(self->timer_handle, self->period_us);
+  if (return_code != ESP_OK) {
+    self->running = false;
+    ESP_LOGE(SCHEDULER_TAG, "Failed to start sample timer.");
+  }
+
+  return return_code;
+}
+
+/*!
+ * Stop releasing cycles
+ */
+static esp_err_t _sample_scheduler_stop(void)
+{
+  if (!self->running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  self->running = false;
+  esp_timer_stop(self->timer_handle);
+
+  return ESP_OK;
+}
+
+/*!
+ * Change the sample rate. The new period takes effect from the next deadline.
+ */
+static esp_err_t _sample_scheduler_set_rate(uint32_t rate_millihz)
+{
+  bool was_running = self->running;
+
+  if ((rate_millihz < SAMPLE_RATE_MIN_MILLIHZ) || (rate_millihz > SAMPLE_RATE_MAX_MILLIHZ)) {
+    ESP_LOGE(SCHEDULER_TAG, "Sample rate %" PRIu32 " mHz out of range.", rate_millihz);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (was_running) {
+    self->stop();
+  }
+
+  self->rate_millihz = rate_millihz;
+  self->period_us = rate_to_period_us(rate_millihz);
+  self->reset_stats();
+
+  if (was_running) {
+    return self->start();
+  }
+
+  return ESP_OK;
+}
+
+/*!
+ * Block until the next cycle is released. Returns false on timeout. On success the
+ * cycle start time (esp_timer time base, uSec) is written to cycle_start_us.
+ */
+static bool _sample_scheduler_wait_for_cycle(TickType_t timeout_ticks, int64_t *cycle_start_us)
+{
+  uint32_t releases = ulTaskNotifyTake(pdTRUE, timeout_ticks);
+  int64_t start_time = esp_timer_get_time();
+  int64_t deadline = 0;
+  int64_t jitter = 0;
+
+  if (releases == 0) {
+    return false;
+  }
+
+  // The stats are read from other tasks, and their 64-bit members can't be written in one go
+  portENTER_CRITICAL(&(self->lock));
+  deadline = self->released_deadline_us;
+  // More than one pending release means the task slept through a deadline
+  self->stats.missed_deadlines += (releases - 1);
+
+  jitter = start_time - deadline;
+
+  self->stats.cycles++;
+  self->stats.last_jitter_us = jitter;
+  self->stats.total_jitter_us += jitter;
+  if (jitter < self->stats.min_jitter_us) {
+    self->stats.min_jitter_us = jitter;
+  }
+  if (jitter > self->stats.max_jitter_us) {
+    self->stats.max_jitter_us = jitter;
+  }
+  portEXIT_CRITICAL(&(self->lock));
+
+  self->cycle_deadline_us = deadline;
+  self->cycle_start_us = start_time;
+
+  if (cycle_start_us != NULL) {
+    *cycle_start_us = start_time;
+  }
+
+  return true;
+}
+
+/*!
+ * Mark the end of the current cycle's work for overrun accounting
+ */
+static void _sample_scheduler_end_cycle(void)
+{
+  int64_t end_time = esp_timer_get_time();
+  int64_t cycle_time = end_time - self->cycle_start_us;
+
+  portENTER_CRITICAL(&(self->lock));
+  if (cycle_time > self->stats.max_cycle_time_us) {
+    self->stats.max_cycle_time_us = cycle_time;
+  }
+
+  if (end_time > (self->cycle_deadline_us + self->period_us)) {
+    self->stats.overruns++;
+  }
+  portEXIT_CRITICAL(&(self->lock));
+}
+
+/*!
+ * A consistent copy of the stats, safe to take from any task
+ */
+static sample_stats_struct _sample_scheduler_get_stats(void)
+{
+  sample_stats_struct stats;
+
+  portENTER_CRITICAL(&(self->lock));
+  stats = self->stats;
+  portEXIT_CRITICAL(&(self->lock));
+
+  return stats;
+}
+
+static void _sample_scheduler_reset_stats(void)
+{
+  portENTER_CRITICAL(&(self->lock));
+  memset(&(self->stats), 0, sizeof(sample_stats_struct));
+  self->stats.min_jitter_us = INT64_MAX;
+  self->stats.max_jitter_us = INT64_MIN;
+  portEXIT_CRITICAL(&(self->lock));
+}
+
+/*!
+ * esp_timer callback -- keep this short, it runs in the esp_timer task
+ */
+static void sample_timer_callback(void *arg)
+{
+  int64_t now = esp_timer_get_time();
+  int64_t skipped = 0;
+
+  if (!self->running) {
+    return;
+  }
+
+  portENTER_CRITICAL(&(self->lock));
+  self->released_deadline_us = self->next_deadline_us;
+  self->next_deadline_us += self->period_us;
+
+  // If the timer itself fell more than a period behind, skip ahead on the same grid
+  // rather than releasing a burst of back-to-back cycles
+  if (self->next_deadline_us <= now) {
+    skipped = ((now - self->next_deadline_us) / self->period_us) + 1;
+    self->next_deadline_us += skipped * self->period_us;
+    self->stats.missed_deadlines += (uint32_t) skipped;
+  }
+  portEXIT_CRITICAL(&(self->lock));
+
+  esp_timer_start_once(self->timer_handle, self->next_deadline_us - now);
+
+  xTaskNotifyGive(self->task_handle);
+}
+
+static int64_t rate_to_period_us(uint32_t rate_millihz)
+{
+  return (int64_t) 1000000000LL / rate_millihz;
+}
@@ -0,0 +1,70 @@
+#ifndef TASK_PLACEMENT_H
+#define TASK_PLACEMENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#define MAX_PLANNED_TASKS 8
+#define MAX_TRACKED_TASKS 32
+
+// Real-time tasks (acquisition, control) share one core, everything else the other
+typedef enum task_class {
+  TASK_CLASS_REALTIME = 0,
+  TASK_CLASS_BACKGROUND = 1
+} task_class_t;
+
+typedef struct task_plan_entry {
+  TaskFunction_t  function;
+  const char      *name;
+  uint32_t        stack_size;
+  task_class_t    task_class;
+  uint32_t        deadline_ms;    // Relative deadline, drives the priority assignment
+  TaskHandle_t    *handle;
+
+  // Filled in by create_tasks()
+  UBaseType_t     priority;
+  BaseType_t      core_id;
+} task_plan_entry_struct;
+
+typedef struct cpu_usage {
+  const char      *name;
+  BaseType_t      core_id;        // tskNO_AFFINITY if the task floats
+  UBaseType_t     priority;
+  uint32_t        runtime_us;     // Run time over the last accounting interval
+  uint32_t        permille;       // Share of one core over the last interval
+  uint32_t        stack_high_water;
+} cpu_usage_struct;
+
+typedef struct cpu_usage_report {
+  uint32_t          interval_us;
+  size_t            task_count;
+  cpu_usage_struct  tasks[MAX_TRACKED_TASKS];
+
+  // Load on the real-time core from tasks that were not planned as real-time
+  uint32_t          rt_core_foreign_permille;
+  // Load from tasks with no affinity, which may have landed on either core
+  uint32_t          floating_permille;
+} cpu_usage_report_struct;
+
+typedef struct Task_placement {
+  task_plan_entry_struct  *plan;
+  size_t                  plan_length;
+
+  BaseType_t              realtime_core;
+  BaseType_t              background_core;
+  UBaseType_t             base_priority;
+
+  uint32_t                last_total_runtime;
+
+  esp_err_t               (*create_tasks)(void);
+  esp_err_t               (*get_cpu_usage)(cpu_usage_report_struct *report);
+  void                    (*log_cpu_usage)(void);
+} Task_placement;
+
+esp_err_t task_placement_init(Task_placement *struct_ptr, task_plan_entry_struct *plan, size_t plan_length,
+  BaseType_t realtime_core, BaseType_t background_core, UBaseType_t base_priority);
+
+#endif /* TASK_PLACEMENT_H */
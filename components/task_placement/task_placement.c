@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "task_placement.h"
+
+// Static private object pointer
+static Task_placement *self;
+
+// Logger tag
+static const char *PLACEMENT_TAG = "Task placement";
+
+// Previous run time snapshot, used to turn the cumulative counters into per-interval deltas
+static TaskStatus_t task_status[MAX_TRACKED_TASKS];
+static TaskHandle_t previous_handles[MAX_TRACKED_TASKS];
+static uint32_t     previous_runtimes[MAX_TRACKED_TASKS];
+static size_t       previous_count = 0;
+
+// Private functions
+static void assign_priorities(void);
+static task_plan_entry_struct* find_plan_entry(TaskHandle_t handle);
+static uint32_t previous_runtime_for(TaskHandle_t handle);
+
+// Public functions provided via struct fn pointers
+static esp_err_t _task_placement_create_tasks(void);
+static esp_err_t _task_placement_get_cpu_usage(cpu_usage_report_struct *report);
+static void _task_placement_log_cpu_usage(void);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t task_placement_init(Task_placement *struct_ptr, task_plan_entry_struct *plan, size_t plan_length,
+  BaseType_t realtime_core, BaseType_t background_core, UBaseType_t base_priority)
+{
+  if ((plan == NULL) || (plan_length == 0) || (plan_length > MAX_PLANNED_TASKS)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+#if (portNUM_PROCESSORS == 1)
+  // Single core builds (e.g. the linux host build) run the whole plan on core 0
+  realtime_core = 0;
+  background_core = 0;
+#endif
+
+  if ((realtime_core >= portNUM_PROCESSORS) || (background_core >= portNUM_PROCESSORS)) {
+    ESP_LOGE(PLACEMENT_TAG, "Core ID out of range.");
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Assign private object pointer
+  self = struct_ptr;
+
+  // Assign struct fields
+  self->plan = plan;
+  self->plan_length = plan_length;
+  self->realtime_core = realtime_core;
+  self->background_core = background_core;
+  self->base_priority = base_priority;
+  self->last_total_runtime = 0;
+  self->create_tasks = _task_placement_create_tasks;
+  self->get_cpu_usage = _task_placement_get_cpu_usage;
+  self->log_cpu_usage = _task_placement_log_cpu_usage;
+
+  assign_priorities();
+
+  for (size_t i = 0; i < self->plan_length; i++) {
+    if (self->plan[i].priority >= (configMAX_PRIORITIES - 1)) {
+      ESP_LOGE(PLACEMENT_TAG, "Derived priority for %s exceeds configMAX_PRIORITIES.", self->plan[i].name);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  return ESP_OK;
+}
+
+/*!
+ * Create every task in the plan pinned to its core
+ */
+static esp_err_t _task_placement_create_tasks(void)
+{
+  BaseType_t created = pdFAIL;
+
+  for (size_t i = 0; i < self->plan_length; i++) {
+    task_plan_entry_struct *entry = &(self->plan[i]);
+
+    ESP_LOGI(PLACEMENT_TAG, "%s: core %d, priority %u, deadline %" PRIu32 " ms", entry->name, (int)entry->core_id,
+      (unsigned)entry->priority, entry->deadline_ms);
+
+    created = xTaskCreatePinnedToCore(entry->function, entry->name, entry->stack_size, NULL, entry->priority,
+                entry->handle, entry->core_id);
+    if (created != pdPASS) {
+      ESP_LOGE(PLACEMENT_TAG, "Failed to create %s.", entry->name);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  return ESP_OK;
+}
+
+/*!
+ * Per-task CPU time since the previous call. Needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ */
+static esp_err_t _task_placement_get_cpu_usage(cpu_usage_report_struct *report)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+  uint32_t total_runtime = 0;
+  uint32_t interval = 0;
+  UBaseType_t task_count = 0;
+
+  memset(report, 0, sizeof(cpu_usage_report_struct));
+
+  task_count = uxTaskGetSystemState(task_status, MAX_TRACKED_TASKS, &total_runtime);
+  if (task_count == 0) {
+    // More tasks than we have room to track
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // Unsigned subtraction handles counter wrap
+  interval = total_runtime - self->last_total_runtime;
+  if (interval == 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  report->interval_us = interval;
+  report->task_count = task_count;
+
+  for (UBaseType_t i = 0; i < task_count; i++) {
+    TaskStatus_t *status = &(task_status[i]);
+    cpu_usage_struct *usage = &(report->tasks[i]);
+    task_plan_entry_struct *entry = find_plan_entry(status->xHandle);
+
+    usage->name = status->pcTaskName;
+    usage->core_id = xTaskGetAffinity(status->xHandle);
+    usage->priority = status->uxCurrentPriority;
+    usage->runtime_us = status->ulRunTimeCounter - previous_runtime_for(status->xHandle);
+    usage->permille = (uint32_t)(((uint64_t)usage->runtime_us * 1000) / interval);
+    usage->stack_high_water = status->usStackHighWaterMark;
+
+    if (usage->core_id == tskNO_AFFINITY) {
+      report->floating_permille += usage->permille;
+    } else if ((usage->core_id == self->realtime_core) && (strncmp(usage->name, "IDLE", 4) != 0) &&
+               ((entry == NULL) || (entry->task_class != TASK_CLASS_REALTIME))) {
+      report->rt_core_foreign_permille += usage->permille;
+    }
+  }
+
+  // Save the snapshot for the next interval
+  for (UBaseType_t i = 0; i < task_count; i++) {
+    previous_handles[i] = task_status[i].xHandle;
+    previous_runtimes[i] = task_status[i].ulRunTimeCounter;
+  }
+  previous_count = task_count;
+  self->last_total_runtime = total_runtime;
+
+  return ESP_OK;
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/*!
+ * Log the CPU usage since the previous call
+ */
+static void _task_placement_log_cpu_usage(void)
+{
+  static cpu_usage_report_struct report;
+  esp_err_t return_code = self->get_cpu_usage(&report);
+
+  if (return_code != ESP_OK) {
+    ESP_LOGW(PLACEMENT_TAG, "CPU usage unavailable: %s", esp_err_to_name(return_code));
+    return;
+  }
+
+  ESP_LOGI(PLACEMENT_TAG, "CPU usage over %" PRIu32 " ms:", report.interval_us / 1000);
+  for (size_t i = 0; i < report.task_count; i++) {
+    cpu_usage_struct *usage = &(report.tasks[i]);
+    if (usage->core_id == tskNO_AFFINITY) {
+      ESP_LOGI(PLACEMENT_TAG, "  %-16s core -  prio %2u  %3" PRIu32 ".%" PRIu32 "%%  stack free %" PRIu32, usage->name,
+        (unsigned)usage->priority, usage->permille / 10, usage->permille % 10, usage->stack_high_water);
+    } else {
+      ESP_LOGI(PLACEMENT_TAG, "  %-16s core %d  prio %2u  %3" PRIu32 ".%" PRIu32 "%%  stack free %" PRIu32, usage->name,
+        (int)usage->core_id, (unsigned)usage->priority, usage->permille / 10, usage->permille % 10,
+        usage->stack_high_water);
+    }
+  }
+  ESP_LOGI(PLACEMENT_TAG, "Non-real-time load on core %d: %" PRIu32 ".%" PRIu32 "%%, "
+    "floating tasks: %" PRIu32 ".%" PRIu32 "%%", (int)self->realtime_core,
+    report.rt_core_foreign_permille / 10, report.rt_core_foreign_permille % 10,
+    report.floating_permille / 10, report.floating_permille % 10);
+}
+
+/*!
+ * Deadline-monotonic assignment: the shorter the deadline, the higher the priority.
+ * Tasks with equal deadlines share a priority level.
+ */
+static void assign_priorities(void)
+{
+  for (size_t i = 0; i < self->plan_length; i++) {
+    task_plan_entry_struct *entry = &(self->plan[i]);
+    UBaseType_t longer_deadlines = 0;
+
+    // Count the distinct deadlines longer than this one
+    for (size_t j = 0; j < self->plan_length; j++) {
+      bool counted = false;
+
+      if (self->plan[j].deadline_ms <= entry->deadline_ms) {
+        continue;
+      }
+      for (size_t k = 0; k < j; k++) {
+        if (self->plan[k].deadline_ms == self->plan[j].deadline_ms) {
+          counted = true;
+          break;
+        }
+      }
+      if (!counted) {
+        longer_deadlines++;
+      }
+    }
+
+    entry->priority = self->base_priority + longer_deadlines;
+    entry->core_id = (entry->task_class == TASK_CLASS_REALTIME) ? self->realtime_core : self->background_core;
+  }
+}
+
+static task_plan_entry_struct* find_plan_entry(TaskHandle_t handle)
+{
+  for (size_t i = 0; i < self->plan_length; i++) {
+    if ((self->plan[i].handle != NULL) && (*(self->plan[i].handle) == handle)) {
+      return &(self->plan[i]);
+    }
+  }
+
+  return NULL;
+}
+
+static uint32_t previous_runtime_for(TaskHandle_t handle)
+{
+  for (size_t i = 0; i < previous_count; i++) {
+    if (previous_handles[i] == handle) {
+      return previous_runtimes[i];
+    }
+  }
+
+  // New task since the last snapshot
+  return 0;
+}
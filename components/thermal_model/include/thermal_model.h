@@ -0,0 +1,59 @@
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+// Model updates before forecasts are trusted
+#define THERMAL_MODEL_MIN_UPDATES       8
+
+// Starting covariance, large so the first few steps move the parameters freely
+#define THERMAL_MODEL_INITIAL_COVARIANCE 100.0f
+
+// Forgetting stops while the covariance is this large, so it can't wind up while nothing changes
+#define THERMAL_MODEL_MAX_COVARIANCE    1000.0f
+
+// What drives the measured value, each 0 (off) to 1 (fully on)
+typedef enum thermal_model_input {
+  THERMAL_INPUT_FAN = 0,        // Fan duty
+  THERMAL_INPUT_PDLC,           // PDLC clear, letting the sun in
+  THERMAL_INPUT_COUNT
+} thermal_model_input_t;
+
+// Previous value, the inputs and a constant (heat from outside, the sun)
+#define THERMAL_MODEL_PARAMETERS        (THERMAL_INPUT_COUNT + 2)
+
+/* First order model of one quantity (temperature or humidity), one step of step_s:
+ *   x[k] - ref = a * (x[k-1] - ref) + b_fan * fan[k] + b_pdlc * pdlc[k] + c
+ * fitted by recursive least squares with exponential forgetting. Samples are averaged
+ * over a step first, so sample noise and the sample rate don't reach the fit. */
+typedef struct Thermal_model {
+  float     theta[THERMAL_MODEL_PARAMETERS];    // a, b_fan, b_pdlc, c
+  float     covariance[THERMAL_MODEL_PARAMETERS][THERMAL_MODEL_PARAMETERS];
+  float     reference;                          // Values are fitted relative to this, e.g. the threshold
+  float     forgetting;                         // Per step, (0, 1]
+  uint32_t  step_s;
+  uint32_t  updates;
+  float     error;                              // Smoothed absolute one step prediction error
+
+  // The step being averaged
+  time_t    step_start;
+  uint32_t  samples;
+  float     sum_value;
+  float     sum_inputs[THERMAL_INPUT_COUNT];
+
+  // The last complete step
+  float     previous_value;
+  bool      has_previous;
+} Thermal_model;
+
+esp_err_t thermal_model_init(Thermal_model *model, uint32_t step_s, float forgetting, float reference);
+void      thermal_model_reset(Thermal_model *model);
+void      thermal_model_add(Thermal_model *model, time_t now, float value, const float inputs[THERMAL_INPUT_COUNT]);
+bool      thermal_model_is_ready(const Thermal_model *model);
+float     thermal_model_forecast(const Thermal_model *model, float value, const float inputs[THERMAL_INPUT_COUNT],
+            uint32_t horizon_s);
+
+#endif /* THERMAL_MODEL_H */
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "thermal_model.h"
+
+#define PERSISTENCE   0   // theta index of a
+#define ERROR_WEIGHT  0.1f
+
+// Private functions
+static void finish_step(Thermal_model *model);
+static void update(Thermal_model *model, const float regressors[THERMAL_MODEL_PARAMETERS], float measured);
+
+
+/*!
+ * Public init function
+ */
+esp_err_t thermal_model_init(Thermal_model *model, uint32_t step_s, float forgetting, float reference)
+{
+  if ((step_s == 0) || !(forgetting > 0) || (forgetting > 1.0f)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  model->step_s = step_s;
+  model->forgetting = forgetting;
+  model->reference = reference;
+  thermal_model_reset(model);
+
+  return ESP_OK;
+}
+
+/*!
+ * Forget the fit: back to "the value stays where it is"
+ */
+void thermal_model_reset(Thermal_model *model)
+{
+  memset(model->theta, 0, sizeof(model->theta));
+  memset(model->covariance, 0, sizeof(model->covariance));
+  model->theta[PERSISTENCE] = 1.0f;
+  for (int i = 0; i < THERMAL_MODEL_PARAMETERS; i++) {
+    model->covariance[i][i] = THERMAL_MODEL_INITIAL_COVARIANCE;
+  }
+
+  model->updates = 0;
+  model->error = 0;
+  model->samples = 0;
+  model->has_previous = false;
+}
+
+/*!
+ * Add one sample with the inputs that were applied up to it. A gap of a step or more, or the
+ * clock going backwards, starts the averaging over without updating the fit.
+ */
+void thermal_model_add(Thermal_model *model, time_t now, float value, const float inputs[THERMAL_INPUT_COUNT])
+{
+  time_t elapsed = now - model->step_start;
+
+  if (model->samples > 0) {
+    if ((elapsed < 0) || (elapsed >= (time_t)(2 * model->step_s))) {
+      model->samples = 0;
+      model->has_previous = false;
+    } else if (elapsed >= (time_t) model->step_s) {
+      finish_step(model);
+    }
+  }
+
+  if (model->samples == 0) {
+    model->step_start = now;
+    model->sum_value = 0;
+    memset(model->sum_inputs, 0, sizeof(model->sum_inputs));
+  }
+
+  model->sum_value += value;
+  for (int i = 0; i < THERMAL_INPUT_COUNT; i++) {
+    model->sum_inputs[i] += inputs[i];
+  }
+  model->samples++;
+}
+
+bool thermal_model_is_ready(const Thermal_model *model)
+{
+  return model->updates >= THERMAL_MODEL_MIN_UPDATES;
+}
+
+/*!
+ * Highest value over the next horizon_s, starting at value with the inputs held where they
+ * are. The persistence is capped at 1 so a poor fit can't make the forecast run away.
+ */
+float thermal_model_forecast(const Thermal_model *model, float value, const float inputs[THERMAL_INPUT_COUNT],
+  uint32_t horizon_s)
+{
+  uint32_t steps = (horizon_s + model->step_s - 1) / model->step_s;
+  float persistence = fminf(fmaxf(model->theta[PERSISTENCE], 0), 1.0f);
+  float drive = model->theta[THERMAL_MODEL_PARAMETERS - 1];
+  float deviation = value - model->reference;
+  float peak = deviation;
+
+  for (int i = 0; i < THERMAL_INPUT_COUNT; i++) {
+    drive += model->theta[i + 1] * inputs[i];
+  }
+
+  for (uint32_t step = 0; step < steps; step++) {
+    deviation = (persistence * deviation) + drive;
+    peak = fmaxf(peak, deviation);
+  }
+
+  return peak + model->reference;
+}
+
+/*!
+ * Close the step being averaged and fit the change since the previous one
+ */
+static void finish_step(Thermal_model *model)
+{
+  float regressors[THERMAL_MODEL_PARAMETERS];
+  float mean = model->sum_value / model->samples;
+
+  if (model->has_previous) {
+    regressors[PERSISTENCE] = model->previous_value - model->reference;
+    for (int i = 0; i < THERMAL_INPUT_COUNT; i++) {
+      regressors[i + 1] = model->sum_inputs[i] / model->samples;
+    }
+    regressors[THERMAL_MODEL_PARAMETERS - 1] = 1.0f;
+
+    update(model, regressors, mean - model->reference);
+  }
+
+  model->previous_value = mean;
+  model->has_previous = true;
+  model->samples = 0;
+}
+
+/*!
+ * Recursive least squares:
+ *   gain = P phi / (lambda + phi' P phi)
+ *   theta += gain * (y - theta' phi)
+ *   P = (P - gain phi' P) / lambda
+ */
+static void update(Thermal_model *model, const float regressors[THERMAL_MODEL_PARAMETERS], float measured)
+{
+  float p_phi[THERMAL_MODEL_PARAMETERS] = {0};
+  float gain[THERMAL_MODEL_PARAMETERS];
+  float denominator = 0;
+  float predicted = 0;
+  float trace = 0;
+  float forgetting = model->forgetting;
+
+  for (int i = 0; i < THERMAL_MODEL_PARAMETERS; i++) {
+    for (int j = 0; j < THERMAL_MODEL_PARAMETERS; j++) {
+      p_phi[i] += model->covariance[i][j] * regressors[j];
+    }
+    denominator += regressors[i] * p_phi[i];
+    predicted += model->theta[i] * regressors[i];
+    trace += model->covariance[i][i];
+  }
+
+  if (trace > THERMAL_MODEL_MAX_COVARIANCE) {
+    forgetting = 1.0f;
+  }
+  denominator += forgetting;
+
+  for (int i = 0; i < THERMAL_MODEL_PARAMETERS; i++) {
+    gain[i] = p_phi[i] / denominator;
+    model->theta[i] += gain[i] * (measured - predicted);
+  }
+
+  // P is symmetric, so phi' P is p_phi transposed; update both halves from the upper one
+  for (int i = 0; i < THERMAL_MODEL_PARAMETERS; i++) {
+    for (int j = i; j < THERMAL_MODEL_PARAMETERS; j++) {
+      model->covariance[i][j] = (model->covariance[i][j] - (gain[i] * p_phi[j])) / forgetting;
+      model->covariance[j][i] = model->covariance[i][j];
+    }
+  }
+
+  model->error += ERROR_WEIGHT * (fabsf(measured - predicted) - model->error);
+  model->updates++;
+}
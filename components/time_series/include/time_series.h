@@ -0,0 +1,55 @@
+#ifndef TIME_SERIES_H
+#define TIME_SERIES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Most samples a window can hold; faster samples are thinned out so they cover the whole span
+#define TIME_SERIES_CAPACITY    64
+
+// Fewest samples a slope is reported for
+#define TIME_SERIES_MIN_SAMPLES 3
+
+// Sample times are kept in ms relative to an origin that is moved forward once they get this large
+#define TIME_SERIES_REBASE_MS   (1L << 24)
+
+// Longest window span, so the least-squares sums can't overflow
+#define TIME_SERIES_MAX_SPAN_MS (TIME_SERIES_REBASE_MS / 2)
+
+typedef enum time_series_channel {
+  TS_TEMPERATURE = 0,   // degC
+  TS_HUMIDITY,          // %Rh
+  TS_CHANNEL_COUNT
+} time_series_channel_t;
+
+// Values are stored as hundredths to keep the window small and the sums exact
+typedef struct time_series_sample {
+  int32_t   x;                          // Milliseconds since the series origin
+  int16_t   y[TS_CHANNEL_COUNT];        // Hundredths of a unit
+} time_series_sample_struct;
+
+typedef struct Time_series {
+  time_series_sample_struct samples[TIME_SERIES_CAPACITY];
+  uint32_t  span_ms;                    // Samples this much older than the newest one drop out
+  uint32_t  spacing_ms;                 // Closest two samples are kept, so the window covers the span
+  size_t    head;                       // Next slot to write
+  size_t    count;
+  int64_t   origin_us;
+
+  // Running least-squares sums over the window, updated in O(1) per sample
+  int64_t   sum_x;
+  int64_t   sum_xx;
+  int64_t   sum_y[TS_CHANNEL_COUNT];
+  int64_t   sum_xy[TS_CHANNEL_COUNT];
+} Time_series;
+
+esp_err_t time_series_init(Time_series *series, uint32_t span_ms);
+void      time_series_set_span(Time_series *series, uint32_t span_ms);
+void      time_series_clear(Time_series *series);
+void      time_series_add(Time_series *series, int64_t time_us, float temperature, float humidity);
+size_t    time_series_count(const Time_series *series);
+esp_err_t time_series_get_slope(const Time_series *series, time_series_channel_t channel, float *per_minute);
+
+#endif /* TIME_SERIES_H */
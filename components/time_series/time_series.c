@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "time_series.h"
+
+// Private functions
+static int16_t to_hundredths(float value);
+static size_t oldest_index(const Time_series *series);
+static size_t newest_index(const Time_series *series);
+static void drop_older_than(Time_series *series, int64_t x);
+static void add_to_sums(Time_series *series, const time_series_sample_struct *sample);
+static void remove_from_sums(Time_series *series, const time_series_sample_struct *sample);
+static void rebase(Time_series *series);
+
+
+/*!
+ * Public init function. The window covers span_ms back from the newest sample.
+ */
+esp_err_t time_series_init(Time_series *series, uint32_t span_ms)
+{
+  if (span_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  series->span_ms = 0;
+  time_series_clear(series);
+  time_series_set_span(series, span_ms);
+
+  return ESP_OK;
+}
+
+/*!
+ * Change the window span, at most TIME_SERIES_MAX_SPAN_MS. A shorter span drops the samples it no longer covers.
+ */
+void time_series_set_span(Time_series *series, uint32_t span_ms)
+{
+  if (span_ms > TIME_SERIES_MAX_SPAN_MS) {
+    span_ms = TIME_SERIES_MAX_SPAN_MS;
+  }
+  if ((span_ms == 0) || (span_ms == series->span_ms)) {
+    return;
+  }
+
+  series->span_ms = span_ms;
+  series->spacing_ms = span_ms / (TIME_SERIES_CAPACITY - 1);
+
+  if (series->count > 0) {
+    drop_older_than(series, (int64_t) series->samples[newest_index(series)].x - span_ms);
+  }
+}
+
+void time_series_clear(Time_series *series)
+{
+  series->head = 0;
+  series->count = 0;
+  series->origin_us = 0;
+  series->sum_x = 0;
+  series->sum_xx = 0;
+  memset(series->sum_y, 0, sizeof(series->sum_y));
+  memset(series->sum_xy, 0, sizeof(series->sum_xy));
+}
+
+/*!
+ * Push a sample taken at time_us, dropping the ones that have aged out of the span. A sample closer
+ * than spacing_ms to the last one kept is skipped, so the window holds the whole span at any rate.
+ */
+void time_series_add(Time_series *series, int64_t time_us, float temperature, float humidity)
+{
+  time_series_sample_struct *slot = NULL;
+  int64_t x = 0;
+
+  if (series->count == 0) {
+    series->origin_us = time_us;
+  }
+
+  // A clock step backwards or a gap longer than the rebase span makes the window meaningless
+  x = (time_us - series->origin_us) / 1000;
+  if ((time_us < series->origin_us) ||
+      ((series->count > 0) && ((x < series->samples[newest_index(series)].x) ||
+                               ((x - series->samples[oldest_index(series)].x) >= TIME_SERIES_REBASE_MS)))) {
+    time_series_clear(series);
+    series->origin_us = time_us;
+    x = 0;
+  }
+
+  if ((series->count > 0) && ((x - series->samples[newest_index(series)].x) < series->spacing_ms)) {
+    return;
+  }
+
+  if (x >= TIME_SERIES_REBASE_MS) {
+    rebase(series);
+    x = (time_us - series->origin_us) / 1000;
+  }
+
+  drop_older_than(series, x - series->span_ms);
+  if (series->count == TIME_SERIES_CAPACITY) {
+    remove_from_sums(series, &(series->samples[oldest_index(series)]));
+    series->count--;
+  }
+
+  slot = &(series->samples[series->head]);
+  slot->x = (int32_t) x;
+  slot->y[TS_TEMPERATURE] = to_hundredths(temperature);
+  slot->y[TS_HUMIDITY] = to_hundredths(humidity);
+  add_to_sums(series, slot);
+
+  series->count++;
+  series->head = (series->head + 1) % TIME_SERIES_CAPACITY;
+}
+
+size_t time_series_count(const Time_series *series)
+{
+  return series->count;
+}
+
+/*!
+ * Least-squares slope over the window, in units per minute
+ */
+esp_err_t time_series_get_slope(const Time_series *series, time_series_channel_t channel, float *per_minute)
+{
+  int64_t n = (int64_t) series->count;
+  int64_t numerator = 0;
+  int64_t denominator = 0;
+
+  if ((unsigned)channel >= TS_CHANNEL_COUNT) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (series->count < TIME_SERIES_MIN_SAMPLES) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  numerator = (n * series->sum_xy[channel]) - (series->sum_x * series->sum_y[channel]);
+  denominator = (n * series->sum_xx) - (series->sum_x * series->sum_x);
+  if (denominator == 0) {
+    // Every sample has the same timestamp
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // Hundredths per ms -> units per minute
+  *per_minute = (float)(((double) numerator * 60000.0) / ((double) denominator * 100.0));
+
+  return ESP_OK;
+}
+
+static int16_t to_hundredths(float value)
+{
+  float scaled = roundf(value * 100.0f);
+
+  if (scaled > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (scaled < INT16_MIN) {
+    return INT16_MIN;
+  }
+
+  return (int16_t) scaled;
+}
+
+static size_t oldest_index(const Time_series *series)
+{
+  return (series->head + TIME_SERIES_CAPACITY - series->count) % TIME_SERIES_CAPACITY;
+}
+
+static size_t newest_index(const Time_series *series)
+{
+  return (series->head + TIME_SERIES_CAPACITY - 1) % TIME_SERIES_CAPACITY;
+}
+
+/*!
+ * Drop samples from the oldest end while they are before x
+ */
+static void drop_older_than(Time_series *series, int64_t x)
+{
+  while ((series->count > 0) && (series->samples[oldest_index(series)].x < x)) {
+    remove_from_sums(series, &(series->samples[oldest_index(series)]));
+    series->count--;
+  }
+}
+
+static void add_to_sums(Time_series *series, const time_series_sample_struct *sample)
+{
+  series->sum_x += sample->x;
+  series->sum_xx += (int64_t) sample->x * sample->x;
+  for (int i = 0; i < TS_CHANNEL_COUNT; i++) {
+    series->sum_y[i] += sample->y[i];
+    series->sum_xy[i] += (int64_t) sample->x * sample->y[i];
+  }
+}
+
+static void remove_from_sums(Time_series *series, const time_series_sample_struct *sample)
+{
+  series->sum_x -= sample->x;
+  series->sum_xx -= (int64_t) sample->x * sample->x;
+  for (int i = 0; i < TS_CHANNEL_COUNT; i++) {
+    series->sum_y[i] -= sample->y[i];
+    series->sum_xy[i] -= (int64_t) sample->x * sample->y[i];
+  }
+}
+
+/*!
+ * Move the origin up to the oldest sample. The sums are shifted exactly, so the slope is unchanged.
+ */
+static void rebase(Time_series *series)
+{
+  int64_t shift = series->samples[oldest_index(series)].x;
+  int64_t n = (int64_t) series->count;
+
+  if (shift == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < series->count; i++) {
+    series->samples[(oldest_index(series) + i) % TIME_SERIES_CAPACITY].x -= (int32_t) shift;
+  }
+
+  // sum((x - s)^2) = sum(x^2) - 2s*sum(x) + n*s^2, sum((x - s)y) = sum(xy) - s*sum(y)
+  series->sum_xx -= (2 * shift * series->sum_x) - (n * shift * shift);
+  series->sum_x -= n * shift;
+  for (int i = 0; i < TS_CHANNEL_COUNT; i++) {
+    series->sum_xy[i] -= shift * series->sum_y[i];
+  }
+
+  series->origin_us += shift * 1000;
+}
@@ -0,0 +1,49 @@
+#ifndef UV_DOSE_H
+#define UV_DOSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Rolling window resolution and length: 60 one-minute buckets
+#define UV_DOSE_BUCKET_S        60
+#define UV_DOSE_BUCKETS         60
+
+// Readings are clamped to this, which keeps a full day of dose inside the int64 sums
+#define UV_DOSE_MAX_READING     50000.0f  // uW/cm^2, about ten times full sun
+
+typedef enum uv_dose_band {
+  UV_DOSE_A = 0,
+  UV_DOSE_B,
+  UV_DOSE_C,
+  UV_DOSE_BAND_COUNT
+} uv_dose_band_t;
+
+/* Trapezoidal dose integrator working from each sample's own time. Irradiance is
+ * kept in nW/cm^2 and dose in fJ/cm^2 as integers, so the sums are exact and a long
+ * day doesn't lose the small increments. Doses are reported in uJ/cm^2 (uW*s/cm^2). */
+typedef struct Uv_dose {
+  int64_t   max_gap_us;                 // Longer intervals are dropped rather than bridged
+  int64_t   last_time_us;
+  int32_t   last_reading[UV_DOSE_BAND_COUNT];
+  bool      has_sample;
+  uint32_t  gaps;
+
+  // Since the last uv_dose_reset()
+  int64_t   total[UV_DOSE_BAND_COUNT];
+
+  // Rolling window, independent of the resets
+  int64_t   buckets[UV_DOSE_BUCKETS][UV_DOSE_BAND_COUNT];
+  size_t    bucket_head;                // Bucket the current sample lands in
+  size_t    bucket_count;
+  int64_t   bucket_end_us;
+} Uv_dose;
+
+esp_err_t uv_dose_init(Uv_dose *dose, uint32_t max_gap_ms);
+void      uv_dose_reset(Uv_dose *dose);
+void      uv_dose_add(Uv_dose *dose, int64_t time_us, float uv_a, float uv_b, float uv_c);
+float     uv_dose_get_total(const Uv_dose *dose, uv_dose_band_t band);
+esp_err_t uv_dose_get_window(const Uv_dose *dose, uv_dose_band_t band, uint32_t window_s, float *dose_uj);
+
+#endif /* UV_DOSE_H */
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "uv_dose.h"
+
+#define FJ_PER_UJ 1000000000.0
+
+// Private functions
+static int32_t to_nanowatts(float reading);
+static void advance_buckets(Uv_dose *dose, int64_t time_us);
+
+
+/*!
+ * Public init function. Intervals longer than max_gap_ms (a sensor outage, a clock step)
+ * are counted and skipped instead of being integrated.
+ */
+esp_err_t uv_dose_init(Uv_dose *dose, uint32_t max_gap_ms)
+{
+  if (max_gap_ms == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(dose, 0, sizeof(Uv_dose));
+  dose->max_gap_us = (int64_t) max_gap_ms * 1000;
+
+  return ESP_OK;
+}
+
+/*!
+ * Start a new dose period, e.g. at the start of the day. The rolling window carries on.
+ */
+void uv_dose_reset(Uv_dose *dose)
+{
+  memset(dose->total, 0, sizeof(dose->total));
+}
+
+/*!
+ * Add a sample. The area between it and the previous sample goes into the totals and
+ * into the rolling window bucket of this sample.
+ */
+void uv_dose_add(Uv_dose *dose, int64_t time_us, float uv_a, float uv_b, float uv_c)
+{
+  const int32_t reading[UV_DOSE_BAND_COUNT] = { to_nanowatts(uv_a), to_nanowatts(uv_b), to_nanowatts(uv_c) };
+  int64_t dt_us = time_us - dose->last_time_us;
+  bool integrate = dose->has_sample;
+
+  if (integrate && ((dt_us <= 0) || (dt_us > dose->max_gap_us))) {
+    // Out of order, repeated or too far apart: start again from this sample
+    dose->gaps++;
+    integrate = false;
+  }
+
+  if (!dose->has_sample) {
+    dose->bucket_end_us = time_us + ((int64_t) UV_DOSE_BUCKET_S * 1000000);
+    dose->bucket_count = 1;
+  }
+  advance_buckets(dose, time_us);
+
+  for (int i = 0; i < UV_DOSE_BAND_COUNT; i++) {
+    if (integrate) {
+      // nW/cm^2 * us = fJ/cm^2
+      int64_t area = (((int64_t) dose->last_reading[i] + reading[i]) * dt_us) / 2;
+
+      dose->total[i] += area;
+      dose->buckets[dose->bucket_head][i] += area;
+    }
+    dose->last_reading[i] = reading[i];
+  }
+
+  dose->last_time_us = time_us;
+  dose->has_sample = true;
+}
+
+/*!
+ * Dose since the last reset, uJ/cm^2
+ */
+float uv_dose_get_total(const Uv_dose *dose, uv_dose_band_t band)
+{
+  if ((unsigned)band >= UV_DOSE_BAND_COUNT) {
+    return 0;
+  }
+
+  return (float)((double) dose->total[band] / FJ_PER_UJ);
+}
+
+/*!
+ * Dose over the last window_s seconds, uJ/cm^2, to the nearest bucket. The current,
+ * partly filled bucket counts as one.
+ */
+esp_err_t uv_dose_get_window(const Uv_dose *dose, uv_dose_band_t band, uint32_t window_s, float *dose_uj)
+{
+  size_t bucket_count = (window_s + UV_DOSE_BUCKET_S - 1) / UV_DOSE_BUCKET_S;
+  int64_t sum = 0;
+
+  if (((unsigned)band >= UV_DOSE_BAND_COUNT) || (window_s == 0) || (bucket_count > UV_DOSE_BUCKETS)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (bucket_count > dose->bucket_count) {
+    bucket_count = dose->bucket_count;
+  }
+
+  for (size_t i = 0; i < bucket_count; i++) {
+    sum += dose->buckets[(dose->bucket_head + UV_DOSE_BUCKETS - i) % UV_DOSE_BUCKETS][band];
+  }
+  *dose_uj = (float)((double) sum / FJ_PER_UJ);
+
+  return ESP_OK;
+}
+
+static int32_t to_nanowatts(float reading)
+{
+  // Negative readings are sensor offset, not negative light
+  if (!(reading > 0)) {
+    return 0;
+  }
+  if (reading > UV_DOSE_MAX_READING) {
+    reading = UV_DOSE_MAX_READING;
+  }
+
+  return (int32_t) lroundf(reading * 1000.0f);
+}
+
+/*!
+ * Move the window up to the bucket time_us falls in, emptying the buckets it passes
+ */
+static void advance_buckets(Uv_dose *dose, int64_t time_us)
+{
+  const int64_t bucket_us = (int64_t) UV_DOSE_BUCKET_S * 1000000;
+  size_t advanced = 0;
+
+  if (time_us < (dose->bucket_end_us - bucket_us)) {
+    // The clock went back past the current bucket, the window no longer lines up
+    memset(dose->buckets, 0, sizeof(dose->buckets));
+    dose->bucket_count = 1;
+    dose->bucket_end_us = time_us + bucket_us;
+    return;
+  }
+
+  while ((time_us >= dose->bucket_end_us) && (advanced < UV_DOSE_BUCKETS)) {
+    dose->bucket_head = (dose->bucket_head + 1) % UV_DOSE_BUCKETS;
+    memset(dose->buckets[dose->bucket_head], 0, sizeof(dose->buckets[dose->bucket_head]));
+    dose->bucket_end_us += bucket_us;
+    if (dose->bucket_count < UV_DOSE_BUCKETS) {
+      dose->bucket_count++;
+    }
+    advanced++;
+  }
+
+  if (time_us >= dose->bucket_end_us) {
+    // Away for longer than the whole window, every bucket is empty now
+    dose->bucket_end_us = time_us + bucket_us;
+  }
+}
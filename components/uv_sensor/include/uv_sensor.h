@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 #include "esp_err.h"
-#include "driver/i2c.h"
+#include "platform_i2c.h"
 
 // Configuration State registers
 #define AS7331_OSR                      0x00
@@ -108,7 +108,7 @@ typedef struct UV_sensor{
   UV_adc_raw_values raw_counts;
   UV_converted_values converted_vals;
 
-  i2c_port_t i2c_port_num;
+  platform_i2c_port_t i2c_port_num;
   uint32_t i2c_timeout_ticks;
   uint32_t delay_period;
   uint8_t i2c_device_addr;
@@ -125,7 +125,7 @@ typedef struct UV_sensor{
   esp_err_t (*get_readings)(UV_converted_values* return_data); 
 } UV_sensor;
 
-esp_err_t uv_sensor_init(UV_sensor *struct_ptr, i2c_port_t i2c_port_num, as7331_gain_t gain, 
+esp_err_t uv_sensor_init(UV_sensor *struct_ptr, platform_i2c_port_t i2c_port_num, as7331_gain_t gain, 
   integration_time_t time);
 
 #endif /* UV_SENSOR_H */
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include "uv_sensor.h"
-#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "platform_i2c.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "string.h"
@@ -29,7 +31,7 @@ static esp_err_t  _uv_sensor_get_readings(UV_converted_values* return_data);
 /*!
  * Public init function
  */
-esp_err_t uv_sensor_init(UV_sensor *struct_ptr, i2c_port_t i2c_port_num, as7331_gain_t gain, 
+esp_err_t uv_sensor_init(UV_sensor *struct_ptr, platform_i2c_port_t i2c_port_num, as7331_gain_t gain, 
   integration_time_t time)
 {
   esp_err_t return_code = ESP_OK;
@@ -249,7 +251,7 @@ static esp_err_t uv_generic_i2c_write(uint8_t reg_addr, uint8_t* write_data, siz
 
   memcpy(&(self->write_buffer[1]), write_data, length);
 
-  return i2c_master_write_to_device(self->i2c_port_num, self->i2c_device_addr, &(self->write_buffer[0]), 
+  return platform_i2c_write(self->i2c_port_num, self->i2c_device_addr, &(self->write_buffer[0]), 
     actual_write_length, self->i2c_timeout_ticks);
 }
 
@@ -267,7 +269,7 @@ static esp_err_t uv_generic_i2c_read(uint8_t reg_addr, uint8_t* return_data, siz
 
   memset(&(self->read_buffer[0]), 0, BUFFER_SIZE);
 
-  return_code = i2c_master_write_read_device(self->i2c_port_num, self->i2c_device_addr, &reg_addr, 1,
+  return_code = platform_i2c_write_read(self->i2c_port_num, self->i2c_device_addr, &reg_addr, 1,
           return_data, length, self->i2c_timeout_ticks);
 
   // Copy over the data to the internal struct buffer
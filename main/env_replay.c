@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "env_replay.h"
+
+#define REPLAY_LINE_LENGTH        256
+#define REPLAY_SAMPLE_PERIOD_S    1
+#define REPLAY_PROGRESS_EVERY     86400  // Samples between progress lines, one simulated day at 1 Hz
+
+extern struct tm global_start_time_info;
+extern time_t global_start_time;
+
+// Where the samples come from: a CSV trace or a generated day/night cycle
+typedef struct replay_source {
+  FILE      *file;
+  uint32_t  line_number;
+  time_t    synthetic_start;
+  uint32_t  synthetic_index;
+  uint32_t  synthetic_count;
+  uint32_t  noise_state;
+} replay_source_struct;
+
+// Simulated clock and the controller's one-shot timer
+static time_t               replay_now = 0;
+static time_t               timer_deadline = 0;
+static env_timer_callback_t timer_callback = NULL;
+
+// Logger tag
+static const char *REPLAY_TAG = "Env replay";
+
+static const char *actuator_names[REPLAY_ACTUATOR_COUNT] = {
+  [REPLAY_FAN]    = "fan",
+  [REPLAY_LIGHTS] = "lights",
+  [REPLAY_PDLC]   = "pdlc"
+};
+
+// Private functions
+static time_t replay_get_time(time_t *now);
+static void replay_start_timer(uint32_t period_s, env_timer_callback_t callback);
+static bool next_sample(replay_source_struct *source, sensor_data_struct *sample);
+static bool read_csv_sample(replay_source_struct *source, sensor_data_struct *sample);
+static void synthetic_sample(replay_source_struct *source, sensor_data_struct *sample);
+static void record_transitions(Environmental_control *env_ctrl, status_data_struct *previous,
+  env_replay_report_struct *report, FILE *output);
+static size_t heap_in_use(void);
+
+static const env_timebase_struct replay_timebase = {
+  .get_time = replay_get_time,
+  .start_timer = replay_start_timer
+};
+
+
+/*!
+ * Feed every sample of the trace through process_env_data as fast as the host allows.
+ * The controller only ever sees the simulated clock, so a day of behaviour takes seconds.
+ */
+esp_err_t env_replay_run(Environmental_control *env_ctrl, Fan *fan, Lights *lights, PDLC *pdlc,
+  env_replay_report_struct *report)
+{
+  esp_err_t return_code = ESP_OK;
+  replay_source_struct source = {0};
+  sensor_data_struct sample = {0};
+  status_data_struct previous = {0};
+  const char *trace_path = getenv("ENV_REPLAY_FILE");
+  const char *output_path = getenv("ENV_REPLAY_OUTPUT");
+  FILE *output = NULL;
+  time_t first_timestamp = 0;
+  size_t heap_start = 0;
+  size_t heap_now = 0;
+  int64_t start_us = 0;
+
+  memset(report, 0, sizeof(env_replay_report_struct));
+
+  if (trace_path != NULL) {
+    source.file = fopen(trace_path, "r");
+    if (source.file == NULL) {
+      ESP_LOGE(REPLAY_TAG, "Can't open %s.", trace_path);
+      return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(REPLAY_TAG, "Replaying %s", trace_path);
+  } else {
+    struct tm start_info = { .tm_year = 2023 - 1900, .tm_mon = 5, .tm_mday = 21, .tm_isdst = -1 };
+
+    source.synthetic_start = mktime(&start_info);
+    source.synthetic_count = CONFIG_ENV_REPLAY_SYNTHETIC_HOURS * 3600 / REPLAY_SAMPLE_PERIOD_S;
+    source.noise_state = 1;
+    ESP_LOGI(REPLAY_TAG, "Replaying %d synthetic hours", CONFIG_ENV_REPLAY_SYNTHETIC_HOURS);
+  }
+
+  if (output_path != NULL) {
+    output = fopen(output_path, "w");
+    if (output != NULL) {
+      fprintf(output, "timestamp,actuator,state\n");
+    }
+  }
+
+  if (!next_sample(&source, &sample)) {
+    ESP_LOGE(REPLAY_TAG, "Trace is empty.");
+    return_code = ESP_ERR_INVALID_SIZE;
+    goto cleanup;
+  }
+
+  // The controller measures its demo window and give-up time from the start time
+  first_timestamp = sample.timestamp;
+  replay_now = first_timestamp;
+  global_start_time = first_timestamp;
+  localtime_r(&global_start_time, &global_start_time_info);
+  timer_callback = NULL;
+
+  heap_start = heap_in_use();
+  return_code = environmental_control_init(env_ctrl, fan, lights, pdlc, &replay_timebase);
+  if (return_code != ESP_OK) {
+    goto cleanup;
+  }
+  previous = env_ctrl->get_statuses();
+
+  start_us = esp_timer_get_time();
+  do {
+    replay_now = sample.timestamp;
+
+    // Fire the timer first if it came due between samples
+    if ((timer_callback != NULL) && (replay_now >= timer_deadline)) {
+      env_timer_callback_t callback = timer_callback;
+
+      timer_callback = NULL;
+      callback();
+      report->timer_fires++;
+      record_transitions(env_ctrl, &previous, report, output);
+    }
+
+    env_ctrl->process_env_data(sample);
+    report->samples++;
+    record_transitions(env_ctrl, &previous, report, output);
+
+    heap_now = heap_in_use();
+    if ((heap_now > heap_start) && ((heap_now - heap_start) > report->heap_peak_bytes)) {
+      report->heap_peak_bytes = heap_now - heap_start;
+    }
+
+    if ((report->samples % REPLAY_PROGRESS_EVERY) == 0) {
+      ESP_LOGI(REPLAY_TAG, "%" PRIu32 " samples", report->samples);
+    }
+  } while (next_sample(&source, &sample));
+
+  report->wall_us = esp_timer_get_time() - start_us;
+  report->simulated_s = replay_now - first_timestamp + REPLAY_SAMPLE_PERIOD_S;
+  report->heap_end_bytes = (long) heap_in_use() - (long) heap_start;
+  report->fan_give_ups = env_ctrl->fan_give_ups;
+
+  ESP_LOGI(REPLAY_TAG, "%" PRIu32 " samples, %lld simulated s in %" PRId64 " ms (%.0fx real time, %.0f decisions/s)",
+    report->samples, (long long) report->simulated_s, report->wall_us / 1000,
+    (report->wall_us > 0) ? ((double) report->simulated_s * 1e6 / report->wall_us) : 0.0,
+    (report->wall_us > 0) ? ((double) report->samples * 1e6 / report->wall_us) : 0.0);
+  ESP_LOGI(REPLAY_TAG, "Transitions: fan %" PRIu32 ", lights %" PRIu32 ", pdlc %" PRIu32 "; timer fires %" PRIu32
+    ", fan give-ups %" PRIu32, report->transitions[REPLAY_FAN], report->transitions[REPLAY_LIGHTS],
+    report->transitions[REPLAY_PDLC], report->timer_fires, report->fan_give_ups);
+  ESP_LOGI(REPLAY_TAG, "Heap above start: peak %u bytes, at end %ld bytes", (unsigned) report->heap_peak_bytes,
+    report->heap_end_bytes);
+
+cleanup:
+  if (source.file != NULL) {
+    fclose(source.file);
+  }
+  if (output != NULL) {
+    fclose(output);
+  }
+
+  return return_code;
+}
+
+static time_t replay_get_time(time_t *now)
+{
+  if (now != NULL) {
+    *now = replay_now;
+  }
+
+  return replay_now;
+}
+
+static void replay_start_timer(uint32_t period_s, env_timer_callback_t callback)
+{
+  timer_deadline = replay_now + period_s;
+  timer_callback = callback;
+}
+
+static bool next_sample(replay_source_struct *source, sensor_data_struct *sample)
+{
+  if (source->file != NULL) {
+    if (!read_csv_sample(source, sample)) {
+      return false;
+    }
+    environmental_control_derive(sample);
+    return true;
+  }
+
+  if (source->synthetic_index >= source->synthetic_count) {
+    return false;
+  }
+  synthetic_sample(source, sample);
+  environmental_control_derive(sample);
+
+  return true;
+}
+
+/*!
+ * timestamp,temperature,humidity,pressure,uv_a,uv_b,uv_c,soil_wetness -- blank lines,
+ * comments and anything else that doesn't start with a number (e.g. a header) are skipped
+ */
+static bool read_csv_sample(replay_source_struct *source, sensor_data_struct *sample)
+{
+  char line[REPLAY_LINE_LENGTH];
+
+  while (fgets(line, sizeof(line), source->file) != NULL) {
+    long long timestamp = 0;
+    double temperature = 0, humidity = 0, pressure = 0;
+    float uv_a = 0, uv_b = 0, uv_c = 0;
+    unsigned int soil_wetness = 0;
+    int fields = 0;
+
+    source->line_number++;
+    fields = sscanf(line, "%lld,%lf,%lf,%lf,%f,%f,%f,%u", &timestamp, &temperature, &humidity, &pressure,
+               &uv_a, &uv_b, &uv_c, &soil_wetness);
+    if (fields <= 0) {
+      continue;
+    }
+    if (fields != 8) {
+      ESP_LOGW(REPLAY_TAG, "Line %" PRIu32 ": expected 8 fields, got %d.", source->line_number, fields);
+      continue;
+    }
+
+    memset(sample, 0, sizeof(sensor_data_struct));
+    sample->timestamp = (time_t) timestamp;
+    sample->bme280_data.temperature = temperature;
+    sample->bme280_data.humidity = humidity;
+    sample->bme280_data.pressure = pressure;
+    sample->uv_data.UV_A = uv_a;
+    sample->uv_data.UV_B = uv_b;
+    sample->uv_data.UV_C = uv_c;
+    sample->soil_wetness = (uint16_t) soil_wetness;
+
+    return true;
+  }
+
+  return false;
+}
+
+/*!
+ * Clear sky day/night cycle: warm, dry and bright around noon, with a little sensor noise
+ */
+static void synthetic_sample(replay_source_struct *source, sensor_data_struct *sample)
+{
+  uint32_t seconds = source->synthetic_index * REPLAY_SAMPLE_PERIOD_S;
+  double hour = fmod(seconds / 3600.0, 24.0);
+  double sun = ((hour > 6.0) && (hour < 18.0)) ? sin(M_PI * (hour - 6.0) / 12.0) : 0.0;
+  double noise = 0;
+
+  // Small LCG so every run sees the same trace
+  source->noise_state = source->noise_state * 1664525UL + 1013904223UL;
+  noise = ((double)(source->noise_state >> 16) / 65536.0) - 0.5;
+
+  memset(sample, 0, sizeof(sensor_data_struct));
+  sample->timestamp = source->synthetic_start + seconds;
+  sample->bme280_data.temperature = 18.0 + (13.0 * sun) + (0.2 * noise);
+  sample->bme280_data.humidity = 88.0 - (35.0 * sun) + (0.5 * noise);
+  sample->bme280_data.pressure = 101325.0 + (20.0 * noise);
+  sample->uv_data.UV_A = (float)(900.0 * sun);
+  sample->uv_data.UV_B = (float)(60.0 * sun);
+  sample->uv_data.UV_C = (float)(2.0 * sun);
+  sample->soil_wetness = 60;
+
+  source->synthetic_index++;
+}
+
+static void record_transitions(Environmental_control *env_ctrl, status_data_struct *previous,
+  env_replay_report_struct *report, FILE *output)
+{
+  status_data_struct current = env_ctrl->get_statuses();
+  status_state_t previous_states[REPLAY_ACTUATOR_COUNT] = {
+    previous->fan_state, previous->lights_state, previous->pdlc_state
+  };
+  status_state_t current_states[REPLAY_ACTUATOR_COUNT] = {
+    current.fan_state, current.lights_state, current.pdlc_state
+  };
+
+  for (int i = 0; i < REPLAY_ACTUATOR_COUNT; i++) {
+    if (current_states[i] == previous_states[i]) {
+      continue;
+    }
+
+    report->transitions[i]++;
+    if (output != NULL) {
+      fprintf(output, "%lld,%s,%d\n", (long long) replay_now, actuator_names[i], (int) current_states[i]);
+    }
+  }
+
+  *previous = current;
+}
+
+static size_t heap_in_use(void)
+{
+  struct mallinfo2 info = mallinfo2();
+
+  return info.uordblks;
+}
@@ -0,0 +1,34 @@
+#ifndef ENV_REPLAY_H
+#define ENV_REPLAY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "environmental_control.h"
+
+// Actuators tracked by the replay, in status_data_struct order
+typedef enum replay_actuator {
+  REPLAY_FAN = 0,
+  REPLAY_LIGHTS,
+  REPLAY_PDLC,
+  REPLAY_ACTUATOR_COUNT
+} replay_actuator_t;
+
+typedef struct env_replay_report {
+  uint32_t  samples;
+  uint32_t  timer_fires;
+  uint32_t  fan_give_ups;     // Fan runs given up on, see FAN_RETRY_HOLDOFF_S
+  uint32_t  transitions[REPLAY_ACTUATOR_COUNT];
+  time_t    simulated_s;      // Span of the trace
+  int64_t   wall_us;          // Time spent in the controller and the replay loop
+  size_t    heap_peak_bytes;  // Heap in use above the starting point, worst case
+  long      heap_end_bytes;   // Heap in use above the starting point once the trace is done
+} env_replay_report_struct;
+
+/*!
+ * Run a sensor trace through the environmental controller on a simulated clock.
+ * Host (linux target) builds only -- see CONFIG_ENV_REPLAY.
+ */
+esp_err_t env_replay_run(Environmental_control *env_ctrl, Fan *fan, Lights *lights, PDLC *pdlc,
+  env_replay_report_struct *report);
+
+#endif /* ENV_REPLAY_H */
@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "cJSON_Utils.h"
+#include "json_number.h"
+#include "json_parser.h"
+#include "json_bench.h"
+
+#define BENCH_CHECKED_VALUES  2000000
+#define BENCH_TIMING_POINTS   4096
+#define BENCH_TIMING_ROUNDS   64
+#define BENCH_FIXED_DECIMALS  2
+#define BENCH_DIFF_ROUNDS     8
+#define BENCH_DIFF_CHANGE     100   // Every this many zones: one removed, one changed and one added
+#define BENCH_PARSER_ROUNDS   2000
+#define BENCH_PARSER_TOKENS   512
+
+// Fixed-decimal edge cases: exact binary rounding and unsigned zero
+typedef struct fixed_case {
+  double      value;
+  int         decimals;
+  const char  *text;
+} fixed_case_struct;
+
+static const fixed_case_struct fixed_cases[] = {
+  { 2.675, 2, "2.67" },   // 2.67499999999999982..
+  { 1.005, 2, "1" },      // 1.00499999999999989..
+  { 0.125, 2, "0.12" },   // Exact tie, to even
+  { 2.5, 0, "2" },
+  { -0.0, 2, "0" },
+  { -0.004, 2, "0" }
+};
+
+// Logger tag
+static const char *BENCH_TAG = "JSON bench";
+
+// Keeps the timed loops from being optimized away
+static volatile int bench_sink = 0;
+
+// Private functions
+static int legacy_print(double value, char *buffer);
+static int fixed_print(double value, char *buffer);
+static int reference_fixed(double value, int decimals, char *buffer);
+static double next_reading(uint32_t *state);
+static double next_any(uint64_t *state);
+static double time_print(int (*print)(double, char *), const double *values, double *mean_bytes);
+static cJSON *zone_document(uint32_t keys, bool changed);
+static double elapsed_ms(int64_t start_us);
+static int config_message(uint32_t fields, char *buffer, size_t size);
+
+
+/*!
+ * Arbitrary doubles and sensor-like readings printed and read back, then the time per number
+ * over the readings
+ */
+esp_err_t json_bench_run(json_bench_report_struct *report)
+{
+  static double readings[BENCH_TIMING_POINTS];
+  char shortest[JSON_NUMBER_BUFFER_SIZE];
+  char legacy[32];
+  char fixed[JSON_NUMBER_BUFFER_SIZE];
+  char reference[32];
+  uint32_t reading_state = 1;
+  uint64_t any_state = 88172645463325252ULL;
+  double value = 0;
+
+  memset(report, 0, sizeof(json_bench_report_struct));
+
+  for (int i = 0; i < BENCH_CHECKED_VALUES; i++) {
+    value = (i & 1) ? next_reading(&reading_state) : next_any(&any_state);
+    json_number_shortest(value, shortest);
+    if (strtod(shortest, NULL) != value) {
+      if (report->round_trip_failures++ == 0) {
+        ESP_LOGE(BENCH_TAG, "%.17g printed as %s", value, shortest);
+      }
+    }
+    if (strlen(shortest) > (size_t) legacy_print(value, legacy)) {
+      report->longer_than_legacy++;
+    }
+    // Every number of places in turn; too large to scale and it is the shortest form
+    if (fabs(value) < 1e6) {
+      json_number_fixed(value, i % (JSON_NUMBER_MAX_DECIMALS + 1), fixed);
+      reference_fixed(value, i % (JSON_NUMBER_MAX_DECIMALS + 1), reference);
+      if ((strcmp(fixed, reference) != 0) && (report->fixed_mismatches++ == 0)) {
+        ESP_LOGE(BENCH_TAG, "%.17g to %d places printed as %s, not %s", value, i % (JSON_NUMBER_MAX_DECIMALS + 1),
+          fixed, reference);
+      }
+    }
+    report->checked++;
+  }
+
+  for (size_t i = 0; i < (sizeof(fixed_cases) / sizeof(fixed_cases[0])); i++) {
+    json_number_fixed(fixed_cases[i].value, fixed_cases[i].decimals, fixed);
+    if (strcmp(fixed, fixed_cases[i].text) != 0) {
+      ESP_LOGE(BENCH_TAG, "%.17g to %d places printed as %s, not %s", fixed_cases[i].value, fixed_cases[i].decimals,
+        fixed, fixed_cases[i].text);
+      report->fixed_mismatches++;
+    }
+  }
+
+  for (int i = 0; i < BENCH_TIMING_POINTS; i++) {
+    readings[i] = next_reading(&reading_state);
+  }
+  report->legacy_ns = time_print(legacy_print, readings, &report->legacy_bytes);
+  report->shortest_ns = time_print(json_number_shortest, readings, &report->shortest_bytes);
+  report->fixed_ns = time_print(fixed_print, readings, &report->fixed_bytes);
+
+  ESP_LOGI(BENCH_TAG, "%" PRIu32 " doubles: %" PRIu32 " did not read back, %" PRIu32 " longer than %%1.15g/%%1.17g",
+    report->checked, report->round_trip_failures, report->longer_than_legacy);
+  ESP_LOGI(BENCH_TAG, "Fixed places: %" PRIu32 " differed from %%.*f", report->fixed_mismatches);
+  ESP_LOGI(BENCH_TAG, "Per reading: printf %.1f ns (%.1f bytes), shortest %.1f ns (%.1f bytes), "
+    "%d places %.1f ns (%.1f bytes)", report->legacy_ns, report->legacy_bytes, report->shortest_ns,
+    report->shortest_bytes, BENCH_FIXED_DECIMALS, report->fixed_ns, report->fixed_bytes);
+
+  return ((report->round_trip_failures == 0) && (report->fixed_mismatches == 0)) ? ESP_OK : ESP_FAIL;
+}
+
+/*!
+ * Best of BENCH_DIFF_ROUNDS on fresh documents each time, since diffing sorts its inputs
+ */
+esp_err_t json_bench_diff_run(json_diff_bench_report_struct *report)
+{
+  static const uint32_t sizes[JSON_DIFF_BENCH_SIZES] = {1000, 10000};
+
+  memset(report, 0, sizeof(json_diff_bench_report_struct));
+
+  for (int size = 0; size < JSON_DIFF_BENCH_SIZES; size++) {
+    report->keys[size] = sizes[size];
+    report->generate_ms[size] = report->apply_ms[size] = INFINITY;
+    report->merge_ms[size] = report->compare_ms[size] = INFINITY;
+
+    for (int round = 0; round < BENCH_DIFF_ROUNDS; round++) {
+      cJSON *from = zone_document(sizes[size], false);
+      cJSON *to = zone_document(sizes[size], true);
+      cJSON *copy = cJSON_Duplicate(from, true);
+      cJSON *patches = NULL;
+      cJSON *merge = NULL;
+      int64_t start_us = 0;
+      bool equal = false;
+      bool applied = false;
+
+      if ((from == NULL) || (to == NULL) || (copy == NULL)) {
+        cJSON_Delete(from);
+        cJSON_Delete(to);
+        cJSON_Delete(copy);
+        return ESP_ERR_NO_MEM;
+      }
+
+      start_us = esp_timer_get_time();
+      equal = cJSON_Compare(from, copy, true);
+      report->compare_ms[size] = fmin(report->compare_ms[size], elapsed_ms(start_us));
+
+      start_us = esp_timer_get_time();
+      patches = cJSONUtils_GeneratePatchesCaseSensitive(from, to);
+      report->generate_ms[size] = fmin(report->generate_ms[size], elapsed_ms(start_us));
+
+      start_us = esp_timer_get_time();
+      applied = (cJSONUtils_ApplyPatchesCaseSensitive(copy, patches) == 0);
+      report->apply_ms[size] = fmin(report->apply_ms[size], elapsed_ms(start_us));
+
+      cJSON_Delete(from);
+      cJSON_Delete(to);
+      from = zone_document(sizes[size], false);
+      to = zone_document(sizes[size], true);
+      start_us = esp_timer_get_time();
+      merge = cJSONUtils_GenerateMergePatchCaseSensitive(from, to);
+      report->merge_ms[size] = fmin(report->merge_ms[size], elapsed_ms(start_us));
+
+      from = cJSONUtils_MergePatchCaseSensitive(from, merge);
+      if (!equal || !applied || !cJSON_Compare(copy, to, true) || !cJSON_Compare(from, to, true)) {
+        if (report->round_trip_failures++ == 0) {
+          ESP_LOGE(BENCH_TAG, "Patches for %" PRIu32 " keys don't reproduce the document", sizes[size]);
+        }
+      }
+      report->patches[size] = (uint32_t) cJSON_GetArraySize(patches);
+
+      cJSON_Delete(from);
+      cJSON_Delete(to);
+      cJSON_Delete(copy);
+      cJSON_Delete(patches);
+      cJSON_Delete(merge);
+    }
+
+    ESP_LOGI(BENCH_TAG, "%" PRIu32 " keys, %" PRIu32 " operations: generate %.2f ms, apply %.2f ms, "
+      "merge patch %.2f ms, compare %.2f ms", report->keys[size], report->patches[size], report->generate_ms[size],
+      report->apply_ms[size], report->merge_ms[size], report->compare_ms[size]);
+  }
+
+  return (report->round_trip_failures == 0) ? ESP_OK : ESP_FAIL;
+}
+
+/*!
+ * Mean over BENCH_PARSER_ROUNDS reads of every field. Each round starts without an index, as a
+ * new message would, so building it is counted; the scanning pass forgets it before every
+ * lookup, which is what each lookup cost before there was one.
+ */
+esp_err_t json_bench_parser_run(json_parser_bench_report_struct *report)
+{
+  static const uint32_t sizes[JSON_PARSER_BENCH_SIZES] = {20, 50, 200};
+  static json_tok_t tokens[BENCH_PARSER_TOKENS];
+  static char message[8192];
+  static char names[200][16];
+  json_tok_pool_t pool;
+  jparse_ctx_t jctx;
+  int64_t start_us = 0;
+
+  memset(report, 0, sizeof(json_parser_bench_report_struct));
+  json_tok_pool_init(&pool, tokens, BENCH_PARSER_TOKENS, BENCH_PARSER_TOKENS);
+  for (uint32_t field = 0; field < 200; field++) {
+    snprintf(names[field], sizeof(names[field]), "field_%03lu", (unsigned long) field);
+  }
+
+  for (int size = 0; size < JSON_PARSER_BENCH_SIZES; size++) {
+    int length = config_message(sizes[size], message, sizeof(message));
+
+    report->fields[size] = sizes[size];
+
+    start_us = esp_timer_get_time();
+    for (int round = 0; round < BENCH_PARSER_ROUNDS; round++) {
+      if (json_parse_start_pool(&jctx, message, length, &pool) != OS_SUCCESS) {
+        ESP_LOGE(BENCH_TAG, "%" PRIu32 " field message didn't parse", report->fields[size]);
+        return ESP_FAIL;
+      }
+      json_parse_end(&jctx);
+    }
+    report->parse_ns[size] = elapsed_ms(start_us) * 1e6 / BENCH_PARSER_ROUNDS;
+
+    json_parse_start_pool(&jctx, message, length, &pool);
+    for (int indexed = 0; indexed < 2; indexed++) {
+      start_us = esp_timer_get_time();
+      for (int round = 0; round < BENCH_PARSER_ROUNDS; round++) {
+        jctx.searched = NULL;
+        jctx.indexed = NULL;
+        for (uint32_t field = 0; field < sizes[size]; field++) {
+          int value = -1;
+
+          if (!indexed) {
+            jctx.searched = NULL;
+            jctx.indexed = NULL;
+          }
+          if ((json_obj_get_int(&jctx, names[field], &value) != OS_SUCCESS) || (value != (int) field)) {
+            report->wrong_values++;
+          }
+        }
+      }
+      if (indexed) {
+        report->indexed_ns[size] = elapsed_ms(start_us) * 1e6 / ((double) BENCH_PARSER_ROUNDS * sizes[size]);
+      } else {
+        report->scan_ns[size] = elapsed_ms(start_us) * 1e6 / ((double) BENCH_PARSER_ROUNDS * sizes[size]);
+      }
+    }
+    json_parse_end(&jctx);
+
+    ESP_LOGI(BENCH_TAG, "%" PRIu32 " fields: parse %.0f ns, per lookup %.0f ns scanning, %.0f ns indexed",
+      report->fields[size], report->parse_ns[size], report->scan_ns[size], report->indexed_ns[size]);
+  }
+
+  json_tok_pool_free(&pool);
+
+  return (report->wrong_values == 0) ? ESP_OK : ESP_FAIL;
+}
+
+/*!
+ * What print_number did before: 15 digits, 17 if those don't read back close enough
+ */
+static int legacy_print(double value, char *buffer)
+{
+  double test = 0;
+  int length = sprintf(buffer, "%1.15g", value);
+
+  if ((sscanf(buffer, "%lg", &test) != 1) || (fabs(test - value) > fmax(fabs(test), fabs(value)) * DBL_EPSILON)) {
+    length = sprintf(buffer, "%1.17g", value);
+  }
+
+  return length;
+}
+
+static int fixed_print(double value, char *buffer)
+{
+  return json_number_fixed(value, BENCH_FIXED_DECIMALS, buffer);
+}
+
+/*!
+ * %.*f with the trailing zeros dropped and an unsigned zero, the form json_number_fixed() promises
+ */
+static int reference_fixed(double value, int decimals, char *buffer)
+{
+  int length = sprintf(buffer, "%.*f", decimals, value);
+
+  if (strchr(buffer, '.') != NULL) {
+    while (buffer[length - 1] == '0') {
+      length--;
+    }
+    if (buffer[length - 1] == '.') {
+      length--;
+    }
+    buffer[length] = '\0';
+  }
+  if (strcmp(buffer, "-0") == 0) {
+    length = sprintf(buffer, "0");
+  }
+
+  return length;
+}
+
+/*!
+ * What the telemetry carries: float readings widened to double, a temperature, a humidity or
+ * a pressure in hPa
+ */
+static double next_reading(uint32_t *state)
+{
+  float unit = 0;
+
+  *state = (*state * 1103515245u) + 12345u;
+  unit = (float) (*state >> 8) / 16777216.0f;
+
+  switch (*state % 3) {
+    case 0:
+      return (double) (-10.0f + (60.0f * unit));
+    case 1:
+      return (double) (100.0f * unit);
+    default:
+      return (double) (950.0f + (100.0f * unit));
+  }
+}
+
+/*!
+ * Any finite double, from its bits
+ */
+static double next_any(uint64_t *state)
+{
+  double value = 0;
+
+  do {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    memcpy(&value, state, sizeof(value));
+  } while (!isfinite(value));
+
+  return value;
+}
+
+/*!
+ * Nanoseconds per number, best of BENCH_TIMING_ROUNDS passes
+ */
+static double time_print(int (*print)(double, char *), const double *values, double *mean_bytes)
+{
+  char buffer[32];
+  int64_t best_us = INT64_MAX;
+  int64_t bytes = 0;
+
+  for (int round = 0; round < BENCH_TIMING_ROUNDS; round++) {
+    int64_t start_us = esp_timer_get_time();
+    int64_t elapsed_us = 0;
+
+    bytes = 0;
+    for (int i = 0; i < BENCH_TIMING_POINTS; i++) {
+      bytes += print(values[i], buffer);
+    }
+    elapsed_us = esp_timer_get_time() - start_us;
+    bench_sink = (int) bytes;
+
+    if (elapsed_us < best_us) {
+      best_us = elapsed_us;
+    }
+  }
+
+  *mean_bytes = (double) bytes / BENCH_TIMING_POINTS;
+
+  return (double) best_us * 1000.0 / BENCH_TIMING_POINTS;
+}
+
+/*!
+ * A wide state tree: one rule object per zone, inserted in shuffled order. The changed one
+ * drops, alters and adds a zone every BENCH_DIFF_CHANGE.
+ */
+static cJSON *zone_document(uint32_t keys, bool changed)
+{
+  cJSON *document = cJSON_CreateObject();
+  uint32_t *order = malloc(keys * sizeof(uint32_t));
+  uint32_t state = 1;
+  char name[32];
+
+  if ((document == NULL) || (order == NULL)) {
+    cJSON_Delete(document);
+    free(order);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < keys; i++) {
+    order[i] = i;
+  }
+  for (uint32_t i = keys - 1; i > 0; i--) {
+    uint32_t j = 0;
+    uint32_t swap = order[i];
+
+    state = (state * 1103515245u) + 12345u;
+    j = (state >> 8) % (i + 1);
+    order[i] = order[j];
+    order[j] = swap;
+  }
+
+  for (uint32_t i = 0; i < keys; i++) {
+    uint32_t zone = order[i];
+    cJSON *rule = NULL;
+
+    if (changed && (zone % BENCH_DIFF_CHANGE == 1)) {
+      continue;
+    }
+    snprintf(name, sizeof(name), "zone_%05lu_rule", (unsigned long) zone);
+    rule = cJSON_AddObjectToObject(document, name);
+    cJSON_AddNumberToObject(rule, "target", (changed && (zone % BENCH_DIFF_CHANGE == 2)) ? zone + 0.5 : zone);
+    cJSON_AddStringToObject(rule, "mode", "auto");
+    if (changed && (zone % BENCH_DIFF_CHANGE == 3)) {
+      snprintf(name, sizeof(name), "zone_%05lu_new", (unsigned long) zone);
+      cJSON_AddNumberToObject(document, name, zone);
+    }
+  }
+
+  free(order);
+
+  return document;
+}
+
+static double elapsed_ms(int64_t start_us)
+{
+  return (double) (esp_timer_get_time() - start_us) / 1000.0;
+}
+
+/*!
+ * A config message with one object of numbered fields, as the backend sends them
+ */
+static int config_message(uint32_t fields, char *buffer, size_t size)
+{
+  int length = snprintf(buffer, size, "{");
+
+  for (uint32_t field = 0; field < fields; field++) {
+    length += snprintf(buffer + length, size - length, "%s\"field_%03lu\":%lu", (field > 0) ? "," : "",
+      (unsigned long) field, (unsigned long) field);
+  }
+  length += snprintf(buffer + length, size - length, "}");
+
+  return length;
+}
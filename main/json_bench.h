@@ -0,0 +1,60 @@
+#ifndef JSON_BENCH_H
+#define JSON_BENCH_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct json_bench_report {
+  uint32_t  checked;                      // Doubles printed and read back
+  uint32_t  round_trip_failures;          // Read back as a different double, must be 0
+  uint32_t  longer_than_legacy;           // Shortest form came out longer than %1.15g/%1.17g
+  uint32_t  fixed_mismatches;             // json_number_fixed() differed from %.*f, must be 0
+  double    legacy_ns;                    // Per number, sprintf %1.15g + sscanf (+ %1.17g)
+  double    shortest_ns;                  // Per number, json_number_shortest()
+  double    fixed_ns;                     // Per number, json_number_fixed() to 2 places
+  double    legacy_bytes;                 // Mean text length of each
+  double    shortest_bytes;
+  double    fixed_bytes;
+} json_bench_report_struct;
+
+/*!
+ * Check the JSON number printing reads back exactly, and time it against the printf based
+ * version cJSON had. Host (linux target) builds only -- see CONFIG_JSON_NUMBER_BENCHMARK.
+ */
+esp_err_t json_bench_run(json_bench_report_struct *report);
+
+#define JSON_DIFF_BENCH_SIZES   2
+
+typedef struct json_diff_bench_report {
+  uint32_t  keys[JSON_DIFF_BENCH_SIZES];          // Members in the documents diffed
+  uint32_t  patches[JSON_DIFF_BENCH_SIZES];       // Operations generated
+  uint32_t  round_trip_failures;                  // Patches that didn't turn one into the other, must be 0
+  double    generate_ms[JSON_DIFF_BENCH_SIZES];   // cJSONUtils_GeneratePatchesCaseSensitive()
+  double    apply_ms[JSON_DIFF_BENCH_SIZES];      // cJSONUtils_ApplyPatchesCaseSensitive()
+  double    merge_ms[JSON_DIFF_BENCH_SIZES];      // cJSONUtils_GenerateMergePatchCaseSensitive()
+  double    compare_ms[JSON_DIFF_BENCH_SIZES];    // cJSON_Compare() of equal documents
+} json_diff_bench_report_struct;
+
+/*!
+ * Diff wide state documents, check the patches apply back and time it. Host builds only --
+ * see CONFIG_JSON_DIFF_BENCHMARK.
+ */
+esp_err_t json_bench_diff_run(json_diff_bench_report_struct *report);
+
+#define JSON_PARSER_BENCH_SIZES 3
+
+typedef struct json_parser_bench_report {
+  uint32_t  fields[JSON_PARSER_BENCH_SIZES];      // Members in the object read
+  uint32_t  wrong_values;                         // Lookups that found the wrong value, must be 0
+  double    parse_ns[JSON_PARSER_BENCH_SIZES];    // json_parse_start_pool() of the message
+  double    scan_ns[JSON_PARSER_BENCH_SIZES];     // Per json_obj_get_int(), scanning the object each time
+  double    indexed_ns[JSON_PARSER_BENCH_SIZES];  // Per json_obj_get_int(), through the object index
+} json_parser_bench_report_struct;
+
+/*!
+ * Read every field of 20 to 200 member objects with json_parser, with and without its object
+ * index. Host builds only -- see CONFIG_JSON_PARSER_BENCHMARK.
+ */
+esp_err_t json_bench_parser_run(json_parser_bench_report_struct *report);
+
+#endif /* JSON_BENCH_H */
@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
@@ -23,29 +25,42 @@
 #include "freertos/queue.h"
 
 /* ESP libs */
-#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
-#include "esp_attr.h"
-#include "esp_log.h"
-#include "esp_random.h"
-#include "led_strip.h"
-#include "driver/gpio.h"
-#include "driver/i2c.h"
 #include "esp_netif_sntp.h"
 #include "lwip/ip_addr.h"
 #include "esp_sntp.h"
-#include "esp_http_client.h"
+#endif
+
+/* Hardware access -- real peripherals on target, simulated ones in the linux host build */
+#include "platform_i2c.h"
+#include "platform_adc.h"
+#include "platform_system.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "platform_sim.h"
+#include "env_replay.h"
+#include "metrics_bench.h"
+#include "json_bench.h"
+#endif
 
 /* Custom components */
 #include "environmental_sensor.h"
 #include "firebase.h"
+#include "command_stream.h"
 #include "soil_sensor.h"
 #include "uv_sensor.h"
 #include "fan.h"
 #include "lights.h"
 #include "pdlc.h"
+#include "sample_scheduler.h"
+#include "task_placement.h"
+#include "deferred_log.h"
+#include "cycle_profiler.h"
 
 /* Configuration items from menuconfig tool */
 #include "../build/config/sdkconfig.h"
@@ -53,6 +68,7 @@
 //
 // Defines
 
+#if !CONFIG_IDF_TARGET_LINUX
 /* WiFi settings */
 // TODO: remove unnecessary definitions and preprocessor commands
 #define USE_HOTSPOT
@@ -100,17 +116,19 @@
 #elif CONFIG_ESP_WIFI_AUTH_WAPI_PSK
 #define ESP_WIFI_SCAN_AUTH_MODE_THRESHOLD WIFI_AUTH_WAPI_PSK
 #endif
-/* The event group allows multiple bits for each event, but we only care about two events:
+#endif /* !CONFIG_IDF_TARGET_LINUX */
+/* The event group allows multiple bits for each event, but we only care about three events:
  * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
+ * - we failed to connect after the maximum amount of retries
+ * - the environmental controller is initialized, commands can be applied to it */
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
-
-// The sensor timer go bit
-#define SENSOR_CYCLE_START_BIT BIT0
+#define CONTROL_READY_BIT  BIT2
 
 // Firebase Realtime Database URL
 #define FIREBASE_URL "https://daily-trader-default-rtdb.firebaseio.com/apps.json"
+// Where commands for the greenhouse are written, streamed back as they change
+#define FIREBASE_COMMAND_URL "https://daily-trader-default-rtdb.firebaseio.com/commands.json"
 
 
 
@@ -120,19 +138,24 @@
 /* Tasks */
 void led_task(void* arg);
 void firebase_task(void *arg);
+void command_task(void *arg);
 void sensors_task(void *arg);
 void environmental_control_task(void *arg);
+void monitor_task(void *arg);
 
 /* Static helper functions and callbacks */
-static void blink_led(uint32_t index, uint8_t red, uint8_t green, uint8_t blue, bool led_state);
-static void configure_led(void);
+#if CONFIG_IDF_TARGET_LINUX
+static void simulation_init(void);
+#else
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data);
 static void wifi_init_sta(void);
-static esp_err_t i2c_master_init(void);
 static void obtain_time(void);
 static void time_sync_notification_cb(struct timeval *tv);
-static void sensor_timer_callback(TimerHandle_t xTimer);
+#endif
+static void push_uplink_events(const sensor_data_struct *sensor_data, const status_data_struct *status_data);
+static void push_uplink_event(const sensor_data_struct *sensor_data, const status_data_struct *status_data,
+              uplink_class_t uplink_class, uplink_event_t type, uint8_t actuator, bool on);
 
 
 //
@@ -141,15 +164,14 @@ static void sensor_timer_callback(TimerHandle_t xTimer);
 /* FreeRTOS variables */
 static TaskHandle_t led_task_handle = NULL;
 static TaskHandle_t firebase_task_handle = NULL;
+static TaskHandle_t command_task_handle = NULL;
 static TaskHandle_t sensors_task_handle = NULL;
 static TaskHandle_t environmental_control_task_handle = NULL;
+static TaskHandle_t monitor_task_handle = NULL;
+static TaskHandle_t log_task_handle = NULL;
 static EventGroupHandle_t s_wifi_event_group;
-static EventGroupHandle_t task_control_events;
-static QueueHandle_t firebase_queue;
 static QueueHandle_t sensor_queue;
 static QueueHandle_t env_ctrl_queue;
-static TimerHandle_t sensor_timer_handle;
-static uint32_t      sensor_timer_id = 475;
 
 /* Const strings */
 static const char *WIFI_TAG = "WIFI";
@@ -157,18 +179,28 @@ static const char *LED_TAG = "LED";
 static const char *SENSOR_TAG = "Sensor task";
 static const char *ENV_CONTROL = "Environmental Control task";
 static const char *SNTP_TAG = "SNTP";
+static const char *MONITOR_TAG = "Monitor task";
 
 /* Static objects and reference data */
-static led_strip_handle_t led_strip;
 static uint8_t red, green, blue;
+#if !CONFIG_IDF_TARGET_LINUX
 static int s_retry_num = 0;
+#endif
 time_t now;
 struct tm timeinfo;
 struct tm global_start_time_info;
 time_t global_start_time;
 
+/* Controller state last put on the uplink, so alarms and transitions go out as they happen */
+static status_data_struct uplink_status;
+static bool uplink_over_temp = false;
+static bool uplink_over_humidity = false;
+static uint32_t uplink_fan_give_ups = 0;
+
 /* Passable Objects */
 Firebase fb;
+Uplink_queue uplink;
+Command_stream commands;
 Environmental_sensor env;
 UV_sensor uv;
 Soil_sensor soil;
@@ -176,6 +208,27 @@ Fan fan;
 Lights lights;
 PDLC pdlc;
 Environmental_control env_ctrl;
+Sample_scheduler sampler;
+Task_placement placement;
+
+/* Task plan -- acquisition and control on the real-time core, the rest on the other.
+ * Priorities are derived from the deadlines by the task placement component. */
+static task_plan_entry_struct task_plan[] = {
+  { environmental_control_task, "Env ctrl task", 8192,  TASK_CLASS_REALTIME,
+    CONFIG_TASK_CONTROL_DEADLINE_MS, &environmental_control_task_handle },
+  { sensors_task,               "Sensors task",  8192,  TASK_CLASS_REALTIME,
+    CONFIG_TASK_SENSORS_DEADLINE_MS, &sensors_task_handle },
+  { firebase_task,              "Firebase task", 16384, TASK_CLASS_BACKGROUND,
+    CONFIG_TASK_FIREBASE_DEADLINE_MS, &firebase_task_handle },
+  { command_task,               "Command task",  8192,  TASK_CLASS_BACKGROUND,
+    CONFIG_TASK_COMMAND_DEADLINE_MS, &command_task_handle },
+  { led_task,                   "LED task",      4096,  TASK_CLASS_BACKGROUND,
+    CONFIG_TASK_LED_DEADLINE_MS, &led_task_handle },
+  { monitor_task,               "Monitor task",  4096,  TASK_CLASS_BACKGROUND,
+    CONFIG_TASK_MONITOR_DEADLINE_MS, &monitor_task_handle },
+  { deferred_log_task,          "Log task",      4096,  TASK_CLASS_BACKGROUND,
+    CONFIG_TASK_LOG_DEADLINE_MS, &log_task_handle },
+};
 /*
 
 App entry point
@@ -183,15 +236,25 @@ App entry point
 */
 void app_main(void)
 {
+  // Hot path logging goes through the deferred logger, set it up before anything uses it
+  ESP_ERROR_CHECK(deferred_log_init());
+  // Same for the latency histograms, the tasks record into them from their first cycle
+  ESP_ERROR_CHECK(cycle_profiler_init(NULL));
+
   // Create our event groups and queues
   s_wifi_event_group = xEventGroupCreate();
-  task_control_events = xEventGroupCreate();
-  firebase_queue = xQueueCreate(10, sizeof(firebase_data_struct));
+  ESP_ERROR_CHECK(uplink_queue_init(&uplink));
   sensor_queue = xQueueCreate(10, sizeof(sensor_data_struct));
   env_ctrl_queue = xQueueCreate(10, sizeof(status_data_struct));
-  sensor_timer_handle = xTimerCreate("Sensor timer", CONFIG_FREERTOS_HZ, pdTRUE, 
-                                    &sensor_timer_id, sensor_timer_callback);
 
+#if CONFIG_IDF_TARGET_LINUX
+  // Host build: the loopback network is always up and the host clock is already set
+  simulation_init();
+  xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+  setenv("TZ", "PST8PDT,M3.2.0,M11.1.0", 1); // America/Los_Angles TZ string
+  tzset();
+  time(&now);
+#else
   //Initialize NVS, needed for WiFi
   esp_err_t ret = nvs_flash_init();
 
@@ -226,16 +289,46 @@ void app_main(void)
     time(&now);
     localtime_r(&now, &timeinfo);
   }
+#endif
 
   // Get the start time
   global_start_time = now;
   localtime_r(&now, &global_start_time_info);
 
-  // Create RTOS threads
-  xTaskCreate(firebase_task, "Firebase task", 16384, NULL, 5, &firebase_task_handle);
-  xTaskCreate(led_task, "LED task", 4096, NULL, 5, &led_task_handle);
-  xTaskCreate(sensors_task, "Sensors task", 8192, NULL, 5, &sensors_task_handle);
-  xTaskCreate(environmental_control_task, "Env ctrl task", 8192, NULL, 5, &environmental_control_task_handle);
+#if CONFIG_ENV_REPLAY
+  // Benchmark the controller against a trace instead of running the firmware
+  env_replay_report_struct replay_report;
+  exit((env_replay_run(&env_ctrl, &fan, &lights, &pdlc, &replay_report) == ESP_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
+#if CONFIG_METRICS_BENCHMARK
+  // Check and time the derived air metrics, then stop
+  metrics_bench_report_struct bench_report;
+  exit((metrics_bench_run(&bench_report) == ESP_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
+#if CONFIG_JSON_NUMBER_BENCHMARK
+  // Check and time JSON number printing, then stop
+  json_bench_report_struct json_report;
+  exit((json_bench_run(&json_report) == ESP_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
+#if CONFIG_JSON_DIFF_BENCHMARK
+  // Check and time JSON diffing and patching, then stop
+  json_diff_bench_report_struct diff_report;
+  exit((json_bench_diff_run(&diff_report) == ESP_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
+#if CONFIG_JSON_PARSER_BENCHMARK
+  // Time json_parser lookups in wide objects, then stop
+  json_parser_bench_report_struct parser_report;
+  exit((json_bench_parser_run(&parser_report) == ESP_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
+
+  // Create RTOS threads, pinned and prioritized per the task plan
+  ESP_ERROR_CHECK(task_placement_init(&placement, task_plan, sizeof(task_plan) / sizeof(task_plan[0]),
+                    CONFIG_TASK_REALTIME_CORE, CONFIG_TASK_BACKGROUND_CORE, CONFIG_TASK_BASE_PRIORITY));
+  ESP_ERROR_CHECK(placement.create_tasks());
 
   // This "main" task will exit and be cleaned up automatically
 }
@@ -248,16 +341,16 @@ FreeRTOS tasks
 */
 void led_task(void* arg)
 {
-  uint32_t index = 0;
   bool led_state = false;
 
-  configure_led();
+  ESP_LOGI(LED_TAG, "Application configured to blink addressable LED!");
+  ESP_ERROR_CHECK(platform_status_led_init(CONFIG_BLINK_GPIO));
 
   while (1) {
-    red = (uint8_t) (esp_random() % 24);
-    green = (uint8_t) (esp_random() % 24);
-    blue = (uint8_t) (esp_random() % 24);
-    blink_led(index, red, green, blue, led_state);
+    red = (uint8_t) (platform_random() % 24);
+    green = (uint8_t) (platform_random() % 24);
+    blue = (uint8_t) (platform_random() % 24);
+    platform_status_led_set(red, green, blue, led_state);
     led_state = !led_state;
     vTaskDelay(50);
   }
@@ -266,27 +359,50 @@ void led_task(void* arg)
 void firebase_task(void *arg)
 {
   firebase_data_struct firebase_data = {0};
+  esp_err_t return_code = ESP_OK;
 
-  firebase_init(&fb, FIREBASE_URL, &firebase_queue);
+  firebase_init(&fb, FIREBASE_URL, &uplink);
   while(1) {
-    // Wait until we get a message from the enviromental control task
-    xQueueReceive(firebase_queue, &firebase_data, portMAX_DELAY);
+    // Wait until we get a message from the enviromental control task, alarms first
+    if (!uplink.pop(&firebase_data, portMAX_DELAY)) {
+      continue;
+    }
+    cycle_profiler_record_since(STAGE_UPLINK_QUEUE_WAIT, firebase_data.queued_time_us);
 
     // Send the data to firebase
-    fb.send_data(&firebase_data);
+    return_code = fb.send_data(&firebase_data);
+    uplink.delivered(&firebase_data, return_code);
+    if (return_code != ESP_OK) {
+      vTaskDelay(pdMS_TO_TICKS(UPLINK_RETRY_DELAY_MS));
+    }
   }
 }
 
+void command_task(void *arg)
+{
+  // Commands go to the controller, so wait for the control task to set it up as well
+  xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | CONTROL_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+
+  ESP_ERROR_CHECK(command_stream_init(&commands, FIREBASE_COMMAND_URL, &env_ctrl));
+
+  // Never returns, the stream is reconnected whenever it drops
+  commands.run();
+}
+
 void sensors_task(void* arg)
 {
   sensor_data_struct  sensor_data = {0};
   struct bme280_data  env_sensor_readings = {0};
   UV_converted_values uv_readings = {0};
   esp_err_t           return_code;
-  EventBits_t         status_bit = 0;
+  EventBits_t         wifi_status = 0;
+  int64_t             cycle_start_us = 0;
+  int64_t             stage_start_us = 0;
+  struct timeval      cycle_start_tv;
 
   // Initialize I2C as master
-  ESP_ERROR_CHECK(i2c_master_init());
+  ESP_ERROR_CHECK(platform_i2c_master_init(CONFIG_I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA, CONFIG_I2C_MASTER_SCL,
+                    CONFIG_I2C_FAST_MODE));
   ESP_LOGI(SENSOR_TAG, "I2C initialized successfully");
 
   vTaskDelay(10);
@@ -295,28 +411,39 @@ void sensors_task(void* arg)
   return_code = uv_sensor_init(&uv, CONFIG_I2C_MASTER_NUM, GAIN_256x, MS_64);
   if (return_code != ESP_OK) {
     vTaskDelay(2000);
-    esp_restart();
+    platform_restart();
   }
 
   vTaskDelay(10);
 
   // Initialize the BME280 Environmental sensor
-  return_code = enviromental_sensor_init(&env, (((1 / portTICK_PERIOD_MS) / 25) + 1) /* 25Hz */, I2C_NUM_0);
+  return_code = enviromental_sensor_init(&env, (((1 / portTICK_PERIOD_MS) / 25) + 1) /* 25Hz */,
+                  CONFIG_I2C_MASTER_NUM);
   if (return_code != ESP_OK) {
     vTaskDelay(2000);
-    esp_restart();
+    platform_restart();
   }
 
   // Initialize the soil sensor
   // TODO: identify the soil dry/wet vals and put them here
-  return_code = soil_sensor_init(&soil, CONFIG_SOIL_SENSOR_ADC_UNIT, CONFIG_SOIL_SENSOR_ADC_CHANNEL, ADC_ATTEN_DB_11);
+  return_code = soil_sensor_init(&soil, CONFIG_SOIL_SENSOR_ADC_UNIT, CONFIG_SOIL_SENSOR_ADC_CHANNEL,
+                  PLATFORM_ADC_ATTEN_DB_11);
   if (return_code != ESP_OK) {
     vTaskDelay(2000);
-    esp_restart();
+    platform_restart();
   }
 
-  // Start the sensor timer
-  xTimerStart(sensor_timer_handle, 1);
+  // Start the sample scheduler -- cycles are released on absolute deadlines by esp_timer
+  return_code = sample_scheduler_init(&sampler, CONFIG_SENSOR_SAMPLE_RATE_MILLIHZ, xTaskGetCurrentTaskHandle());
+  if (return_code != ESP_OK) {
+    vTaskDelay(2000);
+    platform_restart();
+  }
+  return_code = sampler.start();
+  if (return_code != ESP_OK) {
+    vTaskDelay(2000);
+    platform_restart();
+  }
 
   while(1) {
     // Zero out the structs to start fresh
@@ -324,40 +451,57 @@ void sensors_task(void* arg)
     memset(&env_sensor_readings, 0, sizeof(struct bme280_data));
     memset(&uv_readings, 0, sizeof(UV_converted_values));
 
-    // Wait until we get the event flag set by the timer before running
-    status_bit = xEventGroupWaitBits(task_control_events, SENSOR_CYCLE_START_BIT, pdTRUE,
-                       pdTRUE, 1000);
-                      
-    if (!(status_bit & SENSOR_CYCLE_START_BIT)) {
+    // Wait until the scheduler releases the next cycle before running
+    if (!sampler.wait_for_cycle(pdMS_TO_TICKS(10000), &cycle_start_us)) {
+      continue;
+    }
+
+    // Stamp the sample at acquisition start
+    gettimeofday(&cycle_start_tv, NULL);
+    sensor_data.acquisition_time_us = cycle_start_us;
+    sensor_data.timestamp = cycle_start_tv.tv_sec;
+
+    // Check that we are connected to WiFi
+    wifi_status = xEventGroupGetBits(s_wifi_event_group);
+    if (!(wifi_status & WIFI_CONNECTED_BIT)) {
+      DLOG(DLOG_SENSOR_NO_WIFI);
+      sampler.end_cycle();
       continue;
     }
 
     // Get BME280 readings
+    stage_start_us = esp_timer_get_time();
     return_code = env.get_readings(&env_sensor_readings);
+    cycle_profiler_record_since(STAGE_BME280_READ, stage_start_us);
 
     // Log results
-    ESP_LOGI(SENSOR_TAG, "Environmental sensor readings: Temp = %.3lf degC, Pres = %.3lf hPa, Rh = %.3lf %%",
-      env_sensor_readings.temperature, env_sensor_readings.pressure, env_sensor_readings.humidity);
+    DLOG(DLOG_SENSOR_BME280, env_sensor_readings.temperature, env_sensor_readings.pressure,
+      env_sensor_readings.humidity);
     // Copy to sensor_data_struct
     memcpy(&(sensor_data.bme280_data), &env_sensor_readings, sizeof(struct bme280_data));
+    // VPD, dew point and the rest, for the controller and the uplink
+    environmental_control_derive(&sensor_data);
 
     // Gather UV sensor readings
+    stage_start_us = esp_timer_get_time();
     return_code = uv.get_readings(&uv_readings);
-    ESP_LOGI(SENSOR_TAG, "UV sensor readings: UV A = %.3lf uW/cm^2, UV B = %.3lf uW/cm^2, UV C = %.3lf uW/cm^2",
-      uv_readings.UV_A, uv_readings.UV_B, uv_readings.UV_C);
+    cycle_profiler_record_since(STAGE_UV_READ, stage_start_us);
+    DLOG(DLOG_SENSOR_UV, uv_readings.UV_A, uv_readings.UV_B, uv_readings.UV_C);
     // Copy to sensor_data_struct
     memcpy(&(sensor_data.uv_data), &uv_readings, sizeof(UV_converted_values));
 
     // Gather soil sensor readings
+    stage_start_us = esp_timer_get_time();
     sensor_data.soil_wetness = soil.get_reading();
-    ESP_LOGI(SENSOR_TAG, "Soil sensor reading: %u", sensor_data.soil_wetness);
-
-    // Throw in the timestamp
-    time(&now);
-    sensor_data.timestamp = now;
+    cycle_profiler_record_since(STAGE_SOIL_READ, stage_start_us);
+    DLOG(DLOG_SENSOR_SOIL, (uint32_t) sensor_data.soil_wetness);
 
     // Send the sensor data to the environmental_control_task
+    sensor_data.queued_time_us = esp_timer_get_time();
     xQueueGenericSend(sensor_queue, &sensor_data, 1, queueSEND_TO_BACK);
+    xTaskNotify(environmental_control_task_handle, ENV_EVENT_SAMPLE, eSetBits);
+
+    sampler.end_cycle();
   }
 }
 
@@ -367,30 +511,186 @@ void environmental_control_task(void *arg)
   sensor_data_struct sensor_data = {0};
   status_data_struct status_data = {0};
   firebase_data_struct firebase_data = {0};
+  int64_t stage_start_us = 0;
+  uint32_t events = 0;
 
-  return_code = environmental_control_init(&env_ctrl, &fan, &lights, &pdlc);
+  // Run from this task so the controller's timer events are notified here
+  return_code = environmental_control_init(&env_ctrl, &fan, &lights, &pdlc, NULL);
+  if (return_code != ESP_OK) {
+    ESP_LOGE(ENV_CONTROL, "Environmental control init failed: %s", esp_err_to_name(return_code));
+    vTaskDelay(2000);
+    platform_restart();
+  }
+  uplink_status = env_ctrl.get_statuses();
+  xEventGroupSetBits(s_wifi_event_group, CONTROL_READY_BIT);
 
   while(1) {
 
-    // Wait until we get a message with sensor data
-    xQueueReceive(sensor_queue, &sensor_data, portMAX_DELAY);
+    // Wait until a sample is queued or the controller has a timer event
+    xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
 
-    // Make enviromental changes (fan, pdlc, lights) as needed based on sensor data and set thresholds
-    env_ctrl.process_env_data(sensor_data);
-
-    // Gather statuses of the fan, pdlc, lights
+    // Timer events first, they belong to the samples before the ones waiting
+    env_ctrl.handle_events(events);
     status_data = env_ctrl.get_statuses();
-    
-    // Assemble the firebase data struct
-    memcpy(&(firebase_data.sensor_data), &sensor_data, sizeof(sensor_data_struct));
-    memcpy(&(firebase_data.status_data), &status_data, sizeof(status_data_struct));
+    push_uplink_events(&sensor_data, &status_data);
+
+    while (xQueueReceive(sensor_queue, &sensor_data, 0) == pdTRUE) {
+      stage_start_us = esp_timer_get_time();
+      cycle_profiler_record(STAGE_QUEUE_WAIT, stage_start_us - sensor_data.queued_time_us);
+
+      // Make enviromental changes (fan, pdlc, lights) as needed based on sensor data and set thresholds
+      env_ctrl.process_env_data(sensor_data);
+
+      // Gather statuses of the fan, pdlc, lights
+      status_data = env_ctrl.get_statuses();
+      cycle_profiler_record_since(STAGE_CONTROL, stage_start_us);
+
+      // Alarms and transitions this sample caused go out ahead of it
+      push_uplink_events(&sensor_data, &status_data);
 
-    // Send the message to the firebase task
-    xQueueSend(firebase_queue, &firebase_data, 1);
+      // Assemble the firebase data struct
+      memcpy(&(firebase_data.sensor_data), &sensor_data, sizeof(sensor_data_struct));
+      memcpy(&(firebase_data.status_data), &status_data, sizeof(status_data_struct));
+      firebase_data.uplink_class = UPLINK_CLASS_TELEMETRY;
+
+      // Send the message to the firebase task
+      firebase_data.queued_time_us = esp_timer_get_time();
+      uplink.push(&firebase_data);
+    }
   }
 }
 
+void monitor_task(void *arg)
+{
+  sample_stats_struct sample_stats = {0};
+  dlog_stats_struct   log_stats = {0};
+  command_stream_stats_struct command_stats = {0};
+  uplink_class_stats_struct uplink_stats = {0};
+#if CONFIG_IDF_TARGET_LINUX
+  sim_net_stats_struct net_stats = {0};
+#endif
+  TickType_t          next_report = xTaskGetTickCount() + pdMS_TO_TICKS(CONFIG_TASK_STATS_PERIOD_S * 1000);
+  TickType_t          now_ticks = 0;
+
+  // Latency histogram dumps requested with cycle_profiler_request_dump() are run here
+  cycle_profiler_set_dump_task(xTaskGetCurrentTaskHandle());
 
+  while (1) {
+    now_ticks = xTaskGetTickCount();
+    if (((int32_t)(next_report - now_ticks) > 0) &&
+        (ulTaskNotifyTake(pdTRUE, next_report - now_ticks) > 0)) {
+      cycle_profiler_dump();
+      continue;
+    }
+    next_report += pdMS_TO_TICKS(CONFIG_TASK_STATS_PERIOD_S * 1000);
+
+    // Per-task CPU time, including how much non-real-time work landed on the real-time core
+    placement.log_cpu_usage();
+
+    // Sampling jitter
+    sample_stats = sampler.get_stats();
+    if (sample_stats.cycles > 0) {
+      ESP_LOGI(MONITOR_TAG, "Sampling: %" PRIu32 " cycles, jitter min/avg/max = %" PRId64 "/%" PRId64 "/%" PRId64
+        " us, overruns = %" PRIu32 ", missed = %" PRIu32, sample_stats.cycles, sample_stats.min_jitter_us,
+        sample_stats.total_jitter_us / sample_stats.cycles, sample_stats.max_jitter_us,
+        sample_stats.overruns, sample_stats.missed_deadlines);
+    }
+
+    // Deferred logger health
+    log_stats = deferred_log_get_stats();
+    ESP_LOGI(MONITOR_TAG, "Deferred log: %" PRIu32 " written, %" PRIu32 " dropped, max depth %" PRIu32,
+      log_stats.written, log_stats.dropped, log_stats.max_depth);
+
+    // Uplink, per class
+    for (int i = 0; i < UPLINK_CLASS_COUNT; i++) {
+      uplink_stats = uplink.get_stats(i);
+      ESP_LOGI(MONITOR_TAG, "Uplink %s: %" PRIu32 " queued, %" PRIu32 " sent, %" PRIu32 " dropped, %" PRIu32
+        " merged, %" PRIu32 " retries, max depth %" PRIu32 ", latency avg/max = %" PRIu64 "/%" PRIu32 " us",
+        uplink_class_name(i), uplink_stats.queued, uplink_stats.delivered, uplink_stats.dropped,
+        uplink_stats.coalesced, uplink_stats.retries, uplink_stats.max_depth,
+        (uplink_stats.delivered > 0) ? (uplink_stats.total_latency_us / uplink_stats.delivered) : 0,
+        uplink_stats.max_latency_us);
+    }
+
+    // Downlink commands
+    if (commands.get_stats != NULL) {
+      command_stats = commands.get_stats();
+      ESP_LOGI(MONITOR_TAG, "Commands: %" PRIu32 " connects, %" PRIu32 " received, %" PRIu32 " applied (last %" PRIu32
+        "), %" PRIu32 " duplicate, %" PRIu32 " rejected", command_stats.connects, command_stats.commands,
+        command_stats.applied, command_stats.last_id, command_stats.duplicates, command_stats.rejected);
+    }
+
+    // Actuator switching, and how often the dwell times held a request back
+    for (int i = 0; i < ENV_ACTUATOR_COUNT; i++) {
+      ESP_LOGI(MONITOR_TAG, "Actuator %s: %" PRIu32 " transitions, %" PRIu32 " held requests",
+        env_ctrl.actuators[i].name, env_ctrl.actuators[i].transitions, env_ctrl.actuators[i].held_requests);
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    // What the firmware drove into the simulated greenhouse
+    net_stats = sim_net_get_stats();
+    ESP_LOGI(MONITOR_TAG, "Sim: %" PRIu32 " uplink messages (%" PRIu64 " bytes), transitions fan/lights/pdlc = %"
+      PRIu32 "/%" PRIu32 "/%" PRIu32, net_stats.requests, net_stats.bytes, sim_gpio_get_transitions(CONFIG_FAN_1_GPIO),
+      sim_gpio_get_transitions(CONFIG_LIGHTS_GPIO), sim_gpio_get_transitions(CONFIG_PDLC_GPIO));
+#endif
+  }
+}
+
+
+/*!
+ * Queue an alarm for each over temperature or humidity raised or cleared and each time the fan
+ * runs are given up on, and a transition for each actuator switched, since the last call
+ */
+static void push_uplink_events(const sensor_data_struct *sensor_data, const status_data_struct *status_data)
+{
+  if (env_ctrl.over_temp != uplink_over_temp) {
+    uplink_over_temp = env_ctrl.over_temp;
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_ALARM, UPLINK_EVENT_OVER_TEMPERATURE, 0,
+      uplink_over_temp);
+  }
+  if (env_ctrl.over_humidity != uplink_over_humidity) {
+    uplink_over_humidity = env_ctrl.over_humidity;
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_ALARM, UPLINK_EVENT_OVER_HUMIDITY, 0,
+      uplink_over_humidity);
+  }
+  if (env_ctrl.fan_give_ups != uplink_fan_give_ups) {
+    uplink_fan_give_ups = env_ctrl.fan_give_ups;
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_ALARM, UPLINK_EVENT_FAN_GIVE_UP, 0, true);
+  }
+
+  if (status_data->fan_state != uplink_status.fan_state) {
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_TRANSITION, UPLINK_EVENT_ACTUATOR, ENV_ACTUATOR_FAN,
+      status_data->fan_state == ON);
+  }
+  if (status_data->lights_state != uplink_status.lights_state) {
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_TRANSITION, UPLINK_EVENT_ACTUATOR,
+      ENV_ACTUATOR_LIGHTS, status_data->lights_state == ON);
+  }
+  if (status_data->pdlc_state != uplink_status.pdlc_state) {
+    push_uplink_event(sensor_data, status_data, UPLINK_CLASS_TRANSITION, UPLINK_EVENT_ACTUATOR, ENV_ACTUATOR_PDLC,
+      status_data->pdlc_state == ON);
+  }
+  uplink_status = *status_data;
+}
+
+static void push_uplink_event(const sensor_data_struct *sensor_data, const status_data_struct *status_data,
+              uplink_class_t uplink_class, uplink_event_t type, uint8_t actuator, bool on)
+{
+  firebase_data_struct message = {0};
+
+  memcpy(&(message.sensor_data), sensor_data, sizeof(sensor_data_struct));
+  memcpy(&(message.status_data), status_data, sizeof(status_data_struct));
+  message.uplink_class = uplink_class;
+  message.event.type = type;
+  message.event.actuator = actuator;
+  message.event.on = on;
+  message.queued_time_us = esp_timer_get_time();
+
+  uplink.push(&message);
+}
+
+
+#if !CONFIG_IDF_TARGET_LINUX
 /*
 
 Event handlers
@@ -427,22 +727,6 @@ Static functions
 
 //
 // Initialization functions
-static void configure_led(void)
-{
-  ESP_LOGI(LED_TAG, "Application configured to blink addressable LED!");
-  /* LED strip initialization with the GPIO and pixels number*/
-  led_strip_config_t strip_config = {
-      .strip_gpio_num = CONFIG_BLINK_GPIO,
-      .max_leds = 1, // at least one LED on board
-  };
-  led_strip_rmt_config_t rmt_config = {
-      .resolution_hz = 10 * 1000 * 1000, // 10MHz
-  };
-  ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
-  /* Set all LED off to clear all pixels */
-  led_strip_clear(led_strip);
-}
-
 static void wifi_init_sta(void)
 {
   s_wifi_event_group = xEventGroupCreate();
@@ -507,39 +791,8 @@ static void wifi_init_sta(void)
   }
 }
 
-static esp_err_t i2c_master_init(void)
-{
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = CONFIG_I2C_MASTER_SDA,
-        .scl_io_num = CONFIG_I2C_MASTER_SCL,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = CONFIG_I2C_FAST_MODE
-    };
-
-    i2c_param_config(I2C_NUM_0, &conf);
-
-    return i2c_driver_install(I2C_NUM_0, I2C_MODE_MASTER, CONFIG_I2C_MASTER_RX_BUF, CONFIG_I2C_MASTER_TX_BUF, 0);
-}
-
 //
 // Helper functions
-static void blink_led(uint32_t index, uint8_t red, uint8_t green, uint8_t blue, bool led_state)
-{
-  /* If the addressable LED is enabled */
-  if (led_state) {
-      /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
-      led_strip_set_pixel(led_strip, index, red, green, blue);
-      /* Refresh the strip to send data */
-      led_strip_refresh(led_strip);
-  } else {
-      /* Set all LED off to clear all pixels */
-      led_strip_clear(led_strip);
-  }
-}
-
-
 void time_sync_notification_cb(struct timeval *tv)
 {
   // Just prints a message that time sync has occured
@@ -581,20 +834,24 @@ static void obtain_time(void)
   strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
   ESP_LOGI(SNTP_TAG, "The current date/time is: %s", strftime_buf);
 }
+#endif /* !CONFIG_IDF_TARGET_LINUX */
 
-static void sensor_timer_callback(TimerHandle_t xTimer)
+#if CONFIG_IDF_TARGET_LINUX
+/*!
+ * Wire the simulated greenhouse to the actuator pins and the soil probe's ADC channel
+ */
+static void simulation_init(void)
 {
-  EventBits_t wifi_status = xEventGroupGetBits(s_wifi_event_group);
-  // Sanity check that another timer didn't magically fire this callback
-  if (*(uint32_t*)pvTimerGetTimerID(xTimer) != sensor_timer_id) {
-    return;
-  }
+  sim_world_config_struct config = {
+    .fan_gpio = CONFIG_FAN_1_GPIO,
+    .lights_gpio = CONFIG_LIGHTS_GPIO,
+    .pdlc_gpio = CONFIG_PDLC_GPIO,
+    .soil_adc_unit = CONFIG_SOIL_SENSOR_ADC_UNIT,
+    .soil_adc_channel = CONFIG_SOIL_SENSOR_ADC_CHANNEL,
+    .time_scale = CONFIG_SIM_TIME_SCALE,
+    .start_hour = CONFIG_SIM_START_HOUR
+  };
 
-  // Check that we are connected to WiFi
-  if (wifi_status & WIFI_CONNECTED_BIT) {
-    ESP_LOGI(SENSOR_TAG, "Sensor loop starting.");
-    xEventGroupSetBits(task_control_events, SENSOR_CYCLE_START_BIT);
-  } else {
-    ESP_LOGE(WIFI_TAG, "WiFi not connected, unable to run sensor tasks.");
-  }
+  sim_world_init(&config);
 }
+#endif
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "psychrometrics.h"
+#include "metrics_bench.h"
+
+#define BENCH_STEP_C          0.01
+#define BENCH_STEP_PCT        1.0
+#define BENCH_TIMING_POINTS   4096
+#define BENCH_TIMING_ROUNDS   256
+
+// Magnus coefficients behind the saturation table, see psychrometrics.h
+#define MAGNUS_A              0.61094
+#define MAGNUS_B              17.625
+#define MAGNUS_C              243.04
+
+// Logger tag
+static const char *BENCH_TAG = "Metrics bench";
+
+// Keeps the timed loops from being optimized away
+static volatile float bench_sink = 0;
+
+// Private functions
+static void libm_derive(float temperature_c, float humidity_pct, derived_metrics_struct *metrics);
+static double time_derive(void (*derive)(float, float, derived_metrics_struct *), const float *temperatures,
+  const float *humidities);
+
+
+/*!
+ * Errors over -40 .. 60 degC in 0.01 degC steps and 1 .. 100 %Rh, then the time per sample of
+ * the table and of libm over typical greenhouse readings.
+ */
+esp_err_t metrics_bench_run(metrics_bench_report_struct *report)
+{
+  static float temperatures[BENCH_TIMING_POINTS];
+  static float humidities[BENCH_TIMING_POINTS];
+  derived_metrics_struct metrics;
+  uint32_t noise_state = 1;
+  bool passed = false;
+
+  memset(report, 0, sizeof(metrics_bench_report_struct));
+
+  for (double temperature = PSYCHRO_TABLE_MIN_C; temperature <= PSYCHRO_TABLE_MAX_C; temperature += BENCH_STEP_C) {
+    double saturation = MAGNUS_A * exp(MAGNUS_B * temperature / (temperature + MAGNUS_C));
+
+    for (double humidity = BENCH_STEP_PCT; humidity <= 100.0; humidity += BENCH_STEP_PCT) {
+      double vapour = saturation * humidity / 100.0;
+      double exponent = log(vapour / MAGNUS_A);
+      double dew_point = MAGNUS_C * exponent / (MAGNUS_B - exponent);
+      double absolute_humidity = 2166.8 * vapour / (temperature + 273.15);
+
+      psychrometrics_derive((float) temperature, (float) humidity, &metrics);
+      report->saturation_error = fmaxf(report->saturation_error,
+                                   (float) (fabs(metrics.saturation_vp_kpa - saturation) / saturation));
+      report->vpd_error_kpa = fmaxf(report->vpd_error_kpa, (float) fabs(metrics.vpd_kpa - (saturation - vapour)));
+      report->absolute_humidity_error = fmaxf(report->absolute_humidity_error,
+        (float) (fabs(metrics.absolute_humidity_g_m3 - absolute_humidity) / absolute_humidity));
+      // Dew points below the table are clamped, not worked out
+      if (dew_point >= PSYCHRO_TABLE_MIN_C) {
+        report->dew_point_error_c = fmaxf(report->dew_point_error_c, (float) fabs(metrics.dew_point_c - dew_point));
+      }
+      report->points++;
+    }
+  }
+
+  // 0 - 50 degC, 20 - 100 %Rh
+  for (int i = 0; i < BENCH_TIMING_POINTS; i++) {
+    noise_state = (noise_state * 1103515245u) + 12345u;
+    temperatures[i] = 50.0f * (float) (noise_state >> 16) / 65536.0f;
+    noise_state = (noise_state * 1103515245u) + 12345u;
+    humidities[i] = 20.0f + (80.0f * (float) (noise_state >> 16) / 65536.0f);
+  }
+  report->table_ns = time_derive(psychrometrics_derive, temperatures, humidities);
+  report->libm_ns = time_derive(libm_derive, temperatures, humidities);
+
+  passed = (report->saturation_error <= METRICS_BENCH_MAX_SATURATION_ERROR) &&
+           (report->vpd_error_kpa <= METRICS_BENCH_MAX_VPD_ERROR_KPA) &&
+           (report->dew_point_error_c <= METRICS_BENCH_MAX_DEW_POINT_ERROR_C) &&
+           (report->absolute_humidity_error <= METRICS_BENCH_MAX_ABS_HUMIDITY_ERROR);
+
+  ESP_LOGI(BENCH_TAG, "%" PRIu32 " points: saturation %.2g (relative), VPD %.2g kPa, dew point %.2g degC, "
+    "absolute humidity %.2g (relative)", report->points, report->saturation_error, report->vpd_error_kpa,
+    report->dew_point_error_c, report->absolute_humidity_error);
+  ESP_LOGI(BENCH_TAG, "Per sample: table %.1f ns, expf/logf %.1f ns", report->table_ns, report->libm_ns);
+  if (!passed) {
+    ESP_LOGE(BENCH_TAG, "Error over the limit.");
+    return ESP_FAIL;
+  }
+
+  return ESP_OK;
+}
+
+/*!
+ * The same metrics straight from the formula in single precision, what the table replaces
+ */
+static void libm_derive(float temperature_c, float humidity_pct, derived_metrics_struct *metrics)
+{
+  float exponent = 0;
+
+  metrics->saturation_vp_kpa = (float) MAGNUS_A * expf((float) MAGNUS_B * temperature_c /
+                                 (temperature_c + (float) MAGNUS_C));
+  metrics->vapour_pressure_kpa = metrics->saturation_vp_kpa * humidity_pct / 100.0f;
+  metrics->vpd_kpa = metrics->saturation_vp_kpa - metrics->vapour_pressure_kpa;
+  exponent = logf(metrics->vapour_pressure_kpa / (float) MAGNUS_A);
+  metrics->dew_point_c = (float) MAGNUS_C * exponent / ((float) MAGNUS_B - exponent);
+  metrics->absolute_humidity_g_m3 = 2166.8f * metrics->vapour_pressure_kpa / (temperature_c + 273.15f);
+}
+
+/*!
+ * Nanoseconds per call of derive over the points, best of BENCH_TIMING_ROUNDS passes
+ */
+static double time_derive(void (*derive)(float, float, derived_metrics_struct *), const float *temperatures,
+  const float *humidities)
+{
+  derived_metrics_struct metrics;
+  int64_t best_us = INT64_MAX;
+
+  for (int round = 0; round < BENCH_TIMING_ROUNDS; round++) {
+    int64_t start_us = esp_timer_get_time();
+    int64_t elapsed_us = 0;
+    float sum = 0;
+
+    for (int i = 0; i < BENCH_TIMING_POINTS; i++) {
+      derive(temperatures[i], humidities[i], &metrics);
+      sum += metrics.vpd_kpa + metrics.dew_point_c + metrics.absolute_humidity_g_m3;
+    }
+    elapsed_us = esp_timer_get_time() - start_us;
+    bench_sink = sum;
+
+    if (elapsed_us < best_us) {
+      best_us = elapsed_us;
+    }
+  }
+
+  return (double) best_us * 1000.0 / BENCH_TIMING_POINTS;
+}
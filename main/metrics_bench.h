@@ -0,0 +1,29 @@
+#ifndef METRICS_BENCH_H
+#define METRICS_BENCH_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Largest errors accepted against the formula in double precision
+#define METRICS_BENCH_MAX_SATURATION_ERROR  1e-5f   // Relative
+#define METRICS_BENCH_MAX_VPD_ERROR_KPA     1e-4f
+#define METRICS_BENCH_MAX_DEW_POINT_ERROR_C 1e-3f
+#define METRICS_BENCH_MAX_ABS_HUMIDITY_ERROR 1e-4f  // Relative
+
+typedef struct metrics_bench_report {
+  uint32_t  points;                       // Temperature/humidity pairs checked
+  float     saturation_error;             // Worst errors, same units as the limits
+  float     vpd_error_kpa;
+  float     dew_point_error_c;
+  float     absolute_humidity_error;
+  double    table_ns;                     // Per psychrometrics_derive()
+  double    libm_ns;                      // Per the same metrics with expf() and logf()
+} metrics_bench_report_struct;
+
+/*!
+ * Check the derived air metrics across the sensor range and time them against libm.
+ * Host (linux target) builds only -- see CONFIG_METRICS_BENCHMARK.
+ */
+esp_err_t metrics_bench_run(metrics_bench_report_struct *report);
+
+#endif /* METRICS_BENCH_H */